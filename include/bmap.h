@@ -363,7 +363,8 @@ enum bmap_opcnt_types {
 	BMAP_OPCNT_SLVR,		/* IOD sliver */
 	BMAP_OPCNT_TRUNCWAIT,		/* */
 	BMAP_OPCNT_UPSCH,		/* peer update scheduler */
-	BMAP_OPCNT_WORK			/* generic worker thread */
+	BMAP_OPCNT_WORK,		/* generic worker thread */
+	BMAP_OPCNT_WRITEBACK		/* IOD sliver write-back */
 };
 
 RB_HEAD(bmaptree, bmap);
@@ -411,4 +412,64 @@ brepls_init_idx(int *ar)
 		ar[i] = i;
 }
 
+/*
+ * Round a bmap-relative write lease range out to sliver boundaries so
+ * that a sliver, and therefore its CRC, is never written by two clients
+ * holding disjoint ranges.  A zero length denotes the entire bmap.
+ */
+static __inline void
+bmap_wrrange_round(uint32_t *off, uint32_t *len)
+{
+	uint32_t end;
+
+	if (*len == 0 || *off >= SLASH_BMAP_SIZE) {
+		*off = 0;
+		*len = 0;
+		return;
+	}
+	end = MIN(*off + *len, SLASH_BMAP_SIZE);
+	end = (end + SLASH_SLVR_SIZE - 1) / SLASH_SLVR_SIZE *
+	    SLASH_SLVR_SIZE;
+	*off = *off / SLASH_SLVR_SIZE * SLASH_SLVR_SIZE;
+	*len = end - *off;
+	if (*len == SLASH_BMAP_SIZE)
+		*len = 0;
+}
+
+/*
+ * Grow a write lease range to also cover another range.
+ */
+static __inline void
+bmap_wrrange_extend(uint32_t *off, uint32_t *len, uint32_t noff,
+    uint32_t nlen)
+{
+	uint32_t end;
+
+	if (*len == 0)
+		return;
+	bmap_wrrange_round(&noff, &nlen);
+	if (nlen == 0) {
+		*off = 0;
+		*len = 0;
+		return;
+	}
+	end = MAX(*off + *len, noff + nlen);
+	*off = MIN(*off, noff);
+	*len = end - *off;
+	if (*len == SLASH_BMAP_SIZE)
+		*len = 0;
+}
+
+/*
+ * Determine whether a write lease range contains another range.
+ */
+static __inline int
+bmap_wrrange_covers(uint32_t off, uint32_t len, uint32_t noff,
+    uint32_t nlen)
+{
+	if (len == 0)
+		return (1);
+	return (noff >= off && noff + nlen <= off + len);
+}
+
 #endif /* _BMAP_H_ */
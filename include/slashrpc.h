@@ -50,7 +50,7 @@ struct statvfs;
 #define SRMC_BULK_PORTAL	12
 #define SRMC_CTL_PORTAL		13
 
-#define SRMC_VERSION		1
+#define SRMC_VERSION		2
 #define SRMC_MAGIC		UINT64_C(0xaabbccddeeff0022)
 
 /* RPC channel to MDS from MDS. */
@@ -59,7 +59,7 @@ struct statvfs;
 #define SRMM_BULK_PORTAL	17
 #define SRMM_CTL_PORTAL		18
 
-#define SRMM_VERSION		1
+#define SRMM_VERSION		2
 #define SRMM_MAGIC		UINT64_C(0xaabbccddeeff0033)
 
 /* RPC channel to MDS from ION. */
@@ -86,7 +86,7 @@ struct statvfs;
 #define SRIC_BULK_PORTAL	32
 #define SRIC_CTL_PORTAL		33
 
-#define SRIC_VERSION		1
+#define SRIC_VERSION		2
 #define SRIC_MAGIC		UINT64_C(0xaabbccddeeff0066)
 
 /* RPC channel to ION from ION. */
@@ -189,7 +189,13 @@ enum {
 	SRMT_PRECLAIM,				/* 48: partial file reclaim */
 	SRMT_BATCH_RQ,				/* 49: async batch request */
 	SRMT_BATCH_RP,				/* 50: async batch reply */
-	SRMT_CTL				/* 51: generic control */
+	SRMT_CTL,				/* 51: generic control */
+	SRMT_GETATTR_BULK,			/* 52: stat(2) many files at once */
+	SRMT_FIDLEASE,				/* 53: lease a range of FIDs for async creates */
+	SRMT_CREATE_BULK,			/* 54: creat(2) many files at once */
+	SRMT_UNLINK_BULK,			/* 55: unlink(2)/rmdir(2) many entries at once */
+	SRMT_COMPOUND,				/* 56: lookup+getattr+getinode+leasebmap */
+	SRMT_INLINE_IO				/* 57: read/write data held by MDS */
 };
 
 /* ----------------------------- BEGIN MESSAGES ----------------------------- */
@@ -377,11 +383,14 @@ struct srt_inode {
 
 /* namespace update */
 struct srm_update_req {
-	uint64_t		seqno;
+	uint64_t		seqno;		/* xid of first entry to apply */
+	uint64_t		prevxid;	/* last xid of previous request in stream */
 	 int32_t		size;		/* size of the bulk data to follow */
+	 int32_t		rawsize;	/* uncompressed size or zero if raw */
 	 int16_t		count;		/* # of entries to follow */
 	 int16_t		siteid;		/* site ID for tracking purpose */
-/* followed by bulk data of srt_update_entry structures */
+	 int32_t		_pad;
+/* followed by bulk data of srt_update_entry structures, zlib compressed */
 } __packed;
 
 struct srm_update_rep {
@@ -454,11 +463,14 @@ struct srm_leasebmap_req {
 	sl_bmapno_t		bmapno;		/* Starting bmap index number */
 	 int32_t		rw;		/* 'enum rw' value for access */
 	uint32_t		flags;		/* see SRM_LEASEBMAPF_* below */
+	uint32_t		off;		/* write range in bmap (if WRITE) */
+	uint32_t		len;		/* zero for the entire bmap */
 } __packed;
 
 #define SRM_LEASEBMAPF_DIO	(1 << 0)	/* client wants direct I/O */
 #define SRM_LEASEBMAPF_GETINODE	(1 << 1)	/* fetch inode (replica table, etc.) */
 #define SRM_LEASEBMAPF_DATA	(1 << 2)	/* true if any crcstates has SLVR_DATA */
+#define SRM_LEASEBMAPF_INLINE	(1 << 3)	/* CREATE: data held by MDS, no lease */
 
 struct srm_leasebmap_rep {
 	struct srt_bmapdesc	sbd;		/* descriptor for bmap */
@@ -509,12 +521,16 @@ struct srm_getbmap_full_rep {
 struct srm_bmap_chwrmode_req {
 	struct srt_bmapdesc	sbd;
 	sl_ios_id_t		prefios[NPREFIOS];	/* preferred I/O system ID (if WRITE) */
+	uint32_t		off;		/* write range to add to the lease */
+	uint32_t		len;		/* zero for the entire bmap */
 	 int32_t		_pad;
 } __packed;
 
 struct srm_bmap_chwrmode_rep {
 	struct srt_bmapdesc	sbd;
 	 int32_t		rc;
+	uint32_t		off;		/* write range granted */
+	uint32_t		len;		/* zero for the entire bmap */
 	 int32_t		_pad;
 } __packed;
 
@@ -747,6 +763,7 @@ struct srm_set_fattr_req {			/* set non-POSIX file attribute CLI -> MDS */
 
 #define SL_FATTR_IOS_AFFINITY	0
 #define SL_FATTR_REPLPOL	1
+#define SL_FATTR_STRIPED_READ	2
 
 #define srm_set_fattr_rep	srm_generic_rep
 
@@ -797,6 +814,45 @@ struct srm_create_rep {
 	struct srt_bmapdesc	sbd;
 } __packed;
 
+/* maximum number of FIDs a client may lease per FIDLEASE */
+#define SRM_FIDLEASE_MAX	1024
+
+struct srm_fidlease_req {
+	 int32_t		nfids;		/* # of FIDs wanted */
+	 int32_t		_pad;
+} __packed;
+
+struct srm_fidlease_rep {
+	slfid_t			fid;		/* first FID of the range */
+	 int32_t		nfids;		/* # of FIDs granted */
+	 int32_t		rc;
+} __packed;
+
+/* maximum number of entries in a CREATE_BULK */
+#define SRM_CREATE_BULK_MAX	64
+
+struct srm_create_bulk_req {
+	 int32_t		nents;
+	 int32_t		_pad;
+/* srt_create_ent * nents is sent in bulk */
+} __packed;
+
+struct srm_create_bulk_rep {
+	 int32_t		rc;
+	 int32_t		nents;
+	 int32_t		rcs[SRM_CREATE_BULK_MAX];	/* per-entry result */
+} __packed;
+
+struct srt_create_ent {
+	struct sl_fidgen	pfg;		/* parent dir's file ID + generation */
+	slfid_t			fid;		/* leased FID for the new file */
+	struct pfl_timespec	time;		/* time of request */
+	struct srt_creds	owner;		/* st_uid owner for new file */
+	uint32_t		mode;		/* mode_t permission for new file */
+	 int32_t		_pad;
+	char			name[SL_NAME_MAX + 1];
+} __packed;
+
 struct srm_getattr_req {
 	struct sl_fidgen	fg;
 	sl_ios_id_t		iosid;
@@ -809,6 +865,27 @@ struct srm_getattr_rep {
 	 int32_t		rc;
 } __packed;
 
+/*
+ * Maximum number of FIDs in a GETATTR_BULK request: they are carried
+ * inline so the request must fit in SLM_RMC_BUFSZ.
+ */
+#define SRM_GETATTR_BULK_MAX	30
+
+struct srm_getattr_bulk_req {
+	 int32_t		nfids;
+	 int32_t		_pad;
+	struct sl_fidgen	fgs[SRM_GETATTR_BULK_MAX];
+/* srt_getattr_ent * nfids is returned in bulk */
+} __packed;
+
+#define srm_getattr_bulk_rep	srm_generic_rep
+
+struct srt_getattr_ent {
+	struct srt_stat		attr;
+	uint32_t		xattrsize;
+	 int32_t		rc;
+} __packed;
+
 struct srm_getattr2_rep {
 	struct srt_stat		cattr;		/* child node */
 	struct srt_stat		pattr;		/* parent dir */
@@ -816,6 +893,14 @@ struct srm_getattr2_rep {
 	 int32_t		_pad;
 } __packed;
 
+/*
+ * I/O of up to this size carries its data in a second message buffer
+ * of mq->size bytes instead of by bulk, sparing the bulk handshake on
+ * small I/O: a WRITE in the request, a READ flagged SRM_IOF_REPDATA in
+ * the reply.  SLI_RIC_BUFSZ and SLI_RIC_REPSZ leave room for it.
+ */
+#define SRM_IO_INLINE_MAX	4096
+
 struct srm_io_req {
 	struct srt_bmapdesc	sbd;		/* bmap descriptor */
 	uint32_t		ptruncgen;	/* partial trunc gen # */
@@ -826,7 +911,7 @@ struct srm_io_req {
 	uint32_t		offset;		/* relative within bmap */
 	 int32_t		rc;		/* async I/O return code */
 	uint64_t		id;		/* async I/O identifier */
-/* WRITE data is bulk request. */
+/* WRITE data is in request buffer 1 or bulk; see SRM_IO_INLINE_MAX. */
 } __packed;
 
 /* I/O operations */
@@ -837,11 +922,41 @@ struct srm_io_req {
 #define SRM_IOF_APPEND		(1 << 0)	/* ignore offset; position WRITE at EOF */
 #define SRM_IOF_DIO		(1 << 1)	/* direct I/O; no caching */
 #define SRM_IOF_BENCH		(1 << 2)	/* for benchmarking only; junk data */
+#define SRM_IOF_REPDATA		(1 << 3)	/* READ data in reply buffer 1, not bulk */
 
 struct srm_io_rep {
 	uint64_t		id;		/* async I/O identifier */
 	 int32_t		rc;
 	uint32_t		size;
+/* READ data is in reply buffer 1 or bulk; see SRM_IOF_REPDATA. */
+} __packed;
+
+/*
+ * Small files may have their data held by the MDS (see INOF_INLINE)
+ * instead of in bmaps on an IOS.  Such files are accessed with
+ * INLINE_IO until they outgrow the MDS limit, at which point the
+ * client reads the contents back with PROMOTE, writes them to bmap 0,
+ * tells the MDS to drop its copy with COMMIT, and switches to the
+ * regular I/O path.  The file stays inline until the COMMIT.
+ */
+#define SRM_INLINE_MAX		4096		/* largest possible inline file */
+
+struct srm_inline_io_req {
+	struct sl_fidgen	fg;
+	uint32_t		op;		/* SRMIOP_RD or SRMIOP_WR */
+	uint32_t		flags;		/* see SRM_INLINEF_* below */
+	uint32_t		offset;
+	uint32_t		size;
+/* WRITE data is bulk request. */
+} __packed;
+
+#define SRM_INLINEF_PROMOTE	(1 << 0)	/* READ: start conversion to regular bmaps */
+#define SRM_INLINEF_COMMIT	(1 << 1)	/* WRITE: bmap 0 has the data; finish conversion */
+
+struct srm_inline_io_rep {
+	struct srt_stat		attr;
+	 int32_t		rc;
+	uint32_t		size;
 /* READ data is in bulk reply. */
 } __packed;
 
@@ -860,6 +975,39 @@ struct srm_lookup_req {
 
 #define srm_lookup_rep		srm_getattr_rep
 
+/*
+ * COMPOUND chains the usual cold open sequence into one round trip.
+ * Operations run in the order of the SRM_COMPOUNDF_* bits below on
+ * the `current' file, which is 'fg' or, after LOOKUP, the child found
+ * under it.  Processing stops at the first failure.
+ */
+struct srm_compound_req {
+	struct sl_fidgen	fg;		/* parent dir if LOOKUP, else target */
+	char			name[SL_NAME_MAX + 1];/* if LOOKUP */
+	sl_ios_id_t		prefios[NPREFIOS];/* if LEASEBMAP */
+	sl_bmapno_t		bmapno;		/* if LEASEBMAP */
+	uint32_t		ops;		/* see SRM_COMPOUNDF_* below */
+	 int32_t		_pad;
+} __packed;
+
+#define SRM_COMPOUNDF_LOOKUP	(1 << 0)	/* resolve name under 'fg' */
+#define SRM_COMPOUNDF_GETATTR	(1 << 1)	/* stat(2) current file */
+#define SRM_COMPOUNDF_GETINODE	(1 << 2)	/* fetch inode (replica table, etc.) */
+#define SRM_COMPOUNDF_LEASEBMAP	(1 << 3)	/* read lease on 'bmapno' */
+#define SRM_COMPOUNDF_INLINE	(1 << 4)	/* inline data in bulk reply */
+
+struct srm_compound_rep {
+	struct srt_stat		attr;		/* if LOOKUP or GETATTR */
+	uint32_t		xattrsize;
+	uint32_t		ops;		/* SRM_COMPOUNDF_* completed */
+	 int32_t		rc;		/* first failure or 0 */
+	uint32_t		inlsize;	/* if INLINE: length of data */
+	struct srt_inode	ino;		/* if GETINODE */
+	struct srt_bmapdesc	sbd;		/* if LEASEBMAP */
+	uint8_t			repls[SL_REPLICA_NBYTES];
+/* if INLINE, file data is in bulk reply. */
+} __packed;
+
 struct srm_mkdir_req {
 	struct sl_fidgen	pfg;		/* parent dir */
 	char			name[SL_NAME_MAX + 1];
@@ -995,6 +1143,28 @@ struct srm_unlink_rep {
 	 int32_t		rc;
 } __packed;
 
+/* maximum number of entries in an UNLINK_BULK */
+#define SRM_UNLINK_BULK_MAX	64
+
+struct srm_unlink_bulk_req {
+	 int32_t		nents;
+	 int32_t		_pad;
+/* srt_unlink_ent * nents is sent in bulk */
+} __packed;
+
+struct srm_unlink_bulk_rep {
+	 int32_t		rc;
+	 int32_t		nents;
+	 int32_t		rcs[SRM_UNLINK_BULK_MAX];	/* per-entry result */
+} __packed;
+
+struct srt_unlink_ent {
+	slfid_t			pfid;		/* parent dir */
+	 int32_t		isfile;		/* unlink(2) vs. rmdir(2) */
+	 int32_t		_pad;
+	char			name[SL_NAME_MAX + 1];
+} __packed;
+
 struct srm_listxattr_req {
 	struct sl_fidgen	fg;
 	uint32_t		size;
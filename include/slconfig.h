@@ -87,6 +87,7 @@ struct sl_resource {
 	char			 res_name[RES_NAME_MAX];
 	char			*res_desc;	/* human description */
 	struct slcfg_local	*res_localcfg;
+	uint64_t		 res_repl_bw;	/* replication limit, bytes/sec */
 };
 
 /* res_flags */
@@ -151,6 +152,7 @@ struct sl_site {
 	struct psc_listentry	 site_lentry;
 	struct psc_dynarray	 site_resources;
 	sl_siteid_t		 site_id;
+	uint64_t		 site_repl_bw;	/* inter-site repl limit, bytes/sec */
 };
 
 /* highest allowed site ID */
@@ -193,6 +195,10 @@ struct slcfg_local {
 	char			 cfg_prefios[RES_NAME_MAX];
 	char			 cfg_zpname[NAME_MAX + 1];
 	char			*cfg_selftest;
+	int			 cfg_backfs_direct_io;
+	int			 cfg_repl_delta;
+	int			 cfg_write_back;	/* ack writes before disk */
+	size_t			 cfg_write_back_max;
 	int			 cfg_async_io:1;
 	int			 cfg_root_squash:1;
 };
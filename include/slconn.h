@@ -221,26 +221,63 @@ struct sl_expcli_ops {
 
 #define SRPCWAITF_DEFER_BULK_AUTHBUF_CHECK (1 << 0)
 
+#define _SL_RSX_COUNTREQ(op)						\
+	do {								\
+		static struct pfl_opstat *_opst;			\
+									\
+		if (_opst == NULL) {					\
+			const char *_str;				\
+			int _len;					\
+									\
+			_str = strchr(#op, '_') + 1;			\
+			_len = strcspn(_str, ")");			\
+			_opst = pfl_opstat_initf(OPSTF_BASE10,		\
+			    "rpc.issue.%.*s", _len, _str);		\
+		}							\
+		pfl_opstat_incr(_opst);					\
+	} while (0)
+
 #define SL_RSX_NEWREQ(csvc, op, rq, mq, mp)				\
 	_PFL_RVSTART {							\
-		static struct pfl_opstat *_opst;			\
 		int _rc;						\
 									\
 		_rc = (slrpc_ops.slrpc_newreq ?				\
 		    slrpc_ops.slrpc_newreq : slrpc_newgenreq)((csvc),	\
 		    (op), &(rq), sizeof(*(mq)), sizeof(*(mp)), &(mq));	\
-		if (_rc == 0) {						\
-			if (_opst == NULL) {				\
-				const char *_str;			\
-				int _len;				\
+		if (_rc == 0)						\
+			_SL_RSX_COUNTREQ(op);				\
+		_rc;							\
+	} _PFL_RVEND
+
+/*
+ * Like SL_RSX_NEWREQ() but with a second request buffer of @dlen bytes
+ * for a small payload, which is returned in @data.
+ */
+#define SL_RSX_NEWREQD(csvc, op, rq, mq, mp, dlen, data)		\
+	_PFL_RVSTART {							\
+		int _rc;						\
 									\
-				_str = strchr(#op, '_') + 1;		\
-				_len = strcspn(_str, ")");		\
-				_opst = pfl_opstat_initf(OPSTF_BASE10,	\
-				    "rpc.issue.%.*s", _len, _str);	\
-			}						\
-			pfl_opstat_incr(_opst);				\
-		}							\
+		_rc = slrpc_newdatareq((csvc), (op), &(rq),		\
+		    sizeof(*(mq)), sizeof(*(mp)), &(mq), (dlen), 0,	\
+		    &(data));						\
+		if (_rc == 0)						\
+			_SL_RSX_COUNTREQ(op);				\
+		_rc;							\
+	} _PFL_RVEND
+
+/*
+ * Like SL_RSX_NEWREQ() but with room for a second reply buffer of
+ * @dlen bytes for a small payload.
+ */
+#define SL_RSX_NEWREQDREP(csvc, op, rq, mq, mp, dlen)			\
+	_PFL_RVSTART {							\
+		int _rc;						\
+									\
+		_rc = slrpc_newdatareq((csvc), (op), &(rq),		\
+		    sizeof(*(mq)), sizeof(*(mp)), &(mq), 0, (dlen),	\
+		    NULL);						\
+		if (_rc == 0)						\
+			_SL_RSX_COUNTREQ(op);				\
 		_rc;							\
 	} _PFL_RVEND
 
@@ -411,6 +448,8 @@ int	 slrpc_handle_connect(struct pscrpc_request *, uint64_t,
 
 int	 slrpc_newgenreq(struct slashrpc_cservice *, int,
 	    struct pscrpc_request **, int, int, void *);
+int	 slrpc_newdatareq(struct slashrpc_cservice *, int,
+	    struct pscrpc_request **, int, int, void *, int, int, void *);
 
 int	 slrpc_waitrep(struct slashrpc_cservice *,
 	    struct pscrpc_request *, int, void *, int);
@@ -68,9 +68,9 @@
 /* 28 - reuse */
 /* 29 - reuse */
 #define SLERR_RES_BADTYPE		(_SLERR_START + 30)
-/* 31 - reuse me */
-/* 32 - reuse me */
-/* 33 - reuse me */
+#define SLERR_INLINE			(_SLERR_START + 31)
+#define SLERR_NOTINLINE			(_SLERR_START + 32)
+#define SLERR_INLINE_FULL		(_SLERR_START + 33)
 #define SLERR_CRCABSENT			(_SLERR_START + 34)
 /* 35 - reuse me */
 /* 36 - reuse me */
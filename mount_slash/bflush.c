@@ -298,19 +298,33 @@ bmap_flush_create_rpc(struct bmpc_write_coalescer *bwc,
 	struct srm_io_req *mq;
 	struct srm_io_rep *mp;
 	struct sl_resm *m;
-	int rc;
+	unsigned char *data;
+	int i, rc;
 
 	m = libsl_ios2resm(bmap_2_ios(b));
 	rmci = resm2rmci(m);
 
-	rc = SL_RSX_NEWREQ(csvc, SRMT_WRITE, rq, mq, mp);
-	if (rc)
-		goto out;
-
-	rc = slrpc_bulkclient(rq, BULK_GET_SOURCE, SRIC_BULK_PORTAL,
-	    bwc->bwc_iovs, bwc->bwc_niovs);
-	if (rc)
-		goto out;
+	if (bwc->bwc_size <= SRM_IO_INLINE_MAX) {
+		/* Small enough to ride in the request itself. */
+		rc = SL_RSX_NEWREQD(csvc, SRMT_WRITE, rq, mq, mp,
+		    bwc->bwc_size, data);
+		if (rc)
+			goto out;
+		for (i = 0; i < bwc->bwc_niovs; i++) {
+			memcpy(data, bwc->bwc_iovs[i].iov_base,
+			    bwc->bwc_iovs[i].iov_len);
+			data += bwc->bwc_iovs[i].iov_len;
+		}
+		OPSTAT_INCR("flush-write-inline");
+	} else {
+		rc = SL_RSX_NEWREQ(csvc, SRMT_WRITE, rq, mq, mp);
+		if (rc)
+			goto out;
+		rc = slrpc_bulkclient(rq, BULK_GET_SOURCE,
+		    SRIC_BULK_PORTAL, bwc->bwc_iovs, bwc->bwc_niovs);
+		if (rc)
+			goto out;
+	}
 
 	rq->rq_timeout = msl_bmap_lease_secs_remaining(b);
 
@@ -41,8 +41,13 @@
 #include "slconfig.h"
 #include "slerr.h"
 
+#include "slashd/inode.h"
+
 int bmap_max_cache = BMAP_CACHE_MAX;
 
+/* confine write leases to the range of the bmap being written */
+psc_atomic32_t slc_write_range = PSC_ATOMIC32_INIT(1);
+
 /*
  * XXX Avoid ENOMEM
  */
@@ -73,40 +78,77 @@ msl_bmap_init(struct bmap *b)
 }
 
 /*
- * Set READ or WRITE as access mode on an open file bmap.
- * @b: bmap.
- * @rw: access mode to set the bmap to.
+ * Note the bmap-relative range a file system thread is about to write
+ * so that a write lease acquired on its behalf can be confined to it.
+ * The caller clears it with msl_bmap_wrrange_clear() once bmap_get()
+ * returns so that a later lease does not inherit a stale range.
+ * @off: offset into bmap.
+ * @len: length of write.
+ */
+void
+msl_bmap_wrrange_set(uint32_t off, uint32_t len)
+{
+	struct msfs_thread *mft;
+	struct psc_thread *thr;
+
+	thr = pscthr_get();
+	if (thr->pscthr_type != MSTHRT_FS)
+		return;
+	mft = thr->pscthr_private;
+	mft->mft_wroff = off;
+	mft->mft_wrlen = len;
+}
+
+/*
+ * Obtain the range to request for a new write lease: the range noted
+ * by msl_bmap_wrrange_set() or, failing that, the entire bmap.
+ */
+__static void
+msl_bmap_wrrange_get(uint32_t *off, uint32_t *len)
+{
+	struct msfs_thread *mft;
+	struct psc_thread *thr;
+
+	*off = 0;
+	*len = 0;
+	if (!psc_atomic32_read(&slc_write_range))
+		return;
+	thr = pscthr_get();
+	if (thr->pscthr_type != MSTHRT_FS)
+		return;
+	mft = thr->pscthr_private;
+	*off = mft->mft_wroff;
+	*len = mft->mft_wrlen;
+	bmap_wrrange_round(off, len);
+}
+
+/*
+ * Ask the MDS to grant write access to a range of a bmap, either
+ * upgrading a read lease or extending the range of a write lease.
+ * @b: bmap, marked BMAPF_MODECHNG by the caller.
+ * @off: offset of the (sliver-aligned) write range.
+ * @len: length of the write range, zero for the entire bmap.
  */
 __static int
-msl_bmap_modeset(struct bmap *b, enum rw rw, __unusedx int flags)
+msl_bmap_chwrmode(struct bmap *b, uint32_t off, uint32_t len)
 {
 	struct slashrpc_cservice *csvc = NULL;
 	struct pscrpc_request *rq = NULL;
 	struct srm_bmap_chwrmode_req *mq;
 	struct srm_bmap_chwrmode_rep *mp;
+	struct bmap_cli_info *bci;
 	struct fcmh_cli_info *fci;
 	struct sl_resource *r;
 	struct fidc_membh *f;
-	int rc, nretries = 0;
+	int rc, rls, nretries = 0;
 
 	f = b->bcm_fcmh;
 	fci = fcmh_2_fci(f);
-
-	psc_assert(rw == SL_WRITE || rw == SL_READ);
+	bci = bmap_2_bci(b);
 
  retry:
 	psc_assert(b->bcm_flags & BMAPF_MODECHNG);
 
-	if (b->bcm_flags & BMAPF_WR)
-		/*
-		 * Write enabled bmaps are allowed to read with no
-		 * further action being taken.
-		 */
-		return (0);
-
-	/* Add write mode to this bmap. */
-	psc_assert(rw == SL_WRITE && (b->bcm_flags & BMAPF_RD));
-
 	rc = slc_rmc_getcsvc1(&csvc, fci->fci_resm);
 	if (rc)
 		PFL_GOTOERR(out, rc);
@@ -117,6 +159,8 @@ msl_bmap_modeset(struct bmap *b, enum rw rw, __unusedx int flags)
 
 	memcpy(&mq->sbd, bmap_2_sbd(b), sizeof(struct srt_bmapdesc));
 	mq->prefios[0] = msl_pref_ios;
+	mq->off = off;
+	mq->len = len;
 	rc = SL_RSX_WAITREP(csvc, rq, mp);
 	if (rc == 0)
 		rc = mp->rc;
@@ -127,17 +171,30 @@ msl_bmap_modeset(struct bmap *b, enum rw rw, __unusedx int flags)
 
 	r = libsl_id2res(bmap_2_sbd(b)->sbd_ios);
 	psc_assert(r);
-	if (r->res_type == SLREST_ARCHIVAL_FS) {
+
+	BMAP_LOCK(b);
+	rls = 0;
+	bci->bci_wroff = mp->off;
+	bci->bci_wrlen = mp->len;
+	if (r->res_type == SLREST_ARCHIVAL_FS ||
+	    (mp->sbd.sbd_flags & SRM_LEASEBMAPF_DIO)) {
 		/*
-		 * Prepare for archival write by ensuring that all
+		 * Prepare for archival write, or for a write which
+		 * collides with another client, by ensuring that all
 		 * subsequent IO's are direct.
 		 */
-		BMAP_LOCK(b);
 		b->bcm_flags |= BMAPF_DIO;
-		BMAP_ULOCK(b);
+		rls = 1;
+	} else if (!(b->bcm_flags & BMAPF_WR) && len)
+		/*
+		 * Other clients may write outside of our range from now
+		 * on, so drop what was cached under the read lease.
+		 */
+		rls = 1;
+	BMAP_ULOCK(b);
 
+	if (rls)
 		msl_bmap_cache_rls(b);
-	}
 
  out:
 	if (rq) {
@@ -168,6 +225,75 @@ msl_bmap_modeset(struct bmap *b, enum rw rw, __unusedx int flags)
 	return (rc);
 }
 
+/*
+ * Set READ or WRITE as access mode on an open file bmap.
+ * @b: bmap.
+ * @rw: access mode to set the bmap to.
+ */
+__static int
+msl_bmap_modeset(struct bmap *b, enum rw rw, __unusedx int flags)
+{
+	uint32_t off, len;
+
+	psc_assert(rw == SL_WRITE || rw == SL_READ);
+	psc_assert(b->bcm_flags & BMAPF_MODECHNG);
+
+	if (b->bcm_flags & BMAPF_WR)
+		/*
+		 * Write enabled bmaps are allowed to read with no
+		 * further action being taken.
+		 */
+		return (0);
+
+	/* Add write mode to this bmap. */
+	psc_assert(rw == SL_WRITE && (b->bcm_flags & BMAPF_RD));
+
+	msl_bmap_wrrange_get(&off, &len);
+	return (msl_bmap_chwrmode(b, off, len));
+}
+
+/*
+ * Extend our write lease on a bmap to cover a range about to be
+ * written which lies outside of it.
+ * @b: bmap, write leased.
+ * @off: offset into bmap.
+ * @len: length of write.
+ */
+int
+msl_bmap_wrrange_extend(struct bmap *b, uint32_t off, uint32_t len)
+{
+	struct bmap_cli_info *bci = bmap_2_bci(b);
+	uint32_t noff, nlen;
+	int rc;
+
+	BMAP_LOCK(b);
+	bmap_wait_locked(b, b->bcm_flags & BMAPF_MODECHNG);
+	if (msl_bmap_wrrange_covers(b, off, len)) {
+		BMAP_ULOCK(b);
+		return (0);
+	}
+	b->bcm_flags |= BMAPF_MODECHNG;
+	noff = bci->bci_wroff;
+	nlen = bci->bci_wrlen;
+	BMAP_ULOCK(b);
+
+	if (psc_atomic32_read(&slc_write_range)) {
+		/* the MDS may grant more; see mds_bml_wrrange_grow() */
+		bmap_wrrange_extend(&noff, &nlen, off, len);
+	} else {
+		noff = 0;
+		nlen = 0;
+	}
+	OPSTAT_INCR("bmap-wrrange-extend");
+	rc = msl_bmap_chwrmode(b, noff, nlen);
+
+	BMAP_LOCK(b);
+	b->bcm_flags &= ~BMAPF_MODECHNG;
+	bmap_wake_locked(b);
+	BMAP_ULOCK(b);
+	return (rc);
+}
+
 __static int
 msl_rmc_bmlreassign_cb(struct pscrpc_request *rq,
     struct pscrpc_async_args *args)
@@ -521,7 +647,12 @@ slc_reptbl_cmp(const void *a, const void *b, void *arg)
 	/* try degraded IOS */
 	xv = res2rpci(xr)->rpci_flags & RPCIF_AVOID ? 1 : -1;
 	yv = res2rpci(yr)->rpci_flags & RPCIF_AVOID ? 1 : -1;
-	return (CMP(xv, yv));
+	rc = CMP(xv, yv);
+	if (rc)
+		return (rc);
+
+	/* prefer the IOS expected to answer a READ soonest */
+	return (CMP(res2rpci(xr)->rpci_rdlat, res2rpci(yr)->rpci_rdlat));
 }
 
 __static int
@@ -538,7 +669,21 @@ msl_rmc_bmlget_cb(struct pscrpc_request *rq,
 
 	SL_GET_RQ_STATUS(csvc, rq, mp, rc);
 
-	if (rc) {
+	if (abs(rc) == SLERR_INLINE) {
+		/*
+		 * The MDS holds the file data so there is no lease to
+		 * be had; fail lease checks so I/O takes the inline path.
+		 */
+		f = b->bcm_fcmh;
+		FCMH_LOCK(f);
+		f->fcmh_flags |= FCMH_CLI_INLINE;
+		FCMH_ULOCK(f);
+
+		BMAP_LOCK(b);
+		bci->bci_error = rc;
+		b->bcm_flags |= BMAPF_LEASEFAILED;
+		BMAP_ULOCK(b);
+	} else if (rc) {
 		BMAP_LOCK(b);
 		bci->bci_error = rc;
 		BMAP_ULOCK(b);
@@ -592,9 +737,11 @@ msl_bmap_retrieve(struct bmap *b, enum rw rw, int flags)
 	struct fcmh_cli_info *fci;
 	struct msfs_thread *mft;
 	struct psc_thread *thr;
+	struct bmap_cli_info *bci;
 	struct psc_compl compl;
 	struct fidc_membh *f;
 	int rc, nretries = 0;
+	uint32_t off, len;
 
 	thr = pscthr_get();
 	if (thr->pscthr_type == MSTHRT_FS) {
@@ -607,6 +754,10 @@ msl_bmap_retrieve(struct bmap *b, enum rw rw, int flags)
 
 	f = b->bcm_fcmh;
 	fci = fcmh_2_fci(f);
+	bci = bmap_2_bci(b);
+
+	/* the file may still be sitting in the async create queue */
+	msl_acreate_drain(f);
 
  retry:
 	// XXX respect ASYNC
@@ -622,6 +773,11 @@ msl_bmap_retrieve(struct bmap *b, enum rw rw, int flags)
 	mq->bmapno = b->bcm_bmapno;
 	mq->rw = rw;
 	mq->flags |= SRM_LEASEBMAPF_GETINODE;
+	if (rw == SL_WRITE) {
+		msl_bmap_wrrange_get(&off, &len);
+		mq->off = bci->bci_wroff = off;
+		mq->len = bci->bci_wrlen = len;
+	}
 
 	DEBUG_FCMH(PLL_DIAG, f, "retrieving bmap (bmapno=%u) (rw=%s)",
 	    b->bcm_bmapno, rw == SL_READ ? "read" : "write");
@@ -770,6 +926,41 @@ msl_bmap_reap_init(struct bmap *b, const struct srt_bmapdesc *sbd)
 	lc_addtail(&slc_bmaptimeoutq, bci);
 }
 
+/*
+ * Install a read lease that came piggybacked on another RPC (e.g.
+ * COMPOUND) so the first read does not have to issue a GETBMAP.  If
+ * the bmap is already cached, the spare lease is simply left to expire
+ * on the MDS.
+ */
+void
+msl_bmap_stash_lease(struct fidc_membh *f, sl_bmapno_t bno,
+    const struct srt_bmapdesc *sbd, const uint8_t *repls)
+{
+	struct bmap *b;
+
+	if (bmap_lookup(f, bno, &b) == 0) {
+		bmap_op_done(b);
+		return;
+	}
+	if (bmap_getf(f, bno, SL_READ, BMAPGETF_CREATE |
+	    BMAPGETF_NORETRIEVE, &b))
+		return;
+
+	/* lost a race with someone retrieving it the normal way */
+	if (b->bcm_flags & BMAPF_TIMEOQ) {
+		bmap_op_done(b);
+		return;
+	}
+
+	memcpy(bmap_2_bci(b)->bci_repls, repls, SL_REPLICA_NBYTES);
+	msl_bmap_reap_init(b, sbd);
+
+	OPSTAT_INCR("bmap-stash-lease");
+	DEBUG_BMAP(PLL_DIAG, b, "stashed lease seq=%"PRId64,
+	    sbd->sbd_seq);
+	bmap_op_done(b);
+}
+
 int
 msl_rmc_bmaprelease_cb(struct pscrpc_request *rq,
     struct pscrpc_async_args *args)
@@ -1087,6 +1278,68 @@ msl_bmap_to_csvc(struct bmap *b, int exclusive,
 	return (-ETIMEDOUT);
 }
 
+/*
+ * Determine whether reads of a file should be striped across its
+ * replicas, either mount-wide or because the file was so marked.
+ */
+int
+msl_striped_read(struct fidc_membh *f)
+{
+	if (psc_atomic32_read(&slc_striped_read))
+		return (1);
+	return (!!(fcmh_2_fci(f)->fci_inode.flags & INOF_STRIPED_READ));
+}
+
+/*
+ * Obtain a connection for a striped read: consecutive slivers of the
+ * file are assigned round-robin to the VALID replicas, in the order of
+ * preference kept in fcif_idxmap, so a single sequential reader draws
+ * on the bandwidth of every IOS.  Fall back to the regular replica
+ * choice if the assigned IOS can't be reached.
+ *
+ * @b: the bmap.
+ * @off: offset of the read within the bmap.
+ * @csvcp: value-result service handle.
+ */
+int
+msl_bmap_to_csvc_striped(struct bmap *b, uint32_t off,
+    struct slashrpc_cservice **csvcp)
+{
+	struct bmap_cli_info *bci = bmap_2_bci(b);
+	int i, n = 0, idx, v[SL_MAX_REPLICAS];
+	struct fcmh_cli_info *fci;
+	struct sl_resource *res;
+
+	*csvcp = NULL;
+
+	fci = fcmh_get_pri(b->bcm_fcmh);
+	FCMH_LOCK(b->bcm_fcmh);
+	for (i = 0; i < fci->fci_inode.nrepls; i++) {
+		idx = fci->fcif_idxmap[i];
+		if (SL_REPL_GET_BMAP_IOS_STAT(bci->bci_repls,
+		    idx * SL_BITS_PER_REPLICA) != BREPLST_VALID)
+			continue;
+		res = libsl_id2res(fci->fci_inode.reptbl[idx].bs_id);
+		if (res == NULL || res->res_type == SLREST_ARCHIVAL_FS ||
+		    res2rpci(res)->rpci_flags & RPCIF_AVOID)
+			continue;
+		v[n++] = idx;
+	}
+	FCMH_ULOCK(b->bcm_fcmh);
+
+	if (n > 1) {
+		idx = v[(b->bcm_bmapno * SLASH_SLVRS_PER_BMAP +
+		    off / SLASH_SLVR_SIZE) % n];
+		if (msl_try_get_replica_res(b, idx, 1, csvcp) == 0) {
+			OPSTAT_INCR("read-striped");
+			return (0);
+		}
+		*csvcp = NULL;
+		OPSTAT_INCR("read-striped-fallback");
+	}
+	return (msl_bmap_to_csvc(b, 0, csvcp));
+}
+
 void
 bmap_biorq_waitempty(struct bmap *b)
 {
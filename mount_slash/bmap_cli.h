@@ -48,6 +48,8 @@ struct bmap_cli_info {
 	int			 bci_error;		/* lease request error */
 	int			 bci_flush_rc;		/* flush error */
 	int			 bci_nreassigns;	/* number of reassigns */
+	uint32_t		 bci_wroff;		/* write lease range */
+	uint32_t		 bci_wrlen;		/* zero for entire bmap */
 	sl_ios_id_t		 bci_prev_sliods[SL_MAX_IOSREASSIGN];
 	struct psc_listentry	 bci_lentry;		/* bmap flushq */
 	uint8_t			 bci_repls[SL_REPLICA_NBYTES];
@@ -88,6 +90,10 @@ int	 msl_bmap_lease_secs_remaining(struct bmap *);
 int	 msl_bmap_lease_tryext(struct bmap *, int);
 void	 msl_bmap_lease_tryreassign(struct bmap *);
 int	 msl_bmap_lease_secs_remaining(struct bmap *);
+int	 msl_bmap_wrrange_extend(struct bmap *, uint32_t, uint32_t);
+void	 msl_bmap_wrrange_set(uint32_t, uint32_t);
+
+#define msl_bmap_wrrange_clear()	msl_bmap_wrrange_set(0, 0)
 
 void	 bmap_biorq_expire(struct bmap *);
 
@@ -96,6 +102,22 @@ void	 msbreleasethr_main(struct psc_thread *);
 extern struct timespec msl_bmap_max_lease;
 extern struct timespec msl_bmap_timeo_inc;
 
+/*
+ * Determine whether a bmap-relative range may be cached.  A write lease
+ * confined to a range says nothing about the rest of the bmap, which
+ * other clients may be writing concurrently.
+ */
+static __inline int
+msl_bmap_wrrange_covers(struct bmap *b, uint32_t off, uint32_t len)
+{
+	struct bmap_cli_info *bci = bmap_2_bci(b);
+
+	if (!(b->bcm_flags & BMAPF_WR))
+		return (1);
+	return (bmap_wrrange_covers(bci->bci_wroff, bci->bci_wrlen, off,
+	    len));
+}
+
 static __inline struct bmap *
 bci_2_bmap(struct bmap_cli_info *bci)
 {
@@ -367,6 +367,10 @@ msctlhnd_get_fattr(int fd, struct psc_ctlmsghdr *mh, void *m)
 	case SL_FATTR_REPLPOL:
 		mfa->mfa_val = fcmh_2_fci(f)->fci_inode.newreplpol;
 		break;
+	case SL_FATTR_STRIPED_READ:
+		mfa->mfa_val = !!(fcmh_2_fci(f)->fci_inode.flags &
+		    INOF_STRIPED_READ);
+		break;
 	default:
 		rc = psc_ctlsenderr(fd, mh, SLPRI_FID": %s",
 		    mfa->mfa_fid, slstrerror(rc));
@@ -851,16 +855,41 @@ msctlthr_spawn(void)
 	psc_ctlparam_register_simple("sys.pref_ios",
 	    msctlparam_prefios_get, msctlparam_prefios_set);
 
+	psc_ctlparam_register_var("sys.async_create",
+	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
+	    &slc_async_create);
+	psc_ctlparam_register_var("sys.async_delete",
+	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
+	    &slc_async_delete);
+	psc_ctlparam_register_var("sys.compound",
+	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
+	    &slc_compound);
 	psc_ctlparam_register_var("sys.direct_io",
 	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
 	    &slc_direct_io);
 
+	psc_ctlparam_register_var("sys.getattr_window",
+	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
+	    &slc_getattr_window);
+	psc_ctlparam_register_var("sys.negcache_timeo",
+	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
+	    &slc_negcache_timeo);
+
 	psc_ctlparam_register_var("sys.readahead_pgs",
 	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
 	    &slc_max_readahead);
 	psc_ctlparam_register_var("sys.readahead_pipesz",
 	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
 	    &slc_readahead_pipesz);
+	psc_ctlparam_register_var("sys.read_hedge",
+	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
+	    &slc_read_hedge);
+	psc_ctlparam_register_var("sys.striped_read",
+	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
+	    &slc_striped_read);
+	psc_ctlparam_register_var("sys.write_range",
+	    PFLCTL_PARAMT_ATOMIC32, PFLCTL_PARAMF_RDWR,
+	    &slc_write_range);
 
 	thr = pscthr_init(MSTHRT_CTL, msctlthr_main, NULL,
 	    sizeof(struct psc_ctlthr), "msctlthr0");
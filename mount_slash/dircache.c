@@ -58,6 +58,15 @@ struct psc_poolmgr	*dircache_ent_pool;
 
 struct psc_lockedlist	 msl_dircache_pages_lru;
 
+/* seconds a negative namecache entry is trusted; zero disables */
+psc_atomic32_t		 slc_negcache_timeo = PSC_ATOMIC32_INIT(DIRCACHE_NEG_TIMEO);
+
+struct namecache_peek {
+	struct fidc_membh	*ncp_dir;
+	uint64_t		 ncp_fid;
+	int			 ncp_neg;	/* 1: valid negative, -1: stale */
+};
+
 void
 dircache_init(struct fidc_membh *d)
 {
@@ -175,6 +184,19 @@ _dircache_free_page(const struct pfl_callerinfo *pci,
 	if ((p->dcp_flags & DIRCACHEPGF_READ) == 0)
 		OPSTAT_INCR("dircache-unused-page");
 
+	/*
+	 * Once the last prefetched page is gone, lookups are no longer
+	 * answered from prefetched entries.
+	 */
+	if (p->dcp_flags & DIRCACHEPGF_PREFETCH &&
+	    --fci->fcid_prefetch_npages == 0) {
+		int locked;
+
+		locked = FCMH_RLOCK(d);
+		d->fcmh_flags &= ~FCMH_CLI_PREFETCHED;
+		FCMH_URLOCK(d, locked);
+	}
+
 	while (p->dcp_refcnt)
 		DIRCACHE_WAIT(d);
 
@@ -503,14 +525,71 @@ dircache_ent_update(void *p, void *arg)
 	struct dircache_ent *dce = p;
 
 	dce->dce_pfd->pfd_ino = *(uint64_t *)arg;
+	dce->dce_flags &= ~DCEF_NEGATIVE;
 }
 
+/*
+ * An INSERT of a name known to be absent (e.g. after a local CREATE)
+ * revives the negative entry in place.
+ */
 void
-dircache_ent_peek(void *p, void *arg)
+dircache_ent_revive(void *p, void *arg)
 {
 	struct dircache_ent *dce = p;
 
-	*(uint64_t *)arg = dce->dce_pfd->pfd_ino;
+	if (dce->dce_flags & DCEF_NEGATIVE) {
+		dce->dce_pfd->pfd_ino = *(uint64_t *)arg;
+		dce->dce_flags &= ~DCEF_NEGATIVE;
+		OPSTAT_INCR("namecache-neg-revive");
+	}
+}
+
+void
+dircache_ent_stamp(struct fidc_membh *d, struct dircache_ent *dce)
+{
+	PFL_GETPTIMESPEC(&dce->dce_local_tm);
+	dce->dce_remote_tm = d->fcmh_sstb.sst_mtim;
+	dce->dce_dirgen = fcmh_2_gen(d);
+}
+
+/*
+ * Turn an anonymous entry negative, or refresh one that already is.
+ * Entries backed by a READDIR page are left alone: the page will be
+ * purged on the directory mtime change that removed the name.
+ */
+void
+dircache_ent_negate(void *p, void *arg)
+{
+	struct dircache_ent *dce = p;
+
+	if (dce->dce_page)
+		return;
+	dce->dce_pfd->pfd_ino = FID_ANY;
+	dce->dce_flags |= DCEF_NEGATIVE;
+	dircache_ent_stamp(arg, dce);
+}
+
+void
+dircache_ent_peek(void *p, void *arg)
+{
+	struct namecache_peek *ncp = arg;
+	struct dircache_ent *dce = p;
+	struct fidc_membh *d = ncp->ncp_dir;
+	struct pfl_timespec expire;
+
+	ncp->ncp_fid = dce->dce_pfd->pfd_ino;
+	if ((dce->dce_flags & DCEF_NEGATIVE) == 0)
+		return;
+
+	PFL_GETPTIMESPEC(&expire);
+	expire.tv_sec -= psc_atomic32_read(&slc_negcache_timeo);
+	if (timespeccmp(&expire, &dce->dce_local_tm, >) ||
+	    memcmp(&d->fcmh_sstb.sst_mtim, &dce->dce_remote_tm,
+	    sizeof(dce->dce_remote_tm)) ||
+	    dce->dce_dirgen != fcmh_2_gen(d))
+		ncp->ncp_neg = -1;
+	else
+		ncp->ncp_neg = 1;
 }
 
 /*
@@ -520,6 +599,8 @@ dircache_ent_peek(void *p, void *arg)
  * @name: basename to lookup.
  * @cfid: for UPDATE type, new child FID for entry.
  * @op: operation type (LOOKUP, DELETE, etc.).
+ *
+ * A PEEK returns NAMECACHE_NEGATIVE if the name is known not to exist.
  */
 slfid_t
 _namecache_lookup(int op, struct fidc_membh *d, const char *name,
@@ -529,6 +610,7 @@ _namecache_lookup(int op, struct fidc_membh *d, const char *name,
 	uint64_t pfid, key, rc = FID_ANY;
 	struct dircache_ent *dce, *new_dce;
 	struct dircache_ent_query q;
+	struct namecache_peek ncp;
 	struct fcmh_cli_info *fci;
 	struct psc_hashbkt *b;
 	size_t entsz, namelen;
@@ -548,9 +630,22 @@ _namecache_lookup(int op, struct fidc_membh *d, const char *name,
 	case NAMECACHELOOKUPF_DELETE:
 		flags |= PHLF_DEL;
 		break;
+	case NAMECACHELOOKUPF_INSERT:
+		cbf = dircache_ent_revive;
+		arg = &cfid;
+		break;
+	case NAMECACHELOOKUPF_NEGATIVE:
+		if (psc_atomic32_read(&slc_negcache_timeo) <= 0)
+			return (rc);
+		cbf = dircache_ent_negate;
+		arg = d;
+		break;
 	case NAMECACHELOOKUPF_PEEK:
+		ncp.ncp_dir = d;
+		ncp.ncp_fid = FID_ANY;
+		ncp.ncp_neg = 0;
 		cbf = dircache_ent_peek;
-		arg = &rc;
+		arg = &ncp;
 		/* FALLTHRU */
 	default:
 		break;
@@ -565,8 +660,18 @@ _namecache_lookup(int op, struct fidc_membh *d, const char *name,
 
 	switch (op) {
 	case NAMECACHELOOKUPF_PEEK:
-		if (dce)
+		if (dce == NULL) {
+			OPSTAT_INCR("namecache-miss");
+		} else if (ncp.ncp_neg > 0) {
+			OPSTAT_INCR("namecache-neg-hit");
+			rc = NAMECACHE_NEGATIVE;
+		} else if (ncp.ncp_neg < 0) {
+			OPSTAT_INCR("namecache-neg-expire");
+			namecache_delete(d, name);
+		} else {
 			OPSTAT_INCR("namecache-hit");
+			rc = ncp.ncp_fid;
+		}
 		return (rc);
 	case NAMECACHELOOKUPF_DELETE:
 		/*
@@ -595,6 +700,10 @@ _namecache_lookup(int op, struct fidc_membh *d, const char *name,
 			return (rc);
 		}
 		break;
+	case NAMECACHELOOKUPF_NEGATIVE:
+		if (dce)
+			return (rc);
+		break;
 	}
 
 	entsz = PFL_DIRENT_SIZE(namelen);
@@ -609,11 +718,16 @@ _namecache_lookup(int op, struct fidc_membh *d, const char *name,
 	if (dce) {
 		OPSTAT_INCR("namecache-insert-race");
 	} else {
-		OPSTAT_INCR("namecache-insert");
-
 		dce = new_dce;
 		new_dce = NULL;
 
+		if (op == NAMECACHELOOKUPF_NEGATIVE) {
+			OPSTAT_INCR("namecache-neg-insert");
+			dce->dce_flags |= DCEF_NEGATIVE;
+			dircache_ent_stamp(d, dce);
+		} else
+			OPSTAT_INCR("namecache-insert");
+
 		dce->dce_pfd->pfd_ino = cfid;
 		dce->dce_pfd->pfd_namelen = namelen;
 		dce->dce_key = key;
@@ -70,6 +70,7 @@ struct fidc_membh;
 
 #define DIRCACHEPG_SOFT_TIMEO	4		/* expiration after page read */
 #define DIRCACHEPG_HARD_TIMEO	30		/* expiration regardless if read */
+#define DIRCACHE_NEG_TIMEO	4		/* default negative entry lifetime */
 
 /*
  * This consitutes a block of 'struct dirent' members (dircache_ent)
@@ -96,6 +97,7 @@ struct dircache_page {
 #define DIRCACHEPGF_EOF		(1 << 1)	/* denotes last page */
 #define DIRCACHEPGF_READ	(1 << 2)	/* page has been used */
 #define DIRCACHEPGF_FREEING	(1 << 3)	/* a thread is trying to free */
+#define DIRCACHEPGF_PREFETCH	(1 << 4)	/* loaded by lookup-miss prefetch */
 
 #define DIRCACHE_WRLOCK(d)	pfl_rwlock_wrlock(fcmh_2_dc_rwlock(d))
 #define DIRCACHE_REQWRLOCK(d)	pfl_rwlock_reqwrlock(fcmh_2_dc_rwlock(d))
@@ -168,16 +170,27 @@ struct dircache_expire {
  * This is essentially a pointer to a pscfs_dirent.  Many of these
  * reside in one dircache_page but may exist totally independently if
  * brought in through certain namespace operations.
+ *
+ * A negative entry records that the MDS replied ENOENT for the name.
+ * It is only trusted while the parent directory's mtime and generation
+ * are unchanged and it is younger than the negative entry timeout.
  */
 struct dircache_ent {
 	uint64_t		 dce_key;
 	uint64_t		 dce_pfid;
+	int			 dce_flags;	/* see DCEF_* below */
 	struct dircache_page	*dce_page;
 	struct pscfs_dirent	*dce_pfd;
+	struct pfl_timespec	 dce_local_tm;	/* negative: local clock when added */
+	struct pfl_timespec	 dce_remote_tm;	/* negative: directory mtime when added */
+	slfgen_t		 dce_dirgen;	/* negative: directory generation */
 	struct psc_hashentry	 dce_hentry;
 #define dce_lentry dce_hentry.phe_lentry
 };
 
+/* dce_flags */
+#define DCEF_NEGATIVE		(1 << 0)	/* name known not to exist */
+
 struct dircache_ent_query {
 	uint64_t		 dcq_key;
 	uint64_t		 dcq_pfid;
@@ -245,6 +258,7 @@ enum {
 	NAMECACHELOOKUPF_CLOBBER,
 	NAMECACHELOOKUPF_DELETE,
 	NAMECACHELOOKUPF_INSERT,
+	NAMECACHELOOKUPF_NEGATIVE,
 	NAMECACHELOOKUPF_PEEK,
 	NAMECACHELOOKUPF_UPDATE
 };
@@ -254,6 +268,10 @@ enum {
 #define namecache_update(p, name, fid)	_namecache_lookup(NAMECACHELOOKUPF_UPDATE, (p), (name), (fid))
 #define namecache_clobber(p, name, fid)	_namecache_lookup(NAMECACHELOOKUPF_CLOBBER, (p), (name), (fid))
 #define namecache_insert(p, name, fid)	_namecache_lookup(NAMECACHELOOKUPF_INSERT, (p), (name), (fid))
+#define namecache_insert_negative(p, name) _namecache_lookup(NAMECACHELOOKUPF_NEGATIVE, (p), (name), FID_ANY)
+
+/* namecache_lookup() return value for a valid negative entry */
+#define NAMECACHE_NEGATIVE		UINT64_C(0)
 
 void	 namecache_purge(struct fidc_membh *);
 slfid_t	_namecache_lookup(int, struct fidc_membh *, const char *, uint64_t);
@@ -49,6 +49,9 @@
 #include "fidcache.h"
 #include "mount_slash.h"
 #include "rpc_cli.h"
+#include "slashrpc.h"
+
+#include "slashd/inode.h"
 
 /*
  * Update the high-level app stat(2)-like attribute buffer for a FID
@@ -166,6 +169,65 @@ msl_fcmh_stash_inode(struct fidc_membh *f, struct srt_inode *ino)
 	for (i = 0; i < fci->fci_inode.nrepls; i++)
 		fci->fcif_idxmap[i] = i;
 	fci->fcif_mapstircnt = MAPSTIR_THRESH;
+
+	if (ino->flags & INOF_INLINE)
+		f->fcmh_flags |= FCMH_CLI_INLINE;
+	else
+		f->fcmh_flags &= ~FCMH_CLI_INLINE;
+}
+
+/*
+ * Keep a copy of the contents of a file whose data is held by the MDS
+ * to serve reads from until attributes would expire.  The caller must
+ * have just applied the attributes returned with @buf so the copy can
+ * be matched against them later.  A NULL @buf drops the copy.
+ */
+void
+msl_fcmh_stash_inline(struct fidc_membh *f, const void *buf,
+    uint32_t len)
+{
+	struct fcmh_cli_info *fci;
+
+	FCMH_LOCK_ENSURE(f);
+	fci = fcmh_2_fci(f);
+	PSCFREE(fci->fcif_inline_buf);
+	fci->fcif_inline_len = 0;
+	if (buf == NULL)
+		return;
+
+	fci->fcif_inline_buf = PSCALLOC(SRM_INLINE_MAX);
+	memcpy(fci->fcif_inline_buf, buf, len);
+	fci->fcif_inline_len = len;
+	PFL_GETTIMESPEC(&fci->fcif_inline_etime);
+	fci->fcif_inline_etime.tv_sec += FCMH_ATTR_TIMEO;
+	fci->fcif_inline_mtim = f->fcmh_sstb.sst_mtim;
+}
+
+/*
+ * Determine whether the copy of inline data may serve reads.  Any
+ * attribute update showing another writer (a new mtime or size) makes
+ * it stale.
+ */
+int
+msl_fcmh_inline_valid(struct fidc_membh *f)
+{
+	struct fcmh_cli_info *fci;
+	struct timespec ts;
+
+	FCMH_LOCK_ENSURE(f);
+	fci = fcmh_2_fci(f);
+	if (fci->fcif_inline_buf == NULL)
+		return (0);
+	PFL_GETTIMESPEC(&ts);
+	if (timespeccmp(&ts, &fci->fcif_inline_etime, >=) ||
+	    fcmh_2_fsz(f) != fci->fcif_inline_len ||
+	    memcmp(&f->fcmh_sstb.sst_mtim, &fci->fcif_inline_mtim,
+	    sizeof(fci->fcif_inline_mtim))) {
+		OPSTAT_INCR("inline-cache-stale");
+		msl_fcmh_stash_inline(f, NULL, 0);
+		return (0);
+	}
+	return (1);
 }
 
 int
@@ -178,6 +240,8 @@ msl_fcmh_fetch_inode(struct fidc_membh *f)
 	struct fcmh_cli_info *fci;
 	int rc;
 
+	msl_acreate_drain(f);
+
 	fci = fcmh_2_fci(f);
 	rc = slc_rmc_getcsvc1(&csvc, fci->fci_resm);
 	if (rc)
@@ -250,6 +314,8 @@ slc_fcmh_dtor(struct fidc_membh *f)
 		namecache_purge(f);
 	if (f->fcmh_flags & FCMH_CLI_INITDIRCACHE)
 		dircache_purge(f);
+	else if (fcmh_isreg(f))
+		PSCFREE(fcmh_2_fci(f)->fcif_inline_buf);
 }
 
 void
@@ -271,6 +337,9 @@ dump_fcmh_flags(int flags)
 	PFL_PRFLAG(FCMH_CLI_TRUNC, &flags, &seq);
 	PFL_PRFLAG(FCMH_CLI_DIRTY_ATTRS, &flags, &seq);
 	PFL_PRFLAG(FCMH_CLI_DIRTY_QUEUE, &flags, &seq);
+	PFL_PRFLAG(FCMH_CLI_PREFETCH, &flags, &seq);
+	PFL_PRFLAG(FCMH_CLI_PREFETCHED, &flags, &seq);
+	PFL_PRFLAG(FCMH_CLI_INLINE, &flags, &seq);
 	if (flags)
 		printf(" unknown: %x", flags);
 	printf("\n");
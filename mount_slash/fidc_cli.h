@@ -41,6 +41,16 @@ struct fcmh_cli_info_file {
 	uint32_t	 	 xattrsize;
 	int			 idxmap[SL_MAX_REPLICAS];
 	int			 mapstircnt;
+
+	/*
+	 * Copy of data held by the MDS (FCMH_CLI_INLINE) good until
+	 * inline_etime, like cached attributes, and only as long as the
+	 * cached mtime and size still match those it was taken with.
+	 */
+	char			*inline_buf;
+	uint32_t		 inline_len;
+	struct timespec		 inline_etime;
+	struct pfl_timespec	 inline_mtim;
 };
 
 struct fcmh_cli_info_dir {
@@ -53,6 +63,9 @@ struct fcmh_cli_info_dir {
 	 */
 	struct timeval		 lookup_age;	/* async readdir  */
 	uint64_t		 lookup_misses;
+	int			 prefetch_npages; /* DIRCACHEPGF_PREFETCH pages */
+
+	int			 adelete_err;
 };
 
 /*
@@ -70,8 +83,16 @@ struct fcmh_cli_info_dir {
  * @fci_dc_pages: dircache pages.
  * @fcid_lookup_age: second-resolution of last dircache LOOKUP miss.
  * @fcid_lookup_misses: how many LOOKUPs did not hit dircache since @age.
+ * @fcid_prefetch_npages: number of cached pages loaded by a lookup-miss
+ *	prefetch; FCMH_CLI_PREFETCHED is cleared when it drops to zero.
+ * @fcid_adelete_err: first failure of an asynchronous unlink/rmdir in
+ *	this directory, returned by the next operation on it.
  * @fci_lentry: cache membership.
  * @fci_etime: attribute expiration time.
+ * @fci_acreate_seq: last queued asynchronous create of, or in, this
+ *	file; guarded by the create queue lock.
+ * @fci_adelete_seq: last queued asynchronous delete in this directory;
+ *	guarded by the delete queue lock.
  */
 struct fcmh_cli_info {
 	struct sl_resm			*fci_resm;
@@ -83,6 +104,10 @@ struct fcmh_cli_info {
 #define fci_inode		u.f.inode
 #define fcif_idxmap		u.f.idxmap
 #define fcif_mapstircnt		u.f.mapstircnt
+#define fcif_inline_buf		u.f.inline_buf
+#define fcif_inline_len		u.f.inline_len
+#define fcif_inline_etime	u.f.inline_etime
+#define fcif_inline_mtim	u.f.inline_mtim
 
 		struct fcmh_cli_info_dir d;
 #define fci_dc_pages		u.d.pages
@@ -90,9 +115,13 @@ struct fcmh_cli_info {
 #define fcid_ents		u.d.ents
 #define fcid_lookup_age		u.d.lookup_age
 #define fcid_lookup_misses	u.d.lookup_misses
+#define fcid_prefetch_npages	u.d.prefetch_npages
+#define fcid_adelete_err	u.d.adelete_err
 	} u;
 	struct psclist_head		 fci_lentry;	/* all fcmhs with dirty attributes */
 	struct timespec			 fci_etime;	/* attr expire time */
+	uint64_t			 fci_acreate_seq;
+	uint64_t			 fci_adelete_seq;
 };
 
 #define fcmh_2_nrepls(f)	fcmh_2_fci(f)->fci_inode.nrepls
@@ -102,6 +131,7 @@ struct fcmh_cli_info {
 
 #define DIR_LOOKUP_MISSES_INCR		1000
 #define DIR_LOOKUP_MISSES_THRES		400001
+#define DIR_LOOKUP_PREFETCH_SIZE	(32 * 1024)
 
 static __inline struct fcmh_cli_info *
 fcmh_2_fci(struct fidc_membh *f)
@@ -126,6 +156,9 @@ fci_2_fcmh(struct fcmh_cli_info *fci)
 #define FCMH_CLI_DIRTY_MTIME		(_FCMH_FLGSHFT << 3)	/* has dirty mtime */
 #define FCMH_CLI_DIRTY_QUEUE		(_FCMH_FLGSHFT << 4)	/* on dirty queue */
 #define FCMH_CLI_XATTR_INFO		(_FCMH_FLGSHFT << 5)
+#define FCMH_CLI_PREFETCH		(_FCMH_FLGSHFT << 6)	/* lookup-miss readdir in flight */
+#define FCMH_CLI_PREFETCHED		(_FCMH_FLGSHFT << 7)	/* namecache filled by prefetch */
+#define FCMH_CLI_INLINE			(_FCMH_FLGSHFT << 8)	/* data held by MDS, no bmaps */
 
 #define FCMH_CLI_DIRTY_ATTRS		(FCMH_CLI_DIRTY_DSIZE | FCMH_CLI_DIRTY_MTIME)
 
@@ -145,6 +178,8 @@ int	fcmh_checkcreds_ctx(struct fidc_membh *,
 	    int);
 
 int	msl_fcmh_fetch_inode(struct fidc_membh *);
+int	msl_fcmh_inline_valid(struct fidc_membh *);
+void	msl_fcmh_stash_inline(struct fidc_membh *, const void *, uint32_t);
 void	msl_fcmh_stash_inode(struct fidc_membh *, struct srt_inode *);
 void	msl_fcmh_stash_xattrsize(struct fidc_membh *, uint32_t);
 
@@ -98,6 +98,12 @@ struct psc_poolmaster	 slc_readaheadrq_poolmaster;
 struct psc_poolmgr	*slc_readaheadrq_pool;
 struct psc_listcache	 msl_readaheadq;
 
+/* percentile of per-IOS READ latency after which to hedge; 0 disables */
+psc_atomic32_t		 slc_read_hedge = PSC_ATOMIC32_INIT(0);
+/* spread reads of all files across their replicas */
+psc_atomic32_t		 slc_striped_read = PSC_ATOMIC32_INIT(0);
+struct psc_listcache	 msl_readrpcs;
+
 void
 msl_update_iocounters(struct pfl_iostats_grad *ist, enum rw rw, int len)
 {
@@ -433,6 +439,77 @@ msl_try_get_replica_res(struct bmap *b, int iosidx, int require_valid,
 	return (-1);
 }
 
+/*
+ * Account the service time of a READ RPC against the IOS that handled
+ * it.  The EWMA orders replicas in slc_reptbl_cmp() and the log2
+ * histogram provides the percentile used as the hedging deadline.
+ */
+void
+slc_rdlat_sample(struct sl_resource *res, uint64_t usecs)
+{
+	struct resprof_cli_info *rpci = res2rpci(res);
+	int i, n;
+
+	for (n = 0; n < SLC_RDLAT_NBUCKETS - 1 && usecs >> (n + 1); n++)
+		;
+
+	RPCI_LOCK(rpci);
+	if (rpci->rpci_rdlat)
+		rpci->rpci_rdlat = (rpci->rpci_rdlat * 7 + usecs) / 8;
+	else
+		rpci->rpci_rdlat = usecs;
+	rpci->rpci_rdlat_hist[n]++;
+	if (++rpci->rpci_rdlat_n >= SLC_RDLAT_DECAY) {
+		/* age out old samples so the percentile can recover */
+		rpci->rpci_rdlat_n = 0;
+		for (i = 0; i < SLC_RDLAT_NBUCKETS; i++) {
+			rpci->rpci_rdlat_hist[i] /= 2;
+			rpci->rpci_rdlat_n += rpci->rpci_rdlat_hist[i];
+		}
+	}
+	RPCI_ULOCK(rpci);
+
+	if (usecs >= 1000000)
+		OPSTAT_INCR("read-lat-1s");
+	else if (usecs >= 100000)
+		OPSTAT_INCR("read-lat-100ms");
+	else if (usecs >= 10000)
+		OPSTAT_INCR("read-lat-10ms");
+	else if (usecs >= 1000)
+		OPSTAT_INCR("read-lat-1ms");
+	else
+		OPSTAT_INCR("read-lat-sub-1ms");
+}
+
+/*
+ * Estimate the given percentile of READ latency for an IOS.  Returns
+ * zero if there are not yet enough samples to trust.
+ */
+__static uint64_t
+slc_rdlat_deadline(struct sl_resource *res, int pct)
+{
+	struct resprof_cli_info *rpci = res2rpci(res);
+	uint64_t usecs = 0, want, sum = 0;
+	int n;
+
+	RPCI_LOCK(rpci);
+	if (rpci->rpci_rdlat_n >= SLC_RDLAT_MINSAMPLES) {
+		want = (uint64_t)rpci->rpci_rdlat_n * pct / 100;
+		for (n = 0; n < SLC_RDLAT_NBUCKETS - 1; n++) {
+			sum += rpci->rpci_rdlat_hist[n];
+			if (sum >= want)
+				break;
+		}
+		/* upper bound of the bucket */
+		usecs = UINT64_C(1) << (n + 1);
+	}
+	RPCI_ULOCK(rpci);
+
+	if (usecs && usecs < SLC_RDHEDGE_MINUSECS)
+		usecs = SLC_RDHEDGE_MINUSECS;
+	return (usecs);
+}
+
 #define msl_fsrq_aiowait_tryadd_locked(e, r)				\
 	_msl_fsrq_aiowait_tryadd_locked(PFL_CALLERINFO(), (e), (r))
 
@@ -501,6 +578,13 @@ msl_req_aio_add(struct pscrpc_request *rq,
 
 		car->car_fsrqinfo = r->biorq_fsrqi;
 
+	} else if (cbf == msl_readrpc_aio_cleanup) {
+		struct msl_readrpc *g;
+
+		OPSTAT_INCR("aio-register-read-hedge");
+		g = av->pointer_arg[MSL_CBARG_READRPC];
+		car->car_fsrqinfo = g->mrr_fsrqi;
+
 	} else if (cbf == msl_dio_cleanup) {
 
 		OPSTAT_INCR("aio-register-dio");
@@ -846,6 +930,117 @@ msl_read_cleanup(struct pscrpc_request *rq, int rc,
 	return (rc);
 }
 
+__static void
+msl_readrpc_destroy(struct msl_readrpc *g)
+{
+	bmap_op_done_type(g->mrr_bmap, BMAP_OPCNT_ASYNC);
+	PSCFREE(g);
+}
+
+__static void
+msl_readrpc_decref(struct msl_readrpc *g)
+{
+	int ref;
+
+	spinlock(&g->mrr_lock);
+	ref = --g->mrr_refcnt;
+	freelock(&g->mrr_lock);
+	if (ref == 0)
+		msl_readrpc_destroy(g);
+}
+
+/*
+ * Fill the cache pages of a hedgeable READ from the buffer of whichever
+ * RPC won, then release the biorq as msl_read_cleanup() would.  The
+ * other RPC may still be outstanding, so nothing may look at the biorq
+ * after this.
+ */
+__static void
+msl_readrpc_settle(struct msl_readrpc *g, int rc, const char *buf)
+{
+	struct bmpc_ioreq *r = g->mrr_biorq;
+	struct bmap_pagecache_entry *e;
+	struct bmap *b = g->mrr_bmap;
+	int i;
+
+	DYNARRAY_FOREACH(e, i, g->mrr_pages) {
+		if (rc == 0)
+			memcpy(e->bmpce_base, buf + i * BMPC_BUFSZ,
+			    BMPC_BUFSZ);
+		msl_bmpce_rpc_done(e, rc);
+	}
+
+	if (rc) {
+		if (rc == -PFLERR_KEYEXPIRED) {
+			BMAP_LOCK(b);
+			b->bcm_flags |= BMAPF_LEASEEXPIRED;
+			BMAP_ULOCK(b);
+			OPSTAT_INCR("bmap-read-expired");
+		}
+		mfsrq_seterr(r->biorq_fsrqi, rc);
+	} else
+		msl_update_iocounters(slc_iorpc_iostats, SL_READ,
+		    g->mrr_size);
+
+	g->mrr_biorq = NULL;
+	msl_biorq_release(r);
+
+	psc_dynarray_free(g->mrr_pages);
+	PSCFREE(g->mrr_pages);
+}
+
+/*
+ * One RPC of a hedgeable READ has finished.  The first success settles
+ * the pages; an error only does so once no other RPC could still
+ * succeed.
+ */
+__static void
+msl_readrpc_done(struct msl_readrpc *g, int rc, void *buf)
+{
+	int settle = 0;
+
+	spinlock(&g->mrr_lock);
+	g->mrr_nrpcs--;
+	if (rc && g->mrr_rc == 0)
+		g->mrr_rc = rc;
+	if (!(g->mrr_flags & MRRF_SETTLED) &&
+	    (rc == 0 || g->mrr_nrpcs == 0)) {
+		g->mrr_flags |= MRRF_SETTLED;
+		settle = 1;
+	}
+	freelock(&g->mrr_lock);
+
+	if (settle) {
+		if (g->mrr_flags & MRRF_HEDGED) {
+			if (buf && buf == g->mrr_buf[1])
+				OPSTAT_INCR("read-hedge-win");
+			else
+				OPSTAT_INCR("read-hedge-lose");
+		}
+		msl_readrpc_settle(g, rc ? g->mrr_rc : 0, buf);
+	}
+
+	PSCFREE(buf);
+	msl_readrpc_decref(g);
+}
+
+/*
+ * Completion of a hedgeable READ that the IOS answered with AIOWAIT,
+ * once the data has been pushed to us by slc_rci_handle_io() or the
+ * IOS connection has dropped.
+ */
+int
+msl_readrpc_aio_cleanup(__unusedx struct pscrpc_request *rq, int rc,
+    struct pscrpc_async_args *args)
+{
+	struct slashrpc_cservice *csvc = args->pointer_arg[MSL_CBARG_CSVC];
+
+	msl_readrpc_done(args->pointer_arg[MSL_CBARG_READRPC], rc,
+	    args->pointer_arg[MSL_CBARG_BUF]);
+	sl_csvc_decref(csvc);
+	return (rc);
+}
+
 /*
  * Thin layer around msl_read_cleanup(), which does the real READ completion
  * processing, in case an AIOWAIT is discovered.  Upon completion of the
@@ -855,12 +1050,38 @@ int
 msl_read_cb(struct pscrpc_request *rq, struct pscrpc_async_args *args)
 {
 	struct slashrpc_cservice *csvc = args->pointer_arg[MSL_CBARG_CSVC];
+	struct msl_readrpc *g = args->pointer_arg[MSL_CBARG_READRPC];
+	struct timespec ts;
+	struct sl_resm *m;
 	int rc;
 
 	psc_assert(rq->rq_reqmsg->opc == SRMT_READ);
 
 	SL_GET_RQ_STATUS_TYPE(csvc, rq, struct srm_io_rep, rc);
 
+	if (rc == 0) {
+		m = libsl_try_nid2resm(rq->rq_peer.nid);
+		PFL_GETTIMESPEC(&ts);
+		if (m)
+			slc_rdlat_sample(m->resm_res,
+			    ts.tv_sec * 1000000 + ts.tv_nsec / 1000 -
+			    rq->rq_async_args.space[MSL_CBARG_ISSUED]);
+	}
+
+	if (g) {
+		/*
+		 * The data will be pushed into our buffer once the IOS
+		 * has it; the RPC stays counted against the group until
+		 * then so a failed peer cannot settle it early.
+		 */
+		if (rc == -SLERR_AIOWAIT)
+			return (msl_req_aio_add(rq, msl_readrpc_aio_cleanup,
+			    args));
+		msl_readrpc_done(g, rc, args->pointer_arg[MSL_CBARG_BUF]);
+		sl_csvc_decref(csvc);
+		return (rc);
+	}
+
 	if (rc == -SLERR_AIOWAIT)
 		return (msl_req_aio_add(rq, msl_read_cleanup, args));
 
@@ -911,6 +1132,9 @@ int
 msl_dio_cb(struct pscrpc_request *rq, struct pscrpc_async_args *args)
 {
 	struct slashrpc_cservice *csvc = args->pointer_arg[MSL_CBARG_CSVC];
+	struct bmpc_ioreq *r = args->pointer_arg[MSL_CBARG_BIORQ];
+	struct srm_io_req *mq;
+	unsigned char *data;
 	int rc;
 
 	SL_GET_RQ_STATUS_TYPE(csvc, rq, struct srm_io_rep, rc);
@@ -918,6 +1142,17 @@ msl_dio_cb(struct pscrpc_request *rq, struct pscrpc_async_args *args)
 	if (rc == -SLERR_AIOWAIT)
 		return (msl_req_aio_add(rq, msl_dio_cleanup, args));
 
+	/* small READ data comes back in the reply; see SRM_IOF_REPDATA */
+	mq = pscrpc_msg_buf(rq->rq_reqmsg, 0, sizeof(*mq));
+	if (rc == 0 && (mq->flags & SRM_IOF_REPDATA)) {
+		data = pscrpc_msg_buf(rq->rq_repmsg, 1, mq->size);
+		if (data)
+			memcpy(r->biorq_buf + mq->offset - r->biorq_off,
+			    data, mq->size);
+		else
+			rc = -EBADMSG;
+	}
+
 	return (msl_dio_cleanup(rq, rc, args));
 }
 
@@ -931,6 +1166,7 @@ msl_pages_dio_getput(struct bmpc_ioreq *r)
 	struct pscrpc_request *rq = NULL;
 	struct bmap_cli_info *bci;
 	struct msl_fsrqinfo *q;
+	unsigned char *data;
 	struct srm_io_req *mq;
 	struct srm_io_rep *mp;
 	struct iovec *iovs;
@@ -955,6 +1191,16 @@ msl_pages_dio_getput(struct bmpc_ioreq *r)
 	} else {
 		op = SRMT_READ;
 		OPSTAT_INCR("dio-read");
+
+		/*
+		 * A read outside of our write range is done directly
+		 * but may still overlap cached writes of our own.
+		 */
+		if (b->bcm_flags & BMAPF_WR) {
+			BMAP_LOCK(b);
+			bmpc_biorqs_flush_wait(b);
+			BMAP_ULOCK(b);
+		}
 	}
 
 	rc = msl_bmap_to_csvc(b, op == SRMT_WRITE, &csvc);
@@ -971,9 +1217,15 @@ msl_pages_dio_getput(struct bmpc_ioreq *r)
 	for (i = 0, off = 0; i < n; i++, off += len) {
 		len = MIN(LNET_MTU, size - off);
 
-		if (op == SRMT_WRITE)
+		if (op == SRMT_WRITE && len <= SRM_IO_INLINE_MAX)
+			rc = SL_RSX_NEWREQD(csvc, SRMT_WRITE, rq, mq,
+			    mp, len, data);
+		else if (op == SRMT_WRITE)
 			rc = SL_RSX_NEWREQ(csvc, SRMT_WRITE, rq, mq,
 			    mp);
+		else if (len <= SRM_IO_INLINE_MAX)
+			rc = SL_RSX_NEWREQDREP(csvc, SRMT_READ, rq, mq,
+			    mp, len);
 		else
 			rc = SL_RSX_NEWREQ(csvc, SRMT_READ, rq, mq, mp);
 		if (rc)
@@ -986,11 +1238,18 @@ msl_pages_dio_getput(struct bmpc_ioreq *r)
 		iovs[i].iov_base = r->biorq_buf + off;
 		iovs[i].iov_len = len;
 
-		rc = slrpc_bulkclient(rq, op == SRMT_WRITE ?
-		    BULK_GET_SOURCE : BULK_PUT_SINK, SRIC_BULK_PORTAL,
-		    &iovs[i], 1);
-		if (rc)
-			PFL_GOTOERR(out, rc);
+		/* small READ data is copied out in msl_dio_cb() */
+		if (op == SRMT_WRITE && len <= SRM_IO_INLINE_MAX)
+			memcpy(data, iovs[i].iov_base, len);
+		else if (len <= SRM_IO_INLINE_MAX)
+			mq->flags |= SRM_IOF_REPDATA;
+		else {
+			rc = slrpc_bulkclient(rq, op == SRMT_WRITE ?
+			    BULK_GET_SOURCE : BULK_PUT_SINK,
+			    SRIC_BULK_PORTAL, &iovs[i], 1);
+			if (rc)
+				PFL_GOTOERR(out, rc);
+		}
 
 		mq->offset = r->biorq_off + off;
 		mq->size = len;
@@ -1101,6 +1360,61 @@ msl_pages_schedflush(struct bmpc_ioreq *r)
 	BMAP_ULOCK(b);
 }
 
+/*
+ * Decide whether a READ about to be sent should be hedged and, if so,
+ * set up the state shared with the second RPC.  Only application reads
+ * from a non-archival IOS with a trusted latency profile qualify.
+ */
+__static struct msl_readrpc *
+msl_readrpc_new(struct bmpc_ioreq *r, struct pscrpc_request *rq,
+    struct psc_dynarray *a, uint32_t off, int npages)
+{
+	struct bmap *b = r->biorq_bmap;
+	struct msl_readrpc *g;
+	struct timespec ts;
+	struct sl_resm *m;
+	uint64_t usecs;
+	int pct;
+
+	pct = psc_atomic32_read(&slc_read_hedge);
+	if (pct <= 0 || pct >= 100)
+		return (NULL);
+	if (r->biorq_flags & BIORQ_READAHEAD ||
+	    b->bcm_flags & BMAPF_WR)
+		return (NULL);
+	if (fcmh_2_fci(b->bcm_fcmh)->fci_inode.nrepls < 2)
+		return (NULL);
+
+	m = libsl_try_nid2resm(rq->rq_peer.nid);
+	if (m == NULL || m->resm_res->res_type == SLREST_ARCHIVAL_FS)
+		return (NULL);
+	usecs = slc_rdlat_deadline(m->resm_res, pct);
+	if (usecs == 0)
+		return (NULL);
+
+	g = PSCALLOC(sizeof(*g));
+	INIT_SPINLOCK(&g->mrr_lock);
+	INIT_PSC_LISTENTRY(&g->mrr_lentry);
+	g->mrr_refcnt = 2;	/* launcher + RPC */
+	g->mrr_nrpcs = 1;
+	g->mrr_res = m->resm_res;
+	g->mrr_biorq = r;
+	g->mrr_fsrqi = r->biorq_fsrqi;
+	g->mrr_bmap = b;
+	g->mrr_pages = a;
+	g->mrr_off = off;
+	g->mrr_size = npages * BMPC_BUFSZ;
+	g->mrr_buf[0] = PSCALLOC(g->mrr_size);
+
+	ts.tv_sec = usecs / 1000000;
+	ts.tv_nsec = usecs % 1000000 * 1000;
+	PFL_GETTIMESPEC(&g->mrr_deadline);
+	timespecadd(&g->mrr_deadline, &ts, &g->mrr_deadline);
+
+	bmap_op_start_type(b, BMAP_OPCNT_ASYNC);
+	return (g);
+}
+
 /*
  * Launch an RPC for a given range of pages.  Note that a request can be
  * satisfied by multiple RPCs because parts of the range covered by the
@@ -1113,10 +1427,12 @@ msl_read_rpc_launch(struct bmpc_ioreq *r, struct psc_dynarray *bmpces,
 	struct slashrpc_cservice *csvc = NULL;
 	struct pscrpc_request *rq = NULL;
 	struct bmap_pagecache_entry *e;
+	struct msl_readrpc *g = NULL;
 	struct psc_dynarray *a = NULL;
 	struct srm_io_req *mq;
 	struct srm_io_rep *mp;
-	struct iovec *iovs;
+	struct iovec *iovs, iov;
+	struct timespec ts;
 	uint32_t off = 0;
 	int rc = 0, i;
 
@@ -1157,8 +1473,12 @@ msl_read_rpc_launch(struct bmpc_ioreq *r, struct psc_dynarray *bmpces,
 	    -ETIMEDOUT);
 	if (rc)
 		PFL_GOTOERR(out, rc);
-	rc = msl_bmap_to_csvc(r->biorq_bmap,
-	    r->biorq_bmap->bcm_flags & BMAPF_WR, &csvc);
+	if (!(r->biorq_bmap->bcm_flags & BMAPF_WR) &&
+	    msl_striped_read(r->biorq_bmap->bcm_fcmh))
+		rc = msl_bmap_to_csvc_striped(r->biorq_bmap, off, &csvc);
+	else
+		rc = msl_bmap_to_csvc(r->biorq_bmap,
+		    r->biorq_bmap->bcm_flags & BMAPF_WR, &csvc);
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
@@ -1167,8 +1487,15 @@ msl_read_rpc_launch(struct bmpc_ioreq *r, struct psc_dynarray *bmpces,
 		PFL_GOTOERR(out, rc);
 
 	rq->rq_bulk_abortable = 1;
-	rc = slrpc_bulkclient(rq, BULK_PUT_SINK, SRIC_BULK_PORTAL, iovs,
-	    npages);
+	g = msl_readrpc_new(r, rq, a, off, npages);
+	if (g) {
+		iov.iov_base = g->mrr_buf[0];
+		iov.iov_len = g->mrr_size;
+		rc = slrpc_bulkclient(rq, BULK_PUT_SINK,
+		    SRIC_BULK_PORTAL, &iov, 1);
+	} else
+		rc = slrpc_bulkclient(rq, BULK_PUT_SINK,
+		    SRIC_BULK_PORTAL, iovs, npages);
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
@@ -1189,7 +1516,16 @@ msl_read_rpc_launch(struct bmpc_ioreq *r, struct psc_dynarray *bmpces,
 	rq->rq_async_args.pointer_arg[MSL_CBARG_CSVC] = csvc;
 	rq->rq_async_args.pointer_arg[MSL_CBARG_BIORQ] = r;
 	rq->rq_interpret_reply = msl_read_cb;
+	if (g) {
+		rq->rq_async_args.pointer_arg[MSL_CBARG_READRPC] = g;
+		rq->rq_async_args.pointer_arg[MSL_CBARG_BUF] =
+		    g->mrr_buf[0];
+	}
+	PFL_GETTIMESPEC(&ts);
+	rq->rq_async_args.space[MSL_CBARG_ISSUED] =
+	    ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 
+	/* if hedged, this reference belongs to the msl_readrpc */
 	biorq_incref(r);
 
 	rc = SL_NBRQSET_ADD(csvc, rq);
@@ -1199,6 +1535,16 @@ msl_read_rpc_launch(struct bmpc_ioreq *r, struct psc_dynarray *bmpces,
 		PFL_GOTOERR(out, rc);
 	}
 
+	if (g) {
+		spinlock(&g->mrr_lock);
+		if (!(g->mrr_flags & MRRF_SETTLED)) {
+			g->mrr_refcnt++;
+			lc_add(&msl_readrpcs, g);
+		}
+		freelock(&g->mrr_lock);
+		msl_readrpc_decref(g);
+	}
+
 	PSCFREE(iovs);
 	return (0);
 
@@ -1209,6 +1555,10 @@ msl_read_rpc_launch(struct bmpc_ioreq *r, struct psc_dynarray *bmpces,
 	}
 	if (csvc)
 		sl_csvc_decref(csvc);
+	if (g) {
+		PSCFREE(g->mrr_buf[0]);
+		msl_readrpc_destroy(g);
+	}
 
 	PSCFREE(iovs);
 
@@ -1232,10 +1582,99 @@ msl_read_rpc_launch(struct bmpc_ioreq *r, struct psc_dynarray *bmpces,
 	return (rc);
 }
 
+/*
+ * The original READ has outlived its deadline: send the same request to
+ * another valid replica.  Called with a reference to the group.
+ */
+__static void
+msl_readrpc_hedge(struct msl_readrpc *g)
+{
+	struct slashrpc_cservice *csvc = NULL;
+	struct pscrpc_request *rq = NULL;
+	struct sl_resource *res = NULL;
+	struct fcmh_cli_info *fci;
+	struct srm_io_req *mq;
+	struct srm_io_rep *mp;
+	struct timespec ts;
+	struct iovec iov;
+	struct bmap *b = g->mrr_bmap;
+	void *buf = NULL;
+	int i, idx, rc;
+
+	spinlock(&g->mrr_lock);
+	if (g->mrr_flags & MRRF_SETTLED) {
+		freelock(&g->mrr_lock);
+		return;
+	}
+	g->mrr_flags |= MRRF_HEDGED;
+	g->mrr_nrpcs++;
+	g->mrr_refcnt++;
+	freelock(&g->mrr_lock);
+
+	/* replicas are already sorted by preference */
+	fci = fcmh_2_fci(b->bcm_fcmh);
+	for (i = 0; i < fci->fci_inode.nrepls; i++) {
+		idx = fci->fcif_idxmap[i];
+		res = libsl_id2res(fci->fci_inode.reptbl[idx].bs_id);
+		if (res == NULL || res == g->mrr_res ||
+		    res->res_type == SLREST_ARCHIVAL_FS)
+			continue;
+		if (msl_try_get_replica_res(b, idx, 1, &csvc) == 0)
+			break;
+		csvc = NULL;
+	}
+	if (csvc == NULL) {
+		OPSTAT_INCR("read-hedge-noreplica");
+		PFL_GOTOERR(out, rc = -SLERR_ION_OFFLINE);
+	}
+
+	rc = SL_RSX_NEWREQ(csvc, SRMT_READ, rq, mq, mp);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	buf = g->mrr_buf[1] = PSCALLOC(g->mrr_size);
+	iov.iov_base = buf;
+	iov.iov_len = g->mrr_size;
+	rq->rq_bulk_abortable = 1;
+	rc = slrpc_bulkclient(rq, BULK_PUT_SINK, SRIC_BULK_PORTAL, &iov,
+	    1);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	mq->offset = g->mrr_off;
+	mq->size = g->mrr_size;
+	mq->op = SRMIOP_RD;
+	memcpy(&mq->sbd, bmap_2_sbd(b), sizeof(mq->sbd));
+
+	rq->rq_async_args.pointer_arg[MSL_CBARG_CSVC] = csvc;
+	rq->rq_async_args.pointer_arg[MSL_CBARG_READRPC] = g;
+	rq->rq_async_args.pointer_arg[MSL_CBARG_BUF] = buf;
+	rq->rq_interpret_reply = msl_read_cb;
+	PFL_GETTIMESPEC(&ts);
+	rq->rq_async_args.space[MSL_CBARG_ISSUED] =
+	    ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+	rc = SL_NBRQSET_ADD(csvc, rq);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	DEBUG_BMAP(PLL_DIAG, b, "hedge read off=%u size=%u res=%s",
+	    g->mrr_off, g->mrr_size, res->res_name);
+	OPSTAT_INCR("read-hedge-issue");
+	return;
+
+ out:
+	if (rq)
+		pscrpc_req_finished(rq);
+	if (csvc)
+		sl_csvc_decref(csvc);
+	msl_readrpc_done(g, rc, buf);
+}
+
 __static int
 msl_launch_read_rpcs(struct bmpc_ioreq *r)
 {
-	int rc = 0, i, j, needflush = 0;
+	int rc = 0, i, j, needflush = 0, striped;
 	struct psc_dynarray pages = DYNARRAY_INIT;
 	struct bmap_pagecache_entry *e;
 	uint32_t off = 0;
@@ -1268,13 +1707,21 @@ msl_launch_read_rpcs(struct bmpc_ioreq *r)
 		BMAP_ULOCK(r->biorq_bmap);
 	}
 
+	/*
+	 * For striped reads, never let an RPC cross a sliver boundary
+	 * so that each sliver can be fetched from a different replica.
+	 */
+	striped = !(r->biorq_bmap->bcm_flags & BMAPF_WR) &&
+	    msl_striped_read(r->biorq_bmap->bcm_fcmh);
+
 	j = 0;
 	DYNARRAY_FOREACH(e, i, &pages) {
 		/*
 		 * Note that i > j implies i > 0.  Due to cached pages,
 		 * the pages in the array are not necessarily contiguous.
 		 */
-		if (i > j && e->bmpce_off != off) {
+		if (i > j && (e->bmpce_off != off ||
+		    (striped && e->bmpce_off % SLASH_SLVR_SIZE == 0))) {
 			rc = msl_read_rpc_launch(r, &pages, j, i - j);
 			if (rc)
 				break;
@@ -1755,6 +2202,311 @@ msl_update_attributes(struct msl_fsrqinfo *q)
 	FCMH_ULOCK(f);
 }
 
+/*
+ * Issue an INLINE_IO RPC for a file whose data is held by the MDS.
+ * On success, the file attributes are refreshed from the reply and
+ * @lenp is updated with the number of bytes transferred.
+ */
+__static int
+msl_inline_rpc(struct pscfs_req *pfr, struct fidc_membh *f, int op,
+    int flags, void *buf, uint32_t off, uint32_t *lenp)
+{
+	struct slashrpc_cservice *csvc = NULL;
+	struct pscrpc_request *rq = NULL;
+	struct srm_inline_io_req *mq;
+	struct srm_inline_io_rep *mp;
+	struct iovec iov;
+	int rc;
+
+ retry:
+	MSL_RMC_NEWREQ(pfr, f, csvc, SRMT_INLINE_IO, rq, mq, mp, rc);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	mq->fg = f->fcmh_fg;
+	mq->op = op;
+	mq->flags = flags;
+	mq->offset = off;
+	mq->size = *lenp;
+
+	iov.iov_base = buf;
+	iov.iov_len = *lenp;
+	if (iov.iov_len) {
+		rq->rq_bulk_abortable = 1;
+		rc = slrpc_bulkclient(rq, op == SRMIOP_WR ?
+		    BULK_GET_SOURCE : BULK_PUT_SINK, SRMC_BULK_PORTAL,
+		    &iov, 1);
+		if (rc)
+			PFL_GOTOERR(out, rc);
+	}
+
+	rc = SL_RSX_WAITREPF(csvc, rq, mp,
+	    SRPCWAITF_DEFER_BULK_AUTHBUF_CHECK);
+	if (rc && slc_rmc_retry(pfr, &rc))
+		goto retry;
+	if (!rc)
+		rc = mp->rc;
+	if (!rc && op == SRMIOP_RD && mp->size) {
+		if (mp->size > *lenp)
+			PFL_GOTOERR(out, rc = -EINVAL);
+		iov.iov_len = mp->size;
+		rc = slrpc_bulk_checkmsg(rq, rq->rq_repmsg, &iov, 1);
+	}
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	*lenp = mp->size;
+	slc_fcmh_setattrf(f, &mp->attr, FCMH_SETATTRF_CLOBBER);
+
+ out:
+	if (rq)
+		pscrpc_req_finished(rq);
+	if (csvc)
+		sl_csvc_decref(csvc);
+	return (rc);
+}
+
+/*
+ * Convert a file whose data is held by the MDS into a regular file:
+ * have the MDS hand over the contents, write them to bmap 0 on an IOS,
+ * then tell the MDS to drop its copy.  The MDS keeps the file inline
+ * until then, so a failure on the way leaves the data where it was.
+ * The caller must hold the fcmh BUSY, which keeps other local I/O from
+ * reaching bmap 0 before its contents are in place.
+ */
+int
+msl_inline_promote(struct pscfs_req *pfr, struct fidc_membh *f)
+{
+	struct slashrpc_cservice *csvc = NULL;
+	struct pscrpc_request *rq = NULL;
+	char buf[SRM_INLINE_MAX];
+	struct bmap *b = NULL;
+	struct srm_io_req *mq;
+	struct srm_io_rep *mp;
+	int rc, promoted = 0, nretries = 0;
+	uint32_t len, clen;
+	unsigned char *data;
+	struct iovec iov;
+
+	FCMH_BUSY_ENSURE(f);
+
+ restart:
+	len = SRM_INLINE_MAX;
+	rc = msl_inline_rpc(pfr, f, SRMIOP_RD, SRM_INLINEF_PROMOTE,
+	    buf, 0, &len);
+	if (rc == -SLERR_NOTINLINE) {
+		/* another client converted it */
+		promoted = 1;
+		PFL_GOTOERR(out, rc = 0);
+	}
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	if (len == 0)
+		goto commit;
+
+	msl_bmap_wrrange_set(0, len);
+	rc = bmap_get(f, 0, SL_WRITE, &b);
+	msl_bmap_wrrange_clear();
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	rc = msl_bmap_lease_tryext(b, 1);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	rc = msl_bmap_to_csvc(b, 1, &csvc);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	if (len <= SRM_IO_INLINE_MAX) {
+		rc = SL_RSX_NEWREQD(csvc, SRMT_WRITE, rq, mq, mp, len,
+		    data);
+		if (rc)
+			PFL_GOTOERR(out, rc);
+		memcpy(data, buf, len);
+	} else {
+		rc = SL_RSX_NEWREQ(csvc, SRMT_WRITE, rq, mq, mp);
+		if (rc)
+			PFL_GOTOERR(out, rc);
+		iov.iov_base = buf;
+		iov.iov_len = len;
+		rc = slrpc_bulkclient(rq, BULK_GET_SOURCE,
+		    SRIC_BULK_PORTAL, &iov, 1);
+		if (rc)
+			PFL_GOTOERR(out, rc);
+	}
+
+	mq->offset = 0;
+	mq->size = len;
+	mq->op = SRMIOP_WR;
+	memcpy(&mq->sbd, &bmap_2_bci(b)->bci_sbd, sizeof(mq->sbd));
+
+	rc = SL_RSX_WAITREP(csvc, rq, mp);
+	if (!rc)
+		rc = mp->rc;
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+ commit:
+	clen = 0;
+	rc = msl_inline_rpc(pfr, f, SRMIOP_WR, SRM_INLINEF_COMMIT, NULL,
+	    0, &clen);
+	if (rc == -SLERR_NOTINLINE)
+		/* another client finished first with the same data */
+		rc = 0;
+	if (rc == -EAGAIN && ++nretries < 3) {
+		/* the MDS lost track of the conversion; start over */
+		OPSTAT_INCR("inline-promote-restart");
+		if (rq) {
+			pscrpc_req_finished(rq);
+			rq = NULL;
+		}
+		if (csvc) {
+			sl_csvc_decref(csvc);
+			csvc = NULL;
+		}
+		if (b) {
+			bmap_op_done(b);
+			b = NULL;
+		}
+		goto restart;
+	}
+	if (rc == 0)
+		promoted = 1;
+
+ out:
+	if (rc)
+		DEBUG_FCMH(PLL_ERROR, f, "promote failed: len=%u rc=%d",
+		    len, rc);
+	else
+		OPSTAT_INCR("inline-promote");
+
+	if (rq)
+		pscrpc_req_finished(rq);
+	if (csvc)
+		sl_csvc_decref(csvc);
+	if (b)
+		bmap_op_done(b);
+
+	if (promoted) {
+		FCMH_LOCK(f);
+		f->fcmh_flags &= ~FCMH_CLI_INLINE;
+		msl_fcmh_stash_inline(f, NULL, 0);
+		FCMH_ULOCK(f);
+	}
+	return (rc);
+}
+
+/*
+ * Perform I/O on a file whose data is held by the MDS.  Small reads
+ * are served from a cached copy of the whole file while it is fresh
+ * and matches the cached attributes.
+ *
+ * Returns -SLERR_NOTINLINE if the file has been converted to a regular
+ * file, in which case the caller should carry on with bmap I/O;
+ * otherwise the request has been replied to.
+ */
+int
+msl_inline_io(struct pscfs_req *pfr, struct msl_fhent *mfh, char *buf,
+    size_t size, off_t off, enum rw rw)
+{
+	char tmp[SRM_INLINE_MAX];
+	struct fcmh_cli_info *fci;
+	struct fidc_membh *f;
+	struct iovec iov;
+	uint32_t len = 0;
+	int rc = 0;
+
+	f = mfh->mfh_fcmh;
+	fci = fcmh_2_fci(f);
+
+	if (rw == SL_READ) {
+		FCMH_LOCK(f);
+		if (msl_fcmh_inline_valid(f)) {
+			if (off < fci->fcif_inline_len) {
+				len = MIN(size, fci->fcif_inline_len - off);
+				memcpy(tmp, fci->fcif_inline_buf + off, len);
+			}
+			FCMH_ULOCK(f);
+			OPSTAT_INCR("inline-read-cached");
+			goto out;
+		}
+		FCMH_ULOCK(f);
+
+		/* nothing can be held by the MDS past SRM_INLINE_MAX */
+		if (off < SRM_INLINE_MAX)
+			len = MIN(size, SRM_INLINE_MAX - off);
+		rc = msl_inline_rpc(pfr, f, SRMIOP_RD, 0, tmp,
+		    MIN(off, SRM_INLINE_MAX), &len);
+		if (rc)
+			PFL_GOTOERR(out, rc);
+		OPSTAT_INCR("inline-read");
+
+		FCMH_LOCK(f);
+		if (off == 0 && len == fcmh_2_fsz(f))
+			msl_fcmh_stash_inline(f, tmp, len);
+		FCMH_ULOCK(f);
+	} else {
+		if (off + size > SRM_INLINE_MAX)
+			PFL_GOTOERR(out, rc = -SLERR_INLINE_FULL);
+		if (size == 0)
+			goto out;
+
+		len = size;
+		rc = msl_inline_rpc(pfr, f, SRMIOP_WR, 0, buf, off,
+		    &len);
+		if (rc)
+			PFL_GOTOERR(out, rc);
+		OPSTAT_INCR("inline-write");
+
+		FCMH_LOCK(f);
+		msl_fcmh_stash_inline(f, NULL, 0);
+		FCMH_ULOCK(f);
+	}
+
+ out:
+	if (rc == -SLERR_INLINE_FULL) {
+		FCMH_WAIT_BUSY(f);
+		if (f->fcmh_flags & FCMH_CLI_INLINE) {
+			FCMH_ULOCK(f);
+			rc = msl_inline_promote(pfr, f);
+		}
+		FCMH_UNBUSY(f);
+		if (rc == 0 || rc == -SLERR_INLINE_FULL)
+			return (-SLERR_NOTINLINE);
+	} else if (rc == -SLERR_NOTINLINE) {
+		FCMH_LOCK(f);
+		f->fcmh_flags &= ~FCMH_CLI_INLINE;
+		msl_fcmh_stash_inline(f, NULL, 0);
+		FCMH_ULOCK(f);
+
+		/* wait out a conversion in progress on this client */
+		FCMH_WAIT_BUSY(f);
+		FCMH_UNBUSY(f);
+		return (rc);
+	}
+
+	if (rw == SL_READ) {
+		if (rc || len == 0)
+			pscfs_reply_read(pfr, NULL, 0, abs(rc));
+		else {
+			MFH_LOCK(mfh);
+			mfh->mfh_nbytes_rd += len;
+			MFH_ULOCK(mfh);
+
+			iov.iov_base = tmp;
+			iov.iov_len = len;
+			pscfs_reply_read(pfr, &iov, 1, 0);
+		}
+	} else {
+		if (!rc) {
+			MFH_LOCK(mfh);
+			mfh->mfh_nbytes_wr += len;
+			MFH_ULOCK(mfh);
+		}
+		pscfs_reply_write(pfr, len, abs(rc));
+	}
+	return (0);
+}
+
 /*
  * I/O gateway routine which bridges pscfs and the SLASH2 client cache
  * and backend.  msl_io() handles the creation of biorq's and the
@@ -1796,6 +2548,7 @@ msl_io(struct pscfs_req *pfr, struct msl_fhent *mfh, char *buf,
 	DEBUG_FCMH(PLL_DIAG, f, "buf=%p size=%zu off=%"PRId64" rw=%s",
 	    buf, size, off, (rw == SL_READ) ? "read" : "write");
 
+ start:
 	FCMH_LOCK(f);
 	/*
 	 * All I/O's block here for pending truncate requests.
@@ -1807,6 +2560,14 @@ msl_io(struct pscfs_req *pfr, struct msl_fhent *mfh, char *buf,
 	fcmh_wait_locked(f, f->fcmh_flags & FCMH_CLI_TRUNC);
 	fsz = fcmh_getsize(f);
 
+	if (f->fcmh_flags & FCMH_CLI_INLINE) {
+		FCMH_ULOCK(f);
+		rc = msl_inline_io(pfr, mfh, buf, size, off, rw);
+		if (rc != -SLERR_NOTINLINE)
+			return (rc);
+		goto start;
+	}
+
 	FCMH_ULOCK(f);
 
 	if (rw == SL_READ) {
@@ -1866,11 +2627,20 @@ msl_io(struct pscfs_req *pfr, struct msl_fhent *mfh, char *buf,
 
 		PFL_GETTIMESPEC(&ts0);
 
+		if (rw == SL_WRITE)
+			msl_bmap_wrrange_set(roff - (i * SLASH_BMAP_SIZE),
+			    tlen);
+
 		rc = bmap_get(f, start + i, rw, &b);
+		if (rw == SL_WRITE)
+			msl_bmap_wrrange_clear();
 		if (rc)
 			PFL_GOTOERR(out2, rc);
 
 		rc = msl_bmap_lease_tryext(b, 1);
+		if (!rc && rw == SL_WRITE)
+			rc = msl_bmap_wrrange_extend(b,
+			    roff - (i * SLASH_BMAP_SIZE), tlen);
 		if (rc) {
 			bmap_op_done(b);
 			PFL_GOTOERR(out2, rc);
@@ -2020,6 +2790,16 @@ msl_io(struct pscfs_req *pfr, struct msl_fhent *mfh, char *buf,
  out2:
 	/* Step 4: retry if at least one biorq failed */
 	if (rc) {
+		/*
+		 * The MDS turned out to hold the file data.  Nothing
+		 * has been issued yet so start over on the inline path.
+		 */
+		if (abs(rc) == SLERR_INLINE && i == 0 && !retry) {
+			MFH_LOCK(mfh);
+			mfh_decref(mfh);
+			goto start;
+		}
+
 		DEBUG_FCMH(PLL_ERROR, f,
 		    "q=%p bno=%zd sz=%zu tlen=%zu off=%"PSCPRIdOFFT" "
 		    "roff=%"PSCPRIdOFFT" rw=%s rc=%d",
@@ -2083,6 +2863,9 @@ msreadaheadthr_main(struct psc_thread *thr)
 			goto end;
 		if (b->bcm_flags & BMAPF_DIO)
 			goto end;
+		if (!msl_bmap_wrrange_covers(b, rarq->rarq_off,
+		    rarq->rarq_npages * BMPC_BUFSZ))
+			goto end;
 		BMAP_ULOCK(b);
 
 		r = bmpc_biorq_new(NULL, b, NULL, 0, 0, BIORQ_READ |
@@ -2132,3 +2915,64 @@ msreadaheadthr_spawn(void)
 		pscthr_setready(thr);
 	}
 }
+
+/*
+ * Scan READs eligible for hedging and, for each one past its deadline,
+ * launch a second RPC to another replica.
+ */
+void
+msreadhedgethr_main(struct psc_thread *thr)
+{
+	struct psc_dynarray a = DYNARRAY_INIT;
+	struct timespec now, next, wait;
+	struct msl_readrpc *g, *tmp;
+	int i;
+
+	while (pscthr_run(thr)) {
+		PFL_GETTIMESPEC(&now);
+		next = now;
+		next.tv_sec += SLC_RDHEDGE_IDLE;
+		LIST_CACHE_LOCK(&msl_readrpcs);
+		LIST_CACHE_FOREACH_SAFE(g, tmp, &msl_readrpcs)
+			if (timespeccmp(&now, &g->mrr_deadline, >=)) {
+				lc_remove(&msl_readrpcs, g);
+				psc_dynarray_add(&a, g);
+			} else if (timespeccmp(&g->mrr_deadline, &next, <))
+				next = g->mrr_deadline;
+
+		/*
+		 * Sleep until the earliest deadline; lc_add() wakes us
+		 * when a new READ, whose deadline may come first, is
+		 * queued.
+		 */
+		if (psc_dynarray_len(&a) == 0) {
+			timespecsub(&next, &now, &wait);
+			psc_waitq_waitrel_ts(&msl_readrpcs.plc_wq_empty,
+			    &msl_readrpcs.plc_lock, &wait);
+			continue;
+		}
+		LIST_CACHE_ULOCK(&msl_readrpcs);
+
+		DYNARRAY_FOREACH(g, i, &a) {
+			msl_readrpc_hedge(g);
+			msl_readrpc_decref(g);
+		}
+		psc_dynarray_reset(&a);
+	}
+	psc_dynarray_free(&a);
+}
+
+void
+msreadhedgethr_spawn(void)
+{
+	struct psc_thread *thr;
+
+	lc_reginit(&msl_readrpcs, struct msl_readrpc, mrr_lentry,
+	    "readrpcs");
+
+	thr = pscthr_init(MSTHRT_READHEDGE, msreadhedgethr_main, NULL,
+	    sizeof(struct msreadhedge_thread), "msreadhedgethr");
+	psc_multiwait_init(&msreadhedgethr(thr)->mrht_mw, "%s",
+	    thr->pscthr_name);
+	pscthr_setready(thr);
+}
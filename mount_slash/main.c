@@ -36,6 +36,7 @@
 #include <inttypes.h>
 #include <pwd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -153,6 +154,38 @@ psc_atomic32_t			 slc_direct_io = PSC_ATOMIC32_INIT(1);
 
 int				 msl_newent_inherit_groups = 1;
 
+/* GETATTR batching; see msl_getattr_batch() */
+psc_atomic32_t			 slc_getattr_window = PSC_ATOMIC32_INIT(SLC_GETATTR_WINDOW);
+psc_spinlock_t			 msl_getattr_lock = SPINLOCK_INIT;
+struct psc_waitq		 msl_getattr_waitq = PSC_WAITQ_INIT;
+struct psc_dynarray		 msl_getattr_pending = DYNARRAY_INIT;
+int				 msl_getattr_nactive;
+int				 msl_getattr_leader;
+
+/* one-trip cold opens; see msl_compoundrpc() */
+psc_atomic32_t			 slc_compound = PSC_ATOMIC32_INIT(1);
+
+/* asynchronous creates; see msl_acreate() */
+psc_atomic32_t			 slc_async_create = PSC_ATOMIC32_INIT(0);
+psc_spinlock_t			 msl_fidlease_lock = SPINLOCK_INIT;
+slfid_t				 msl_fidlease_next;
+slfid_t				 msl_fidlease_end;
+struct psc_listcache		 msl_acreateq;
+struct psc_waitq		 msl_acreate_waitq = PSC_WAITQ_INIT;
+struct psc_waitq		 msl_acreate_donewq = PSC_WAITQ_INIT;
+uint64_t			 msl_acreate_seq;
+uint64_t			 msl_acreate_doneseq;
+int				 msl_acreate_urgent;
+
+/* asynchronous unlink/rmdir; see msl_adelete() */
+psc_atomic32_t			 slc_async_delete = PSC_ATOMIC32_INIT(0);
+struct psc_listcache		 msl_adeleteq;
+struct psc_waitq		 msl_adelete_waitq = PSC_WAITQ_INIT;
+struct psc_waitq		 msl_adelete_donewq = PSC_WAITQ_INIT;
+uint64_t			 msl_adelete_seq;
+uint64_t			 msl_adelete_doneseq;
+int				 msl_adelete_urgent;
+
 struct sl_resource *
 msl_get_pref_ios(void)
 {
@@ -357,6 +390,572 @@ msl_io_convert_errno(int rc)
 	return (rc);
 }
 
+/*
+ * Take a FID from the range leased from the MDS, leasing a new range
+ * with a FIDLEASE RPC when the current one runs dry.
+ */
+int
+msl_fidlease_get(slfid_t *fidp)
+{
+	struct slashrpc_cservice *csvc = NULL;
+	struct pscrpc_request *rq = NULL;
+	struct srm_fidlease_req *mq;
+	struct srm_fidlease_rep *mp;
+	int rc;
+
+	spinlock(&msl_fidlease_lock);
+	if (msl_fidlease_next < msl_fidlease_end) {
+		*fidp = msl_fidlease_next++;
+		freelock(&msl_fidlease_lock);
+		return (0);
+	}
+	freelock(&msl_fidlease_lock);
+
+	MSL_RMC_NEWREQ_PFCC(NULL, NULL, csvc, SRMT_FIDLEASE, rq, mq, mp,
+	    rc);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	mq->nfids = SLC_FIDLEASE_NFIDS;
+	rc = SL_RSX_WAITREP(csvc, rq, mp);
+	if (rc == 0)
+		rc = -mp->rc;
+	if (rc == 0 && mp->nfids <= 0)
+		rc = EAGAIN;
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	OPSTAT_INCR("fid-lease");
+
+	/*
+	 * If another thread refilled the range meanwhile, its leftover
+	 * FIDs are simply never used.
+	 */
+	spinlock(&msl_fidlease_lock);
+	msl_fidlease_next = mp->fid;
+	msl_fidlease_end = mp->fid + mp->nfids;
+	*fidp = msl_fidlease_next++;
+	freelock(&msl_fidlease_lock);
+
+ out:
+	if (rc)
+		OPSTAT_INCR("fid-lease-err");
+	if (rq)
+		pscrpc_req_finished(rq);
+	if (csvc)
+		sl_csvc_decref(csvc);
+	return (rc);
+}
+
+/*
+ * Create a file locally under a leased FID and queue the create for
+ * msacreatethr to send to the MDS in a CREATE_BULK.  The caller has
+ * already established, via a negative namecache entry, that the name
+ * does not exist.
+ */
+int
+msl_acreate(struct pscfs_req *pfr, struct fidc_membh *p,
+    const char *name, mode_t mode, struct pscfs_creds *pcr,
+    struct fidc_membh **cp)
+{
+	struct fidc_membh *c = NULL;
+	struct srt_create_ent *e;
+	struct msl_acreate *ac;
+	struct srt_stat sstb;
+	struct sl_fidgen fg;
+	int rc;
+
+	rc = msl_fidlease_get(&fg.fg_fid);
+	if (rc)
+		return (rc);
+	fg.fg_gen = 0;
+
+	ac = PSCALLOC(sizeof(*ac));
+	INIT_LISTENTRY(&ac->mac_lentry);
+
+	e = &ac->mac_ent;
+	e->pfg.fg_fid = fcmh_2_fid(p);
+	e->pfg.fg_gen = FGEN_ANY;
+	e->fid = fg.fg_fid;
+	e->mode = !(mode & 0777) ? (0666 & ~pscfs_getumask(pfr)) : mode;
+	e->owner.scr_uid = pcr->pcr_uid;
+	e->owner.scr_gid = newent_select_group(p, pcr);
+	strlcpy(e->name, name, sizeof(e->name));
+	PFL_GETPTIMESPEC(&e->time);
+
+	memset(&sstb, 0, sizeof(sstb));
+	sstb.sst_fg = fg;
+	sstb.sst_mode = S_IFREG | (e->mode & ~S_IFMT);
+	sstb.sst_nlink = 1;
+	sstb.sst_uid = e->owner.scr_uid;
+	sstb.sst_gid = e->owner.scr_gid;
+	sstb.sst_blksize = MSL_FS_BLKSIZ;
+	sstb.sst_atim = e->time;
+	sstb.sst_mtim = e->time;
+	sstb.sst_ctim = e->time;
+
+	rc = uidmap_ext_cred(&e->owner);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	rc = msl_create_fcmh(pfr, &fg, &c);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	FCMH_LOCK(c);
+	slc_fcmh_setattrf(c, &sstb, FCMH_SETATTRF_HAVELOCK |
+	    FCMH_SETATTRF_CLOBBER);
+	fcmh_op_start_type(c, FCMH_OPCNT_WORKER);
+	FCMH_ULOCK(c);
+	fcmh_op_start_type(p, FCMH_OPCNT_WORKER);
+
+	namecache_insert(p, name, fg.fg_fid);
+
+	ac->mac_pfcmh = p;
+	ac->mac_fcmh = c;
+
+	LIST_CACHE_LOCK(&msl_acreateq);
+	ac->mac_seq = ++msl_acreate_seq;
+	fcmh_2_fci(p)->fci_acreate_seq = ac->mac_seq;
+	fcmh_2_fci(c)->fci_acreate_seq = ac->mac_seq;
+	lc_add(&msl_acreateq, ac);
+	if (lc_nitems(&msl_acreateq) >= SRM_CREATE_BULK_MAX)
+		psc_waitq_wakeall(&msl_acreate_waitq);
+	LIST_CACHE_ULOCK(&msl_acreateq);
+
+	OPSTAT_INCR("acreate");
+	*cp = c;
+	return (0);
+
+ out:
+	PSCFREE(ac);
+	return (rc);
+}
+
+/*
+ * Wait until every asynchronous create of, or in, @f has been processed
+ * by the MDS, so that a request about @f issued afterwards cannot
+ * reference a file the MDS has not heard of yet.  Requests about other
+ * files are not held up.
+ */
+void
+msl_acreate_drain(struct fidc_membh *f)
+{
+	uint64_t seq;
+
+	if (f == NULL ||
+	    fcmh_2_fci(f)->fci_acreate_seq <= msl_acreate_doneseq)
+		return;
+
+	LIST_CACHE_LOCK(&msl_acreateq);
+	seq = fcmh_2_fci(f)->fci_acreate_seq;
+	if (msl_acreate_doneseq < seq) {
+		OPSTAT_INCR("acreate-drain");
+		msl_acreate_urgent = 1;
+		psc_waitq_wakeall(&msl_acreate_waitq);
+	}
+	while (msl_acreate_doneseq < seq) {
+		psc_waitq_wait(&msl_acreate_donewq,
+		    &msl_acreateq.plc_lock);
+		LIST_CACHE_LOCK(&msl_acreateq);
+	}
+	LIST_CACHE_ULOCK(&msl_acreateq);
+}
+
+/*
+ * Settle one asynchronous create after the MDS has replied.  On error
+ * the file never came to be, so forget the name and kill the fcmh.
+ */
+void
+msl_acreate_done(struct msl_acreate *ac, int rc)
+{
+	struct fidc_membh *c = ac->mac_fcmh, *p = ac->mac_pfcmh;
+
+	if (rc) {
+		OPSTAT_INCR("acreate-err");
+		DEBUG_FCMH(PLL_WARN, c, "asynchronous create of '%s' "
+		    "failed: rc=%d", ac->mac_ent.name, rc);
+		namecache_delete(p, ac->mac_ent.name);
+	}
+
+	/*
+	 * The attributes were made up locally; let the next stat(2)
+	 * fetch the real ones.
+	 */
+	FCMH_LOCK(c);
+	if (rc)
+		c->fcmh_flags |= FCMH_DELETED;
+	timerclear(&fcmh_2_fci(c)->fci_age);
+	fcmh_op_done_type(c, FCMH_OPCNT_WORKER);
+
+	FCMH_LOCK(p);
+	timerclear(&fcmh_2_fci(p)->fci_age);
+	fcmh_op_done_type(p, FCMH_OPCNT_WORKER);
+
+	PSCFREE(ac);
+}
+
+/*
+ * Send a batch of asynchronous creates to the MDS in one CREATE_BULK.
+ */
+void
+msl_acreate_flush(struct msl_acreate **acv, int n)
+{
+	struct slashrpc_cservice *csvc = NULL;
+	struct srm_create_bulk_rep *mp = NULL;
+	struct srm_create_bulk_req *mq;
+	struct pscrpc_request *rq = NULL;
+	struct srt_create_ent *e;
+	struct iovec iov;
+	uint64_t seq;
+	int i, rc;
+
+	OPSTAT_INCR("acreate-bulk");
+	OPSTAT_ADD("acreate-bulk-ents", n);
+
+	iov.iov_len = n * sizeof(*e);
+	iov.iov_base = e = PSCALLOC(iov.iov_len);
+	for (i = 0; i < n; i++)
+		e[i] = acv[i]->mac_ent;
+
+	do {
+		MSL_RMC_NEWREQ_PFCC(NULL, NULL, csvc, SRMT_CREATE_BULK,
+		    rq, mq, mp, rc);
+		if (rc)
+			break;
+
+		mq->nents = n;
+		rc = slrpc_bulkclient(rq, BULK_GET_SOURCE,
+		    SRMC_BULK_PORTAL, &iov, 1);
+		if (rc)
+			break;
+
+		rc = SL_RSX_WAITREP(csvc, rq, mp);
+	} while (rc && slc_rmc_retry_pfcc(NULL, &rc));
+
+	if (rc == 0)
+		rc = -mp->rc;
+	if (rc == 0 && mp->nents != n)
+		rc = EBADMSG;
+
+	/*
+	 * ESTALE means the MDS no longer knows the lease the FID came
+	 * from (e.g. it restarted), so stop drawing from our range.
+	 */
+	for (i = 0; rc == 0 && i < n; i++)
+		if (mp->rcs[i] == -ESTALE) {
+			spinlock(&msl_fidlease_lock);
+			msl_fidlease_next = msl_fidlease_end;
+			freelock(&msl_fidlease_lock);
+			break;
+		}
+
+	seq = acv[n - 1]->mac_seq;
+	for (i = 0; i < n; i++)
+		msl_acreate_done(acv[i], rc ? rc : -mp->rcs[i]);
+
+	LIST_CACHE_LOCK(&msl_acreateq);
+	msl_acreate_doneseq = seq;
+	psc_waitq_wakeall(&msl_acreate_donewq);
+	LIST_CACHE_ULOCK(&msl_acreateq);
+
+	PSCFREE(iov.iov_base);
+	if (rq)
+		pscrpc_req_finished(rq);
+	if (csvc)
+		sl_csvc_decref(csvc);
+}
+
+/*
+ * Gather asynchronous creates for up to SLC_ACREATE_WINDOW microseconds
+ * or until a full CREATE_BULK is queued or someone is waiting on them,
+ * then push them to the MDS.
+ */
+void
+msacreatethr_main(struct psc_thread *thr)
+{
+	struct msl_acreate *ac, *tmp, *acv[SRM_CREATE_BULK_MAX];
+	int n;
+
+	while (pscthr_run(thr)) {
+		LIST_CACHE_LOCK(&msl_acreateq);
+		lc_peekheadwait(&msl_acreateq);
+		if (lc_nitems(&msl_acreateq) < SRM_CREATE_BULK_MAX &&
+		    !msl_acreate_urgent) {
+			psc_waitq_waitrel_us(&msl_acreate_waitq,
+			    &msl_acreateq.plc_lock, SLC_ACREATE_WINDOW);
+			LIST_CACHE_LOCK(&msl_acreateq);
+		}
+		msl_acreate_urgent = 0;
+
+		n = 0;
+		LIST_CACHE_FOREACH_SAFE(ac, tmp, &msl_acreateq) {
+			lc_remove(&msl_acreateq, ac);
+			acv[n++] = ac;
+			if (n == nitems(acv))
+				break;
+		}
+		LIST_CACHE_ULOCK(&msl_acreateq);
+
+		if (n)
+			msl_acreate_flush(acv, n);
+	}
+}
+
+void
+msacreatethr_spawn(void)
+{
+	struct psc_thread *thr;
+
+	lc_reginit(&msl_acreateq, struct msl_acreate, mac_lentry,
+	    "acreateq");
+
+	thr = pscthr_init(MSTHRT_ACREATE, msacreatethr_main, NULL,
+	    sizeof(struct msacreate_thread), "msacreatethr");
+	psc_multiwait_init(&msacreatethr(thr)->mact_mw, "%s",
+	    thr->pscthr_name);
+	pscthr_setready(thr);
+}
+
+/*
+ * Return, and forget, the failure of an earlier asynchronous unlink or
+ * rmdir in a directory.
+ */
+int
+msl_adelete_geterr(struct fidc_membh *d)
+{
+	struct fcmh_cli_info *fci;
+	int rc;
+
+	if (!fcmh_isdir(d))
+		return (0);
+
+	fci = fcmh_2_fci(d);
+	FCMH_LOCK(d);
+	rc = fci->fcid_adelete_err;
+	fci->fcid_adelete_err = 0;
+	FCMH_ULOCK(d);
+	if (rc)
+		OPSTAT_INCR("adelete-err-reported");
+	return (rc);
+}
+
+/*
+ * Queue an unlink or rmdir for msadeletethr to send to the MDS in an
+ * UNLINK_BULK.  The name is dropped from the namecache right away so
+ * that any LOOKUP of it goes to the MDS, which drains the queue first.
+ */
+void
+msl_adelete(struct fidc_membh *p, const char *name, int isfile)
+{
+	struct fidc_membh *c;
+	struct msl_adelete *ad;
+
+	ad = PSCALLOC(sizeof(*ad));
+	INIT_LISTENTRY(&ad->mad_lentry);
+	ad->mad_ent.pfid = fcmh_2_fid(p);
+	ad->mad_ent.isfile = isfile;
+	strlcpy(ad->mad_ent.name, name, sizeof(ad->mad_ent.name));
+	ad->mad_cfid = namecache_lookup(p, name);
+	namecache_delete(p, name);
+
+	/* the directory may still be filling from the create queue */
+	if (!isfile && ad->mad_cfid != FID_ANY &&
+	    ad->mad_cfid != NAMECACHE_NEGATIVE &&
+	    fidc_lookup_fid(ad->mad_cfid, &c) == 0) {
+		msl_acreate_drain(c);
+		fcmh_op_done(c);
+	}
+
+	fcmh_op_start_type(p, FCMH_OPCNT_WORKER);
+	ad->mad_pfcmh = p;
+
+	LIST_CACHE_LOCK(&msl_adeleteq);
+	ad->mad_seq = ++msl_adelete_seq;
+	fcmh_2_fci(p)->fci_adelete_seq = ad->mad_seq;
+	lc_add(&msl_adeleteq, ad);
+	if (lc_nitems(&msl_adeleteq) >= SRM_UNLINK_BULK_MAX)
+		psc_waitq_wakeall(&msl_adelete_waitq);
+	LIST_CACHE_ULOCK(&msl_adeleteq);
+
+	OPSTAT_INCR("adelete");
+}
+
+/*
+ * Wait until every asynchronous delete in directory @f has been
+ * processed by the MDS.
+ */
+void
+msl_adelete_drain(struct fidc_membh *f)
+{
+	uint64_t seq;
+
+	if (f == NULL ||
+	    fcmh_2_fci(f)->fci_adelete_seq <= msl_adelete_doneseq)
+		return;
+
+	LIST_CACHE_LOCK(&msl_adeleteq);
+	seq = fcmh_2_fci(f)->fci_adelete_seq;
+	if (msl_adelete_doneseq < seq) {
+		OPSTAT_INCR("adelete-drain");
+		msl_adelete_urgent = 1;
+		psc_waitq_wakeall(&msl_adelete_waitq);
+	}
+	while (msl_adelete_doneseq < seq) {
+		psc_waitq_wait(&msl_adelete_donewq,
+		    &msl_adeleteq.plc_lock);
+		LIST_CACHE_LOCK(&msl_adeleteq);
+	}
+	LIST_CACHE_ULOCK(&msl_adeleteq);
+}
+
+/*
+ * Settle one asynchronous delete after the MDS has replied.
+ */
+void
+msl_adelete_done(struct msl_adelete *ad, int rc)
+{
+	struct fidc_membh *c, *p = ad->mad_pfcmh;
+	struct fcmh_cli_info *fci;
+
+	fci = fcmh_2_fci(p);
+	FCMH_LOCK(p);
+	if (rc) {
+		OPSTAT_INCR("adelete-err");
+		DEBUG_FCMH(PLL_WARN, p, "asynchronous %s of '%s' failed: "
+		    "rc=%d", ad->mad_ent.isfile ? "unlink" : "rmdir",
+		    ad->mad_ent.name, rc);
+		if (fci->fcid_adelete_err == 0)
+			fci->fcid_adelete_err = rc;
+	}
+	timerclear(&fci->fci_age);
+	fcmh_op_done_type(p, FCMH_OPCNT_WORKER);
+
+	/* Link count and such changed; refetch the child's attributes. */
+	if (rc == 0 && ad->mad_cfid != FID_ANY &&
+	    ad->mad_cfid != NAMECACHE_NEGATIVE &&
+	    fidc_lookup_fid(ad->mad_cfid, &c) == 0) {
+		FCMH_LOCK(c);
+		timerclear(&fcmh_2_fci(c)->fci_age);
+		fcmh_op_done(c);
+	}
+
+	PSCFREE(ad);
+}
+
+/*
+ * Send a batch of asynchronous deletes to the MDS in one UNLINK_BULK.
+ */
+void
+msl_adelete_flush(struct msl_adelete **adv, int n)
+{
+	struct slashrpc_cservice *csvc = NULL;
+	struct srm_unlink_bulk_rep *mp = NULL;
+	struct srm_unlink_bulk_req *mq;
+	struct pscrpc_request *rq = NULL;
+	struct srt_unlink_ent *e;
+	struct iovec iov;
+	uint64_t seq;
+	int i, rc;
+
+	/* a delete may refer to a file still in the create queue */
+	for (i = 0; i < n; i++)
+		msl_acreate_drain(adv[i]->mad_pfcmh);
+
+	OPSTAT_INCR("adelete-bulk");
+	OPSTAT_ADD("adelete-bulk-ents", n);
+
+	iov.iov_len = n * sizeof(*e);
+	iov.iov_base = e = PSCALLOC(iov.iov_len);
+	for (i = 0; i < n; i++)
+		e[i] = adv[i]->mad_ent;
+
+	do {
+		MSL_RMC_NEWREQ_PFCC(NULL, NULL, csvc, SRMT_UNLINK_BULK,
+		    rq, mq, mp, rc);
+		if (rc)
+			break;
+
+		mq->nents = n;
+		rc = slrpc_bulkclient(rq, BULK_GET_SOURCE,
+		    SRMC_BULK_PORTAL, &iov, 1);
+		if (rc)
+			break;
+
+		rc = SL_RSX_WAITREP(csvc, rq, mp);
+	} while (rc && slc_rmc_retry_pfcc(NULL, &rc));
+
+	if (rc == 0)
+		rc = -mp->rc;
+	if (rc == 0 && mp->nents != n)
+		rc = EBADMSG;
+
+	seq = adv[n - 1]->mad_seq;
+	for (i = 0; i < n; i++)
+		msl_adelete_done(adv[i], rc ? rc : -mp->rcs[i]);
+
+	LIST_CACHE_LOCK(&msl_adeleteq);
+	msl_adelete_doneseq = seq;
+	psc_waitq_wakeall(&msl_adelete_donewq);
+	LIST_CACHE_ULOCK(&msl_adeleteq);
+
+	PSCFREE(iov.iov_base);
+	if (rq)
+		pscrpc_req_finished(rq);
+	if (csvc)
+		sl_csvc_decref(csvc);
+}
+
+/*
+ * Gather asynchronous deletes for up to SLC_ADELETE_WINDOW microseconds
+ * or until a full UNLINK_BULK is queued or someone is waiting on them,
+ * then push them to the MDS.
+ */
+void
+msadeletethr_main(struct psc_thread *thr)
+{
+	struct msl_adelete *ad, *tmp, *adv[SRM_UNLINK_BULK_MAX];
+	int n;
+
+	while (pscthr_run(thr)) {
+		LIST_CACHE_LOCK(&msl_adeleteq);
+		lc_peekheadwait(&msl_adeleteq);
+		if (lc_nitems(&msl_adeleteq) < SRM_UNLINK_BULK_MAX &&
+		    !msl_adelete_urgent) {
+			psc_waitq_waitrel_us(&msl_adelete_waitq,
+			    &msl_adeleteq.plc_lock, SLC_ADELETE_WINDOW);
+			LIST_CACHE_LOCK(&msl_adeleteq);
+		}
+		msl_adelete_urgent = 0;
+
+		n = 0;
+		LIST_CACHE_FOREACH_SAFE(ad, tmp, &msl_adeleteq) {
+			lc_remove(&msl_adeleteq, ad);
+			adv[n++] = ad;
+			if (n == nitems(adv))
+				break;
+		}
+		LIST_CACHE_ULOCK(&msl_adeleteq);
+
+		if (n)
+			msl_adelete_flush(adv, n);
+	}
+}
+
+void
+msadeletethr_spawn(void)
+{
+	struct psc_thread *thr;
+
+	lc_reginit(&msl_adeleteq, struct msl_adelete, mad_lentry,
+	    "adeleteq");
+
+	thr = pscthr_init(MSTHRT_ADELETE, msadeletethr_main, NULL,
+	    sizeof(struct msadelete_thread), "msadeletethr");
+	psc_multiwait_init(&msadeletethr(thr)->madt_mw, "%s",
+	    thr->pscthr_name);
+	pscthr_setready(thr);
+}
+
 void
 mslfsop_create(struct pscfs_req *pfr, pscfs_inum_t pinum,
     const char *name, int oflags, mode_t mode)
@@ -395,6 +994,9 @@ mslfsop_create(struct pscfs_req *pfr, pscfs_inum_t pinum,
 	if (rc)
 		PFL_GOTOERR(out, rc);
 	rc = fcmh_reserved(p);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	rc = msl_adelete_geterr(p);
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
@@ -403,6 +1005,27 @@ mslfsop_create(struct pscfs_req *pfr, pscfs_inum_t pinum,
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
+	/*
+	 * If we know the name does not exist, we can create the file
+	 * under a leased FID and let the MDS catch up later.  Any
+	 * failure here just means we take the synchronous path.
+	 */
+	if (psc_atomic32_read(&slc_async_create) &&
+	    fcmh_2_fci(p)->fci_resm == slc_rmc_resm &&
+	    namecache_lookup(p, name) == NAMECACHE_NEGATIVE &&
+	    msl_acreate(pfr, p, name, mode, &pcr, &c) == 0) {
+		mfh = msl_fhent_new(pfr, c);
+		mfh->mfh_oflags = oflags;
+		PFL_GETTIMESPEC(&mfh->mfh_open_time);
+
+		FCMH_LOCK(c);
+		memcpy(&mfh->mfh_open_atime, &c->fcmh_sstb.sst_atime,
+		    sizeof(mfh->mfh_open_atime));
+		sl_internalize_stat(&c->fcmh_sstb, &stb);
+		FCMH_ULOCK(c);
+		goto opened;
+	}
+
  retry:
 	MSL_RMC_NEWREQ(pfr, p, csvc, SRMT_CREATE, rq, mq, mp, rc);
 	if (rc)
@@ -465,6 +1088,13 @@ mslfsop_create(struct pscfs_req *pfr, pscfs_inum_t pinum,
 
 	fci = fcmh_2_fci(c);
 
+	/* the MDS holds the data of this file; no bmap lease to load */
+	if (mp->flags & SRM_LEASEBMAPF_INLINE) {
+		c->fcmh_flags |= FCMH_CLI_INLINE;
+		FCMH_ULOCK(c);
+		goto opened;
+	}
+
 	// fci_inode should be read from
 	// msl_fcmh_save_inode(c, &mp->ino);
 
@@ -503,6 +1133,7 @@ mslfsop_create(struct pscfs_req *pfr, pscfs_inum_t pinum,
 
 	bmap_op_done(b);
 
+ opened:
 	if ((c->fcmh_sstb.sst_mode & _S_IXUGO) == 0 &&
 	    psc_atomic32_read(&slc_direct_io))
 		rflags |= PSCFS_CREATEF_DIO;
@@ -510,13 +1141,13 @@ mslfsop_create(struct pscfs_req *pfr, pscfs_inum_t pinum,
 	FCMH_LOCK(c);
 	fcmh_op_start_type(c, FCMH_OPCNT_OPEN);
  out:
-	pscfs_reply_create(pfr, mp ? mp->cattr.sst_fid : 0,
-	    mp ? mp->cattr.sst_gen : 0, pscfs_entry_timeout, &stb,
+	pscfs_reply_create(pfr, c ? fcmh_2_fid(c) : 0,
+	    c ? fcmh_2_gen(c) : 0, pscfs_entry_timeout, &stb,
 	    pscfs_attr_timeout, mfh, rflags, rc);
 
 	psclogs_diag(SLCSS_FSOP, "CREATE: pfid="SLPRI_FID" "
 	    "cfid="SLPRI_FID" name='%s' mode=%#o oflags=%#o rc=%d",
-	    pinum, mp ? mp->cattr.sst_fid : FID_ANY, name, mode, oflags,
+	    pinum, c ? fcmh_2_fid(c) : FID_ANY, name, mode, oflags,
 	    rc);
 
 	if (c)
@@ -529,12 +1160,130 @@ mslfsop_create(struct pscfs_req *pfr, pscfs_inum_t pinum,
 		sl_csvc_decref(csvc);
 }
 
+/*
+ * Issue a COMPOUND RPC in place of the LOOKUP or GETATTR, GET_INODE
+ * and GETBMAP round trips needed on a cold open.  If @name is given,
+ * it is looked up under @p; otherwise @fg is used directly.  The
+ * attributes and replica table are installed into the fcmh and any
+ * read lease granted on bmap 0 is installed into the bmap cache.
+ * @ops: SRM_COMPOUNDF_* operations wanted besides the LOOKUP/GETATTR;
+ *	only an open should ask for LEASEBMAP and INLINE.
+ */
+__static int
+msl_compoundrpc(struct pscfs_req *pfr, struct fidc_membh *p,
+    const char *name, const struct sl_fidgen *fg, int ops,
+    struct sl_fidgen *fgp, struct srt_stat *sstb,
+    struct fidc_membh **fp)
+{
+	struct slashrpc_cservice *csvc = NULL;
+	struct pscrpc_request *rq = NULL;
+	struct fidc_membh *f = NULL;
+	struct srm_compound_rep *mp = NULL;
+	struct srm_compound_req *mq;
+	char ibuf[SRM_INLINE_MAX];
+	struct iovec iov;
+	int rc;
+
+ retry:
+	MSL_RMC_NEWREQ(pfr, p, csvc, SRMT_COMPOUND, rq, mq, mp, rc);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	if (name) {
+		mq->ops = SRM_COMPOUNDF_LOOKUP;
+		mq->fg.fg_fid = fcmh_2_fid(p);
+		mq->fg.fg_gen = FGEN_ANY;
+		strlcpy(mq->name, name, sizeof(mq->name));
+	} else {
+		mq->ops = SRM_COMPOUNDF_GETATTR;
+		mq->fg = *fg;
+	}
+	mq->ops |= ops;
+	mq->prefios[0] = msl_pref_ios;
+	mq->bmapno = 0;
+
+	if (ops & SRM_COMPOUNDF_INLINE) {
+		iov.iov_base = ibuf;
+		iov.iov_len = sizeof(ibuf);
+		rq->rq_bulk_abortable = 1;
+		rc = slrpc_bulkclient(rq, BULK_PUT_SINK,
+		    SRMC_BULK_PORTAL, &iov, 1);
+		if (rc)
+			PFL_GOTOERR(out, rc);
+	}
+
+	rc = SL_RSX_WAITREPF(csvc, rq, mp,
+	    SRPCWAITF_DEFER_BULK_AUTHBUF_CHECK);
+	if (rc && slc_rmc_retry(pfr, &rc))
+		goto retry;
+	if (abs(rc) == PFLERR_NOSYS) {
+		/* the MDS predates COMPOUND; stick to the old RPCs */
+		OPSTAT_INCR("compound-nosys");
+		psc_atomic32_set(&slc_compound, 0);
+	}
+	if (rc == 0 && (mp->ops & SRM_COMPOUNDF_INLINE) && mp->inlsize) {
+		if (mp->inlsize > sizeof(ibuf))
+			PFL_GOTOERR(out, rc = -EINVAL);
+		iov.iov_len = mp->inlsize;
+		rc = slrpc_bulk_checkmsg(rq, rq->rq_repmsg, &iov, 1);
+	}
+	if (rc == 0 && (mp->ops & (SRM_COMPOUNDF_LOOKUP |
+	    SRM_COMPOUNDF_GETATTR)) == 0) {
+		rc = mp->rc;
+		if (name && abs(rc) == ENOENT)
+			namecache_insert_negative(p, name);
+	}
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	rc = msl_create_fcmh(pfr, &mp->attr.sst_fg, &f);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+
+	if (fgp)
+		*fgp = mp->attr.sst_fg;
+
+	if (name)
+		namecache_clobber(p, name, fcmh_2_fid(f));
+
+	FCMH_LOCK(f);
+	slc_fcmh_setattr_locked(f, &mp->attr);
+	msl_fcmh_stash_xattrsize(f, mp->xattrsize);
+	if (mp->ops & SRM_COMPOUNDF_GETINODE)
+		msl_fcmh_stash_inode(f, &mp->ino);
+	if (mp->ops & SRM_COMPOUNDF_INLINE)
+		msl_fcmh_stash_inline(f, ibuf, mp->inlsize);
+	if (sstb)
+		*sstb = f->fcmh_sstb;
+	FCMH_ULOCK(f);
+
+	if (mp->ops & SRM_COMPOUNDF_LEASEBMAP)
+		msl_bmap_stash_lease(f, 0, &mp->sbd, mp->repls);
+
+ out:
+	psclogs_diag(SLCSS_FSOP, "COMPOUND: pfid="SLPRI_FID" name='%s' "
+	    "cfid="SLPRI_FID" ops=%#x rc=%d",
+	    p ? fcmh_2_fid(p) : FID_ANY, name ? name : "",
+	    f ? fcmh_2_fid(f) : FID_ANY, mp ? mp->ops : 0, rc);
+
+	if (rc == 0 && fp)
+		*fp = f;
+	else if (f)
+		fcmh_op_done(f);
+	if (rq)
+		pscrpc_req_finished(rq);
+	if (csvc)
+		sl_csvc_decref(csvc);
+	return (rc);
+}
+
 __static int
 msl_open(struct pscfs_req *pfr, pscfs_inum_t inum, int oflags,
     struct msl_fhent **mfhp, int *rflags)
 {
 	struct fidc_membh *c = NULL;
 	struct pscfs_creds pcr;
+	struct sl_fidgen fg;
 	int rc = 0;
 
 	msfsthr_ensure(pfr);
@@ -546,9 +1295,27 @@ msl_open(struct pscfs_req *pfr, pscfs_inum_t inum, int oflags,
 	if (!msl_progallowed(pfr))
 		PFL_GOTOERR(out, rc = EPERM);
 
-	rc = msl_load_fcmh(pfr, inum, &c);
-	if (rc)
-		PFL_GOTOERR(out, rc);
+	/*
+	 * If the file has fallen out of the cache, fetch its attributes
+	 * together with a read lease for its first bmap.
+	 */
+	if (psc_atomic32_read(&slc_compound) &&
+	    (oflags & (O_ACCMODE | O_DIRECTORY)) == O_RDONLY &&
+	    FID_GET_SITEID(inum) == slc_rmc_resm->resm_siteid &&
+	    msl_peek_fcmh(pfr, inum, &c)) {
+		fg.fg_fid = inum;
+		fg.fg_gen = FGEN_ANY;
+		/* on failure, fall back to a regular load below */
+		msl_compoundrpc(pfr, NULL, NULL, &fg,
+		    SRM_COMPOUNDF_GETINODE | SRM_COMPOUNDF_LEASEBMAP |
+		    SRM_COMPOUNDF_INLINE, NULL, NULL, &c);
+	}
+
+	if (c == NULL) {
+		rc = msl_load_fcmh(pfr, inum, &c);
+		if (rc)
+			PFL_GOTOERR(out, rc);
+	}
 
 	if ((oflags & O_ACCMODE) != O_WRONLY) {
 		rc = fcmh_checkcreds(c, pfr, &pcr, R_OK);
@@ -637,14 +1404,186 @@ mslfsop_opendir(struct pscfs_req *pfr, pscfs_inum_t inum, int oflags)
 	pscfs_reply_opendir(pfr, mfh, rflags, rc);
 }
 
+/*
+ * Fetch the attributes of one file with a GETATTR RPC.
+ */
 int
-msl_stat(struct fidc_membh *f, void *arg)
+msl_getattr_rpc(struct pscfs_clientctx *pfcc,
+    struct msl_getattr_waiter *w)
 {
 	struct slashrpc_cservice *csvc = NULL;
-	struct pscfs_clientctx *pfcc = arg;
+	struct fidc_membh *f = w->mgw_fcmh;
 	struct pscrpc_request *rq = NULL;
 	struct srm_getattr_req *mq;
 	struct srm_getattr_rep *mp;
+	int rc;
+
+	do {
+		MSL_RMC_NEWREQ_PFCC(pfcc, f, csvc, SRMT_GETATTR, rq, mq,
+		    mp, rc);
+		if (rc)
+			break;
+
+		mq->fg = f->fcmh_fg;
+		mq->iosid = msl_pref_ios;
+
+		rc = SL_RSX_WAITREP(csvc, rq, mp);
+	} while (rc && slc_rmc_retry_pfcc(pfcc, &rc));
+
+	if (rc == 0)
+		rc = mp->rc;
+	if (rc == 0) {
+		w->mgw_attr = mp->attr;
+		w->mgw_xattrsize = mp->xattrsize;
+	}
+	if (rq)
+		pscrpc_req_finished(rq);
+	if (csvc)
+		sl_csvc_decref(csvc);
+	return (rc);
+}
+
+/*
+ * Fetch the attributes of several files with one GETATTR_BULK RPC and
+ * fill in each waiter's result.
+ */
+void
+msl_getattr_bulkrpc(struct pscfs_clientctx *pfcc,
+    struct msl_getattr_waiter **ws, int n)
+{
+	struct slashrpc_cservice *csvc = NULL;
+	struct srm_getattr_bulk_req *mq;
+	struct srm_getattr_bulk_rep *mp;
+	struct pscrpc_request *rq = NULL;
+	struct msl_getattr_waiter *w;
+	struct srt_getattr_ent *e;
+	struct iovec iov;
+	int i, rc;
+
+	OPSTAT_INCR("getattr-bulk");
+	OPSTAT_ADD("getattr-bulk-fids", n);
+
+	for (i = 0; i < n; i++)
+		msl_acreate_drain(ws[i]->mgw_fcmh);
+
+	iov.iov_len = n * sizeof(*e);
+	iov.iov_base = PSCALLOC(iov.iov_len);
+
+	do {
+		MSL_RMC_NEWREQ_PFCC(pfcc, NULL, csvc, SRMT_GETATTR_BULK,
+		    rq, mq, mp, rc);
+		if (rc)
+			break;
+
+		mq->nfids = n;
+		for (i = 0; i < n; i++)
+			mq->fgs[i] = ws[i]->mgw_fcmh->fcmh_fg;
+
+		rc = slrpc_bulkclient(rq, BULK_PUT_SINK,
+		    SRMC_BULK_PORTAL, &iov, 1);
+		if (rc)
+			break;
+
+		rc = SL_RSX_WAITREP(csvc, rq, mp);
+	} while (rc && slc_rmc_retry_pfcc(pfcc, &rc));
+
+	if (rc == 0)
+		rc = mp->rc;
+	if (rc)
+		OPSTAT_INCR("getattr-bulk-err");
+
+	for (i = 0, e = iov.iov_base; i < n; i++, e++) {
+		w = ws[i];
+		if (rc) {
+			w->mgw_flags |= MGWF_RETRY;
+			continue;
+		}
+		w->mgw_rc = e->rc;
+		w->mgw_attr = e->attr;
+		w->mgw_xattrsize = e->xattrsize;
+	}
+
+	PSCFREE(iov.iov_base);
+	if (rq)
+		pscrpc_req_finished(rq);
+	if (csvc)
+		sl_csvc_decref(csvc);
+}
+
+/*
+ * Gather concurrent GETATTRs into GETATTR_BULK RPCs.  A thread arriving
+ * while no batch is being assembled becomes the leader: if others are
+ * about, it waits up to slc_getattr_window microseconds or until a full
+ * batch has gathered, then issues the RPC on behalf of everyone in it.
+ * A lone caller is sent straight out as a plain GETATTR.
+ */
+int
+msl_getattr_batch(struct pscfs_clientctx *pfcc,
+    struct msl_getattr_waiter *w)
+{
+	struct msl_getattr_waiter *ws[SRM_GETATTR_BULK_MAX];
+	int i, n, usecs;
+
+	spinlock(&msl_getattr_lock);
+	msl_getattr_nactive++;
+	psc_dynarray_add(&msl_getattr_pending, w);
+	if (psc_dynarray_len(&msl_getattr_pending) >=
+	    SRM_GETATTR_BULK_MAX)
+		psc_waitq_wakeall(&msl_getattr_waitq);
+
+	while ((w->mgw_flags & MGWF_DONE) == 0) {
+		if (msl_getattr_leader) {
+			psc_waitq_wait(&msl_getattr_waitq,
+			    &msl_getattr_lock);
+			spinlock(&msl_getattr_lock);
+			continue;
+		}
+
+		msl_getattr_leader = 1;
+		usecs = psc_atomic32_read(&slc_getattr_window);
+		if (msl_getattr_nactive > 1 && usecs > 0 &&
+		    psc_dynarray_len(&msl_getattr_pending) <
+		    SRM_GETATTR_BULK_MAX) {
+			psc_waitq_waitrel_us(&msl_getattr_waitq,
+			    &msl_getattr_lock, usecs);
+			spinlock(&msl_getattr_lock);
+		}
+
+		n = MIN(psc_dynarray_len(&msl_getattr_pending),
+		    SRM_GETATTR_BULK_MAX);
+		for (i = 0; i < n; i++)
+			ws[i] = psc_dynarray_getpos(
+			    &msl_getattr_pending, i);
+		for (i = 0; i < n; i++)
+			psc_dynarray_remove(&msl_getattr_pending,
+			    ws[i]);
+		freelock(&msl_getattr_lock);
+
+		if (n == 1) {
+			OPSTAT_INCR("getattr-single");
+			ws[0]->mgw_rc = msl_getattr_rpc(pfcc, ws[0]);
+		} else
+			msl_getattr_bulkrpc(pfcc, ws, n);
+
+		spinlock(&msl_getattr_lock);
+		for (i = 0; i < n; i++)
+			ws[i]->mgw_flags |= MGWF_DONE;
+		msl_getattr_leader = 0;
+		psc_waitq_wakeall(&msl_getattr_waitq);
+	}
+	msl_getattr_nactive--;
+	freelock(&msl_getattr_lock);
+
+	if (w->mgw_flags & MGWF_RETRY)
+		return (msl_getattr_rpc(pfcc, w));
+	return (w->mgw_rc);
+}
+
+int
+msl_stat(struct fidc_membh *f, void *arg)
+{
+	struct pscfs_clientctx *pfcc = arg;
+	struct msl_getattr_waiter w;
 	struct fcmh_cli_info *fci;
 	struct timeval now;
 	int rc = 0;
@@ -681,27 +1620,25 @@ msl_stat(struct fidc_membh *f, void *arg)
 	f->fcmh_flags |= FCMH_GETTING_ATTRS;
 	FCMH_ULOCK(f);
 
-	do {
-		MSL_RMC_NEWREQ_PFCC(pfcc, f, csvc, SRMT_GETATTR, rq, mq,
-		    mp, rc);
-		if (rc)
-			break;
-
-		mq->fg = f->fcmh_fg;
-		mq->iosid = msl_pref_ios;
-
-		rc = SL_RSX_WAITREP(csvc, rq, mp);
-	} while (rc && slc_rmc_retry_pfcc(pfcc, &rc));
+	memset(&w, 0, sizeof(w));
+	w.mgw_fcmh = f;
 
-	if (rc == 0)
-		rc = mp->rc;
+	/*
+	 * GETATTR_BULK goes to our MDS so only files it owns may be
+	 * batched.
+	 */
+	if (psc_atomic32_read(&slc_getattr_window) > 0 &&
+	    fci->fci_resm == slc_rmc_resm)
+		rc = msl_getattr_batch(pfcc, &w);
+	else
+		rc = msl_getattr_rpc(pfcc, &w);
 
 	FCMH_LOCK(f);
-	if (!rc && fcmh_2_fid(f) != mp->attr.sst_fid)
+	if (!rc && fcmh_2_fid(f) != w.mgw_attr.sst_fid)
 		rc = EBADF;
 	if (!rc) {
-		slc_fcmh_setattr_locked(f, &mp->attr);
-		msl_fcmh_stash_xattrsize(f, mp->xattrsize);
+		slc_fcmh_setattr_locked(f, &w.mgw_attr);
+		msl_fcmh_stash_xattrsize(f, w.mgw_xattrsize);
 	}
 	f->fcmh_flags &= ~FCMH_GETTING_ATTRS;
 	fcmh_wake_locked(f);
@@ -709,10 +1646,6 @@ msl_stat(struct fidc_membh *f, void *arg)
 	DEBUG_FCMH(PLL_DEBUG, f, "attrs retrieved via rpc rc=%d", rc);
 
 	FCMH_ULOCK(f);
-	if (rq)
-		pscrpc_req_finished(rq);
-	if (csvc)
-		sl_csvc_decref(csvc);
 	return (rc);
 }
 
@@ -786,6 +1719,9 @@ mslfsop_link(struct pscfs_req *pfr, pscfs_inum_t c_inum,
 	if (!fcmh_isdir(p))
 		PFL_GOTOERR(out, rc = ENOTDIR);
 	rc = fcmh_reserved(p);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	rc = msl_adelete_geterr(p);
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
@@ -812,6 +1748,8 @@ mslfsop_link(struct pscfs_req *pfr, pscfs_inum_t c_inum,
 	    FID_GET_SITEID(fcmh_2_fid(c)))
 		PFL_GOTOERR(out, rc = EXDEV);
 
+	msl_acreate_drain(c);
+
  retry:
 	MSL_RMC_NEWREQ(pfr, p, csvc, SRMT_LINK, rq, mq, mp, rc);
 	if (rc)
@@ -887,6 +1825,9 @@ mslfsop_mkdir(struct pscfs_req *pfr, pscfs_inum_t pinum,
 	if (rc)
 		PFL_GOTOERR(out, rc);
 	rc = fcmh_reserved(p);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	rc = msl_adelete_geterr(p);
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
@@ -968,6 +1909,13 @@ msl_lookuprpc(struct pscfs_req *pfr, struct fidc_membh *p,
 	struct srm_lookup_rep *mp;
 	int rc;
 
+	if (psc_atomic32_read(&slc_compound)) {
+		rc = msl_compoundrpc(pfr, p, name, NULL,
+		    SRM_COMPOUNDF_GETINODE, fgp, sstb, fp);
+		if (abs(rc) != PFLERR_NOSYS)
+			return (rc);
+	}
+
  retry:
 	MSL_RMC_NEWREQ(pfr, p, csvc, SRMT_LOOKUP, rq, mq, mp, rc);
 	if (rc)
@@ -980,8 +1928,11 @@ msl_lookuprpc(struct pscfs_req *pfr, struct fidc_membh *p,
 	rc = SL_RSX_WAITREP(csvc, rq, mp);
 	if (rc && slc_rmc_retry(pfr, &rc))
 		goto retry;
-	if (rc == 0)
+	if (rc == 0) {
 		rc = mp->rc;
+		if (abs(rc) == ENOENT)
+			namecache_insert_negative(p, name);
+	}
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
@@ -1024,71 +1975,84 @@ msl_lookuprpc(struct pscfs_req *pfr, struct fidc_membh *p,
 }
 
 
-/* Remove the following #if when we actually implement dircache_tally_lookup_miss() */
-#if 0
 int
 slc_wk_issue_readdir(void *p)
 {
 	struct slc_wkdata_readdir *wk = p;
 
-	msl_readdir_issue(NULL, wk->d, wk->off, wk->size, 0);
-	FCMH_LOCK(wk->d);
-	wk->pg->dcp_refcnt--;
+	if (msl_readdir_issue(NULL, wk->d, wk->off, wk->size, 0, 1)) {
+		/* Someone else is loading this page; end the walk. */
+		FCMH_LOCK(wk->d);
+		wk->d->fcmh_flags &= ~FCMH_CLI_PREFETCH;
+		FCMH_ULOCK(wk->d);
+	}
 	fcmh_op_done_type(wk->d, FCMH_OPCNT_WORKER);
 	return (0);
 }
-#endif
+
+/*
+ * Queue an asynchronous READDIR of the page at the given offset on
+ * behalf of a lookup-miss driven directory prefetch.
+ */
+void
+msl_readdir_prefetch(struct fidc_membh *d, off_t off)
+{
+	struct slc_wkdata_readdir *wk;
+
+	wk = pfl_workq_getitem(slc_wk_issue_readdir,
+	    struct slc_wkdata_readdir);
+	fcmh_op_start_type(d, FCMH_OPCNT_WORKER);
+	wk->d = d;
+	wk->off = off;
+	wk->size = DIR_LOOKUP_PREFETCH_SIZE;
+	pfl_workq_putitem(wk);
+}
 
 /*
  * Register a 'miss' in the FID namespace lookup cache.
  * If we reach a threshold, we issue an asynchronous READDIR in hopes
- * that we will hit subsequent requests.
+ * that we will hit subsequent requests.  The READDIR brings back
+ * attributes along with the names so each later LOOKUP in this
+ * directory can be answered locally.  The walk continues page by page
+ * from msl_readdir_finish() until EOF.
  */
 void
 dircache_tally_lookup_miss(struct fidc_membh *p)
 {
-#if 0
 	struct fcmh_cli_info *pi = fcmh_2_fci(p);
-	struct slc_wkdata_readdir *wk = NULL;
 	struct timeval ts, delta;
-	struct dircache_page *np;
 	int ra = 0;
 
 	OPSTAT_INCR("dircache-lookup-miss");
 
 	FCMH_LOCK(p);
+	if (p->fcmh_flags & FCMH_CLI_PREFETCHED)
+		OPSTAT_INCR("dircache-prefetch-miss");
 	PFL_GETTIMEVAL(&ts);
 	timersub(&ts, &pi->fcid_lookup_age, &delta);
 	if (delta.tv_sec > 1) {
 		pi->fcid_lookup_age = ts;
-		pi->fcid_lookup_misses = pi->fcid_lookup_misses >>
-		    delta.tv_sec;
+		if (delta.tv_sec >= 64)
+			pi->fcid_lookup_misses = 0;
+		else
+			pi->fcid_lookup_misses >>= delta.tv_sec;
 	}
 	pi->fcid_lookup_misses += DIR_LOOKUP_MISSES_INCR;
-	if (pi->fcid_lookup_misses >= DIR_LOOKUP_MISSES_THRES)
+	if (pi->fcid_lookup_misses >= DIR_LOOKUP_MISSES_THRES &&
+	    (p->fcmh_flags & FCMH_CLI_PREFETCH) == 0) {
+		p->fcmh_flags |= FCMH_CLI_PREFETCH;
+		pi->fcid_lookup_misses = 0;
 		ra = 1;
+	}
 	FCMH_ULOCK(p);
 
 	if (!ra)
 		return;
 
-	if (dircache_hasoff(p, off)) {
-
-	np = dircache_new_page(p, 0, 0);
-	if (np == NULL)
-		return;
-
-	wk = pfl_workq_getitem(slc_wk_issue_readdir,
-	    struct slc_wkdata_readdir);
-	fcmh_op_start_type(p, FCMH_OPCNT_WORKER);
-	wk->d = p;
-	wk->pg = np;
-	wk->off = off;
-	wk->size = 32 * 1024;
-	pfl_workq_putitem(wk);
-
-	msl_readdir_issue(NULL, d, 0, size, 0);
-#endif
+	OPSTAT_INCR("dircache-prefetch");
+	psclog_diag("lookup misses triggered prefetch of "
+	    "dir="SLPRI_FID, fcmh_2_fid(p));
+	msl_readdir_prefetch(p, 0);
 }
 
 __static int
@@ -1161,6 +2125,10 @@ msl_lookup_fidcache(struct pscfs_req *pfr,
 		PFL_GOTOERR(out, rc);
 
 	cfid = namecache_lookup(p, name);
+	if (cfid == NAMECACHE_NEGATIVE)
+		PFL_GOTOERR(out, rc = ENOENT);
+	if (cfid != FID_ANY && p->fcmh_flags & FCMH_CLI_PREFETCHED)
+		OPSTAT_INCR("dircache-prefetch-hit");
 	if (cfid == FID_ANY || fidc_lookup_fid(cfid, &c)) {
 		if (cfid == FID_ANY)
 			dircache_tally_lookup_miss(p);
@@ -1229,6 +2197,9 @@ msl_delete(struct pscfs_req *pfr, pscfs_inum_t pinum,
 		PFL_GOTOERR(out, rc);
 	if (pinum == SLFID_ROOT && strcmp(name, MSL_FIDNS_RPATH) == 0)
 		PFL_GOTOERR(out, rc = EPERM);
+	rc = msl_adelete_geterr(p);
+	if (rc)
+		PFL_GOTOERR(out, rc);
 
 	slc_getfscreds(pfr, &pcr);
 
@@ -1255,6 +2226,12 @@ msl_delete(struct pscfs_req *pfr, pscfs_inum_t pinum,
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
+	if (psc_atomic32_read(&slc_async_delete) &&
+	    fcmh_2_fci(p)->fci_resm == slc_rmc_resm) {
+		msl_adelete(p, name, isfile);
+		PFL_GOTOERR(out, rc = 0);
+	}
+
  retry:
 	if (isfile)
 		MSL_RMC_NEWREQ(pfr, p, csvc, SRMT_UNLINK, rq, mq, mp,
@@ -1355,6 +2332,9 @@ mslfsop_mknod(struct pscfs_req *pfr, pscfs_inum_t pinum,
 	if (!fcmh_isdir(p))
 		PFL_GOTOERR(out, rc = ENOTDIR);
 	rc = fcmh_reserved(p);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	rc = msl_adelete_geterr(p);
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
@@ -1423,6 +2403,12 @@ mslfsop_mknod(struct pscfs_req *pfr, pscfs_inum_t pinum,
 void
 msl_readdir_error(struct fidc_membh *d, struct dircache_page *p, int rc)
 {
+	if (p->dcp_flags & DIRCACHEPGF_PREFETCH) {
+		FCMH_LOCK(d);
+		d->fcmh_flags &= ~FCMH_CLI_PREFETCH;
+		FCMH_ULOCK(d);
+	}
+
 	DIRCACHE_WRLOCK(d);
 	p->dcp_refcnt--;
 	PFLOG_DIRCACHEPG(PLL_DEBUG, p, "error rc=%d", rc);
@@ -1441,15 +2427,34 @@ void
 msl_readdir_finish(struct fidc_membh *d, struct dircache_page *p,
     int eof, int nents, int size, void *base)
 {
-	int i, rc;
+	int i, rc, ra = 0, prefetch;
 	struct srt_readdir_ent *e;
 	struct fidc_membh *f;
 	void *ebase;
 
 	ebase = PSC_AGP(base, size);
+	prefetch = p->dcp_flags & DIRCACHEPGF_PREFETCH;
 
 	dircache_reg_ents(d, p, nents, base, size, eof);
 	DIRCACHE_WAKE(d);
+
+	/*
+	 * Continue a lookup-miss driven prefetch with the next page.
+	 * Pages loaded for an application READDIR do not extend it.
+	 */
+	if (prefetch) {
+		FCMH_LOCK(d);
+		d->fcmh_flags |= FCMH_CLI_PREFETCHED;
+		if (eof || nents == 0)
+			d->fcmh_flags &= ~FCMH_CLI_PREFETCH;
+		else if (d->fcmh_flags & FCMH_CLI_PREFETCH)
+			ra = 1;
+		FCMH_ULOCK(d);
+	}
+	if (ra) {
+		OPSTAT_INCR("dircache-prefetch-page");
+		msl_readdir_prefetch(d, p->dcp_nextoff);
+	}
 	for (i = 0, e = ebase; i < nents; i++, e++) {
 		if (e->sstb.sst_fid == FID_ANY ||
 		    e->sstb.sst_fid == 0) {
@@ -1541,7 +2546,7 @@ msl_readdir_cb(struct pscrpc_request *rq, struct pscrpc_async_args *av)
 
 int
 msl_readdir_issue(struct pscfs_clientctx *pfcc, struct fidc_membh *d,
-    off_t off, size_t size, int wait)
+    off_t off, size_t size, int wait, int prefetch)
 {
 	void *dentbuf = NULL;
 	struct slashrpc_cservice *csvc = NULL;
@@ -1556,6 +2561,13 @@ msl_readdir_issue(struct pscfs_clientctx *pfcc, struct fidc_membh *d,
 	if (p == NULL)
 		return (-ESRCH);
 
+	if (prefetch) {
+		DIRCACHE_WRLOCK(d);
+		p->dcp_flags |= DIRCACHEPGF_PREFETCH;
+		fcmh_2_fci(d)->fcid_prefetch_npages++;
+		DIRCACHE_ULOCK(d);
+	}
+
 	fcmh_op_start_type(d, FCMH_OPCNT_READDIR);
 
 	MSL_RMC_NEWREQ_PFCC(pfcc, d, csvc, SRMT_READDIR, rq, mq, mp,
@@ -1642,6 +2654,9 @@ mslfsop_readdir(struct pscfs_req *pfr, size_t size, off_t off,
 		PFL_GOTOERR(out, rc = ENOTDIR);
 	}
 	rc = fcmh_reserved(d);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	rc = msl_adelete_geterr(d);
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
@@ -1760,7 +2775,7 @@ mslfsop_readdir(struct pscfs_req *pfr, size_t size, off_t off,
 		 * had an error.  Issue a READDIR then wait for a reply.
 		 */
 		hit = 0;
-		rc = msl_readdir_issue(pfcc, d, off, size, 1);
+		rc = msl_readdir_issue(pfcc, d, off, size, 1, 0);
 		if (rc && !slc_rmc_retry(pfr, &rc)) {
 			pscfs_reply_readdir(pfr, NULL, 0, rc);
 			return;
@@ -1778,7 +2793,7 @@ mslfsop_readdir(struct pscfs_req *pfr, size_t size, off_t off,
 		pscfs_reply_readdir(pfr, NULL, 0, rc);
 
 	if (raoff) {
-		msl_readdir_issue(NULL, d, raoff, size, 0);
+		msl_readdir_issue(NULL, d, raoff, size, 0, 0);
 		fcmh_op_done_type(d, FCMH_OPCNT_READAHEAD);
 	}
 }
@@ -2359,6 +3374,9 @@ mslfsop_rename(struct pscfs_req *pfr, pscfs_inum_t opinum,
 		PFL_GOTOERR(out, rc);
 
 	rc = fcmh_reserved(op);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	rc = msl_adelete_geterr(op);
 	if (rc)
 		PFL_GOTOERR(out, rc);
 
@@ -2392,6 +3410,9 @@ mslfsop_rename(struct pscfs_req *pfr, pscfs_inum_t opinum,
 			PFL_GOTOERR(out, rc);
 
 		rc = fcmh_reserved(np);
+		if (rc)
+			PFL_GOTOERR(out, rc);
+		rc = msl_adelete_geterr(np);
 		if (rc)
 			PFL_GOTOERR(out, rc);
 
@@ -2436,6 +3457,11 @@ mslfsop_rename(struct pscfs_req *pfr, pscfs_inum_t opinum,
 			PFL_GOTOERR(out, rc);
 	}
 
+	if (np != op) {
+		msl_acreate_drain(op);
+		msl_adelete_drain(op);
+	}
+
  retry:
 	MSL_RMC_NEWREQ(pfr, np, csvc, SRMT_RENAME, rq, mq, mp, rc);
 	if (rc)
@@ -2625,6 +3651,9 @@ mslfsop_symlink(struct pscfs_req *pfr, const char *buf,
 	rc = fcmh_reserved(p);
 	if (rc)
 		PFL_GOTOERR(out, rc);
+	rc = msl_adelete_geterr(p);
+	if (rc)
+		PFL_GOTOERR(out, rc);
 
  retry:
 	MSL_RMC_NEWREQ(pfr, p, csvc, SRMT_SYMLINK, rq, mq, mp, rc);
@@ -2943,6 +3972,12 @@ mslfsop_setattr(struct pscfs_req *pfr, pscfs_inum_t inum,
 		unset_trunc = 0;
 		rc = 0;
 		break;
+	case -SLERR_INLINE_FULL:
+		/* too large to be held by the MDS; move data to an IOS */
+		rc = msl_inline_promote(pfr, c);
+		if (rc == 0)
+			goto retry;
+		break;
 	}
 
  out:
@@ -2954,6 +3989,9 @@ mslfsop_setattr(struct pscfs_req *pfr, pscfs_inum_t inum,
 		}
 		if (rc && getting_attrs)
 			c->fcmh_flags &= ~FCMH_GETTING_ATTRS;
+		if ((to_set & PSCFS_SETATTRF_DATASIZE) &&
+		    (c->fcmh_flags & FCMH_CLI_INLINE))
+			msl_fcmh_stash_inline(c, NULL, 0);
 		sl_internalize_stat(&c->fcmh_sstb, stb);
 
 		if (flush_mtime || flush_size) {
@@ -3719,6 +4757,9 @@ msl_init(void)
 	sl_freapthr_spawn(MSTHRT_FREAP, "msfreapthr");
 	msattrflushthr_spawn();
 	msreadaheadthr_spawn();
+	msreadhedgethr_spawn();
+	msacreatethr_spawn();
+	msadeletethr_spawn();
 
 	name = getenv("MDS");
 	if (name == NULL)
@@ -49,6 +49,8 @@ struct dircache_page;
 
 /* mount_slash thread types */
 enum {
+	MSTHRT_ACREATE,			/* asynchronous create flusher */
+	MSTHRT_ADELETE,			/* asynchronous unlink/rmdir flusher */
 	MSTHRT_ATTR_FLUSH,		/* attr write data flush thread */
 	MSTHRT_BENCH,			/* I/O benchmarking thread */
 	MSTHRT_BRELEASE,		/* bmap lease releaser */
@@ -65,11 +67,20 @@ enum {
 	MSTHRT_RCI,			/* service RPC reqs for CLI from ION */
 	MSTHRT_RCM,			/* service RPC reqs for CLI from MDS */
 	MSTHRT_READAHEAD,		/* readahead thread */
+	MSTHRT_READHEDGE,		/* hedged read launcher */
 	MSTHRT_OPSTIMER,		/* opstats updater */
 	MSTHRT_USKLNDPL,		/* userland socket lustre net dev poll thr */
 	MSTHRT_WORKER			/* generic worker */
 };
 
+struct msacreate_thread {
+	struct psc_multiwait		 mact_mw;
+};
+
+struct msadelete_thread {
+	struct psc_multiwait		 madt_mw;
+};
+
 struct msattrflush_thread {
 	struct psc_multiwait		 maft_mw;
 };
@@ -92,6 +103,8 @@ struct msfs_thread {
 	struct psc_multiwait		 mft_mw;
 	char				 mft_uprog[256];
 	struct pscfs_req		*mft_pfr;
+	uint32_t			 mft_wroff;	/* bmap range being written */
+	uint32_t			 mft_wrlen;
 };
 
 struct msrci_thread {
@@ -108,6 +121,12 @@ struct msreadahead_thread {
 	struct psc_multiwait		 mrat_mw;
 };
 
+struct msreadhedge_thread {
+	struct psc_multiwait		 mrht_mw;	/* for slc_geticsvc_nb() */
+};
+
+PSCTHR_MKCAST(msacreatethr, msacreate_thread, MSTHRT_ACREATE);
+PSCTHR_MKCAST(msadeletethr, msadelete_thread, MSTHRT_ADELETE);
 PSCTHR_MKCAST(msattrflushthr, msattrflush_thread, MSTHRT_ATTR_FLUSH);
 PSCTHR_MKCAST(msflushthr, msflush_thread, MSTHRT_FLUSH);
 PSCTHR_MKCAST(msbreleasethr, msbrelease_thread, MSTHRT_BRELEASE);
@@ -116,6 +135,7 @@ PSCTHR_MKCAST(msfsthr, msfs_thread, MSTHRT_FS);
 PSCTHR_MKCAST(msrcithr, msrci_thread, MSTHRT_RCI);
 PSCTHR_MKCAST(msrcmthr, msrcm_thread, MSTHRT_RCM);
 PSCTHR_MKCAST(msreadaheadthr, msreadahead_thread, MSTHRT_READAHEAD);
+PSCTHR_MKCAST(msreadhedgethr, msreadhedge_thread, MSTHRT_READHEDGE);
 
 #define NUM_BMAP_FLUSH_THREADS		16
 #define NUM_ATTR_FLUSH_THREADS		4
@@ -124,6 +144,20 @@ PSCTHR_MKCAST(msreadaheadthr, msreadahead_thread, MSTHRT_READAHEAD);
 #define MS_READAHEAD_MAXPGS		64
 #define MS_READAHEAD_PIPESZ		128
 
+/* read latency tracking, see slc_rdlat_sample() */
+#define SLC_RDLAT_NBUCKETS		24		/* log2(usec) histogram buckets */
+#define SLC_RDLAT_MINSAMPLES		32		/* before deadlines are trusted */
+#define SLC_RDLAT_DECAY			4096		/* halve histogram this often */
+
+#define SLC_RDHEDGE_IDLE		1		/* max sec between deadline scans */
+#define SLC_RDHEDGE_MINUSECS		2000		/* never hedge sooner than this */
+
+#define SLC_GETATTR_WINDOW		500		/* usec to gather GETATTRs */
+
+#define SLC_FIDLEASE_NFIDS		256		/* FIDs to lease at a time */
+#define SLC_ACREATE_WINDOW		2000		/* usec to gather async creates */
+#define SLC_ADELETE_WINDOW		2000		/* usec to gather async deletes */
+
 #define MSL_FIDNS_RPATH			".slfidns"
 
 /*
@@ -146,7 +180,6 @@ struct slc_async_req {
 
 struct slc_wkdata_readdir {
 	struct fidc_membh		*d;
-	struct dircache_page		*pg;
 	off_t				 off;
 	size_t				 size;
 };
@@ -233,6 +266,9 @@ struct resprof_cli_info {
 	struct statvfs			 rpci_sfb;
 	struct timespec			 rpci_sfb_time;
 	int				 rpci_flags;
+	uint64_t			 rpci_rdlat;	/* READ RPC latency EWMA (usec) */
+	uint32_t			 rpci_rdlat_n;	/* samples in histogram */
+	uint32_t			 rpci_rdlat_hist[SLC_RDLAT_NBUCKETS];
 };
 
 #define RPCIF_AVOID			(1 << 0)	/* IOS self-advertised degradation */
@@ -267,6 +303,72 @@ struct readaheadrq {
 	int				rarq_npages;
 };
 
+/*
+ * A READ RPC eligible for hedging.  Both the original RPC and the
+ * hedge, if one is launched, sink into private buffers so that whichever
+ * arrives first can fill the cache pages while the loser is discarded.
+ */
+struct msl_readrpc {
+	psc_spinlock_t			 mrr_lock;
+	int				 mrr_flags;
+	int				 mrr_refcnt;
+	int				 mrr_nrpcs;	/* RPCs in flight */
+	int				 mrr_rc;	/* first error seen */
+	struct timespec			 mrr_deadline;	/* when to hedge */
+	struct sl_resource		*mrr_res;	/* target of original RPC */
+	struct bmpc_ioreq		*mrr_biorq;	/* released when settled */
+	struct msl_fsrqinfo		*mrr_fsrqi;	/* for AIO bookkeeping */
+	struct bmap			*mrr_bmap;
+	struct psc_dynarray		*mrr_pages;
+	uint32_t			 mrr_off;
+	uint32_t			 mrr_size;
+	void				*mrr_buf[2];	/* original, hedge */
+	struct psc_listentry		 mrr_lentry;
+};
+
+#define MRRF_SETTLED			(1 << 0)	/* pages have been filled in */
+#define MRRF_HEDGED			(1 << 1)	/* second RPC launched */
+
+/*
+ * A thread waiting on attributes fetched by msl_stat(), possibly on its
+ * behalf as part of a GETATTR_BULK issued by another thread.
+ */
+struct msl_getattr_waiter {
+	struct fidc_membh		*mgw_fcmh;
+	struct srt_stat			 mgw_attr;
+	uint32_t			 mgw_xattrsize;
+	int				 mgw_rc;
+	int				 mgw_flags;
+};
+
+#define MGWF_DONE			(1 << 0)	/* result is filled in */
+#define MGWF_RETRY			(1 << 1)	/* bulk failed; use GETATTR */
+
+/*
+ * A create that has been replied to locally using a leased FID and
+ * awaits submission to the MDS in a CREATE_BULK.
+ */
+struct msl_acreate {
+	struct fidc_membh		*mac_pfcmh;	/* parent directory */
+	struct fidc_membh		*mac_fcmh;	/* new file */
+	uint64_t			 mac_seq;	/* position in queue */
+	struct srt_create_ent		 mac_ent;
+	struct psc_listentry		 mac_lentry;
+};
+
+/*
+ * An unlink or rmdir that has been replied to locally and awaits
+ * submission to the MDS in an UNLINK_BULK.  Failures are remembered in
+ * the parent directory and returned by the next operation on it.
+ */
+struct msl_adelete {
+	struct fidc_membh		*mad_pfcmh;	/* parent directory */
+	slfid_t				 mad_cfid;	/* child, if known */
+	uint64_t			 mad_seq;	/* position in queue */
+	struct srt_unlink_ent		 mad_ent;
+	struct psc_listentry		 mad_lentry;
+};
+
 struct uid_mapping {
 	/* these are 64-bit as limitation of hash API */
 	uint64_t			um_key;
@@ -288,7 +390,9 @@ struct gid_mapping {
 #define msl_biorq_release(r)		_msl_biorq_release(PFL_CALLERINFOSS(SLSS_FCMH), (r))
 
 int	 msl_bmap_to_csvc(struct bmap *, int, struct slashrpc_cservice **);
+int	 msl_bmap_to_csvc_striped(struct bmap *, uint32_t, struct slashrpc_cservice **);
 void	 msl_bmap_reap_init(struct bmap *, const struct srt_bmapdesc *);
+void	 msl_bmap_stash_lease(struct fidc_membh *, sl_bmapno_t, const struct srt_bmapdesc *, const uint8_t *);
 void	 msl_bmpces_fail(struct bmpc_ioreq *, int);
 void	_msl_biorq_release(const struct pfl_callerinfo *, struct bmpc_ioreq *);
 
@@ -296,10 +400,18 @@ void	 mfh_decref(struct msl_fhent *);
 void	 mfh_incref(struct msl_fhent *);
 
 ssize_t	 msl_io(struct pscfs_req *, struct msl_fhent *, char *, size_t, off_t, enum rw);
+int	 msl_inline_io(struct pscfs_req *, struct msl_fhent *, char *, size_t, off_t, enum rw);
+int	 msl_inline_promote(struct pscfs_req *, struct fidc_membh *);
+void	 msl_acreate_drain(struct fidc_membh *);
+void	 msl_adelete_drain(struct fidc_membh *);
+int	 msl_readdir_issue(struct pscfs_clientctx *, struct fidc_membh *, off_t, size_t, int, int);
+void	 msl_readdir_prefetch(struct fidc_membh *, off_t);
 int	 msl_stat(struct fidc_membh *, void *);
+int	 msl_striped_read(struct fidc_membh *);
 
 int	 msl_read_cleanup(struct pscrpc_request *, int, struct pscrpc_async_args *);
 int	 msl_dio_cleanup(struct pscrpc_request *, int, struct pscrpc_async_args *);
+int	 msl_readrpc_aio_cleanup(struct pscrpc_request *, int, struct pscrpc_async_args *);
 
 ssize_t	 slc_getxattr(const struct pscfs_clientctx *,
 	    const struct pscfs_creds *, const char *, void *, size_t,
@@ -309,15 +421,19 @@ size_t	 msl_pages_copyout(struct bmpc_ioreq *, struct msl_fsrqinfo *);
 int	 msl_fd_should_retry(struct msl_fhent *, struct pscfs_req *, int);
 
 void	 msl_update_iocounters(struct pfl_iostats_grad *, enum rw, int);
+void	 slc_rdlat_sample(struct sl_resource *, uint64_t);
 
 int	 msl_try_get_replica_res(struct bmap *, int, int,
 	    struct slashrpc_cservice **);
 struct msl_fhent *
 	 msl_fhent_new(struct pscfs_req *, struct fidc_membh *);
 
+void	 msacreatethr_spawn(void);
+void	 msadeletethr_spawn(void);
 void	 msbmapthr_spawn(void);
 void	 msctlthr_spawn(void);
 void	 msreadaheadthr_spawn(void);
+void	 msreadhedgethr_spawn(void);
 
 void	 slc_getuprog(pid_t, char *, size_t);
 void	 slc_setprefios(sl_ios_id_t);
@@ -366,19 +482,30 @@ extern struct pfl_opstat	*slc_rdcache_iostats;
 extern struct pfl_iostats_grad	 slc_iosyscall_iostats[];
 extern struct pfl_iostats_grad	 slc_iorpc_iostats[];
 
+extern struct psc_listcache	 msl_acreateq;
+extern struct psc_listcache	 msl_adeleteq;
 extern struct psc_listcache	 slc_attrtimeoutq;
 extern struct psc_listcache	 slc_bmapflushq;
 extern struct psc_listcache	 slc_bmaptimeoutq;
 extern struct psc_listcache	 msl_readaheadq;
+extern struct psc_listcache	 msl_readrpcs;
 
 extern struct psc_poolmgr	*slc_async_req_pool;
 extern struct psc_poolmgr	*slc_biorq_pool;
 extern struct psc_poolmgr	*slc_mfh_pool;
 
+extern psc_atomic32_t		 slc_async_create;
+extern psc_atomic32_t		 slc_async_delete;
+extern psc_atomic32_t		 slc_compound;
 extern psc_atomic32_t		 slc_direct_io;
 extern psc_atomic32_t		 slc_max_nretries;
+extern psc_atomic32_t		 slc_getattr_window;
 extern psc_atomic32_t		 slc_max_readahead;
+extern psc_atomic32_t		 slc_negcache_timeo;
 extern psc_atomic32_t		 slc_readahead_pipesz;
+extern psc_atomic32_t		 slc_read_hedge;
+extern psc_atomic32_t		 slc_striped_read;
+extern psc_atomic32_t		 slc_write_range;
 
 extern int			 bmap_max_cache;
 
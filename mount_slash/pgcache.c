@@ -329,7 +329,9 @@ bmpc_biorq_new(struct msl_fsrqinfo *q, struct bmap *b, char *buf,
 	r->biorq_fsrqi = q;
 	r->biorq_last_sliod = IOS_ID_ANY;
 
-	if (b->bcm_flags & BMAPF_DIO) {
+	if ((b->bcm_flags & BMAPF_DIO) ||
+	    ((flags & BIORQ_READ) && !(flags & BIORQ_READAHEAD) &&
+	     !msl_bmap_wrrange_covers(b, off, len))) {
 		r->biorq_flags |= BIORQ_DIO;
 		if (flags & BIORQ_READ) {
 			r->biorq_flags |= BIORQ_FREEBUF;
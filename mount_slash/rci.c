@@ -170,6 +170,20 @@ slc_rci_handle_io(struct pscrpc_request *rq)
 
 		PSCFREE(iovs);
 
+	} else if (car->car_cbf == msl_readrpc_aio_cleanup) {
+		struct msl_readrpc *g;
+		struct iovec iov;
+
+		OPSTAT_INCR("read-cb-hedge");
+
+		/* hedgeable READs sink into a private buffer */
+		g = car->car_argv.pointer_arg[MSL_CBARG_READRPC];
+		iov.iov_base = car->car_argv.pointer_arg[MSL_CBARG_BUF];
+		iov.iov_len = g->mrr_size;
+		if (!mq->rc)
+			mq->rc = slrpc_bulkserver(rq, BULK_GET_SINK,
+			    SRCI_BULK_PORTAL, &iov, 1);
+
 	} else if (car->car_cbf == msl_dio_cleanup) {
 
 		r = car->car_argv.pointer_arg[MSL_CBARG_BIORQ];
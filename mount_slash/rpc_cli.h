@@ -37,11 +37,16 @@ struct slrpc_cservice;
 /* async RPC pointers */
 #define MSL_CBARG_BMPCE			0
 #define MSL_CBARG_CSVC			1
+#define MSL_CBARG_READRPC		2
 #define MSL_CBARG_BIORQ			3
 #define MSL_CBARG_BIORQS		4
 #define MSL_CBARG_BMPC			5
 #define MSL_CBARG_BMAP			6
 #define MSL_CBARG_RESM			7
+#define MSL_CBARG_BUF			8
+
+/* async RPC scalars */
+#define MSL_CBARG_ISSUED		0		/* usec timestamp of launch */
 
 enum {
 	MSL_BMLGET_CBARG_BMAP,
@@ -70,12 +75,20 @@ enum {
 
 /*
  * Initialize a new RPC request for a pscfs clientctx.
- * Most arguments here are macro-value-result.
+ * Most arguments here are macro-value-result.  Any asynchronous
+ * creates and deletes still queued that involve @f are pushed to the
+ * MDS first so the request cannot overtake them.
  */
 #define MSL_RMC_NEWREQ_PFCC(pfcc, f, csvc, op, rq, mq, mp, rc)		\
 	do {								\
 		struct sl_resm *_resm;					\
 									\
+		if ((op) != SRMT_CREATE_BULK &&				\
+		    (op) != SRMT_FIDLEASE &&				\
+		    (op) != SRMT_UNLINK_BULK) {				\
+			msl_acreate_drain(f);				\
+			msl_adelete_drain(f);				\
+		}							\
 		_resm = (f) ? fcmh_2_fci(f)->fci_resm : slc_rmc_resm;	\
 		if (rq) {						\
 			pscrpc_req_finished(rq);			\
@@ -145,6 +158,10 @@ msl_getmw(void)
 
 	thr = pscthr_get();
 	switch (thr->pscthr_type) {
+	case MSTHRT_ACREATE:
+		return (&msacreatethr(thr)->mact_mw);
+	case MSTHRT_ADELETE:
+		return (&msadeletethr(thr)->madt_mw);
 	case MSTHRT_ATTR_FLUSH:
 		return (&msattrflushthr(thr)->maft_mw);
 	case MSTHRT_BRELEASE:
@@ -161,6 +178,8 @@ msl_getmw(void)
 		return (&msrcmthr(thr)->mrcm_mw);
 	case MSTHRT_READAHEAD:
 		return (&msreadaheadthr(thr)->mrat_mw);
+	case MSTHRT_READHEDGE:
+		return (&msreadhedgethr(thr)->mrht_mw);
 	case MSTHRT_CTL:
 	case MSTHRT_WORKER:
 		return (NULL);
@@ -121,7 +121,8 @@ const char *replpol_tab[] = {
 
 const char *fattr_tab[] = {
 	"ios-aff",
-	"repl-pol"
+	"repl-pol",
+	"striped-read"
 };
 
 const char *bool_tab[] = {
@@ -421,6 +422,7 @@ cmd_fattr(int ac, char **av)
 		arg.opcode = MSCMT_SET_FATTR;
 		switch (arg.attrid) {
 		case SL_FATTR_IOS_AFFINITY:
+		case SL_FATTR_STRIPED_READ:
 			arg.val = lookup(bool_tab, nitems(bool_tab),
 			    val);
 			if (arg.val == -1)
@@ -653,6 +655,7 @@ fattr_prdat(__unusedx const struct psc_ctlmsghdr *mh,
 		attrname = fattr_tab[mfa->mfa_attrid];
 	switch (mfa->mfa_attrid) {
 	case SL_FATTR_IOS_AFFINITY:
+	case SL_FATTR_STRIPED_READ:
 		val = mfa->mfa_val ? "on" : "off";
 		break;
 	case SL_FATTR_REPLPOL:
@@ -69,6 +69,33 @@ slrpc_newgenreq(struct slashrpc_cservice *csvc, int op,
 	    *(void **)mqp));
 }
 
+/*
+ * Create a request with a second buffer for a small payload: @qdlen
+ * bytes in the request, returned in @datap, and/or @pdlen bytes in the
+ * reply.
+ */
+int
+slrpc_newdatareq(struct slashrpc_cservice *csvc, int op,
+    struct pscrpc_request **rqp, int qlen, int plen, void *mqp,
+    int qdlen, int pdlen, void *datap)
+{
+	int rc, nq = 1, np = 1, qlens[3] = { qlen }, plens[3] = { plen };
+
+	if (qdlen)
+		qlens[nq++] = qdlen;
+	qlens[nq++] = sizeof(struct srt_authbuf_footer);
+	if (pdlen)
+		plens[np++] = pdlen;
+	plens[np++] = sizeof(struct srt_authbuf_footer);
+
+	rc = RSX_NEWREQN(csvc->csvc_import, csvc->csvc_version, op,
+	    *rqp, nq, qlens, np, plens, *(void **)mqp);
+	if (rc == 0 && qdlen)
+		*(void **)datap = pscrpc_msg_buf((*rqp)->rq_reqmsg, 1,
+		    qdlen);
+	return (rc);
+}
+
 int
 slrpc_waitrep(__unusedx struct slashrpc_cservice *csvc,
     struct pscrpc_request *rq, int plen, void *mpp, int flags)
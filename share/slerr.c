@@ -83,9 +83,9 @@ char *slash_errstrs[] = {
 /* 28 */ "unknown code 28",
 /* 29 */ "unknown code 29",
 /* 30 */ "Peer resource is of wrong type",
-/* 31 */ "unknown code 31",
-/* 32 */ "unknown code 32",
-/* 33 */ "unknown code 33",
+/* 31 */ "File data is held inline by the MDS",
+/* 32 */ "File data is not held inline by the MDS",
+/* 33 */ "File has outgrown inline data",
 /* 34 */ "CRC absent",
 	 NULL
 };
@@ -164,6 +164,119 @@ slm_bmap_resetnonce(struct bmap *b)
 	}
 }
 
+/*
+ * Read a run of consecutive on-disk bmap records of a file with one
+ * I/O and verify their CRCs, leaving them on the fcmh for subsequent
+ * faults of these bmaps.
+ * @f: file.
+ * @bno: first bmap of the run.
+ * @n: number of bmaps.
+ */
+void
+mds_bmap_prefetch(struct fidc_membh *f, sl_bmapno_t bno, int n)
+{
+	struct fcmh_mds_info *fmi = fcmh_2_fmi(f);
+	struct slm_bmap_ra *ra, *old = NULL;
+	uint64_t crc, od_crc;
+	uint32_t gen;
+	int i, rc, vfsid;
+	size_t nb;
+	char *p;
+
+	if (n > SLM_BMAP_RA_MAX)
+		n = SLM_BMAP_RA_MAX;
+	if (n < 2 || !fcmh_isreg(f))
+		return;
+
+	FCMH_LOCK(f);
+	gen = fmi->fmi_bmapra_gen;
+	FCMH_ULOCK(f);
+
+	ra = PSCALLOC(sizeof(*ra) + n * BMAP_OD_SZ);
+	slfid_to_vfsid(fcmh_2_fid(f), &vfsid);
+	rc = mdsio_read(vfsid, &rootcreds, ra->sbra_buf, n * BMAP_OD_SZ,
+	    &nb, (off_t)BMAP_OD_SZ * bno + SL_BMAP_START_OFF,
+	    fcmh_2_mfh(f));
+	if (rc) {
+		DEBUG_FCMH(PLL_WARN, f, "bmap prefetch bno=%u n=%d "
+		    "rc=%d", bno, n, rc);
+		PSCFREE(ra);
+		return;
+	}
+
+	/*
+	 * Records failing verification are left out; a fault on one
+	 * of them reads it on its own and reports the error.
+	 */
+	ra->sbra_start = bno;
+	for (i = 0; i < n && (size_t)(i + 1) * BMAP_OD_SZ <= nb; i++) {
+		p = ra->sbra_buf + i * BMAP_OD_SZ;
+		memcpy(&od_crc, p + BMAP_OD_CRCSZ, sizeof(od_crc));
+		psc_crc64_calc(&crc, p, BMAP_OD_CRCSZ);
+		if (od_crc == crc || (od_crc == 0 &&
+		    pfl_memchk(p, 0, BMAP_OD_CRCSZ)))
+			ra->sbra_valid |= 1 << i;
+	}
+	ra->sbra_n = i;
+
+	OPSTAT_INCR("bmap-prefetch-io");
+	OPSTAT_ADD("bmap-prefetch-load", i);
+
+	FCMH_LOCK(f);
+	/* a bmap written meanwhile may not be in what we just read */
+	if (ra->sbra_valid && gen == fmi->fmi_bmapra_gen) {
+		old = fmi->fmi_bmapra;
+		fmi->fmi_bmapra = ra;
+		ra = NULL;
+	}
+	FCMH_ULOCK(f);
+
+	PSCFREE(ra);
+	PSCFREE(old);
+}
+
+/*
+ * Take a bmap's on-disk record from the records read ahead on its
+ * fcmh, if present.  Returns nonzero if the record was found.
+ */
+int
+mds_bmap_ra_consume(struct bmap *b, uint64_t *od_crc)
+{
+	struct bmap_mds_info *bmi = bmap_2_bmi(b);
+	struct fidc_membh *f = b->bcm_fcmh;
+	struct fcmh_mds_info *fmi;
+	struct slm_bmap_ra *ra;
+	uint32_t i;
+	char *p;
+
+	fmi = fcmh_2_fmi(f);
+	FCMH_LOCK(f);
+	ra = fmi->fmi_bmapra;
+	if (ra == NULL || b->bcm_bmapno < ra->sbra_start ||
+	    b->bcm_bmapno >= ra->sbra_start + ra->sbra_n) {
+		FCMH_ULOCK(f);
+		return (0);
+	}
+	i = b->bcm_bmapno - ra->sbra_start;
+	if ((ra->sbra_valid & (1 << i)) == 0) {
+		FCMH_ULOCK(f);
+		return (0);
+	}
+	p = ra->sbra_buf + i * BMAP_OD_SZ;
+	memcpy(bmi_2_ondisk(bmi), p, BMAP_OD_CRCSZ);
+	memcpy(od_crc, p + BMAP_OD_CRCSZ, sizeof(*od_crc));
+	ra->sbra_valid &= ~(1 << i);
+	if (ra->sbra_valid == 0)
+		fmi->fmi_bmapra = NULL;
+	else
+		ra = NULL;
+	FCMH_ULOCK(f);
+
+	PSCFREE(ra);
+	OPSTAT_INCR("bmap-prefetch-hit");
+	return (1);
+}
+
 /*
  * Retrieve a bmap from the on-disk inode file.
  * @b: bmap.
@@ -172,9 +285,10 @@ slm_bmap_resetnonce(struct bmap *b)
 int
 mds_bmap_read(struct bmap *b, __unusedx enum rw rw, int flags)
 {
-	int rc, vfsid, retifset[NBREPLST];
+	int rc = 0, vfsid, verified = 0, retifset[NBREPLST];
 	struct bmap_mds_info *bmi = bmap_2_bmi(b);
 	struct slm_update_data *upd;
+	struct fcmh_mds_info *fmi;
 	struct fidc_membh *f;
 	struct iovec iovs[2];
 	uint64_t crc, od_crc = 0;
@@ -191,6 +305,15 @@ mds_bmap_read(struct bmap *b, __unusedx enum rw rw, int flags)
 
 	f = b->bcm_fcmh;
 
+	/*
+	 * Inline file data occupies the space of the bmap records past
+	 * bmap 0.  While a client moves the data to an IOS, bmap 0 may
+	 * be used; its record was cleared when the move started.
+	 */
+	if ((fcmh_2_ino(f)->ino_flags & INOF_INLINE) &&
+	    (b->bcm_bmapno || (f->fcmh_flags & FCMH_MDS_INLPROMOTE) == 0))
+		return (-SLERR_INLINE);
+
 	iovs[0].iov_base = bmi_2_ondisk(bmi);
 	iovs[0].iov_len = BMAP_OD_CRCSZ;
 	iovs[1].iov_base = &od_crc;
@@ -201,9 +324,28 @@ mds_bmap_read(struct bmap *b, __unusedx enum rw rw, int flags)
 	psclog_diag("read bmap: handle=%p fid="SLPRI_FID" bmapno=%d",
 	    bmap_2_mfh(b), f->fcmh_sstb.sst_fg.fg_fid, b->bcm_bmapno);
 
-	rc = mdsio_preadv(vfsid, &rootcreds, iovs, nitems(iovs), &nb,
-	    (off_t)BMAP_OD_SZ * b->bcm_bmapno + SL_BMAP_START_OFF,
-	    bmap_2_mfh(b));
+	/*
+	 * Records in the read ahead run were verified when it was
+	 * loaded.  Faulting bmaps of a file in order starts a new run.
+	 */
+	if (slm_opstate == SLM_OPSTATE_NORMAL) {
+		fmi = fcmh_2_fmi(f);
+		verified = mds_bmap_ra_consume(b, &od_crc);
+		if (!verified && fmi->fmi_bmap_lastno != BMAPNO_ANY &&
+		    b->bcm_bmapno == fmi->fmi_bmap_lastno + 1) {
+			mds_bmap_prefetch(f, b->bcm_bmapno,
+			    fcmh_nallbmaps(f) - b->bcm_bmapno);
+			verified = mds_bmap_ra_consume(b, &od_crc);
+		}
+		fmi->fmi_bmap_lastno = b->bcm_bmapno;
+	}
+
+	if (verified)
+		nb = BMAP_OD_SZ;
+	else
+		rc = mdsio_preadv(vfsid, &rootcreds, iovs,
+		    nitems(iovs), &nb, (off_t)BMAP_OD_SZ *
+		    b->bcm_bmapno + SL_BMAP_START_OFF, bmap_2_mfh(b));
 
 	if (rc)
 		goto out1;
@@ -225,7 +367,7 @@ mds_bmap_read(struct bmap *b, __unusedx enum rw rw, int flags)
 		return (0);
 	}
 
-	if (nb == BMAP_OD_SZ) {
+	if (nb == BMAP_OD_SZ && !verified) {
 		psc_crc64_calc(&crc, bmi_2_ondisk(bmi), BMAP_OD_CRCSZ);
 		if (od_crc != crc)
 			rc = PFLERR_BADCRC;
@@ -259,6 +401,32 @@ mds_bmap_read(struct bmap *b, __unusedx enum rw rw, int flags)
 	return (0);
 }
 
+/*
+ * Drop a bmap's record from any read ahead run on its fcmh after the
+ * bmap has been written, and keep runs being loaded from being kept.
+ */
+void
+mds_bmap_ra_invalidate(struct bmap *b)
+{
+	struct fidc_membh *f = b->bcm_fcmh;
+	struct fcmh_mds_info *fmi;
+	struct slm_bmap_ra *ra;
+	int lk;
+
+	if (!fcmh_isreg(f))
+		return;
+
+	fmi = fcmh_2_fmi(f);
+	lk = FCMH_RLOCK(f);
+	fmi->fmi_bmapra_gen++;
+	ra = fmi->fmi_bmapra;
+	if (ra && b->bcm_bmapno >= ra->sbra_start &&
+	    b->bcm_bmapno < ra->sbra_start + ra->sbra_n)
+		ra->sbra_valid &= ~(1 << (b->bcm_bmapno -
+		    ra->sbra_start));
+	FCMH_URLOCK(f, lk);
+}
+
 /*
  * Update the on-disk data of bmap.  Note we must reserve journal log
  * space if @logf is given.
@@ -297,6 +465,8 @@ mds_bmap_write(struct bmap *b, void *logf, void *logarg)
 	if (logf)
 		mds_unreserve_slot(1);
 
+	mds_bmap_ra_invalidate(b);
+
 	if (rc == 0 && nb != BMAP_OD_SZ)
 		rc = SLERR_SHORTIO;
 	if (rc)
@@ -27,6 +27,7 @@
 
 #include <sys/time.h>
 
+#include "pfl/hashtbl.h"
 #include "pfl/lockedlist.h"
 #include "pfl/odtable.h"
 #include "pfl/pthrutil.h"
@@ -191,6 +192,8 @@ struct bmap_mds_lease {
 	sl_ios_id_t		  bml_ios;
 	lnet_process_id_t	  bml_cli_nidpid;
 	uint32_t		  bml_flags;
+	uint32_t		  bml_off;		/* write range in bmap */
+	uint32_t		  bml_len;		/* zero for entire bmap */
 	time_t			  bml_start;
 	time_t			  bml_expire;
 	psc_spinlock_t		  bml_lock;
@@ -243,6 +246,37 @@ struct bmap_ios_assign {
 /* bia_flags */
 #define BIAF_DIO		(1 << 0)
 
+/*
+ * A run of consecutive on-disk bmap records of a file read with one
+ * I/O, kept on the fcmh until the bmaps are faulted in.
+ */
+struct slm_bmap_ra {
+	sl_bmapno_t		sbra_start;
+	int			sbra_n;
+	uint32_t		sbra_valid;	/* records verified and unconsumed */
+	char			sbra_buf[0];	/* sbra_n * BMAP_OD_SZ */
+};
+
+#define SLM_BMAP_RA_MAX		16		/* max records per read ahead */
+
+/*
+ * A write lease found in the bmap assignment odtable at startup which
+ * has not yet been recovered, hashed by FID.
+ */
+struct slm_bia_recover {
+	slfid_t			sbr_fid;
+	int			sbr_flags;
+	struct pfl_hashentry	sbr_hentry;
+	struct pfl_odt_receipt	sbr_odtr;
+	struct bmap_ios_assign	sbr_bia;
+};
+
+/* sbr_flags */
+#define SBRF_BUSY		(1 << 0)	/* being recovered */
+
+void	 mds_bmap_prefetch(struct fidc_membh *, sl_bmapno_t, int);
+int	 mds_bmap_ra_consume(struct bmap *, uint64_t *);
+void	 mds_bmap_ra_invalidate(struct bmap *);
 int	 mds_bmap_read(struct bmap *, enum rw, int);
 int	 mds_bmap_write(struct bmap *, void *, void *);
 int	_mds_bmap_write_rel(const struct pfl_callerinfo *, struct bmap *, void *);
@@ -257,13 +291,14 @@ int	 mds_bmap_crc_write(struct srm_bmap_crcup *, sl_ios_id_t,
 	    const struct srm_bmap_crcwrt_req *);
 int	 mds_bmap_exists(struct fidc_membh *, sl_bmapno_t);
 int	 mds_bmap_load_cli(struct fidc_membh *, sl_bmapno_t, int, enum rw,
-	    sl_ios_id_t, struct srt_bmapdesc *, struct pscrpc_export *,
-	    uint8_t *, int);
+	    uint32_t, uint32_t, sl_ios_id_t, struct srt_bmapdesc *,
+	    struct pscrpc_export *, uint8_t *, int);
 int	 mds_bmap_load_fg(const struct sl_fidgen *, sl_bmapno_t,
 	    struct bmap **);
 int	 mds_bmap_loadvalid(struct fidc_membh *, sl_bmapno_t,
 	    struct bmap **);
-int	 mds_bmap_bml_chwrmode(struct bmap_mds_lease *, sl_ios_id_t);
+int	 mds_bmap_bml_chwrmode(struct bmap_mds_lease *, sl_ios_id_t,
+	    uint32_t, uint32_t);
 int	 mds_bmap_bml_release(struct bmap_mds_lease *);
 void	 mds_bmap_ensure_valid(struct bmap *);
 
@@ -279,10 +314,15 @@ uint64_t mds_bmap_timeotbl_mdsi(struct bmap_mds_lease *, int);
 int64_t	 slm_bmap_calc_repltraffic(struct bmap *);
 
 void	 mds_bia_odtable_startup_cb(void *, struct pfl_odt_receipt *, void *);
+void	 mds_bia_recover_fid(slfid_t);
+int	 mds_bia_recover_npending(void);
+void	 mds_bia_recover_start(void);
+void	 mds_bia_recover_wait(void);
 
 extern struct psc_poolmaster	 slm_bml_poolmaster;
 extern struct psc_poolmgr	*slm_bml_pool;
 extern struct bmap_timeo_table	 mdsBmapTimeoTbl;
+extern struct psc_hashtbl	 slm_bia_recover_hashtbl;
 
 static __inline struct bmap *
 bmi_2_bmap(struct bmap_mds_info *bmi)
@@ -47,6 +47,8 @@ slcfg_init_res(struct sl_resource *r)
 	if (r->res_type == SLREST_MDS) {
 		rpmi->rpmi_info = sp = PSCALLOC(sizeof(*sp));
 		sp->sp_flags = SPF_NEED_JRNL_INIT;
+		INIT_SPINLOCK(&sp->sp_recv_lock);
+		psc_dynarray_init(&sp->sp_recv_pending);
 		psc_meter_init(&sp->sp_batchmeter, 0, "nsupd-%s",
 		    r->res_name);
 	} else {
@@ -73,8 +75,13 @@ slcfg_init_resm(struct sl_resm *m)
 }
 
 void
-slcfg_init_site(__unusedx struct sl_site *site)
+slcfg_init_site(struct sl_site *site)
 {
+	struct site_mds_info *smi;
+
+	smi = site2smi(site);
+	INIT_SPINLOCK(&smi->smi_lock);
+	psc_dynarray_init(&smi->smi_links);
 }
 
 int	 cfg_site_pri_sz = sizeof(struct site_mds_info);
@@ -26,6 +26,8 @@
  * Interface for controlling live operation of slashd.
  */
 
+#include <time.h>
+
 #include "pfl/cdefs.h"
 #include "pfl/ctl.h"
 #include "pfl/ctlsvr.h"
@@ -35,6 +37,7 @@
 #include "ctl.h"
 #include "ctl_mds.h"
 #include "ctlsvr.h"
+#include "journal_mds.h"
 #include "mdsio.h"
 #include "mdslog.h"
 #include "repl_mds.h"
@@ -214,6 +217,46 @@ slmctl_resfieldm_xid(int fd, struct psc_ctlmsghdr *mh,
 	    levels, nlevels, nbuf));
 }
 
+int
+slmctl_resfieldm_lag_xid(int fd, struct psc_ctlmsghdr *mh,
+    struct psc_ctlmsg_param *pcp, char **levels, int nlevels, int set,
+    struct sl_resource *r)
+{
+	struct sl_mds_peerinfo *sp;
+	uint64_t lag = 0;
+	char nbuf[24];
+
+	sp = res2mdsinfo(r);
+	if (set)
+		return (psc_ctlsenderr(fd, mh,
+		    "lag_xid: field is read-only"));
+	if (nsupd_prg.cur_xid >= sp->sp_xid)
+		lag = nsupd_prg.cur_xid - sp->sp_xid + 1;
+	snprintf(nbuf, sizeof(nbuf), "%"PRIu64, lag);
+	return (psc_ctlmsg_param_send(fd, mh, pcp, PCTHRNAME_EVERYONE,
+	    levels, nlevels, nbuf));
+}
+
+int
+slmctl_resfieldm_lag_secs(int fd, struct psc_ctlmsghdr *mh,
+    struct psc_ctlmsg_param *pcp, char **levels, int nlevels, int set,
+    struct sl_resource *r)
+{
+	struct sl_mds_peerinfo *sp;
+	time_t lag = 0;
+	char nbuf[24];
+
+	sp = res2mdsinfo(r);
+	if (set)
+		return (psc_ctlsenderr(fd, mh,
+		    "lag_secs: field is read-only"));
+	if (nsupd_prg.cur_xid >= sp->sp_xid && sp->sp_synced)
+		lag = time(NULL) - sp->sp_synced;
+	snprintf(nbuf, sizeof(nbuf), "%"PSCPRI_TIMET, lag);
+	return (psc_ctlmsg_param_send(fd, mh, pcp, PCTHRNAME_EVERYONE,
+	    levels, nlevels, nbuf));
+}
+
 int
 slmctl_resfieldi_xid(int fd, struct psc_ctlmsghdr *mh,
     struct psc_ctlmsg_param *pcp, char **levels, int nlevels, int set,
@@ -344,6 +387,8 @@ slmctl_resfieldi_upschq(int fd, struct psc_ctlmsghdr *mh,
 }
 
 const struct slctl_res_field slctl_resmds_fields[] = {
+	{ "lag_secs",		slmctl_resfieldm_lag_secs },
+	{ "lag_xid",		slmctl_resfieldm_lag_xid },
 	{ "xid",		slmctl_resfieldm_xid },
 	{ NULL, NULL },
 };
@@ -442,6 +487,144 @@ slmctlrep_getreplqueued(int fd, struct psc_ctlmsghdr *mh, void *mb)
 	return (rc);
 }
 
+__static int
+slmctl_sendreplrate(int fd, struct psc_ctlmsghdr *mh,
+    struct slmctlmsg_replrate *scrr, const char *src, const char *dst,
+    int64_t rate, int64_t limit, int64_t tokens)
+{
+	memset(scrr, 0, sizeof(*scrr));
+	strlcpy(scrr->scrr_src, src, sizeof(scrr->scrr_src));
+	strlcpy(scrr->scrr_dst, dst, sizeof(scrr->scrr_dst));
+	scrr->scrr_rate = rate;
+	scrr->scrr_limit = limit;
+	scrr->scrr_tokens = tokens;
+	return (psc_ctlmsg_sendv(fd, mh, scrr));
+}
+
+/*
+ * Send a response to a "GETREPLRATE" inquiry: the measured replication
+ * rate against the configured limit of every IOS and site link.
+ * @fd: client socket descriptor.
+ * @mh: already filled-in control message header.
+ * @m: control message to examine and reuse.
+ */
+int
+slmctlrep_getreplrate(int fd, struct psc_ctlmsghdr *mh, void *m)
+{
+	struct slmctlmsg_replrate *scrr = m;
+	struct resprof_mds_info *rpmi;
+	int64_t rate[2], limit[2], tokens[2];
+	struct site_mds_info *smi;
+	struct slm_replink *rl;
+	struct sl_resource *r;
+	struct sl_site *s, *d;
+	int i, rc = 1;
+
+	CONF_LOCK();
+	CONF_FOREACH_RES(s, r, i) {
+		if (!RES_ISFS(r))
+			continue;
+
+		rpmi = res2rpmi(r);
+		RPMI_LOCK(rpmi);
+		slm_tokbkt_report(&res2rpmi_ios(r)->si_tb_egress,
+		    &rate[0], &limit[0], &tokens[0]);
+		slm_tokbkt_report(&res2rpmi_ios(r)->si_tb_ingress,
+		    &rate[1], &limit[1], &tokens[1]);
+		RPMI_ULOCK(rpmi);
+
+		rc = slmctl_sendreplrate(fd, mh, scrr, r->res_name,
+		    SLMC_REPLRATE_ANY, rate[0], limit[0], tokens[0]);
+		if (!rc)
+			goto done;
+		rc = slmctl_sendreplrate(fd, mh, scrr, SLMC_REPLRATE_ANY,
+		    r->res_name, rate[1], limit[1], tokens[1]);
+		if (!rc)
+			goto done;
+	}
+	CONF_FOREACH_SITE(s) {
+		smi = site2smi(s);
+		for (i = 0; ; i++) {
+			spinlock(&smi->smi_lock);
+			if (i >= psc_dynarray_len(&smi->smi_links)) {
+				freelock(&smi->smi_lock);
+				break;
+			}
+			rl = psc_dynarray_getpos(&smi->smi_links, i);
+			d = rl->srl_dst;
+			slm_tokbkt_report(&rl->srl_tb, &rate[0],
+			    &limit[0], &tokens[0]);
+			freelock(&smi->smi_lock);
+
+			rc = slmctl_sendreplrate(fd, mh, scrr,
+			    s->site_name, d->site_name, rate[0],
+			    limit[0], tokens[0]);
+			if (!rc)
+				goto done;
+		}
+	}
+ done:
+	CONF_ULOCK();
+	return (rc);
+}
+
+/*
+ * Send a response to a "GETPLACE" inquiry: the inputs and outcome of
+ * write lease placement for each IOS.
+ * @fd: client socket descriptor.
+ * @mh: already filled-in control message header.
+ * @m: control message to examine and reuse.
+ */
+int
+slmctlrep_getplace(int fd, struct psc_ctlmsghdr *mh, void *m)
+{
+	struct slmctlmsg_place *scp = m;
+	struct resprof_mds_info *rpmi;
+	struct sl_resource *r;
+	struct rpmi_ios *si;
+	struct sl_resm *rm;
+	struct sl_site *s;
+	int64_t score;
+	int i, j, rc = 1;
+
+	CONF_LOCK();
+	CONF_FOREACH_RES(s, r, i) {
+		if (!RES_ISFS(r))
+			continue;
+
+		memset(scp, 0, sizeof(*scp));
+		strlcpy(scp->scp_resname, r->res_name,
+		    sizeof(scp->scp_resname));
+
+		scp->scp_score = INT64_MAX;
+		DYNARRAY_FOREACH(rm, j, &r->res_members) {
+			scp->scp_nwrleases += psc_atomic32_read(
+			    &resm2rmmi(rm)->rmmi_refcnt);
+			score = slm_resm_score(rm);
+			if (score < scp->scp_score)
+				scp->scp_score = score;
+		}
+
+		rpmi = res2rpmi(r);
+		si = res2iosinfo(r);
+		RPMI_LOCK(rpmi);
+		scp->scp_freepm = si->si_ssfb.sf_blocks ?
+		    si->si_ssfb.sf_bavail * 1000 /
+		    si->si_ssfb.sf_blocks : -1;
+		scp->scp_queued = si->si_bw_ingress.bwd_queued;
+		scp->scp_lastscore = si->si_place_score;
+		scp->scp_nplaced = si->si_nplaced;
+		RPMI_ULOCK(rpmi);
+
+		rc = psc_ctlmsg_sendv(fd, mh, scp);
+		if (!rc)
+			goto done;
+	}
+ done:
+	CONF_ULOCK();
+	return (rc);
+}
+
 /*
  * Send a response to a "GETSTATFS" inquiry.
  * @fd: client socket descriptor.
@@ -482,6 +665,18 @@ slmctlrep_getstatfs(int fd, struct psc_ctlmsghdr *mh, void *m)
 	return (rc);
 }
 
+void
+slmctlparam_distill_lag_get(char *val)
+{
+	snprintf(val, PCP_VALUE_MAX, "%"PRIu64, mds_distill_lag());
+}
+
+void
+slmctlparam_lease_recovery_get(char *val)
+{
+	snprintf(val, PCP_VALUE_MAX, "%d", mds_bia_recover_npending());
+}
+
 void
 slmctlparam_nextfid_get(char *val)
 {
@@ -581,7 +776,9 @@ struct psc_ctlop slmctlops[] = {
 	, { slmctlrep_getstatfs,	sizeof(struct slmctlmsg_statfs) }
 	, { slmctlcmd_stop,		0 }
 	, { slmctlrep_getbml,		sizeof(struct slmctlmsg_bml) }
-	, { slmctlcmd_upsch_query,	0 },
+	, { slmctlcmd_upsch_query,	0 }
+	, { slmctlrep_getreplrate,	sizeof(struct slmctlmsg_replrate) }
+	, { slmctlrep_getplace,		sizeof(struct slmctlmsg_place) }
 };
 
 psc_ctl_thrget_t psc_ctl_thrgets[] = {
@@ -635,10 +832,20 @@ slmctlthr_main(const char *fn)
 
 	psc_ctlparam_register("sys.namespace_stats",
 	    slmctlparam_namespace_stats);
+	psc_ctlparam_register_simple("sys.distill_lag",
+	    slmctlparam_distill_lag_get, NULL);
 	psc_ctlparam_register_simple("sys.nextfid",
 	    slmctlparam_nextfid_get, slmctlparam_nextfid_set);
 	psc_ctlparam_register_var("sys.global",
 	    PFLCTL_PARAMT_INT, PFLCTL_PARAMF_RDWR, &use_global_mount);
+	psc_ctlparam_register_var("sys.inline_max",
+	    PFLCTL_PARAMT_INT, PFLCTL_PARAMF_RDWR, &slm_inline_max);
+	psc_ctlparam_register_var("sys.journal_batch",
+	    PFLCTL_PARAMT_INT, PFLCTL_PARAMF_RDWR, &slm_jrnl_nsbatch);
+	psc_ctlparam_register_simple("sys.lease_recovery",
+	    slmctlparam_lease_recovery_get, NULL);
+	psc_ctlparam_register_var("sys.odtable_combine",
+	    PFLCTL_PARAMT_INT, PFLCTL_PARAMF_RDWR, &slm_odt_wcomb);
 	psc_ctlparam_register_var("sys.reclaim_xid",
 	    PFLCTL_PARAMT_UINT64, 0, &reclaim_prg.cur_xid);
 	psc_ctlparam_register_var("sys.reclaim_batchno",
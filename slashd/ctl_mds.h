@@ -40,6 +40,28 @@ struct slmctlmsg_replqueued {
 
 #define SLMC_REPLQ_BUSY		":busy"
 
+/* replication rate of a link: IOS ingress/egress or site pair */
+struct slmctlmsg_replrate {
+	char			scrr_src[RES_NAME_MAX];
+	char			scrr_dst[RES_NAME_MAX];
+	 int64_t		scrr_rate;	/* measured, bytes/sec */
+	 int64_t		scrr_limit;	/* bytes/sec; 0 for none */
+	 int64_t		scrr_tokens;
+};
+
+#define SLMC_REPLRATE_ANY	"*"
+
+/* write lease placement state of an IOS */
+struct slmctlmsg_place {
+	char			scp_resname[RES_NAME_MAX];
+	 int32_t		scp_freepm;	/* free space, per mille */
+	 int32_t		scp_nwrleases;	/* write leases assigned */
+	 int64_t		scp_queued;	/* ingress backlog, bytes */
+	 int64_t		scp_score;	/* current, lower is better */
+	 int64_t		scp_lastscore;	/* at last placement */
+	uint64_t		scp_nplaced;
+};
+
 struct slmctlmsg_statfs {
 	char			scsf_resname[RES_NAME_MAX];
 	int32_t			scsf_flags;
@@ -79,3 +101,5 @@ struct slmctlmsg_upsch_query {
 #define SLMCMT_STOP		(NPCMT + 5)
 #define SLMCMT_GETBML		(NPCMT + 6)
 #define SLMCMT_UPSCH_QUERY	(NPCMT + 7)
+#define SLMCMT_GETREPLRATE	(NPCMT + 8)
+#define SLMCMT_GETPLACE		(NPCMT + 9)
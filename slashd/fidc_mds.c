@@ -199,8 +199,10 @@ slm_fcmh_ctor(struct fidc_membh *f, int flags)
 		ino_mfh = fcmh_2_dino_mfhp(f);
 	}
 
-	if (fcmh_isreg(f))
+	if (fcmh_isreg(f)) {
 		psc_dynarray_init(&fmi->fmi_ptrunc_clients);
+		fmi->fmi_bmap_lastno = BMAPNO_ANY;
+	}
 
 	if (fcmh_isdir(f) || fcmh_isreg(f)) {
 		/*
@@ -247,6 +249,7 @@ slm_fcmh_dtor(struct fidc_membh *f)
 	if (fcmh_isreg(f)) {
 		psc_assert(psc_dynarray_len(&fmi->fmi_ptrunc_clients) == 0);
 		psc_dynarray_free(&fmi->fmi_ptrunc_clients);
+		PSCFREE(fmi->fmi_bmapra);
 	}
 
 	if (fcmh_isreg(f) || fcmh_isdir(f)) {
@@ -322,6 +325,7 @@ dump_fcmh_flags(int flags)
 
 	_dump_fcmh_flags_common(&flags, &seq);
 	PFL_PRFLAG(FCMH_MDS_IN_PTRUNC, &flags, &seq);
+	PFL_PRFLAG(FCMH_MDS_INLPROMOTE, &flags, &seq);
 	if (flags)
 		printf(" unknown: %#x", flags);
 	printf("\n");
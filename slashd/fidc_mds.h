@@ -35,6 +35,8 @@
 #include "slashd.h"
 #include "up_sched_res.h"
 
+struct slm_bmap_ra;
+
 /**
  * fcmh_mds_info - MDS-specific fcmh data.
  * @fmi_mfid - backing object MIO FID.  This is used to access the
@@ -58,6 +60,11 @@ struct fcmh_mds_info {
 			uint64_t  fmif_ptrunc_size;	/* new truncate(2) size */
 			struct psc_dynarray
 				  fmif_ptrunc_clients;	/* clients awaiting CRC recalc */
+			struct slm_bmap_ra
+				 *fmif_bmapra;		/* bmap records read ahead */
+			uint32_t  fmif_bmapra_gen;	/* bumped on bmap write */
+			sl_bmapno_t
+				  fmif_bmap_lastno;	/* last bmap read from disk */
 		} f;
 	} u;
 #define fmi_dino_mfid		u.d.fmid_dino_mfid
@@ -65,10 +72,14 @@ struct fcmh_mds_info {
 
 #define fmi_ptrunc_size		u.f.fmif_ptrunc_size
 #define fmi_ptrunc_clients	u.f.fmif_ptrunc_clients
+#define fmi_bmapra		u.f.fmif_bmapra
+#define fmi_bmapra_gen		u.f.fmif_bmapra_gen
+#define fmi_bmap_lastno		u.f.fmif_bmap_lastno
 };
 
 /* mds-specific fcmh_flags */
 #define FCMH_MDS_IN_PTRUNC	(_FCMH_FLGSHFT << 0)
+#define FCMH_MDS_INLPROMOTE	(_FCMH_FLGSHFT << 1)	/* inline data being moved to bmap 0 */
 
 #define fcmh_2_inoh(f)		(&fcmh_2_fmi(f)->fmi_inodeh)
 #define fcmh_2_ino(f)		(&fcmh_2_inoh(f)->inoh_ino)
@@ -25,8 +25,13 @@
 #define PSC_SUBSYS SLSS_FCMH
 #include "slsubsys.h"
 
+#include <sys/param.h>
+
+#include <string.h>
+
 #include "pfl/cdefs.h"
 
+#include "bmap_mds.h"
 #include "fidc_mds.h"
 #include "inode.h"
 #include "journal_mds.h"
@@ -36,6 +41,8 @@
 
 #include "zfs-fuse/zfs_slashlib.h"
 
+int			 slm_inline_max;	/* 0 disables inline files */
+
 __static void
 mds_inode_od_initnew(struct slash_inode_handle *ih)
 {
@@ -46,6 +53,32 @@ mds_inode_od_initnew(struct slash_inode_handle *ih)
 	ih->inoh_ino.ino_version = INO_VERSION;
 }
 
+/*
+ * Drop the old inline data left behind bmap 0's record by the
+ * conversion of an inline file, then clear INOF_INLINE_TRIM.
+ */
+__static int
+mds_inline_trim(int vfsid, struct slash_inode_handle *ih)
+{
+	struct srt_stat sstb;
+	int rc, locked;
+
+	memset(&sstb, 0, sizeof(sstb));
+	sstb.sst_size = SL_INLINE_START_OFF;
+	rc = mdsio_setattr(vfsid, 0, &sstb, SL_SETATTRF_METASIZE,
+	    &rootcreds, NULL, inoh_2_mfh(ih), NULL);
+	if (rc)
+		return (rc);
+
+	locked = INOH_RLOCK(ih);
+	ih->inoh_ino.ino_flags &= ~INOF_INLINE_TRIM;
+	rc = mds_inode_write(vfsid, ih, NULL, NULL);
+	if (rc)
+		ih->inoh_ino.ino_flags |= INOF_INLINE_TRIM;
+	INOH_URLOCK(ih, locked);
+	return (rc);
+}
+
 int
 mds_inode_read(struct slash_inode_handle *ih)
 {
@@ -112,6 +145,13 @@ mds_inode_read(struct slash_inode_handle *ih)
 			ih->inoh_flags &= ~INOH_INO_NOTLOADED;
 			DEBUG_INOH(PLL_INFO, ih, "successfully loaded inode od");
 		}
+
+		/* finish a conversion cut short by a crash */
+		if (rc == 0 &&
+		    (ih->inoh_ino.ino_flags & INOF_INLINE_TRIM)) {
+			OPSTAT_INCR("inline-trim-recover");
+			rc = mds_inline_trim(vfsid, ih);
+		}
 	}
 	INOH_URLOCK(ih, locked);
 	return (rc);
@@ -305,6 +345,175 @@ mds_inodes_odsync(int vfsid, struct fidc_membh *f,
 	return (rc);
 }
 
+/*
+ * Flag a newly created regular file to hold its data in its metafile
+ * instead of in bmaps on an IOS.
+ */
+int
+mds_inline_init(int vfsid, struct fidc_membh *f)
+{
+	int rc;
+
+	FCMH_WAIT_BUSY(f);
+	fcmh_2_ino(f)->ino_flags |= INOF_INLINE;
+	rc = mds_inodes_odsync(vfsid, f, mdslog_ino_repls);
+	if (rc)
+		fcmh_2_ino(f)->ino_flags &= ~INOF_INLINE;
+	FCMH_UNBUSY(f);
+	if (rc == 0)
+		OPSTAT_INCR("inline-create");
+	return (rc);
+}
+
+/*
+ * Read inline file data.  Anything past the end of the metafile reads
+ * as zeros, as it would from a sparse bmap.
+ * @off: offset into file data.
+ * @len: number of bytes to read; caller has clamped to file size.
+ */
+int
+mds_inline_read(int vfsid, struct fidc_membh *f, void *buf,
+    uint32_t off, uint32_t len)
+{
+	struct iovec iov;
+	size_t nb = 0;
+	int rc;
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+	rc = mdsio_preadv(vfsid, &rootcreds, &iov, 1, &nb,
+	    SL_INLINE_START_OFF + off, fcmh_2_mfh(f));
+	if (rc)
+		return (rc);
+	if (nb < len)
+		memset((char *)buf + nb, 0, len - nb);
+	return (0);
+}
+
+int
+mds_inline_write(int vfsid, struct fidc_membh *f, const void *buf,
+    uint32_t off, uint32_t len)
+{
+	struct iovec iov;
+	size_t nb;
+	int rc;
+
+	if ((uint64_t)off + len > SLM_INLINE_LIMIT)
+		return (SLERR_INLINE_FULL);
+
+	iov.iov_base = (void *)buf;
+	iov.iov_len = len;
+	rc = mdsio_pwritev(vfsid, &rootcreds, &iov, 1, &nb,
+	    SL_INLINE_START_OFF + off, fcmh_2_mfh(f), NULL, NULL);
+	if (rc == 0 && nb != len)
+		rc = SLERR_SHORTIO;
+	return (rc);
+}
+
+/*
+ * Resize inline file data.  Truncating the metafile right at the new
+ * end of file guarantees a later extension reads back zeros.
+ */
+int
+mds_inline_truncate(int vfsid, struct fidc_membh *f, uint64_t size)
+{
+	struct srt_stat sstb;
+
+	if (size > SLM_INLINE_LIMIT)
+		return (SLERR_INLINE_FULL);
+
+	memset(&sstb, 0, sizeof(sstb));
+	sstb.sst_size = SL_INLINE_START_OFF + size;
+	return (mdsio_setattr(vfsid, 0, &sstb, SL_SETATTRF_METASIZE,
+	    &rootcreds, NULL, fcmh_2_mfh(f), NULL));
+}
+
+/*
+ * Start converting an inline file into a regular one on behalf of a
+ * client about to write the contents to bmap 0 on an IOS; see the
+ * PROMOTE and COMMIT flags of INLINE_IO.  bmap 0's record is cleared
+ * of anything left by an earlier attempt so it is loaded as a new bmap.
+ * The caller must hold the fcmh BUSY.
+ */
+int
+mds_inline_promote_start(int vfsid, struct fidc_membh *f)
+{
+	char buf[BMAP_OD_SZ];
+	struct iovec iov;
+	size_t nb;
+	int rc;
+
+	FCMH_BUSY_ENSURE(f);
+
+	if (f->fcmh_flags & FCMH_MDS_INLPROMOTE)
+		return (0);
+
+	memset(buf, 0, sizeof(buf));
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+	rc = mdsio_pwritev(vfsid, &rootcreds, &iov, 1, &nb,
+	    SL_BMAP_START_OFF, fcmh_2_mfh(f), NULL, NULL);
+	if (rc == 0 && nb != sizeof(buf))
+		rc = SLERR_SHORTIO;
+	if (rc)
+		return (rc);
+
+	FCMH_LOCK(f);
+	f->fcmh_flags |= FCMH_MDS_INLPROMOTE;
+	FCMH_ULOCK(f);
+	OPSTAT_INCR("inline-promote-start");
+	return (0);
+}
+
+/*
+ * Finish converting an inline file into a regular one after the client
+ * has written the contents to bmap 0.  The caller must hold the fcmh
+ * BUSY.
+ *
+ * The steps are ordered so that a crash at any point leaves a usable
+ * file: bmap 0's record does not overlap the inline data, so it is
+ * written first while the file is still inline.  The inode is then
+ * switched over in a single write, which also flags the inline data
+ * behind bmap 0 as stale (INOF_INLINE_TRIM).  If the trim that follows
+ * does not make it, mds_inode_read() redoes it before any bmap past 0
+ * can be loaded.
+ */
+int
+mds_inline_promote(int vfsid, struct fidc_membh *f)
+{
+	struct slash_inode_handle *ih;
+	struct bmap *b;
+	int rc = 0;
+
+	FCMH_BUSY_ENSURE(f);
+
+	if (bmap_lookup(f, 0, &b) == 0) {
+		rc = mds_bmap_write_logrepls(b);
+		bmap_op_done(b);
+		if (rc)
+			return (rc);
+	}
+
+	ih = fcmh_2_inoh(f);
+	FCMH_LOCK(f);
+	ih->inoh_ino.ino_flags &= ~INOF_INLINE;
+	ih->inoh_ino.ino_flags |= INOF_INLINE_TRIM;
+	rc = mds_inode_write(vfsid, ih, mdslog_ino_repls, f);
+	if (rc) {
+		ih->inoh_ino.ino_flags &= ~INOF_INLINE_TRIM;
+		ih->inoh_ino.ino_flags |= INOF_INLINE;
+	} else
+		f->fcmh_flags &= ~FCMH_MDS_INLPROMOTE;
+	FCMH_ULOCK(f);
+	if (rc)
+		return (rc);
+
+	rc = mds_inline_trim(vfsid, ih);
+	if (rc == 0)
+		OPSTAT_INCR("inline-promote");
+	return (rc);
+}
+
 char *
 _dump_ino(char *buf, size_t siz, const struct slash_inode_od *ino)
 {
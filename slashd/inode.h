@@ -54,6 +54,13 @@
 #define SL_EXTRAS_START_OFF	((off_t)0x0200)
 #define SL_BMAP_START_OFF	((off_t)0x0600)
 
+/*
+ * Files flagged INOF_INLINE have no bmaps; their data is kept past the
+ * slot of bmap 0's record, which is filled in while the file is being
+ * converted to a regular one.
+ */
+#define SL_INLINE_START_OFF	(SL_BMAP_START_OFF + BMAP_OD_SZ)
+
 /*
  * Point to an offset within the linear metadata file which holds a
  * snapshot.  Snapshots are read-only and their metadata may not be
@@ -87,6 +94,9 @@ struct slm_ino_od {
 #define slash_inode_od slm_ino_od
 
 #define INOF_IOS_AFFINITY	(1 << 0)			/* Prefer existing IOS for new bmaps */
+#define INOF_STRIPED_READ	(1 << 1)			/* clients read from all replicas */
+#define INOF_INLINE		(1 << 2)			/* data held in metafile, see SL_INLINE_START_OFF */
+#define INOF_INLINE_TRIM	(1 << 3)			/* stale inline data still follows bmap 0 */
 
 /*
  * A 64-bit checksum follows this structure on disk.
@@ -160,6 +170,13 @@ int	mds_inox_ensure_loaded(struct slash_inode_handle *);
 
 int	mds_inodes_odsync(int, struct fidc_membh *, void (*logf)(void *, uint64_t, int));
 
+int	mds_inline_init(int, struct fidc_membh *);
+int	mds_inline_promote(int, struct fidc_membh *);
+int	mds_inline_promote_start(int, struct fidc_membh *);
+int	mds_inline_read(int, struct fidc_membh *, void *, uint32_t, uint32_t);
+int	mds_inline_truncate(int, struct fidc_membh *, uint64_t);
+int	mds_inline_write(int, struct fidc_membh *, const void *, uint32_t, uint32_t);
+
 char	*_dump_ino(char *, size_t, const struct slash_inode_od *);
 
 extern struct sl_ino_compat sl_ino_compat_table[];
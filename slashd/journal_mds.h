@@ -187,12 +187,33 @@ struct slmds_jent_namespace {
 	char				sjnm_name[SL_TWO_NAME_MAX]; /* one or two names */
 } __packed;
 
+/* the portion of a namespace log entry actually in use */
+#define SJNM_LEN(sjnm)							\
+	(offsetof(struct slmds_jent_namespace, sjnm_name) +		\
+	    (sjnm)->sjnm_namelen + (sjnm)->sjnm_namelen2)
+
+/*
+ * Namespace operations that need no distilling may be group committed:
+ * several of them are packed into a single journal entry, each in its
+ * variable-length form (see SJNM_LEN) padded to an 8-byte boundary.
+ */
+struct slmds_jent_nsbatch {
+	uint32_t			sjnb_count;		/* # of operations */
+	uint32_t			sjnb_len;		/* bytes of sjnb_data */
+	char				sjnb_data[0];
+} __packed;
+
+#define SJNB_RECLEN(sjnm)		PSC_ALIGN(SJNM_LEN(sjnm), 8)
+
 /*
  * The combined size of the standard header of each log entry (i.e.
  * struct psc_journal_enthdr) and its data, if any, must occupy less
- * than or this size.
+ * than or this size.  Journals may be formatted with larger entries
+ * (up to SLJ_MDS_MAXENTSIZE) to pack more namespace operations into
+ * each write.
  */
 #define	SLJ_MDS_ENTSIZE			512
+#define	SLJ_MDS_MAXENTSIZE		8192
 
 /*
  * Keep track of the bmap associated with a CRC update to save FID and
@@ -210,7 +231,8 @@ struct sl_mds_crc_log {
 #define MDS_LOG_BMAP_ASSIGN		(_PJE_FLSHFT << 3)
 #define MDS_LOG_INO_REPLS		(_PJE_FLSHFT << 4)
 #define MDS_LOG_NAMESPACE		(_PJE_FLSHFT << 5)
-#define _MDS_LOG_LAST_TYPE		(_PJE_FLSHFT << 5)
+#define MDS_LOG_NAMESPACE_BATCH		(_PJE_FLSHFT << 6)
+#define _MDS_LOG_LAST_TYPE		(_PJE_FLSHFT << 6)
 
 /*
  * A structure used to describe the log application progress on each site.
@@ -230,6 +252,8 @@ void	mdslogfill_bmap_repls(struct bmap *, struct slmds_jent_bmap_repls *);
 void	mdslogfill_ino_repls(struct fidc_membh *, struct slmds_jent_ino_repls *);
 
 void	mds_journal_init(uint64_t);
+void	mds_nsbatch_wait(void);
+uint64_t mds_distill_lag(void);
 
 int	mds_bmap_crc_update(struct bmap *, sl_ios_id_t, struct srm_bmap_crcup *);
 
@@ -241,5 +265,6 @@ int	mds_replay_handler(struct psc_journal_enthdr *);
 
 extern struct psc_journal		*slm_journal;
 extern struct psc_journal_cursor	 mds_cursor;
+extern int				 slm_jrnl_nsbatch;
 
 #endif /* _JOURNAL_MDS_H_ */
@@ -502,6 +502,32 @@ mds_replay_namespace(struct slmds_jent_namespace *sjnm, int replay)
 	return (rc);
 }
 
+static int
+mds_replay_nsentry(struct slmds_jent_namespace *sjnm)
+{
+	uint64_t fid;
+	int rc;
+
+	psc_assert(sjnm->sjnm_magic == SJ_NAMESPACE_MAGIC);
+	rc = mds_replay_namespace(sjnm, 1);
+
+	/*
+	 * If we fail above, we still skip these SLASH2 FIDs here
+	 * in case a client gets confused.
+	 *
+	 * 04/12/2012:
+	 *
+	 * Alternatively, we can just set it to be one beyond the last
+	 * fid stored in a journal entry.
+	 */
+	if (sjnm->sjnm_op == NS_OP_CREATE ||
+	    sjnm->sjnm_op == NS_OP_MKDIR ||
+	    sjnm->sjnm_op == NS_OP_LINK ||
+	    sjnm->sjnm_op == NS_OP_SYMLINK)
+		slm_get_next_slashfid(&fid);
+	return (rc);
+}
+
 /**
  * mds_replay_handler - Handle journal replay events.
  */
@@ -509,8 +535,9 @@ int
 mds_replay_handler(struct psc_journal_enthdr *pje)
 {
 	struct slmds_jent_namespace *sjnm;
-	int rc = 0, type;
-	uint64_t fid;
+	struct slmds_jent_nsbatch *sjnb;
+	int i, rc = 0, rc2, type;
+	char *p;
 
 	mds_note_update(1);
 	type = pje->pje_type & ~(_PJE_FLSHFT - 1);
@@ -531,24 +558,19 @@ mds_replay_handler(struct psc_journal_enthdr *pje)
 		rc = mds_replay_bmap_assign(pje);
 		break;
 	    case MDS_LOG_NAMESPACE:
-		sjnm = PJE_DATA(pje);
-		psc_assert(sjnm->sjnm_magic == SJ_NAMESPACE_MAGIC);
-		rc = mds_replay_namespace(sjnm, 1);
-
-		/*
-		 * If we fail above, we still skip these SLASH2 FIDs here
-		 * in case a client gets confused.
-		 *
-		 * 04/12/2012:
-		 *
-		 * Alternatively, we can just set it to be one beyond the last
-		 * fid stored in a journal entry.
-		 */
-		if (sjnm->sjnm_op == NS_OP_CREATE ||
-		    sjnm->sjnm_op == NS_OP_MKDIR ||
-		    sjnm->sjnm_op == NS_OP_LINK ||
-		    sjnm->sjnm_op == NS_OP_SYMLINK)
-			slm_get_next_slashfid(&fid);
+		rc = mds_replay_nsentry(PJE_DATA(pje));
+		break;
+	    case MDS_LOG_NAMESPACE_BATCH:
+		sjnb = PJE_DATA(pje);
+		p = sjnb->sjnb_data;
+		for (i = 0; i < (int)sjnb->sjnb_count; i++) {
+			sjnm = (void *)p;
+			rc2 = mds_replay_nsentry(sjnm);
+			if (rc2 && !rc)
+				rc = rc2;
+			p += SJNB_RECLEN(sjnm);
+		}
+		psc_assert(p == sjnb->sjnb_data + sjnb->sjnb_len);
 		break;
 	    default:
 		psc_fatalx("invalid log entry type %d", pje->pje_type);
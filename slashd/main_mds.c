@@ -390,7 +390,7 @@ __dead void
 usage(void)
 {
 	fprintf(stderr,
-	    "usage: %s [-V] [-D datadir] [-f slashconf] [-p zpoolcache] [-S socket]\n"
+	    "usage: %s [-LV] [-D datadir] [-f slashconf] [-p zpoolcache] [-S socket]\n"
 	    "\t[zpoolname]\n",
 	    progname);
 	exit(1);
@@ -432,7 +432,7 @@ main(int argc, char *argv[])
 	if (p)
 		cfn = p;
 
-	while ((c = getopt(argc, argv, "D:f:p:S:V")) != -1)
+	while ((c = getopt(argc, argv, "D:f:Lp:S:V")) != -1)
 		switch (c) {
 		case 'D':
 			sl_datadir = optarg;
@@ -440,6 +440,9 @@ main(int argc, char *argv[])
 		case 'f':
 			cfn = optarg;
 			break;
+		case 'L':
+			slm_lazy_recovery = 1;
+			break;
 		case 'p':
 			zpcachefn = optarg;
 			break;
@@ -569,6 +572,9 @@ main(int argc, char *argv[])
 	    SL_FN_PTRUNC_ODTAB, "ptrunc");
 
 	mds_bmap_timeotbl_init();
+	psc_hashtbl_init(&slm_bia_recover_hashtbl, 0,
+	    struct slm_bia_recover, sbr_fid, sbr_hentry, 1023, NULL,
+	    "biarecover");
 
 	sqlite3_enable_shared_cache(1);
 	//dbdo(NULL, NULL, "PRAGMA page_size=");
@@ -672,8 +678,20 @@ main(int argc, char *argv[])
 	pscthr_init(SLMTHRT_BKDB, slmbkdbthr_main, NULL, 0,
 	    "slmbkdbthr");
 
+	slm_odt_readahead(1);
 	pfl_odt_check(slm_bia_odt, mds_bia_odtable_startup_cb, NULL);
 	pfl_odt_check(slm_ptrunc_odt, slm_ptrunc_odt_startup_cb, NULL);
+	slm_odt_readahead(0);
+	slm_odt_initfree(slm_bia_odt);
+
+	/*
+	 * Lease recovery proceeds in the worker threads.  Unless asked
+	 * to recover lazily, wait for it before letting clients in;
+	 * otherwise, a file is recovered on first access.
+	 */
+	mds_bia_recover_start();
+	if (!slm_lazy_recovery)
+		mds_bia_recover_wait();
 
 	slm_opstate = SLM_OPSTATE_NORMAL;
 
@@ -58,6 +58,18 @@
 
 struct pfl_odt		*slm_bia_odt;
 
+/*
+ * Write leases from the bmap assignment odtable not yet recovered,
+ * protected by slm_bia_recover_lock.  Those found by the startup scan
+ * wait in slm_bia_recover_found until the scan is over.
+ */
+struct psc_hashtbl	 slm_bia_recover_hashtbl;
+psc_spinlock_t		 slm_bia_recover_lock = SPINLOCK_INIT;
+struct psc_waitq	 slm_bia_recover_waitq = PSC_WAITQ_INIT;
+int			 slm_bia_recover_npending;
+struct psc_dynarray	 slm_bia_recover_found = DYNARRAY_INIT;
+int			 slm_lazy_recovery;	/* accept clients before recovery finishes */
+
 int
 mds_bmap_exists(struct fidc_membh *f, sl_bmapno_t n)
 {
@@ -145,22 +157,105 @@ slm_bmap_calc_repltraffic(struct bmap *b)
 	return (amt);
 }
 
+/*
+ * Determine whether an existing lease collides with new access to a
+ * bmap.  Read leases cover the entire bmap, but write leases may be
+ * confined to a range, so two writers only collide if their ranges
+ * overlap.
+ * @bml: existing lease.
+ * @rw: access mode of the new lease.
+ * @off: offset of new write range.
+ * @len: length of new write range, zero for the entire bmap.
+ */
+__static int
+mds_bml_conflict(struct bmap_mds_lease *bml, enum rw rw, uint32_t off,
+    uint32_t len)
+{
+	if (rw == SL_READ)
+		return (bml->bml_flags & BML_WRITE);
+	if (!(bml->bml_flags & BML_WRITE) || !len || !bml->bml_len)
+		return (1);
+	return (off < bml->bml_off + bml->bml_len &&
+	    bml->bml_off < off + len);
+}
+
+/*
+ * Widen a write lease range about to be extended so that it at least
+ * doubles, growing in the direction of the write.  A thread writing a
+ * bmap sequentially then needs a handful of BMAPCHWRMODEs rather than
+ * one per sliver.  Growth stops at the ranges leased by other writers,
+ * which would otherwise be switched to direct I/O along with us.
+ * @nbml: the lease being extended.
+ * @noff: offset of extended range, value-result.
+ * @nlen: length of extended range, value-result.
+ */
+__static void
+mds_bml_wrrange_grow(struct bmap_mds_lease *nbml, uint32_t *noff,
+    uint32_t *nlen)
+{
+	struct bmap_mds_info *bmi = nbml->bml_bmi;
+	lnet_process_id_t *np = &nbml->bml_cli_nidpid;
+	struct bmap_mds_lease *bml, *tmp;
+	uint32_t lo = 0, hi = SLASH_BMAP_SIZE, end, want;
+
+	BMAP_LOCK_ENSURE(bmi_2_bmap(bmi));
+
+	if (*nlen == 0 || nbml->bml_len == 0)
+		return;
+
+	end = *noff + *nlen;
+	PLL_FOREACH(bml, &bmi->bmi_leases) {
+		tmp = bml;
+		do {
+			if ((bml->bml_cli_nidpid.nid == np->nid &&
+			    bml->bml_cli_nidpid.pid == np->pid) ||
+			    !(bml->bml_flags & BML_WRITE) ||
+			    !bml->bml_len)
+				goto next;
+			if (bml->bml_off + bml->bml_len <= *noff)
+				lo = MAX(lo, bml->bml_off + bml->bml_len);
+			else if (bml->bml_off >= end)
+				hi = MIN(hi, bml->bml_off);
+ next:
+			bml = bml->bml_chain;
+		} while (tmp != bml);
+	}
+
+	want = MAX(*nlen, 2 * nbml->bml_len);
+	if (*noff < nbml->bml_off)
+		*noff = MAX(lo, end > want ? end - want : 0);
+	else
+		end = MIN(hi, *noff + want);
+	*nlen = end - *noff;
+	bmap_wrrange_round(noff, nlen);
+}
+
 /*
  * Called when a new read or write lease is added to the bmap.
  * Maintains the DIO status of the bmap based on the numbers of readers
  * and writers present.
- * @b: the locked bmap
+ *
+ * Only leases which actually collide with the new one are downgraded.
+ * If every collision is between two write leases confined to ranges,
+ * the bmap itself stays cached and only the colliding clients (and
+ * the new lease) are switched to direct I/O.
+ * @nbml: the new (or changing) lease.
  * @rw: read / write op
- * @np: value-result target ION network + process ID.
+ * @want_dio: whether the caller asked for direct I/O.
+ * @off: offset of write range.
+ * @len: length of write range, zero for the entire bmap.
  * Note: the new bml has yet to be added.
  */
 __static int
-mds_bmap_directio(struct bmap *b, enum rw rw, int want_dio,
-    lnet_process_id_t *np)
+mds_bmap_directio(struct bmap_mds_lease *nbml, enum rw rw, int want_dio,
+    uint32_t off, uint32_t len)
 {
-	struct bmap_mds_info *bmi = bmap_2_bmi(b);
+	struct bmap_mds_info *bmi = nbml->bml_bmi;
+	struct bmap *b = bmi_2_bmap(bmi);
 	struct bmap_mds_lease *bml = NULL, *tmp;
-	int rc = 0, force_dio = 0, check_leases = 0;
+	lnet_process_id_t *np = &nbml->bml_cli_nidpid;
+	int rc = 0, force_dio = 0, range_dio = 0, check_leases = 0;
+	int whole;
 
 	BMAP_LOCK_ENSURE(b);
 
@@ -199,7 +294,17 @@ mds_bmap_directio(struct bmap *b, enum rw rw, int want_dio,
 				    bml->bml_cli_nidpid.pid == np->pid)
 					goto next;
 
-				force_dio = 1;
+				if (!want_dio &&
+				    !mds_bml_conflict(bml, rw, off, len))
+					goto next;
+
+				whole = want_dio || rw == SL_READ ||
+				    !(bml->bml_flags & BML_WRITE) ||
+				    !len || !bml->bml_len;
+				if (whole)
+					force_dio = 1;
+				else
+					range_dio = 1;
 
 				BML_LOCK(bml);
 				if (bml->bml_flags & BML_DIO) {
@@ -210,7 +315,8 @@ mds_bmap_directio(struct bmap *b, enum rw rw, int want_dio,
 				rc = -SLERR_BMAP_DIOWAIT;
 				if (!(bml->bml_flags & BML_DIOCB)) {
 					bml->bml_flags |= BML_DIOCB;
-					b->bcm_flags |= BMAPF_DIOCB;
+					if (whole)
+						b->bcm_flags |= BMAPF_DIOCB;
 					mdscoh_req(bml);
 				} else
 					BML_ULOCK(bml);
@@ -223,6 +329,11 @@ mds_bmap_directio(struct bmap *b, enum rw rw, int want_dio,
 		OPSTAT_INCR("bmap-dio-set");
 		b->bcm_flags |= BMAPF_DIO;
 		b->bcm_flags &= ~BMAPF_DIOCB;
+	} else if (!rc && range_dio) {
+		OPSTAT_INCR("bmap-dio-range");
+		BML_LOCK(nbml);
+		nbml->bml_flags |= BML_DIO;
+		BML_ULOCK(nbml);
 	}
 	return (rc);
 }
@@ -340,6 +451,63 @@ slm_res_shuffle(struct psc_dynarray *a, int begin)
 		    psc_random32u(i + 1));
 }
 
+/*
+ * Score an IOS member as the target of a new write bmap lease; lower is
+ * better.  The load is the write leases already assigned to the member
+ * plus the replication backlog and ingress rate its IOS reported, in
+ * units of SLM_PLACE_BWUNIT.  It is scaled by the inverse of the free
+ * space fraction so fuller IOS are chosen less often, and an IOS that
+ * is almost full is only used as a last resort.
+ */
+int64_t
+slm_resm_score(struct sl_resm *m)
+{
+	struct resprof_mds_info *rpmi = res2rpmi(m->resm_res);
+	struct rpmi_ios *si = res2rpmi_ios(m->resm_res);
+	int64_t load, freepm = 1000;
+
+	load = 1 + psc_atomic32_read(&resm2rmmi(m)->rmmi_refcnt);
+
+	RPMI_LOCK(rpmi);
+	if (si->si_ssfb.sf_blocks)
+		freepm = si->si_ssfb.sf_bavail * 1000 /
+		    si->si_ssfb.sf_blocks;
+	/* bwd_queued is kept in BW_UNITSZ units */
+	load += ((int64_t)MAX(si->si_bw_ingress.bwd_queued, 0) *
+	    BW_UNITSZ + si->si_tb_ingress.tb_rate) / SLM_PLACE_BWUNIT;
+	RPMI_ULOCK(rpmi);
+
+	if (freepm < SLM_PLACE_MINFREE)
+		return (INT64_MAX);
+	return (load * 1000 / freepm);
+}
+
+/*
+ * Order the members in a[begin..] by power-of-two choices: each
+ * position is taken by the better scoring of two randomly sampled
+ * remaining members.  Unlike always ranking by score, this spreads new
+ * leases across similarly loaded IOS instead of herding them onto
+ * whichever looked best at the last statfs update.
+ */
+void
+slm_res_p2c(struct psc_dynarray *a, int begin)
+{
+	int i, n, x, y;
+
+	n = psc_dynarray_len(a);
+	for (i = begin; i < n - 1; i++) {
+		/* draw two distinct members */
+		x = i + psc_random32u(n - i);
+		y = i + psc_random32u(n - i - 1);
+		if (y >= x)
+			y++;
+		if (slm_resm_score(psc_dynarray_getpos(a, y)) <
+		    slm_resm_score(psc_dynarray_getpos(a, x)))
+			x = y;
+		psc_dynarray_swap(a, i, x);
+	}
+}
+
 __static void
 slm_res_fillmembers(struct sl_resource *r, struct psc_dynarray *a,
     int shuffle)
@@ -352,7 +520,7 @@ slm_res_fillmembers(struct sl_resource *r, struct psc_dynarray *a,
 		psc_dynarray_add_ifdne(a, m);
 
 	if (shuffle)
-		slm_res_shuffle(a, begin);
+		slm_res_p2c(a, begin);
 }
 
 /*
@@ -398,7 +566,29 @@ slm_get_ioslist(struct fidc_membh *f, sl_ios_id_t piosid,
 		slm_res_fillmembers(r, a, 0);
 	}
 
-	slm_res_shuffle(a, begin);
+	slm_res_p2c(a, begin);
+}
+
+/*
+ * Account a write lease placement for slmctl.
+ */
+__static void
+slm_resm_placed(struct sl_resm *m)
+{
+	struct resprof_mds_info *rpmi = res2rpmi(m->resm_res);
+	struct rpmi_ios *si = res2rpmi_ios(m->resm_res);
+	int64_t score;
+
+	score = slm_resm_score(m);
+
+	RPMI_LOCK(rpmi);
+	si->si_place_score = score;
+	si->si_nplaced++;
+	RPMI_ULOCK(rpmi);
+
+	psclog_diag("placed write lease on res=%s score=%"PRId64,
+	    m->resm_name, score);
+	OPSTAT_INCR("ios-place");
 }
 
 /*
@@ -496,8 +686,10 @@ slm_resm_select(struct bmap *b, sl_ios_id_t pios, sl_ios_id_t *to_skip,
 				break;
 			}
 
-		if (!skip && slm_try_sliodresm(resm))
+		if (!skip && slm_try_sliodresm(resm)) {
+			slm_resm_placed(resm);
 			break;
+		}
 	}
 
  out:
@@ -625,7 +817,7 @@ mds_bmap_ios_assign(struct bmap_mds_lease *bml, sl_ios_id_t iosid)
 	 * An ION has been assigned to the bmap, mark it in the odtable
 	 * so that the assignment may be restored on reboot.
 	 */
-	elem = pfl_odt_allocslot(slm_bia_odt);
+	elem = slm_odt_allocslot(slm_bia_odt);
 
 	BMAP_LOCK(b);
 	if (elem == ODTBL_SLOT_INV) {
@@ -633,7 +825,7 @@ mds_bmap_ios_assign(struct bmap_mds_lease *bml, sl_ios_id_t iosid)
 		BMAP_ULOCK(b);
 		bml->bml_flags |= BML_ASSFAIL;
 
-		DEBUG_BMAP(PLL_ERROR, b, "failed pfl_odt_allocslot()");
+		DEBUG_BMAP(PLL_ERROR, b, "failed slm_odt_allocslot()");
 		return (-ENOMEM);
 	}
 	b->bcm_flags &= ~BMAPF_NOION;
@@ -763,16 +955,20 @@ mds_bmap_dupls_find(struct bmap_mds_info *bmi, lnet_process_id_t *cnp,
 
 /*
  * Attempt to upgrade a client-granted bmap lease from READ-only to
- * READ+WRITE.
+ * READ+WRITE, or to extend the range of a write lease.
  * @bml: bmap lease.
  * @prefios: client's preferred I/O system ID.
+ * @off: offset of write range.
+ * @len: length of write range, zero for the entire bmap.
  */
 int
-mds_bmap_bml_chwrmode(struct bmap_mds_lease *bml, sl_ios_id_t prefios)
+mds_bmap_bml_chwrmode(struct bmap_mds_lease *bml, sl_ios_id_t prefios,
+    uint32_t off, uint32_t len)
 {
 	int rc, wlease, rlease;
 	struct bmap_mds_info *bmi;
 	struct bmap *b;
+	uint32_t noff, nlen;
 
 	bmi = bml->bml_bmi;
 	b = bmi_2_bmap(bmi);
@@ -784,13 +980,31 @@ mds_bmap_bml_chwrmode(struct bmap_mds_lease *bml, sl_ios_id_t prefios)
 	    bml, bmi->bmi_writers, bmi->bmi_readers);
 
 	if (bml->bml_flags & BML_WRITE) {
-		rc = -PFLERR_ALREADY;
+		noff = bml->bml_off;
+		nlen = bml->bml_len;
+		bmap_wrrange_extend(&noff, &nlen, off, len);
+		if (noff == bml->bml_off && nlen == bml->bml_len) {
+			rc = -PFLERR_ALREADY;
+			goto out;
+		}
+		mds_bml_wrrange_grow(bml, &noff, &nlen);
+		rc = mds_bmap_directio(bml, SL_WRITE, 0, noff, nlen);
+		if (rc)
+			goto out;
+		bml->bml_off = noff;
+		bml->bml_len = nlen;
+		OPSTAT_INCR("bmap-wrrange-extend");
 		goto out;
 	}
 
-	rc = mds_bmap_directio(b, SL_WRITE, 0, &bml->bml_cli_nidpid);
+	noff = off;
+	nlen = len;
+	bmap_wrrange_round(&noff, &nlen);
+	rc = mds_bmap_directio(bml, SL_WRITE, 0, noff, nlen);
 	if (rc)
 		goto out;
+	bml->bml_off = noff;
+	bml->bml_len = nlen;
 
 	BMAP_ULOCK(b);
 
@@ -905,8 +1119,8 @@ mds_bmap_bml_add(struct bmap_mds_lease *bml, enum rw rw,
 	bmap_wait_locked(b, b->bcm_flags & BMAPF_IOSASSIGNED);
 	bmap_op_start_type(b, BMAP_OPCNT_LEASE);
 
-	rc = mds_bmap_directio(b, rw, bml->bml_flags & BML_DIO,
-	    &bml->bml_cli_nidpid);
+	rc = mds_bmap_directio(bml, rw, bml->bml_flags & BML_DIO,
+	    bml->bml_off, bml->bml_len);
 	if (rc && !(bml->bml_flags & BML_RECOVER))
 		/* 'rc != 0' means that we're waiting on an async cb
 		 *    completion.
@@ -1280,7 +1494,7 @@ mds_bmap_bml_release(struct bmap_mds_lease *bml)
 		pjournal_put_buf(slm_journal, sjar);
 		mds_unreserve_slot(1);
 
-		pfl_odt_freeitem(slm_bia_odt, odtr);
+		slm_odt_freeitem(slm_bia_odt, odtr);
 	}
 
 	return (rc);
@@ -1313,6 +1527,8 @@ mds_handle_rls_bmap(struct pscrpc_request *rq, __unusedx int sliod)
 		fg.fg_fid = sbd->sbd_fg.fg_fid;
 		fg.fg_gen = 0; // XXX FGEN_ANY
 
+		mds_bia_recover_fid(fg.fg_fid);
+
 		if (slm_fcmh_get(&fg, &f))
 			continue;
 
@@ -1364,11 +1580,13 @@ mds_bml_new(struct bmap *b, struct pscrpc_export *e, int flags,
 	return (bml);
 }
 
+/*
+ * Recover a bmap write lease found in the bmap assignment odtable.
+ */
 void
-mds_bia_odtable_startup_cb(void *data, struct pfl_odt_receipt *odtr,
-    __unusedx void *arg)
+mds_bia_recover(struct slm_bia_recover *sbr)
 {
-	struct bmap_ios_assign *bia = data;
+	struct bmap_ios_assign *bia = &sbr->sbr_bia;
 	struct pfl_odt_receipt *r = NULL;
 	struct fidc_membh *f = NULL;
 	struct bmap_mds_lease *bml;
@@ -1377,7 +1595,7 @@ mds_bia_odtable_startup_cb(void *data, struct pfl_odt_receipt *odtr,
 	int rc;
 
 	r = PSCALLOC(sizeof(*r));
-	memcpy(r, odtr, sizeof(*r));
+	memcpy(r, &sbr->sbr_odtr, sizeof(*r));
 
 	psclog_debug("fid="SLPRI_FID" seq=%"PRId64" res=(%s) bmapno=%u",
 	    bia->bia_fid, bia->bia_seq,
@@ -1443,13 +1661,167 @@ mds_bia_odtable_startup_cb(void *data, struct pfl_odt_receipt *odtr,
 
  out:
 	if (rc)
-		pfl_odt_freeitem(slm_bia_odt, r);
+		slm_odt_freeitem(slm_bia_odt, r);
 	if (b)
 		bmap_op_done(b);
 	if (f)
 		fcmh_op_done(f);
 }
 
+/*
+ * Recover any write leases from the bmap assignment odtable still
+ * pending for a file.  Lease and CRC update requests call this before
+ * looking at the leases of a file so that, with lazy recovery, a file
+ * is recovered on first access instead of waiting for the workers to
+ * reach it.  If another thread is already recovering one of the
+ * leases, wait for it to finish.
+ */
+void
+mds_bia_recover_fid(slfid_t fid)
+{
+	struct slm_bia_recover *sbr, *tmp;
+	struct psc_hashbkt *b;
+	int busy;
+
+	spinlock(&slm_bia_recover_lock);
+	for (;;) {
+		if (slm_bia_recover_npending == 0)
+			break;
+		sbr = NULL;
+		busy = 0;
+		b = psc_hashbkt_get(&slm_bia_recover_hashtbl, &fid);
+		PSC_HASHBKT_FOREACH_ENTRY(&slm_bia_recover_hashtbl,
+		    tmp, b) {
+			if (tmp->sbr_fid != fid)
+				continue;
+			if (tmp->sbr_flags & SBRF_BUSY) {
+				busy = 1;
+				continue;
+			}
+			sbr = tmp;
+			break;
+		}
+		psc_hashbkt_put(&slm_bia_recover_hashtbl, b);
+
+		if (sbr) {
+			sbr->sbr_flags |= SBRF_BUSY;
+			freelock(&slm_bia_recover_lock);
+
+			mds_bia_recover(sbr);
+
+			spinlock(&slm_bia_recover_lock);
+			psc_hashent_remove(&slm_bia_recover_hashtbl, sbr);
+			slm_bia_recover_npending--;
+			psc_waitq_wakeall(&slm_bia_recover_waitq);
+			PSCFREE(sbr);
+			continue;
+		}
+		if (!busy)
+			break;
+		psc_waitq_wait(&slm_bia_recover_waitq,
+		    &slm_bia_recover_lock);
+		spinlock(&slm_bia_recover_lock);
+	}
+	freelock(&slm_bia_recover_lock);
+}
+
+int
+mds_bia_recover_wkcb(void *p)
+{
+	struct slm_wkdata_bia_recover *wk = p;
+
+	mds_bia_recover_fid(wk->fid);
+	return (0);
+}
+
+/*
+ * Return the number of leases from the bmap assignment odtable still
+ * to be recovered.
+ */
+int
+mds_bia_recover_npending(void)
+{
+	int n;
+
+	spinlock(&slm_bia_recover_lock);
+	n = slm_bia_recover_npending;
+	freelock(&slm_bia_recover_lock);
+	return (n);
+}
+
+/*
+ * Wait for all leases found in the bmap assignment odtable to be
+ * recovered.
+ */
+void
+mds_bia_recover_wait(void)
+{
+	spinlock(&slm_bia_recover_lock);
+	while (slm_bia_recover_npending) {
+		psc_waitq_wait(&slm_bia_recover_waitq,
+		    &slm_bia_recover_lock);
+		spinlock(&slm_bia_recover_lock);
+	}
+	freelock(&slm_bia_recover_lock);
+}
+
+/*
+ * Called for each item in the bmap assignment odtable at startup.
+ * Loading the inode and bmap of each lease is the expensive part, so
+ * the item is only recorded here; mds_bia_recover_start() hands it to
+ * the worker threads once the scan is over.
+ */
+void
+mds_bia_odtable_startup_cb(void *data, struct pfl_odt_receipt *odtr,
+    __unusedx void *arg)
+{
+	struct slm_bia_recover *sbr;
+
+	sbr = PSCALLOC(sizeof(*sbr));
+	memcpy(&sbr->sbr_bia, data, sizeof(sbr->sbr_bia));
+	memcpy(&sbr->sbr_odtr, odtr, sizeof(sbr->sbr_odtr));
+	sbr->sbr_fid = sbr->sbr_bia.bia_fid;
+	psc_hashent_init(&slm_bia_recover_hashtbl, sbr);
+
+	spinlock(&slm_bia_recover_lock);
+	psc_hashtbl_add_item(&slm_bia_recover_hashtbl, sbr);
+	psc_dynarray_add(&slm_bia_recover_found, sbr);
+	slm_bia_recover_npending++;
+	freelock(&slm_bia_recover_lock);
+}
+
+/*
+ * Start recovering the leases found by the odtable scan, which must be
+ * over: recovery updates the odtable itself and may not run while
+ * pfl_odt_check() is still walking it.
+ */
+void
+mds_bia_recover_start(void)
+{
+	struct slm_wkdata_bia_recover *wk;
+	struct slm_bia_recover *sbr;
+	slfid_t *fids;
+	int i, n;
+
+	/*
+	 * A worker frees every entry of the FID it recovers, so take
+	 * the FIDs before any worker can run.
+	 */
+	n = psc_dynarray_len(&slm_bia_recover_found);
+	fids = PSCALLOC(n * sizeof(*fids));
+	DYNARRAY_FOREACH(sbr, i, &slm_bia_recover_found)
+		fids[i] = sbr->sbr_fid;
+	psc_dynarray_free(&slm_bia_recover_found);
+
+	for (i = 0; i < n; i++) {
+		wk = pfl_workq_getitem(mds_bia_recover_wkcb,
+		    struct slm_wkdata_bia_recover);
+		wk->fid = fids[i];
+		pfl_workq_putitem(wk);
+	}
+	PSCFREE(fids);
+}
+
 /*
  * Process a CRC update request from an ION.
  * @c: the RPC request containing the FID, bmapno, and chunk ID (cid).
@@ -1472,6 +1844,8 @@ mds_bmap_crc_write(struct srm_bmap_crcup *c, sl_ios_id_t iosid,
 	if (vfsid != current_vfsid)
 		return (-EINVAL);
 
+	mds_bia_recover_fid(c->fg.fg_fid);
+
 	rc = slm_fcmh_get(&c->fg, &f);
 	if (rc) {
 		if (rc == ENOENT) {
@@ -1745,6 +2119,8 @@ slm_fill_bmapdesc(struct srt_bmapdesc *sbd, struct bmap *b)
  * @bmapno: bmap index number.
  * @flags: bmap lease flags (SRM_LEASEBMAPF_*).
  * @rw: read/write access to the bmap.
+ * @off: offset of write range.
+ * @len: length of write range, zero for the entire bmap.
  * @prefios: client preferred I/O system ID.
  * @sbd: value-result bmap descriptor to pass back to client.
  * @exp: RPC export to client.
@@ -1755,8 +2131,9 @@ slm_fill_bmapdesc(struct srt_bmapdesc *sbd, struct bmap *b)
  */
 int
 mds_bmap_load_cli(struct fidc_membh *f, sl_bmapno_t bmapno, int flags,
-    enum rw rw, sl_ios_id_t prefios, struct srt_bmapdesc *sbd,
-    struct pscrpc_export *exp, uint8_t *repls, int new)
+    enum rw rw, uint32_t off, uint32_t len, sl_ios_id_t prefios,
+    struct srt_bmapdesc *sbd, struct pscrpc_export *exp, uint8_t *repls,
+    int new)
 {
 	struct slashrpc_cservice *csvc;
 	struct bmap_mds_lease *bml;
@@ -1780,6 +2157,8 @@ mds_bmap_load_cli(struct fidc_membh *f, sl_bmapno_t bmapno, int flags,
 		FCMH_ULOCK(f);
 	}
 
+	mds_bia_recover_fid(fcmh_2_fid(f));
+
 	flag = BMAPGETF_CREATE | (new ? BMAPGETF_NODISKREAD : 0);
 	rc = bmap_getf(f, bmapno, SL_WRITE, flag, &b);
 	if (rc)
@@ -1789,6 +2168,11 @@ mds_bmap_load_cli(struct fidc_membh *f, sl_bmapno_t bmapno, int flags,
 	    (rw == SL_WRITE ? BML_WRITE : BML_READ) |
 	     (flags & SRM_LEASEBMAPF_DIO ? BML_DIO : 0),
 	    &exp->exp_connection->c_peer);
+	if (rw == SL_WRITE) {
+		bml->bml_off = off;
+		bml->bml_len = len;
+		bmap_wrrange_round(&bml->bml_off, &bml->bml_len);
+	}
 
 	rc = mds_bmap_bml_add(bml, rw, prefios);
 	if (rc) {
@@ -1801,6 +2185,8 @@ mds_bmap_load_cli(struct fidc_membh *f, sl_bmapno_t bmapno, int flags,
 	}
 
 	slm_fill_bmapdesc(sbd, b);
+	if (bml->bml_flags & BML_DIO)
+		sbd->sbd_flags |= SRM_LEASEBMAPF_DIO;
 
 	/*
 	 * SLASH2 monotonic coherency sequence number assigned to this
@@ -1848,6 +2234,8 @@ mds_lease_reassign(struct fidc_membh *f, struct srt_bmapdesc *sbd_in,
 	struct bmap *b;
 	int rc;
 
+	mds_bia_recover_fid(fcmh_2_fid(f));
+
 	rc = bmap_get(f, sbd_in->sbd_bmapno, SL_WRITE, &b);
 	if (rc)
 		return (rc);
@@ -1949,6 +2337,8 @@ mds_lease_renew(struct fidc_membh *f, struct srt_bmapdesc *sbd_in,
 	int rc, rw;
 
 	OPSTAT_INCR("lease-renew");
+	mds_bia_recover_fid(fcmh_2_fid(f));
+
 	rc = bmap_get(f, sbd_in->sbd_bmapno, SL_WRITE, &b);
 	if (rc)
 		return (rc);
@@ -1961,6 +2351,11 @@ mds_lease_renew(struct fidc_membh *f, struct srt_bmapdesc *sbd_in,
 
 	rw = (sbd_in->sbd_ios == IOS_ID_ANY) ? BML_READ : BML_WRITE;
 	bml = mds_bml_new(b, exp, rw, &exp->exp_connection->c_peer);
+	if (obml) {
+		/* The renewed lease keeps the range of the original. */
+		bml->bml_off = obml->bml_off;
+		bml->bml_len = obml->bml_len;
+	}
 
 	rc = mds_bmap_bml_add(bml, (rw == BML_READ ? SL_READ : SL_WRITE),
 	    sbd_in->sbd_ios);
@@ -2039,6 +2434,13 @@ slm_setattr_core(struct fidc_membh *f, struct srt_stat *sstb,
 		}
 
 		locked = FCMH_RLOCK(f);
+		if (fcmh_2_ino(f)->ino_flags & INOF_INLINE) {
+			/* no bmaps; the metafile was trimmed in place */
+			FCMH_URLOCK(f, locked);
+			if (deref)
+				fcmh_op_done(f);
+			return;
+		}
 		f->fcmh_flags |= FCMH_MDS_IN_PTRUNC;
 		fmi = fcmh_2_fmi(f);
 		fmi->fmi_ptrunc_size = sstb->sst_size;
@@ -2521,18 +2923,15 @@ _dbdo(const struct pfl_callerinfo *pci,
 	sqlite3_reset(sth->sth_sth);
 }
 
-void
-slm_ptrunc_odt_startup_cb(void *data, __unusedx struct pfl_odt_receipt *odtr,
-    __unusedx void *arg)
+int
+slm_ptrunc_recover_wkcb(void *p)
 {
-	struct {
-		struct sl_fidgen fg;
-	} *pt = data;
+	struct slm_wkdata_ptrunc_recover *wk = p;
 	struct fidc_membh *f;
 //	sl_bmapno_t bno;
 	int rc;
 
-	rc = slm_fcmh_get(&pt->fg, &f);
+	rc = slm_fcmh_get(&wk->fg, &f);
 	if (rc == 0) {
 //		bno = howmany(fcmh_2_fsz(f), SLASH_BMAP_SIZE) - 1;
 		/* XXX do something */
@@ -2545,4 +2944,20 @@ slm_ptrunc_odt_startup_cb(void *data, __unusedx struct pfl_odt_receipt *odtr,
 //	brepls_init(retifset, 0);
 //	retifset[BREPLST_TRUNCPNDG_SCHED] = 1;
 //	wr = mds_repl_bmap_walk_all(b, tract, retifset, 0);
+	return (0);
+}
+
+void
+slm_ptrunc_odt_startup_cb(void *data, __unusedx struct pfl_odt_receipt *odtr,
+    __unusedx void *arg)
+{
+	struct slm_wkdata_ptrunc_recover *wk;
+	struct {
+		struct sl_fidgen fg;
+	} *pt = data;
+
+	wk = pfl_workq_getitem(slm_ptrunc_recover_wkcb,
+	    struct slm_wkdata_ptrunc_recover);
+	wk->fg = pt->fg;
+	pfl_workq_putitem(wk);
 }
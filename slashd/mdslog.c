@@ -33,6 +33,8 @@
 
 #include <inttypes.h>
 #include <string.h>
+#include <time.h>
+#include <zlib.h>
 
 #include "pfl/crc.h"
 #include "pfl/ctlsvr.h"
@@ -41,6 +43,7 @@
 #include "pfl/fs.h"
 #include "pfl/hostname.h"
 #include "pfl/journal.h"
+#include "pfl/listcache.h"
 #include "pfl/lock.h"
 #include "pfl/log.h"
 #include "pfl/rpc.h"
@@ -76,6 +79,8 @@
 #define CBARG_CSVC		0
 #define CBARG_RARG		1
 #define CBARG_RES		2
+#define CBARG_UCHUNK		1			/* shares slot with CBARG_RARG */
+#define CBARG_GEN		0			/* in av->space[] */
 
 /* max # MDS records in one progress file */
 #define	MAX_UPDATE_PROG_ENTRY	1024
@@ -106,11 +111,19 @@ struct slm_progress		 reclaim_prg;
 #define SL_UPDATE_MAX_AGE	 30
 #define SL_RECLAIM_MAX_AGE	 30
 
+/* protected by nsupd_prg.lock */
+int				 slm_update_kick;	/* slmjnsthr has work */
+int				 slm_update_record;	/* peer progress changed */
+
 struct psc_journal		*slm_journal;
 
+/* group commit namespace operations that need no distilling */
+int				 slm_jrnl_nsbatch = 1;
+
 static psc_spinlock_t		 mds_distill_lock = SPINLOCK_INIT;
 
 static void			*mds_cursor_handle;
+static uint64_t			 mds_cursor_txg;	/* of last cursor write */
 struct psc_journal_cursor	 mds_cursor;
 
 psc_spinlock_t			 mds_txg_lock = SPINLOCK_INIT;
@@ -179,6 +192,15 @@ mds_release_file(void *handle)
 	return rc;
 }
 
+void
+mds_update_kick(void)
+{
+	spinlock(&nsupd_prg.lock);
+	slm_update_kick = 1;
+	psc_waitq_wakeall(&nsupd_prg.waitq);
+	freelock(&nsupd_prg.lock);
+}
+
 static void
 mds_record_update_prog(void)
 {
@@ -256,6 +278,10 @@ void
 mds_txg_handler(__unusedx uint64_t *txgp, __unusedx void *data, int op)
 {
 	psc_assert(op == PJRNL_TXG_GET || op == PJRNL_TXG_PUT);
+
+	/* write back held odtable slots with the group they belong to */
+	if (op == PJRNL_TXG_PUT && psc_atomic32_read(&slm_odt_ndirty))
+		slm_odt_flushall();
 }
 
 int
@@ -495,17 +521,196 @@ mds_write_logentry(uint64_t xid, uint64_t fid, uint64_t gen)
  * We encode the cursor creation time and hostname into the log file
  * names to minimize collisions.  If undetected, these collisions can
  * lead to insidious bugs, especially when on-disk format changes.
+ *
+ * The journal thread decodes each entry and hands its parts to a writer
+ * thread per secondary log, so the reclaim and update log writes of an
+ * entry proceed side by side.  It then waits for both: the journal
+ * takes a return from the distill handler to mean the entry is safely
+ * elsewhere and may recycle its slot.
+ */
+
+struct slm_distill_item {
+	struct psc_listentry	 di_lentry;
+	uint64_t		 di_xid;
+	int			 di_action;
+	uint64_t		 di_fid;		/* reclaim only */
+	uint64_t		 di_gen;		/* reclaim only */
+	struct srt_update_entry	 di_ue;			/* update only */
+};
+
+struct slm_distill_queue {
+	struct psc_listcache	 dq_lc;
+	int			 dq_nitems;
+	uint64_t		 dq_done_xid;		/* last xid written */
+};
+
+/* protected by mds_distill_lock */
+struct slm_distill_queue	 slm_distill_reclaimq;
+struct slm_distill_queue	 slm_distill_updateq;
+uint64_t			 slm_distill_decoded_xid;
+struct psc_waitq		 slm_distill_waitq = PSC_WAITQ_INIT;
+
+/*
+ * Return the xid up to which every decoded journal entry has made it
+ * into the secondary logs.  Must be called with mds_distill_lock held.
  */
+__static uint64_t
+mds_distill_commit_xid(void)
+{
+	uint64_t xid = slm_distill_decoded_xid;
+
+	if (slm_distill_reclaimq.dq_nitems &&
+	    slm_distill_reclaimq.dq_done_xid < xid)
+		xid = slm_distill_reclaimq.dq_done_xid;
+	if (slm_distill_updateq.dq_nitems &&
+	    slm_distill_updateq.dq_done_xid < xid)
+		xid = slm_distill_updateq.dq_done_xid;
+	return (xid);
+}
+
+/*
+ * Return how far, in xids, distilling trails the journal; see
+ * sys.distill_lag.
+ */
+uint64_t
+mds_distill_lag(void)
+{
+	uint64_t xid;
+
+	spinlock(&mds_distill_lock);
+	xid = mds_distill_commit_xid();
+	freelock(&mds_distill_lock);
+	return (slm_journal->pj_lastxid > xid ?
+	    slm_journal->pj_lastxid - xid : 0);
+}
+
+__static void
+mds_distill_enqueue(struct slm_distill_queue *dq,
+    struct slm_distill_item *di)
+{
+	spinlock(&mds_distill_lock);
+	dq->dq_nitems++;
+	freelock(&mds_distill_lock);
+
+	lc_add(&dq->dq_lc, di);
+}
+
+__static void
+mds_distill_write_update(struct slm_distill_item *di)
+{
+	struct srt_update_entry *u;
+	int rc, count, total;
+	void *buf;
+	size_t size;
+
+	if (nsupd_prg.log_handle == NULL) {
+		nsupd_prg.log_offset = 0;
+		mds_open_logfile(nsupd_prg.cur_batchno, 1, 0,
+		    &nsupd_prg.log_handle);
+
+		if (di->di_action == 1) {
+			/*
+			 * Don't borrow nsupd_prg.log_buf here; slmjnsthr
+			 * may already be using it.
+			 */
+			buf = PSCALLOC(SLM_UPDATE_BATCH_NENTS * U_ENTSZ);
+			rc = mds_read_file(nsupd_prg.log_handle, buf,
+			    SLM_UPDATE_BATCH_NENTS * U_ENTSZ, &size, 0);
+			if (rc)
+				psc_fatalx("Failed to read update log "
+				    "file, batchno=%"PRId64": %s",
+				    nsupd_prg.cur_batchno,
+				    slstrerror(rc));
+
+			total = size / U_ENTSZ;
+			u = buf;
+			for (count = 0; count < total; u++, count++) {
+				if (u->xid == di->di_xid)
+					break;
+				nsupd_prg.log_offset += U_ENTSZ;
+			}
+			PSCFREE(buf);
+		}
+	}
+
+	rc = mds_write_file(nsupd_prg.log_handle, &di->di_ue, U_ENTSZ,
+	    &size, nsupd_prg.log_offset);
+	if (size != U_ENTSZ)
+		psc_fatal("failed to write update log file, "
+		    "batchno=%"PRId64" rc=%d",
+		    nsupd_prg.cur_batchno, rc);
+
+	/* see if we need to close the current update log file */
+	nsupd_prg.log_offset += U_ENTSZ;
+	if (nsupd_prg.log_offset == SLM_UPDATE_BATCH_NENTS * U_ENTSZ) {
+		mds_release_file(nsupd_prg.log_handle);
+
+		nsupd_prg.log_handle = NULL;
+		nsupd_prg.cur_batchno++;
+
+		spinlock(&mds_distill_lock);
+		nsupd_prg.sync_xid = di->di_xid;
+		freelock(&mds_distill_lock);
+	}
+
+	spinlock(&mds_distill_lock);
+	nsupd_prg.cur_xid = di->di_xid;
+	freelock(&mds_distill_lock);
+
+	/* updates are streamed to peers as soon as they are logged */
+	mds_update_kick();
+}
+
+__static void
+mds_distill_write_reclaim(struct slm_distill_item *di)
+{
+	mds_write_logentry(di->di_xid, di->di_fid, di->di_gen);
+}
+
+__static void
+mds_distill_writer(struct psc_thread *thr, struct slm_distill_queue *dq,
+    void (*writef)(struct slm_distill_item *))
+{
+	struct slm_distill_item *di;
+
+	while (pscthr_run(thr)) {
+		di = lc_getwait(&dq->dq_lc);
+		writef(di);
+
+		spinlock(&mds_distill_lock);
+		dq->dq_done_xid = di->di_xid;
+		dq->dq_nitems--;
+		psc_waitq_wakeall(&slm_distill_waitq);
+		freelock(&mds_distill_lock);
+
+		OPSTAT_INCR("distill-write");
+		PSCFREE(di);
+	}
+}
+
+void
+slmjdreclaimthr_main(struct psc_thread *thr)
+{
+	mds_distill_writer(thr, &slm_distill_reclaimq,
+	    mds_distill_write_reclaim);
+}
+
+void
+slmjdupdatethr_main(struct psc_thread *thr)
+{
+	mds_distill_writer(thr, &slm_distill_updateq,
+	    mds_distill_write_update);
+}
+
 int
 mds_distill_handler(struct psc_journal_enthdr *pje,
     __unusedx uint64_t xid, int npeers, int action)
 {
 	struct slmds_jent_namespace *sjnm = NULL;
 	struct slmds_jent_bmap_crc *sjbc = NULL;
-	struct srt_update_entry ue, *u;
-	int rc, count, total;
+	struct slm_distill_item *di;
+	struct srt_update_entry *ue;
 	uint16_t type;
-	size_t size;
 
 	psc_assert(pje->pje_magic == PJE_MAGIC);
 
@@ -520,7 +725,7 @@ mds_distill_handler(struct psc_journal_enthdr *pje,
 	}
 
 	if (type != MDS_LOG_NAMESPACE)
-		return (0);
+		goto out;
 
 	sjnm = PJE_DATA(pje);
 	psc_assert(sjnm->sjnm_magic == SJ_NAMESPACE_MAGIC);
@@ -541,107 +746,77 @@ mds_distill_handler(struct psc_journal_enthdr *pje,
 	    sjnm->sjnm_op == NS_OP_UNLINK ||
 	    sjnm->sjnm_op == NS_OP_SETSIZE);
 
-	mds_write_logentry(pje->pje_xid, sjnm->sjnm_target_fid,
-	    sjnm->sjnm_target_gen);
+	di = PSCALLOC(offsetof(struct slm_distill_item, di_ue));
+	INIT_PSC_LISTENTRY(&di->di_lentry);
+	di->di_xid = pje->pje_xid;
+	di->di_action = action;
+	di->di_fid = sjnm->sjnm_target_fid;
+	di->di_gen = sjnm->sjnm_target_gen;
+	mds_distill_enqueue(&slm_distill_reclaimq, di);
 
  check_update:
 	if (!npeers)
-		return (0);
-
-	if (nsupd_prg.log_handle == NULL) {
-		nsupd_prg.log_offset = 0;
-		mds_open_logfile(nsupd_prg.cur_batchno, 1, 0,
-		    &nsupd_prg.log_handle);
-
-		if (action == 1) {
-			rc = mds_read_file(nsupd_prg.log_handle,
-			    nsupd_prg.log_buf, SLM_UPDATE_BATCH_NENTS *
-			    U_ENTSZ, &size, 0);
-			if (rc)
-				psc_fatalx("Failed to read update log "
-				    "file, batchno=%"PRId64": %s",
-				    nsupd_prg.cur_batchno,
-				    slstrerror(rc));
+		goto out;
 
-			total = size / U_ENTSZ;
-			u = nsupd_prg.log_buf;
-			for (count = 0; count < total; u++, count++) {
-				if (u->xid == pje->pje_xid)
-					break;
-				nsupd_prg.log_offset += U_ENTSZ;
-			}
-		}
-	}
+	di = PSCALLOC(sizeof(*di));
+	INIT_PSC_LISTENTRY(&di->di_lentry);
+	di->di_xid = pje->pje_xid;
+	di->di_action = action;
 
-	memset(&ue, 0, U_ENTSZ);
-	ue.xid = pje->pje_xid;
+	ue = &di->di_ue;
+	ue->xid = pje->pje_xid;
 
 	/*
 	 * Fabricate a setattr update entry to change the size.
 	 */
 	if (type == MDS_LOG_BMAP_CRC) {
-		ue.op = NS_OP_SETSIZE;
-		ue.mask = mdsio_slflags_2_setattrmask(
+		ue->op = NS_OP_SETSIZE;
+		ue->mask = mdsio_slflags_2_setattrmask(
 		    PSCFS_SETATTRF_DATASIZE);
-		ue.size = sjbc->sjbc_fsize;
-		ue.target_fid = sjbc->sjbc_fid;
-		goto write_update;
-	}
-
-	ue.op = sjnm->sjnm_op;
-	ue.target_gen = sjnm->sjnm_target_gen;
-	ue.parent_fid = sjnm->sjnm_parent_fid;
-	ue.target_fid = sjnm->sjnm_target_fid;
-	ue.new_parent_fid = sjnm->sjnm_new_parent_fid;
-
-	ue.mode = sjnm->sjnm_mode;
-	ue.mask = sjnm->sjnm_mask;
-	ue.uid = sjnm->sjnm_uid;
-	ue.gid = sjnm->sjnm_gid;
-
-	ue.size = sjnm->sjnm_size;
-
-	ue.atime = sjnm->sjnm_atime;
-	ue.mtime = sjnm->sjnm_mtime;
-	ue.ctime = sjnm->sjnm_ctime;
-	ue.atime_ns = sjnm->sjnm_atime_ns;
-	ue.mtime_ns = sjnm->sjnm_mtime_ns;
-	ue.ctime_ns = sjnm->sjnm_ctime_ns;
-
-	ue.namelen = sjnm->sjnm_namelen;
-	ue.namelen2 = sjnm->sjnm_namelen2;
-	memcpy(ue.name, sjnm->sjnm_name,
-	    sjnm->sjnm_namelen + sjnm->sjnm_namelen2);
-
- write_update:
-	rc = mds_write_file(nsupd_prg.log_handle, &ue, U_ENTSZ, &size,
-	    nsupd_prg.log_offset);
-	if (size != U_ENTSZ)
-		psc_fatal("failed to write update log file, "
-		    "batchno=%"PRId64" rc=%d",
-		    nsupd_prg.cur_batchno, rc);
+		ue->size = sjbc->sjbc_fsize;
+		ue->target_fid = sjbc->sjbc_fid;
+		goto queue_update;
+	}
 
-	/* see if we need to close the current update log file */
-	nsupd_prg.log_offset += U_ENTSZ;
-	if (nsupd_prg.log_offset == SLM_UPDATE_BATCH_NENTS * U_ENTSZ) {
-		mds_release_file(nsupd_prg.log_handle);
+	ue->op = sjnm->sjnm_op;
+	ue->target_gen = sjnm->sjnm_target_gen;
+	ue->parent_fid = sjnm->sjnm_parent_fid;
+	ue->target_fid = sjnm->sjnm_target_fid;
+	ue->new_parent_fid = sjnm->sjnm_new_parent_fid;
+
+	ue->mode = sjnm->sjnm_mode;
+	ue->mask = sjnm->sjnm_mask;
+	ue->uid = sjnm->sjnm_uid;
+	ue->gid = sjnm->sjnm_gid;
+
+	ue->size = sjnm->sjnm_size;
+
+	ue->atime = sjnm->sjnm_atime;
+	ue->mtime = sjnm->sjnm_mtime;
+	ue->ctime = sjnm->sjnm_ctime;
+	ue->atime_ns = sjnm->sjnm_atime_ns;
+	ue->mtime_ns = sjnm->sjnm_mtime_ns;
+	ue->ctime_ns = sjnm->sjnm_ctime_ns;
+
+	ue->namelen = sjnm->sjnm_namelen;
+	ue->namelen2 = sjnm->sjnm_namelen2;
+	memcpy(ue->name, sjnm->sjnm_name,
+	    sjnm->sjnm_namelen + sjnm->sjnm_namelen2);
 
-		nsupd_prg.log_handle = NULL;
-		nsupd_prg.cur_batchno++;
+ queue_update:
+	mds_distill_enqueue(&slm_distill_updateq, di);
 
+ out:
+	/* the slot may only be recycled once both logs have the entry */
+	spinlock(&mds_distill_lock);
+	if (slm_distill_decoded_xid < pje->pje_xid)
+		slm_distill_decoded_xid = pje->pje_xid;
+	while (mds_distill_commit_xid() < pje->pje_xid) {
+		OPSTAT_INCR("distill-wait");
+		psc_waitq_wait(&slm_distill_waitq, &mds_distill_lock);
 		spinlock(&mds_distill_lock);
-		nsupd_prg.sync_xid = pje->pje_xid;
-		freelock(&mds_distill_lock);
-
-		spinlock(&nsupd_prg.lock);
-		psc_waitq_wakeall(&nsupd_prg.waitq);
-		freelock(&nsupd_prg.lock);
 	}
-
-	spinlock(&mds_distill_lock);
-	nsupd_prg.cur_xid = pje->pje_xid;
 	freelock(&mds_distill_lock);
-
 	return (0);
 }
 
@@ -670,6 +845,154 @@ slm_wk_rmdir_ino(void *p)
 	return (0);
 }
 
+/*
+ * Namespace operations are handed to slmjnsbatchthr, which packs
+ * whatever has queued up while its previous journal write was in
+ * progress into one journal entry.  Queueing never waits, so the ZFS
+ * transaction an operation is logged from is not held open; an RPC
+ * handler waits for its records with mds_nsbatch_wait() before it
+ * replies.
+ */
+struct slm_nsbuf {
+	uint64_t		 nbf_gen;
+	uint64_t		 nbf_txg;
+	int			 nbf_count;
+	int			 nbf_len;
+	char			 nbf_data[0];
+};
+
+struct slm_nsbatch {
+	psc_spinlock_t		 nb_lock;
+	struct psc_waitq	 nb_waitq;		/* for a batch to be written */
+	struct psc_waitq	 nb_thrwaitq;		/* for work for the thread */
+	uint64_t		 nb_gen;		/* last batch started */
+	uint64_t		 nb_done;		/* last batch written */
+	int			 nb_max;		/* room in a journal entry */
+	struct slm_nsbuf	*nb_cur;		/* batch being filled */
+	struct psc_dynarray	 nb_ready;		/* full batches, oldest first */
+} slm_nsbatch;
+
+/*
+ * Write a batch out to the journal.
+ */
+__static void
+mds_nsbatch_write(struct slm_nsbuf *nbf)
+{
+	struct slmds_jent_namespace *sjnm;
+	struct slmds_jent_nsbatch *sjnb;
+
+	if (nbf->nbf_count == 1) {
+		sjnm = pjournal_get_buf(slm_journal, sizeof(*sjnm));
+		memcpy(sjnm, nbf->nbf_data, nbf->nbf_len);
+		pjournal_add_entry(slm_journal, nbf->nbf_txg,
+		    MDS_LOG_NAMESPACE, 0, sjnm, SJNM_LEN(sjnm));
+		pjournal_put_buf(slm_journal, sjnm);
+	} else {
+		sjnb = pjournal_get_buf(slm_journal, sizeof(*sjnb) +
+		    nbf->nbf_len);
+		sjnb->sjnb_count = nbf->nbf_count;
+		sjnb->sjnb_len = nbf->nbf_len;
+		memcpy(sjnb->sjnb_data, nbf->nbf_data, nbf->nbf_len);
+		pjournal_add_entry(slm_journal, nbf->nbf_txg,
+		    MDS_LOG_NAMESPACE_BATCH, 0, sjnb,
+		    sizeof(*sjnb) + nbf->nbf_len);
+		pjournal_put_buf(slm_journal, sjnb);
+		OPSTAT_INCR("journal-nsbatch");
+		OPSTAT_ADD("journal-nsbatch-ops", nbf->nbf_count);
+	}
+}
+
+/*
+ * Queue a namespace operation for slmjnsbatchthr.  A batch only holds
+ * operations of a single ZFS transaction group.
+ */
+__static void
+mds_nsbatch_add(const struct slmds_jent_namespace *sjnm, uint64_t txg)
+{
+	struct slm_nsbatch *nb = &slm_nsbatch;
+	int len = SJNB_RECLEN(sjnm);
+	struct slm_nsbuf *nbf;
+	uint64_t *genp;
+
+	spinlock(&nb->nb_lock);
+	nbf = nb->nb_cur;
+	if (nbf && (nbf->nbf_txg != txg ||
+	    nbf->nbf_len + len > nb->nb_max)) {
+		psc_dynarray_add(&nb->nb_ready, nbf);
+		nbf = NULL;
+	}
+	if (nbf == NULL) {
+		nbf = PSCALLOC(sizeof(*nbf) + nb->nb_max);
+		nbf->nbf_gen = ++nb->nb_gen;
+		nbf->nbf_txg = txg;
+		nb->nb_cur = nbf;
+	}
+	memcpy(nbf->nbf_data + nbf->nbf_len, sjnm, SJNM_LEN(sjnm));
+	nbf->nbf_len += len;
+	nbf->nbf_count++;
+	psc_waitq_wakeall(&nb->nb_thrwaitq);
+
+	genp = slmthr_getnsbatchgen();
+	if (genp)
+		*genp = nbf->nbf_gen;
+	freelock(&nb->nb_lock);
+}
+
+/*
+ * Wait until the namespace operations this thread has logged are in
+ * the journal.
+ */
+void
+mds_nsbatch_wait(void)
+{
+	struct slm_nsbatch *nb = &slm_nsbatch;
+	uint64_t *genp, gen;
+
+	genp = slmthr_getnsbatchgen();
+	if (genp == NULL || *genp == 0)
+		return;
+	gen = *genp;
+	*genp = 0;
+
+	spinlock(&nb->nb_lock);
+	while (nb->nb_done < gen) {
+		OPSTAT_INCR("journal-nsbatch-wait");
+		psc_waitq_wait(&nb->nb_waitq, &nb->nb_lock);
+		spinlock(&nb->nb_lock);
+	}
+	freelock(&nb->nb_lock);
+}
+
+void
+slmjnsbatchthr_main(struct psc_thread *thr)
+{
+	struct slm_nsbatch *nb = &slm_nsbatch;
+	struct slm_nsbuf *nbf;
+
+	while (pscthr_run(thr)) {
+		spinlock(&nb->nb_lock);
+		if (psc_dynarray_len(&nb->nb_ready)) {
+			nbf = psc_dynarray_getpos(&nb->nb_ready, 0);
+			psc_dynarray_removepos(&nb->nb_ready, 0);
+		} else if (nb->nb_cur) {
+			nbf = nb->nb_cur;
+			nb->nb_cur = NULL;
+		} else {
+			psc_waitq_wait(&nb->nb_thrwaitq, &nb->nb_lock);
+			continue;
+		}
+		freelock(&nb->nb_lock);
+
+		mds_nsbatch_write(nbf);
+
+		spinlock(&nb->nb_lock);
+		nb->nb_done = nbf->nbf_gen;
+		psc_waitq_wakeall(&nb->nb_waitq);
+		freelock(&nb->nb_lock);
+		PSCFREE(nbf);
+	}
+}
+
 /*
  * Log a namespace operation before we attempt it.  This makes sure that
  * it will be propagated towards other MDSes and made permanent before
@@ -749,12 +1072,20 @@ mdslog_namespace(int op, uint64_t txg, uint64_t pfid, uint64_t npfid,
 	psc_assert(sjnm->sjnm_namelen + sjnm->sjnm_namelen2 <=
 	    sizeof(sjnm->sjnm_name));
 
-	pjournal_add_entry(slm_journal, txg, MDS_LOG_NAMESPACE, distill,
-	    sjnm, offsetof(struct slmds_jent_namespace, sjnm_name) +
-	    sjnm->sjnm_namelen + sjnm->sjnm_namelen2);
-
-	if (!distill)
+	/*
+	 * Distilled entries are keyed by journal xid downstream, so
+	 * only operations that need no distilling may share an entry.
+	 */
+	if (!distill && slm_jrnl_nsbatch &&
+	    SJNB_RECLEN(sjnm) <= slm_nsbatch.nb_max) {
+		mds_nsbatch_add(sjnm, txg);
 		pjournal_put_buf(slm_journal, sjnm);
+	} else {
+		pjournal_add_entry(slm_journal, txg, MDS_LOG_NAMESPACE,
+		    distill, sjnm, SJNM_LEN(sjnm));
+		if (!distill)
+			pjournal_put_buf(slm_journal, sjnm);
+	}
 
 	psclog_info("namespace op %s (%d): distill=%d "
 	    "fid="SLPRI_FID" name='%s%s%s' mask=%#x size=%"PRId64" "
@@ -994,25 +1325,94 @@ mds_skip_reclaim_batch(uint64_t batchno)
 }
 
 /*
- * Send a batch of updates to peer MDSes that want them.
+ * A run of namespace updates from one batch, with the padding of the
+ * fixed-size log entries trimmed and compressed once, shared by the
+ * RPCs streaming it to all peers.  A chunk never changes once loaded:
+ * entries the distill process appends to a batch later go into a new
+ * chunk, so no entry is compressed or sent to a peer more than once.
  */
-int
-mds_send_batch_update(uint64_t batchno)
+struct slm_update_chunk {
+	uint64_t		 uc_batchno;
+	uint64_t		 uc_firstxid;		/* xid of first entry */
+	uint64_t		 uc_xid;		/* xid of last entry */
+	int			 uc_first;		/* index of first entry in batch */
+	int			 uc_count;		/* # of entries */
+	int			 uc_refcnt;
+	int32_t			 uc_size;		/* size of uc_buf */
+	int32_t			 uc_rawsize;		/* uncompressed size or 0 */
+	void			*uc_buf;
+	struct psclist_head	 uc_lentry;
+};
+
+/* the chunk holds the final entry of its batch */
+#define UC_ENDS_BATCH(uc)	((uc)->uc_first + (uc)->uc_count ==	\
+				    SLM_UPDATE_BATCH_NENTS)
+
+psc_spinlock_t			 slm_update_chunk_lock = SPINLOCK_INIT;
+struct psclist_head		 slm_update_chunks =
+				    PSCLIST_HEAD_INIT(slm_update_chunks);
+
+__static void
+mds_update_chunk_put(struct slm_update_chunk *uc)
+{
+	spinlock(&slm_update_chunk_lock);
+	psc_assert(uc->uc_refcnt > 0);
+	if (--uc->uc_refcnt) {
+		freelock(&slm_update_chunk_lock);
+		return;
+	}
+	freelock(&slm_update_chunk_lock);
+	PSCFREE(uc->uc_buf);
+	PSCFREE(uc);
+}
+
+/*
+ * Get the updates of a batch starting at @xid.  A cached chunk starting
+ * there is reused; otherwise only the part of the log file between the
+ * cached chunks around @xid is read and loaded into a new chunk.
+ * Only the journal namespace thread adds or removes chunks from the
+ * cache.
+ * @batchno: batch number.
+ * @xid: xid of the first entry wanted.
+ * @donep: set if the batch is complete and has nothing at or past @xid.
+ */
+__static struct slm_update_chunk *
+mds_update_chunk_get(uint64_t batchno, uint64_t xid, int *donep)
 {
-	int siter, i, rc, npeers, count, total, didwork = 0, record = 0;
+	struct slm_update_chunk *uc, *next = NULL;
 	struct srt_update_entry *u, *nu;
-	struct slashrpc_cservice *csvc;
-	struct sl_mds_peerinfo *sp;
-	struct srm_update_rep *mp;
-	struct srm_update_req *mq;
-	struct pscrpc_request *rq;
-	struct sl_resource *res;
-	struct sl_resm *resm;
-	struct sl_site *site;
-	struct iovec iov;
-	uint64_t xid;
-	size_t size;
+	uLongf zsize;
 	void *handle;
+	size_t size;
+	int i, rc, first = 0, end, count;
+
+	*donep = 0;
+	psclist_for_each_entry(uc, &slm_update_chunks, uc_lentry) {
+		if (uc->uc_batchno != batchno)
+			continue;
+		if (uc->uc_firstxid <= xid && xid <= uc->uc_xid) {
+			next = uc;
+			break;
+		}
+		if (uc->uc_xid < xid) {
+			if (UC_ENDS_BATCH(uc)) {
+				*donep = 1;
+				return (NULL);
+			}
+			first = MAX(first, uc->uc_first + uc->uc_count);
+		} else if (next == NULL || uc->uc_first < next->uc_first)
+			next = uc;
+	}
+
+	/*
+	 * xids need not be contiguous: a chunk starting past @xid is
+	 * still the right one if no entry lies between it and the
+	 * chunks before @xid.
+	 */
+	if (next && (next->uc_firstxid <= xid ||
+	    next->uc_first == first))
+		goto hit;
+	end = next ? next->uc_first : SLM_UPDATE_BATCH_NENTS;
 
 	rc = mds_open_logfile(batchno, 1, 1, &handle);
 	if (rc) {
@@ -1024,24 +1424,40 @@ mds_send_batch_update(uint64_t batchno)
 			psc_fatalx("failed to open update log file, "
 			    "batchno=%"PRId64": %s",
 			    batchno, slstrerror(rc));
-		return (didwork);
+		return (NULL);
 	}
 	rc = mds_read_file(handle, nsupd_prg.log_buf,
-	    SLM_UPDATE_BATCH_NENTS * U_ENTSZ, &size, 0);
+	    (end - first) * U_ENTSZ, &size, (off_t)first * U_ENTSZ);
 	mds_release_file(handle);
 
-	if (size == 0)
-		return (didwork);
-
 	psc_assert(size % U_ENTSZ == 0);
 	count = (int)size / (int)U_ENTSZ;
 
-	/* Find the xid associated with the last log entry. */
-	u = PSC_AGP(nsupd_prg.log_buf, (count - 1) * U_ENTSZ);
-	xid = u->xid;
+	/* Skip what the peer already has. */
+	for (i = 0, u = nsupd_prg.log_buf; i < count; i++, u++)
+		if (u->xid >= xid)
+			break;
+	if (i == count) {
+		if (next)
+			goto hit;
+		if (first + count == SLM_UPDATE_BATCH_NENTS)
+			*donep = 1;
+		return (NULL);
+	}
+	first += i;
+	count -= i;
+
+	uc = PSCALLOC(sizeof(*uc));
+	INIT_PSC_LISTENTRY(&uc->uc_lentry);
+	uc->uc_batchno = batchno;
+	uc->uc_first = first;
+	uc->uc_count = count;
+	uc->uc_firstxid = u->xid;
+	uc->uc_xid = u[count - 1].xid;
 
 	/* Trim padding from buffer to reduce RPC traffic. */
-	u = nu = nsupd_prg.log_buf;
+	nu = nsupd_prg.log_buf;
+	memmove(nu, u, UPDATE_ENTRY_LEN(u));
 	size = UPDATE_ENTRY_LEN(u);
 	for (i = 1; i < count; i++) {
 		u++;
@@ -1050,7 +1466,225 @@ mds_send_batch_update(uint64_t batchno)
 		size += UPDATE_ENTRY_LEN(u);
 	}
 
-	npeers = 0;
+	zsize = compressBound(size);
+	uc->uc_buf = PSCALLOC(zsize);
+	rc = compress2(uc->uc_buf, &zsize, nsupd_prg.log_buf, size,
+	    Z_BEST_SPEED);
+	if (rc == Z_OK && zsize < size) {
+		uc->uc_size = zsize;
+		uc->uc_rawsize = size;
+		OPSTAT_ADD("nsupd-zsaved", size - zsize);
+	} else {
+		memcpy(uc->uc_buf, nsupd_prg.log_buf, size);
+		uc->uc_size = size;
+		OPSTAT_INCR("nsupd-zskip");
+	}
+
+	/* one reference for the cache, one for the caller */
+	uc->uc_refcnt = 2;
+	spinlock(&slm_update_chunk_lock);
+	psclist_add_tail(&uc->uc_lentry, &slm_update_chunks);
+	freelock(&slm_update_chunk_lock);
+	OPSTAT_INCR("nsupd-chunk-load");
+	return (uc);
+
+ hit:
+	spinlock(&slm_update_chunk_lock);
+	next->uc_refcnt++;
+	freelock(&slm_update_chunk_lock);
+	OPSTAT_INCR("nsupd-chunk-hit");
+	return (next);
+}
+
+/*
+ * Drop cached batches that no peer is currently streaming from.  A
+ * peer that restarts its stream further back reloads from the log.
+ */
+__static void
+mds_update_chunk_prune(void)
+{
+	struct slm_update_chunk *uc, *uc_next;
+	struct resprof_mds_info *rpmi;
+	struct sl_mds_peerinfo *sp;
+	struct sl_resm *resm;
+	int inuse;
+
+	psclist_for_each_entry_safe(uc, uc_next, &slm_update_chunks,
+	    uc_lentry) {
+		inuse = 0;
+		SL_MDS_WALK(resm,
+			if (resm == nodeResm)
+				continue;
+			rpmi = resm2rpmi(resm);
+			sp = rpmi->rpmi_info;
+			RPMI_LOCK(rpmi);
+			if (sp->sp_send_batchno == uc->uc_batchno ||
+			    sp->sp_batchno == uc->uc_batchno)
+				inuse = 1;
+			RPMI_ULOCK(rpmi);
+		);
+		if (inuse)
+			continue;
+		spinlock(&slm_update_chunk_lock);
+		psclist_del(&uc->uc_lentry, &slm_update_chunks);
+		freelock(&slm_update_chunk_lock);
+		mds_update_chunk_put(uc);
+	}
+}
+
+int
+slm_rmm_update_cb(struct pscrpc_request *rq,
+    struct pscrpc_async_args *av)
+{
+	struct slashrpc_cservice *csvc = av->pointer_arg[CBARG_CSVC];
+	struct slm_update_chunk *uc = av->pointer_arg[CBARG_UCHUNK];
+	struct sl_resource *res = av->pointer_arg[CBARG_RES];
+	int gen = av->space[CBARG_GEN];
+	struct resprof_mds_info *rpmi;
+	struct sl_mds_peerinfo *sp;
+	struct srm_update_rep *mp;
+	uint64_t cur_xid;
+	int rc;
+
+	SL_GET_RQ_STATUS(csvc, rq, mp, rc);
+
+	spinlock(&mds_distill_lock);
+	cur_xid = nsupd_prg.cur_xid;
+	freelock(&mds_distill_lock);
+
+	rpmi = res2rpmi(res);
+	sp = rpmi->rpmi_info;
+
+	RPMI_LOCK(rpmi);
+	sp->sp_inflight--;
+	if (rc == 0) {
+		OPSTAT_INCR("nsupd-rpc-send");
+		sp->sp_fails = 0;
+
+		/*
+		 * Replies may arrive out of order, and a request the
+		 * peer parked until its predecessor arrives is answered
+		 * before it is applied.  The reply carries the last xid
+		 * the peer has applied, so the highest one wins.
+		 */
+		if (sp->sp_xid <= mp->seqno) {
+			sp->sp_xid = mp->seqno + 1;
+			if (mp->seqno >= uc->uc_xid &&
+			    UC_ENDS_BATCH(uc) &&
+			    sp->sp_batchno <= uc->uc_batchno)
+				sp->sp_batchno = uc->uc_batchno + 1;
+		}
+		if (sp->sp_xid > cur_xid)
+			sp->sp_synced = time(NULL);
+	} else {
+		OPSTAT_INCR("nsupd-rpc-fail");
+		sp->sp_fails++;
+
+		/*
+		 * Restart the stream from what the peer has
+		 * acknowledged once everything in flight has drained.
+		 */
+		if (gen == sp->sp_gen) {
+			sp->sp_gen++;
+			sp->sp_send_prevxid = 0;
+		}
+	}
+	RPMI_ULOCK(rpmi);
+
+	psclog(rc ? PLL_ERROR : PLL_DIAG,
+	    "update batchno=%"PRId64" xid=%"PRId64" res=%s rc=%d",
+	    uc->uc_batchno, uc->uc_xid, res->res_name, rc);
+
+	mds_update_chunk_put(uc);
+	sl_csvc_decref(csvc);
+
+	if (rc == 0) {
+		spinlock(&nsupd_prg.lock);
+		slm_update_record = 1;
+		freelock(&nsupd_prg.lock);
+	}
+	mds_update_kick();
+	return (0);
+}
+
+/*
+ * Issue an asynchronous NAMESPACE_UPDATE carrying the entries of @uc
+ * starting at @xid to an MDS peer.
+ */
+__static int
+mds_send_update_chunk(struct sl_resm *resm,
+    struct slm_update_chunk *uc, uint64_t xid, uint64_t prevxid,
+    int gen)
+{
+	struct slashrpc_cservice *csvc;
+	struct srm_update_req *mq;
+	struct srm_update_rep *mp;
+	struct pscrpc_request *rq;
+	struct iovec iov;
+	int rc;
+
+	csvc = slm_getmcsvcf(resm, CSVCF_NONBLOCK);
+	if (csvc == NULL)
+		return (-ENOTCONN);
+	rc = SL_RSX_NEWREQ(csvc, SRMT_NAMESPACE_UPDATE, rq, mq, mp);
+	if (rc) {
+		sl_csvc_decref(csvc);
+		return (rc);
+	}
+	mq->seqno = xid;
+	mq->prevxid = prevxid;
+	mq->count = uc->uc_count;
+	mq->size = uc->uc_size;
+	mq->rawsize = uc->uc_rawsize;
+	mq->siteid = nodeSite->site_id;
+
+	iov.iov_base = uc->uc_buf;
+	iov.iov_len = uc->uc_size;
+	slrpc_bulkclient(rq, BULK_GET_SOURCE, SRMM_BULK_PORTAL, &iov, 1);
+
+	spinlock(&slm_update_chunk_lock);
+	uc->uc_refcnt++;
+	freelock(&slm_update_chunk_lock);
+
+	rq->rq_interpret_reply = slm_rmm_update_cb;
+	rq->rq_async_args.pointer_arg[CBARG_CSVC] = csvc;
+	rq->rq_async_args.pointer_arg[CBARG_UCHUNK] = uc;
+	rq->rq_async_args.pointer_arg[CBARG_RES] = resm->resm_res;
+	rq->rq_async_args.space[CBARG_GEN] = gen;
+	rc = SL_NBRQSET_ADD(csvc, rq);
+	if (rc) {
+		pscrpc_req_finished(rq);
+		sl_csvc_decref(csvc);
+		mds_update_chunk_put(uc);
+	}
+	return (rc);
+}
+
+/*
+ * Stream updates to peer MDSes that want them.  Each peer has its own
+ * send cursor so a slow or unreachable peer does not hold back the
+ * others, and up to SLM_UPDATE_NINFLIGHT requests may be outstanding to
+ * a peer at once.  A batch still being filled is sent as far as it
+ * goes; whatever accumulates while requests are in flight goes out
+ * together in the next one.
+ */
+__static int
+mds_stream_updates(void)
+{
+	int siter, rc, gen, done, nsent = 0;
+	uint64_t batchno, cur_xid, xid, prevxid;
+	struct resprof_mds_info *rpmi;
+	struct slm_update_chunk *uc;
+	struct sl_mds_peerinfo *sp;
+	struct sl_resource *res;
+	struct sl_resm *resm;
+	struct sl_site *site;
+
+	spinlock(&mds_distill_lock);
+	cur_xid = nsupd_prg.cur_xid;
+	freelock(&mds_distill_lock);
+	if (!cur_xid)
+		return (0);
 
 	CONF_LOCK();
 	CONF_FOREACH_SITE(site)
@@ -1060,102 +1694,92 @@ mds_send_batch_update(uint64_t batchno)
 		resm = psc_dynarray_getpos(&res->res_members, 0);
 		if (resm == nodeResm)
 			continue;
-		npeers++;
-		sp = resm2rpmi(resm)->rpmi_info;
+		rpmi = res2rpmi(res);
+		sp = rpmi->rpmi_info;
+
+		RPMI_LOCK(rpmi);
+		if (sp->sp_xid > cur_xid)
+			sp->sp_synced = time(NULL);
 
 		/*
 		 * A simplistic backoff strategy to avoid CPU spinning.
 		 * A better way could be to let the ping thread handle
 		 * this.
 		 */
-		if (sp->sp_fails >= 3) {
-			if (sp->sp_skips == 0) {
+		if (sp->sp_fails >= 3 && sp->sp_inflight == 0) {
+			if (sp->sp_skips == 0)
 				sp->sp_skips = 3;
+			if (--sp->sp_skips) {
+				RPMI_ULOCK(rpmi);
 				continue;
 			}
-			sp->sp_skips--;
-			if (sp->sp_skips)
-				continue;
-		}
-		if (sp->sp_batchno < batchno)
-			continue;
-
-		/*
-		 * Note that the update xid we can see is not
-		 * necessarily contiguous.
-		 */
-		if (sp->sp_batchno > batchno ||
-		    sp->sp_xid > xid) {
-			didwork++;
-			continue;
 		}
+		RPMI_ULOCK(rpmi);
 
-		/* Find out which part of the buffer should be sent out */
-		i = count;
-		total = size;
-		u = nsupd_prg.log_buf;
-		do {
-			if (u->xid >= sp->sp_xid)
+		for (;;) {
+			RPMI_LOCK(rpmi);
+			if (sp->sp_send_prevxid == 0) {
+				if (sp->sp_inflight) {
+					RPMI_ULOCK(rpmi);
+					break;
+				}
+				sp->sp_send_seqno = sp->sp_xid;
+				sp->sp_send_batchno = sp->sp_batchno;
+			}
+			/*
+			 * Note that the update xid we can see is not
+			 * necessarily contiguous.
+			 */
+			if (sp->sp_inflight >= SLM_UPDATE_NINFLIGHT ||
+			    sp->sp_send_seqno > cur_xid) {
+				RPMI_ULOCK(rpmi);
 				break;
-			i--;
-			total -= UPDATE_ENTRY_LEN(u);
-			u = PSC_AGP(u, UPDATE_ENTRY_LEN(u));
-		} while (total);
-
-		psc_assert(total);
-
-		iov.iov_len = total;
-		iov.iov_base = u;
-
-		csvc = slm_getmcsvc_wait(resm);
-		if (csvc == NULL) {
-			sp->sp_fails++;
-			continue;
-		}
-		rc = SL_RSX_NEWREQ(csvc, SRMT_NAMESPACE_UPDATE, rq, mq,
-		    mp);
-		if (rc) {
-			sl_csvc_decref(csvc);
-			continue;
-		}
-		mq->count = i;
-		mq->size = iov.iov_len;
-		mq->siteid = nodeSite->site_id;
-
-		slrpc_bulkclient(rq, BULK_GET_SOURCE, SRMM_BULK_PORTAL,
-		    &iov, 1);
-
-		rc = SL_RSX_WAITREP(csvc, rq, mp);
-		if (rc == 0)
-			rc = mp->rc;
-		else
-			sp->sp_fails++;
+			}
+			batchno = sp->sp_send_batchno;
+			xid = sp->sp_send_seqno;
+			prevxid = sp->sp_send_prevxid;
+			gen = sp->sp_gen;
+			sp->sp_inflight++;
+			RPMI_ULOCK(rpmi);
 
-		pscrpc_req_finished(rq);
-		sl_csvc_decref(csvc);
+			uc = mds_update_chunk_get(batchno, xid, &done);
+			if (done) {
+				/* peer already has this whole batch */
+				RPMI_LOCK(rpmi);
+				sp->sp_inflight--;
+				if (gen == sp->sp_gen)
+					sp->sp_send_batchno = batchno + 1;
+				RPMI_ULOCK(rpmi);
+				continue;
+			}
+			rc = -EAGAIN;
+			if (uc)
+				rc = mds_send_update_chunk(resm, uc, xid,
+				    prevxid, gen);
+
+			RPMI_LOCK(rpmi);
+			if (rc) {
+				sp->sp_inflight--;
+				if (rc != -EAGAIN)
+					sp->sp_fails++;
+			} else if (gen == sp->sp_gen) {
+				sp->sp_send_seqno = uc->uc_xid + 1;
+				sp->sp_send_prevxid = uc->uc_xid;
+				if (UC_ENDS_BATCH(uc))
+					sp->sp_send_batchno = batchno + 1;
+			}
+			RPMI_ULOCK(rpmi);
 
-		if (rc == 0) {
-			record++;
-			didwork++;
-			sp->sp_fails = 0;
-			sp->sp_xid = xid + 1;
-			if (count == SLM_UPDATE_BATCH_NENTS)
-				sp->sp_batchno++;
+			if (uc)
+				mds_update_chunk_put(uc);
+			if (rc)
+				break;
+			nsent++;
 		}
 	}
 	CONF_ULOCK();
 
-	/*
-	 * Record the progress first before potentially removing an old
-	 * log file.
-	 */
-	if (record)
-		mds_record_update_prog();
-	if (didwork == npeers &&
-	    count == SLM_UPDATE_BATCH_NENTS &&
-	    batchno >= 1)
-		mds_remove_logfile(batchno - 1, 1, 0);
-	return (didwork);
+	return (nsent);
 }
 
 /*
@@ -1175,6 +1799,7 @@ mds_update_cursor(void *buf, uint64_t txg, int flag)
 		return;
 	}
 	psc_assert(start_txg == txg);
+	mds_cursor_txg = txg;
 
 	/*
 	 * During the replay, actually as soon as ZFS starts, its group
@@ -1206,6 +1831,9 @@ mds_update_cursor(void *buf, uint64_t txg, int flag)
 		cursor->pjc_distill_xid = nsupd_prg.sync_xid;
 	else
 		cursor->pjc_distill_xid = reclaim_prg.sync_xid;
+	if (slm_distill_decoded_xid &&
+	    cursor->pjc_distill_xid > mds_distill_commit_xid())
+		cursor->pjc_distill_xid = mds_distill_commit_xid();
 	freelock(&mds_distill_lock);
 
 	cursor->pjc_fid = slm_get_curr_slashfid();
@@ -1239,13 +1867,27 @@ slmjcursorthr_main(struct psc_thread *thr)
 			freelock(&slm_cursor_lock);
 		}
 
+		/*
+		 * Write back held odtable slots first so they commit no
+		 * later than the transaction group recorded below.
+		 */
+		slm_odt_barrier(1);
+
 		/* Use SLASH2_CURSOR_UPDATE to write cursor file */
 		rc = mdsio_write_cursor(current_vfsid, &mds_cursor,
 		    sizeof(mds_cursor), mds_cursor_handle,
 		    mds_update_cursor);
+		slm_odt_barrier(0);
 		if (rc)
 			psclog_warnx("failed to update cursor, rc=%d", rc);
-		else
+		else {
+			/*
+			 * FID leases are bounded by the cursor as it will
+			 * be found after a crash, so wait for this one to
+			 * reach the disk before letting them advance.
+			 */
+			zfsslash2_wait_synced(mds_cursor_txg);
+			slm_set_fidlease_base(mds_cursor.pjc_fid);
 			psclog_diag("cursor updated: txg=%"PRId64", xid=%"PRId64
 			    ", fid="SLPRI_FID", seqno=(%"PRIx64", %"PRIx64")",
 			    mds_cursor.pjc_commit_txg,
@@ -1253,6 +1895,7 @@ slmjcursorthr_main(struct psc_thread *thr)
 			    mds_cursor.pjc_fid,
 			    mds_cursor.pjc_seqno_lwm,
 			    mds_cursor.pjc_seqno_hwm);
+		}
 	}
 }
 
@@ -1313,7 +1956,13 @@ mds_open_cursor(void)
 	}
 #endif
 
-	slm_set_curr_slashfid(mds_cursor.pjc_fid);
+	/*
+	 * FIDs up to SLM_FIDLEASE_SLACK past the cursor may have been
+	 * leased to clients before we went down; never hand them out
+	 * again.
+	 */
+	slm_set_fidlease_base(mds_cursor.pjc_fid);
+	slm_set_curr_slashfid(mds_cursor.pjc_fid + SLM_FIDLEASE_SLACK);
 
 	psclog_info("SLFID prior to replay="SLPRI_FID,
 	    mds_cursor.pjc_fid);
@@ -1699,32 +2348,50 @@ slmjreclaimthr_main(struct psc_thread *thr)
 void
 slmjnsthr_main(struct psc_thread *thr)
 {
-	uint64_t batchno;
-	int didwork;
+	uint64_t lwm, rmbatchno;
+	int record;
 
 	/*
-	 * This thread scans the batches of updates between the low and
-	 * high water marks and sends them to peer MDSes.  Although
-	 * different MDSes have different paces, we send updates in
-	 * order within one MDS.
+	 * This thread streams updates to peer MDSes as the distill
+	 * process logs them.  Although different MDSes have different
+	 * paces, updates are applied in order within one MDS.  Log
+	 * files are removed once every peer has moved past them.
 	 */
+	rmbatchno = mds_update_lwm(1);
+	mds_remove_logfiles(rmbatchno, 1);
+	if (rmbatchno)
+		rmbatchno--;
+
 	while (pscthr_run(thr)) {
-		batchno = mds_update_lwm(1);
-		do {
-			spinlock(&mds_distill_lock);
-			if (!nsupd_prg.cur_xid ||
-			    mds_update_lwm(0) > nsupd_prg.cur_xid) {
-				freelock(&mds_distill_lock);
-				break;
-			}
-			freelock(&mds_distill_lock);
-			didwork = mds_send_batch_update(batchno);
-			batchno++;
-		} while (didwork && mds_update_hwm(1) >= batchno);
+		spinlock(&nsupd_prg.lock);
+		slm_update_kick = 0;
+		freelock(&nsupd_prg.lock);
+
+		mds_stream_updates();
+		mds_update_chunk_prune();
+
+		spinlock(&nsupd_prg.lock);
+		record = slm_update_record;
+		slm_update_record = 0;
+		freelock(&nsupd_prg.lock);
+
+		lwm = mds_update_lwm(1);
+		if (record || lwm > rmbatchno + 1) {
+			/*
+			 * Record the progress first before potentially
+			 * removing an old log file.
+			 */
+			mds_record_update_prog();
+			for (; rmbatchno + 1 < lwm; rmbatchno++)
+				mds_remove_logfile(rmbatchno, 1, 0);
+		}
 
 		spinlock(&nsupd_prg.lock);
-		psc_waitq_waitrel_s(&nsupd_prg.waitq, &nsupd_prg.lock,
-		    SL_UPDATE_MAX_AGE);
+		if (slm_update_kick)
+			freelock(&nsupd_prg.lock);
+		else
+			psc_waitq_waitrel_s(&nsupd_prg.waitq,
+			    &nsupd_prg.lock, SL_UPDATE_MAX_AGE);
 	}
 }
 
@@ -1959,6 +2626,20 @@ mds_journal_init(uint64_t fsuuid)
 	if (slm_journal == NULL)
 		psc_fatalx("failed to open log file %s",
 		    journalfn);
+	if (PJ_PJESZ(slm_journal) < SLJ_MDS_ENTSIZE ||
+	    PJ_PJESZ(slm_journal) > SLJ_MDS_MAXENTSIZE)
+		psc_fatalx("journal %s has unsupported entry size %d",
+		    journalfn, PJ_PJESZ(slm_journal));
+
+	INIT_SPINLOCK(&slm_nsbatch.nb_lock);
+	psc_waitq_init(&slm_nsbatch.nb_waitq);
+	psc_waitq_init(&slm_nsbatch.nb_thrwaitq);
+	psc_dynarray_init(&slm_nsbatch.nb_ready);
+	slm_nsbatch.nb_max = PJ_PJESZ(slm_journal) -
+	    offsetof(struct psc_journal_enthdr, pje_data) -
+	    sizeof(struct slmds_jent_nsbatch);
+	pscthr_init(SLMTHRT_JNSBATCH, slmjnsbatchthr_main, NULL, 0,
+	    "slmjnsbatchthr");
 
 #if 0
 	/*
@@ -2176,6 +2857,7 @@ mds_journal_init(uint64_t fsuuid)
 		if (sp->sp_batchno < batchno)
 			batchno = sp->sp_batchno;
 		sp->sp_batchmeter.pm_maxp = &nsupd_prg.cur_batchno;
+		sp->sp_synced = time(NULL);
 	}
 	nsupd_prg.prg_buf = psc_realloc(nsupd_prg.prg_buf,
 	    npeers * UP_ENTSZ, 0);
@@ -2226,6 +2908,7 @@ mds_journal_init(uint64_t fsuuid)
 		sp->sp_batchno = nsupd_prg.cur_batchno;
 		sp->sp_flags &= ~SPF_NEED_JRNL_INIT;
 		sp->sp_batchmeter.pm_maxp = &nsupd_prg.cur_batchno;
+		sp->sp_synced = time(NULL);
 	);
 
 	psclog_info("nsupd_prg.cur_batchno = %"PRId64", "
@@ -2235,6 +2918,9 @@ mds_journal_init(uint64_t fsuuid)
  replay_log:
 	slm_journal->pj_npeers = npeers;
 	slm_journal->pj_distill_xid = last_distill_xid;
+	slm_distill_decoded_xid = last_distill_xid;
+	slm_distill_reclaimq.dq_done_xid = last_distill_xid;
+	slm_distill_updateq.dq_done_xid = last_distill_xid;
 	slm_journal->pj_commit_txg = mds_cursor.pjc_commit_txg;
 	slm_journal->pj_replay_xid = mds_cursor.pjc_replay_xid;
 
@@ -2244,6 +2930,15 @@ mds_journal_init(uint64_t fsuuid)
 	psclog_info("Last replayed SLASH2 transaction ID is %"PRId64,
 	    slm_journal->pj_replay_xid);
 
+	lc_reginit(&slm_distill_reclaimq.dq_lc, struct slm_distill_item,
+	    di_lentry, "distillrclm");
+	lc_reginit(&slm_distill_updateq.dq_lc, struct slm_distill_item,
+	    di_lentry, "distillupd");
+	pscthr_init(SLMTHRT_JDISTILL, slmjdreclaimthr_main, NULL, 0,
+	    "slmjdreclaimthr");
+	pscthr_init(SLMTHRT_JDISTILL, slmjdupdatethr_main, NULL, 0,
+	    "slmjdupdatethr");
+
 	pjournal_replay(slm_journal, SLMTHRT_JRNL, "slmjthr",
 	    mds_replay_handler, mds_distill_handler);
 
@@ -2265,14 +2960,12 @@ mds_journal_init(uint64_t fsuuid)
 	if (!npeers)
 		return;
 
-#if 0
 	/*
 	 * Start a thread to propagate local namespace updates to peers
 	 * after our MDS peer list has been all setup.
 	 */
 	pscthr_init(SLMTHRT_JNAMESPACE, slmjnsthr_main, NULL, 0,
 	    "slmjnsthr");
-#endif
 }
 
 void
@@ -27,6 +27,7 @@
 #include <string.h>
 
 #include "pfl/alloc.h"
+#include "pfl/atomic.h"
 #include "pfl/cdefs.h"
 #include "pfl/ctlsvr.h"
 #include "pfl/lock.h"
@@ -34,15 +35,89 @@
 #include "pfl/log.h"
 #include "pfl/odtable.h"
 #include "pfl/str.h"
+#include "pfl/tree.h"
 #include "pfl/types.h"
+#include "pfl/vbitmap.h"
 
 #include "mdsio.h"
 #include "slashd.h"
 
 #include "zfs-fuse/zfs_slashlib.h"
 
+/*
+ * While the odtables are scanned at startup, slot reads are served
+ * from a window filled by one large sequential read instead of a small
+ * mdsio_preadv() per slot.
+ */
+#define SLM_ODT_RA_SIZE		(1024 * 1024)
+
+/*
+ * In normal operation, slot writes are held in a per-table dirty set
+ * and written back in elem order, with runs of adjacent slots packed
+ * into one mdsio_pwritev().  The set is written back when it fills,
+ * when the table is synced, when the journal lets go of a transaction
+ * group (mds_txg_handler()), and by the cursor thread before each
+ * cursor update so no slot write crosses the transaction group the
+ * journal considers committed.
+ */
+#define SLM_ODT_WC_MAX		128		/* dirty slots per table */
+
+#define SLM_ODT_MAX		2		/* bmap assignments, ptrunc */
+
+struct slm_odt_dirty {
+	size_t			 od_elem;
+	int			 od_flags;
+	struct pfl_odt_entftr	 od_ftr;
+	RB_ENTRY(slm_odt_dirty)	 od_tentry;
+	char			 od_obj[0];
+};
+
+/* od_flags */
+#define ODF_OBJ			(1 << 0)	/* od_obj is valid */
+#define ODF_FTR			(1 << 1)	/* od_ftr is valid */
+#define ODF_ALL			(ODF_OBJ | ODF_FTR)
+
+RB_HEAD(slm_odt_dirtytree, slm_odt_dirty);
+
+struct slm_odt_info {
+	struct pfl_odt		*oi_odt;
+	struct pfl_mutex	 oi_mutex;
+
+	/* startup readahead window */
+	char			*oi_rabuf;
+	off_t			 oi_raoff;
+	size_t			 oi_ralen;
+
+	/* write combining */
+	struct slm_odt_dirtytree oi_dirty;
+	int			 oi_ndirty;
+
+	/* free slots, most recently freed on top */
+	psc_spinlock_t		 oi_freelock;
+	size_t			*oi_free;
+	size_t			 oi_nfree;
+	size_t			 oi_maxfree;
+};
+
 void *slm_odt_zerobuf;
 
+int			 slm_odt_ra_active;
+int			 slm_odt_wcomb = 1;
+int			 slm_odt_wc_barrier;
+psc_atomic32_t		 slm_odt_ndirty;
+struct slm_odt_info	 slm_odt_info[SLM_ODT_MAX];
+
+int
+slm_odt_dirty_cmp(const void *x, const void *y)
+{
+	const struct slm_odt_dirty *a = x, *b = y;
+
+	return (CMP(a->od_elem, b->od_elem));
+}
+
+RB_GENERATE(slm_odt_dirtytree, slm_odt_dirty, od_tentry,
+    slm_odt_dirty_cmp)
+
 void
 _slm_odt_zerobuf_ensurelen(size_t len)
 {
@@ -60,6 +135,109 @@ _slm_odt_zerobuf_ensurelen(size_t len)
 	freelock(&zerobuf_lock);
 }
 
+struct slm_odt_info *
+slm_odt_getinfo(struct pfl_odt *t)
+{
+	int i;
+
+	for (i = 0; i < SLM_ODT_MAX; i++)
+		if (slm_odt_info[i].oi_odt == t)
+			return (&slm_odt_info[i]);
+	return (NULL);
+}
+
+void
+slm_odt_register(struct pfl_odt *t)
+{
+	struct slm_odt_info *oi;
+	int i;
+
+	if (slm_odt_getinfo(t))
+		return;
+	for (i = 0; i < SLM_ODT_MAX; i++) {
+		oi = &slm_odt_info[i];
+		if (oi->oi_odt == NULL) {
+			psc_mutex_init(&oi->oi_mutex);
+			RB_INIT(&oi->oi_dirty);
+			INIT_SPINLOCK(&oi->oi_freelock);
+			oi->oi_odt = t;
+			return;
+		}
+	}
+	psc_fatalx("too many odtables");
+}
+
+/*
+ * Try to satisfy a slot read from the startup readahead window,
+ * refilling the window from the slot onward if it is not covered.
+ * Returns nonzero if the read was satisfied.
+ */
+int
+slm_odt_ra_read_locked(struct slm_odt_info *oi, off_t off,
+    const struct iovec *iov, int nio, size_t len)
+{
+	struct pfl_odt *t = oi->oi_odt;
+	size_t nb;
+	char *p;
+	int i, rc;
+
+	if (!slm_odt_ra_active || len > SLM_ODT_RA_SIZE)
+		return (0);
+
+	if (oi->oi_rabuf == NULL)
+		oi->oi_rabuf = PSCALLOC(SLM_ODT_RA_SIZE);
+	if (off < oi->oi_raoff ||
+	    off + (off_t)len > oi->oi_raoff + (off_t)oi->oi_ralen) {
+		rc = mdsio_read(current_vfsid, &rootcreds, oi->oi_rabuf,
+		    SLM_ODT_RA_SIZE, &nb, off, t->odt_mfh);
+		if (rc || nb < len) {
+			oi->oi_ralen = 0;
+			return (0);
+		}
+		oi->oi_raoff = off;
+		oi->oi_ralen = nb;
+		OPSTAT_INCR("odtable-readahead");
+	}
+
+	p = oi->oi_rabuf + (off - oi->oi_raoff);
+	for (i = 0; i < nio; i++) {
+		/* never scribble over the shared padding buffer */
+		if (iov[i].iov_base != slm_odt_zerobuf)
+			memcpy(iov[i].iov_base, p, iov[i].iov_len);
+		p += iov[i].iov_len;
+	}
+	return (1);
+}
+
+/*
+ * Enable the readahead window around the sequential startup scan of
+ * the odtables.  It stays off otherwise, as journal replay and normal
+ * operation access slots at random.
+ */
+void
+slm_odt_readahead(int on)
+{
+	struct slm_odt_info *oi;
+	int i;
+
+	if (on) {
+		slm_odt_ra_active = 1;
+		return;
+	}
+
+	for (i = 0; i < SLM_ODT_MAX; i++) {
+		oi = &slm_odt_info[i];
+		if (oi->oi_odt == NULL)
+			continue;
+		psc_mutex_lock(&oi->oi_mutex);
+		slm_odt_ra_active = 0;
+		PSCFREE(oi->oi_rabuf);
+		oi->oi_ralen = 0;
+		psc_mutex_unlock(&oi->oi_mutex);
+	}
+	slm_odt_ra_active = 0;
+}
+
 #define PACK_IOV(p, len)						\
 	do {								\
 		iov[nio].iov_base = (void *)(p);			\
@@ -69,9 +247,10 @@ _slm_odt_zerobuf_ensurelen(size_t len)
 	} while (0)
 
 void
-slm_odt_write(struct pfl_odt *t, const void *p,
-    struct pfl_odt_entftr *f, size_t elem)
+slm_odt_pwrite(struct slm_odt_info *oi, const void *p,
+    const struct pfl_odt_entftr *f, size_t elem)
 {
+	struct pfl_odt *t = oi->oi_odt;
 	size_t nb, expect = 0;
 	struct pfl_odt_hdr *h;
 	struct iovec iov[3];
@@ -100,15 +279,251 @@ slm_odt_write(struct pfl_odt *t, const void *p,
 	if (f)
 		PACK_IOV(f, sizeof(*f));
 
+	/* drop any readahead window covering this slot */
+	if (off < oi->oi_raoff + (off_t)oi->oi_ralen &&
+	    off + (off_t)expect > oi->oi_raoff)
+		oi->oi_ralen = 0;
+
 	rc = mdsio_pwritev(current_vfsid, &rootcreds, iov, nio, &nb,
 	    off, t->odt_mfh, NULL, NULL);
 	psc_assert(!rc && nb == expect);
 }
 
+/*
+ * Write back all dirty slots of a table.  Whole slots are written in
+ * elem order, each run of adjacent slots with a single vectored write.
+ */
+void
+slm_odt_flush_locked(struct slm_odt_info *oi)
+{
+	struct slm_odt_dirty *od, *next, *done[SLM_ODT_WC_MAX];
+	struct iovec iov[3 * SLM_ODT_WC_MAX];
+	struct pfl_odt *t = oi->oi_odt;
+	size_t nb, expect = 0, last = 0;
+	int i, rc, nio = 0, ndone = 0;
+	struct pfl_odt_hdr *h;
+	ssize_t pad;
+	off_t off = 0;
+
+	if (oi->oi_ndirty == 0)
+		return;
+
+	h = t->odt_hdr;
+	pad = h->odth_slotsz - h->odth_objsz -
+	    sizeof(struct pfl_odt_entftr);
+	_slm_odt_zerobuf_ensurelen(pad);
+
+	for (od = RB_MIN(slm_odt_dirtytree, &oi->oi_dirty); od;
+	    od = next) {
+		next = RB_NEXT(slm_odt_dirtytree, &oi->oi_dirty, od);
+		RB_REMOVE(slm_odt_dirtytree, &oi->oi_dirty, od);
+		done[ndone++] = od;
+
+		if ((od->od_flags & ODF_ALL) != ODF_ALL) {
+			slm_odt_pwrite(oi,
+			    od->od_flags & ODF_OBJ ? od->od_obj : NULL,
+			    od->od_flags & ODF_FTR ? &od->od_ftr : NULL,
+			    od->od_elem);
+			continue;
+		}
+
+		if (nio && od->od_elem != last + 1) {
+			rc = mdsio_pwritev(current_vfsid, &rootcreds,
+			    iov, nio, &nb, off, t->odt_mfh, NULL, NULL);
+			psc_assert(!rc && nb == expect);
+			nio = 0;
+			expect = 0;
+		}
+		if (nio == 0)
+			off = h->odth_start + od->od_elem * h->odth_slotsz;
+		PACK_IOV(od->od_obj, h->odth_objsz);
+		PACK_IOV(slm_odt_zerobuf, pad);
+		PACK_IOV(&od->od_ftr, sizeof(od->od_ftr));
+		last = od->od_elem;
+	}
+	if (nio) {
+		rc = mdsio_pwritev(current_vfsid, &rootcreds, iov, nio,
+		    &nb, off, t->odt_mfh, NULL, NULL);
+		psc_assert(!rc && nb == expect);
+	}
+
+	OPSTAT_INCR("odtable-flush");
+	OPSTAT_ADD("odtable-flush-slots", ndone);
+
+	for (i = 0; i < ndone; i++)
+		PSCFREE(done[i]);
+	psc_atomic32_sub(&slm_odt_ndirty, oi->oi_ndirty);
+	oi->oi_ndirty = 0;
+	oi->oi_ralen = 0;
+}
+
+/*
+ * Write back the dirty slots of every table.
+ */
+void
+slm_odt_flushall(void)
+{
+	struct slm_odt_info *oi;
+	int i;
+
+	for (i = 0; i < SLM_ODT_MAX; i++) {
+		oi = &slm_odt_info[i];
+		if (oi->oi_odt == NULL)
+			continue;
+		psc_mutex_lock(&oi->oi_mutex);
+		slm_odt_flush_locked(oi);
+		psc_mutex_unlock(&oi->oi_mutex);
+	}
+}
+
+/*
+ * The cursor thread raises the barrier and flushes just before writing
+ * the cursor; until the barrier is lowered, slot writes go straight to
+ * ZFS so that every slot write issued so far lands in a transaction
+ * group no later than the cursor's.
+ */
+void
+slm_odt_barrier(int on)
+{
+	slm_odt_wc_barrier = on;
+	if (on)
+		slm_odt_flushall();
+}
+
+/*
+ * Collect the free slots of a table once its startup scan and journal
+ * replay are over, so slots can be handed out without searching the
+ * odtable bitmap.
+ */
+void
+slm_odt_initfree(struct pfl_odt *t)
+{
+	struct slm_odt_info *oi;
+	struct pfl_odt_hdr *h;
+	size_t elem, n, *stack;
+
+	h = t->odt_hdr;
+	oi = slm_odt_getinfo(t);
+	psc_assert(oi->oi_free == NULL);
+	stack = PSCALLOC(h->odth_nelems * sizeof(*stack));
+
+	n = 0;
+	spinlock(&oi->oi_freelock);
+	oi->oi_free = stack;
+	oi->oi_maxfree = h->odth_nelems;
+	spinlock(&t->odt_lock);
+	/* lowest slots on top to keep the table dense */
+	for (elem = h->odth_nelems; elem-- > 0; )
+		if (!psc_vbitmap_get(t->odt_bitmap, elem))
+			stack[n++] = elem;
+	freelock(&t->odt_lock);
+	oi->oi_nfree = n;
+	freelock(&oi->oi_freelock);
+}
+
+/*
+ * Allocate a slot.  Slots on the free stack are marked in the odtable
+ * bitmap here; one that pfl_odt_allocslot() has meanwhile handed out
+ * is skipped.  An empty stack falls back to pfl_odt_allocslot(), which
+ * also grows the table.
+ */
+size_t
+slm_odt_allocslot(struct pfl_odt *t)
+{
+	struct slm_odt_info *oi;
+	size_t elem;
+
+	oi = slm_odt_getinfo(t);
+	spinlock(&oi->oi_freelock);
+	while (oi->oi_nfree) {
+		elem = oi->oi_free[--oi->oi_nfree];
+		spinlock(&t->odt_lock);
+		if (!psc_vbitmap_get(t->odt_bitmap, elem)) {
+			psc_vbitmap_set(t->odt_bitmap, elem);
+			freelock(&t->odt_lock);
+			freelock(&oi->oi_freelock);
+			OPSTAT_INCR("odtable-alloc-free");
+			return (elem);
+		}
+		freelock(&t->odt_lock);
+	}
+	freelock(&oi->oi_freelock);
+
+	OPSTAT_INCR("odtable-alloc-scan");
+	return (pfl_odt_allocslot(t));
+}
+
+void
+slm_odt_freeitem(struct pfl_odt *t, struct pfl_odt_receipt *r)
+{
+	struct slm_odt_info *oi;
+	size_t elem;
+
+	elem = r->odtr_elem;
+	pfl_odt_freeitem(t, r);
+
+	/*
+	 * Slots beyond the stack (before slm_odt_initfree() or past
+	 * the table size it saw) are left for pfl_odt_allocslot().
+	 */
+	oi = slm_odt_getinfo(t);
+	spinlock(&oi->oi_freelock);
+	if (oi->oi_nfree < oi->oi_maxfree)
+		oi->oi_free[oi->oi_nfree++] = elem;
+	freelock(&oi->oi_freelock);
+}
+
+void
+slm_odt_write(struct pfl_odt *t, const void *p,
+    struct pfl_odt_entftr *f, size_t elem)
+{
+	struct slm_odt_dirty *od, q;
+	struct slm_odt_info *oi;
+	struct pfl_odt_hdr *h;
+
+	h = t->odt_hdr;
+	oi = slm_odt_getinfo(t);
+	psc_mutex_lock(&oi->oi_mutex);
+
+	q.od_elem = elem;
+	od = RB_FIND(slm_odt_dirtytree, &oi->oi_dirty, &q);
+	if (od == NULL && (!slm_odt_wcomb || slm_odt_wc_barrier ||
+	    slm_opstate != SLM_OPSTATE_NORMAL)) {
+		slm_odt_pwrite(oi, p, f, elem);
+		psc_mutex_unlock(&oi->oi_mutex);
+		return;
+	}
+
+	if (od == NULL) {
+		od = PSCALLOC(sizeof(*od) + h->odth_objsz);
+		od->od_elem = elem;
+		RB_INSERT(slm_odt_dirtytree, &oi->oi_dirty, od);
+		oi->oi_ndirty++;
+		psc_atomic32_inc(&slm_odt_ndirty);
+	} else
+		OPSTAT_INCR("odtable-write-combine");
+
+	if (p) {
+		memcpy(od->od_obj, p, h->odth_objsz);
+		od->od_flags |= ODF_OBJ;
+	}
+	if (f) {
+		od->od_ftr = *f;
+		od->od_flags |= ODF_FTR;
+	}
+
+	if (oi->oi_ndirty >= SLM_ODT_WC_MAX || slm_odt_wc_barrier ||
+	    !slm_odt_wcomb)
+		slm_odt_flush_locked(oi);
+	psc_mutex_unlock(&oi->oi_mutex);
+}
+
 void
 slm_odt_read(struct pfl_odt *t, const struct pfl_odt_receipt *r,
     void *p, struct pfl_odt_entftr *f)
 {
+	struct slm_odt_dirty *od, q;
+	struct slm_odt_info *oi;
 	size_t nb, expect = 0;
 	struct pfl_odt_hdr *h;
 	struct iovec iov[3];
@@ -119,6 +534,27 @@ slm_odt_read(struct pfl_odt *t, const struct pfl_odt_receipt *r,
 	memset(iov, 0, sizeof(iov));
 
 	h = t->odt_hdr;
+	oi = slm_odt_getinfo(t);
+	psc_mutex_lock(&oi->oi_mutex);
+
+	/* pick up any parts of the slot still held in the dirty set */
+	q.od_elem = r->odtr_elem;
+	od = RB_FIND(slm_odt_dirtytree, &oi->oi_dirty, &q);
+	if (od) {
+		if (p && od->od_flags & ODF_OBJ) {
+			memcpy(p, od->od_obj, h->odth_objsz);
+			p = NULL;
+		}
+		if (f && od->od_flags & ODF_FTR) {
+			*f = od->od_ftr;
+			f = NULL;
+		}
+		if (p == NULL && f == NULL) {
+			psc_mutex_unlock(&oi->oi_mutex);
+			return;
+		}
+	}
+
 	pad = h->odth_slotsz - h->odth_objsz - sizeof(*f);
 	_slm_odt_zerobuf_ensurelen(pad);
 
@@ -137,20 +573,40 @@ slm_odt_read(struct pfl_odt *t, const struct pfl_odt_receipt *r,
 	if (f)
 		PACK_IOV(f, sizeof(*f));
 
+	if (slm_odt_ra_read_locked(oi, off, iov, nio, expect)) {
+		psc_mutex_unlock(&oi->oi_mutex);
+		return;
+	}
+
 	rc = mdsio_preadv(current_vfsid, &rootcreds, iov, nio, &nb, off,
 	    t->odt_mfh);
+	psc_mutex_unlock(&oi->oi_mutex);
 	psc_assert(!rc && nb == expect);
 }
 
 void
 slm_odt_sync(struct pfl_odt *t, __unusedx size_t elem)
 {
+	struct slm_odt_info *oi;
+
+	oi = slm_odt_getinfo(t);
+	psc_mutex_lock(&oi->oi_mutex);
+	slm_odt_flush_locked(oi);
+	psc_mutex_unlock(&oi->oi_mutex);
+
 	mdsio_fsync(current_vfsid, &rootcreds, 0, t->odt_mfh);
 }
 
 void
 slm_odt_close(struct pfl_odt *t)
 {
+	struct slm_odt_info *oi;
+
+	oi = slm_odt_getinfo(t);
+	psc_mutex_lock(&oi->oi_mutex);
+	slm_odt_flush_locked(oi);
+	psc_mutex_unlock(&oi->oi_mutex);
+
 	mdsio_release(current_vfsid, &rootcreds, t->odt_mfh);
 }
 
@@ -192,6 +648,8 @@ slm_odt_open(struct pfl_odt *t, const char *fn, __unusedx int oflg)
 	rc = mdsio_read(current_vfsid, &rootcreds, h, sizeof(*h), &nb,
 	    0, t->odt_mfh);
 	psc_assert(rc == 0 && nb == sizeof(*h));
+
+	slm_odt_register(t);
 }
 
 void
@@ -215,6 +673,8 @@ slm_odt_create(struct pfl_odt *t, const char *fn, __unusedx int overwrite)
 	rc = mdsio_write(current_vfsid, &rootcreds, h, sizeof(*h), &nb,
 	    0, t->odt_mfh, NULL, NULL);
 	psc_assert(rc == 0 && nb == sizeof(*h));
+
+	slm_odt_register(t);
 }
 
 struct pfl_odt_ops slm_odtops = {
@@ -40,9 +40,11 @@
 #include "pfl/crc.h"
 #include "pfl/lock.h"
 #include "pfl/log.h"
+#include "pfl/opstats.h"
 #include "pfl/pool.h"
 #include "pfl/pthrutil.h"
 #include "pfl/str.h"
+#include "pfl/time.h"
 #include "pfl/tree.h"
 #include "pfl/treeutil.h"
 #include "pfl/waitq.h"
@@ -73,6 +75,12 @@ struct sl_mds_iosinfo	 slm_null_iosinfo = {
  */
 int slm_bwqueuesz = 8 * 32 * 1024;
 
+/*
+ * Set when replication was held back for lack of tokens so the upsch
+ * engine retries once they have had time to accrue.
+ */
+int slm_repl_tb_throttled;
+
 __static int
 iosidx_cmp(const void *a, const void *b)
 {
@@ -986,6 +994,213 @@ mds_repl_delrq(const struct sl_fidgen *fgp, sl_bmapno_t bmapno,
 	return (rc);
 }
 
+/*
+ * Replication rate limiting.  Each IOS has an ingress and an egress
+ * token bucket and each pair of sites one for the traffic between
+ * them.  Buckets fill with wall-clock time at the configured rate
+ * (repl_bw for an IOS, site_repl_bw for a site) up to SLM_REPL_TB_BURST
+ * seconds worth of tokens.  A transfer is admitted while every bucket
+ * on its path holds tokens and its estimated size is then charged,
+ * which may leave a bucket in debt for later refills to pay off: bmaps
+ * are large compared to the bucket depth of slow links.
+ */
+__static void
+slm_tokbkt_sample(struct slm_tokbkt *tb, const struct timespec *now)
+{
+	struct timespec d;
+	int64_t usecs, rate;
+
+	if (tb->tb_mark.tv_sec == 0) {
+		tb->tb_mark = *now;
+		return;
+	}
+	timespecsub(now, &tb->tb_mark, &d);
+	usecs = d.tv_sec * 1000000 + d.tv_nsec / 1000;
+	if (usecs < SLM_REPL_TB_SAMPLE_USECS)
+		return;
+	rate = tb->tb_done * 1000000 / usecs;
+	tb->tb_rate = (tb->tb_rate * 3 + rate) / 4;
+	tb->tb_done = 0;
+	tb->tb_mark = *now;
+}
+
+__static void
+slm_tokbkt_refill(struct slm_tokbkt *tb, int64_t limit,
+    const struct timespec *now)
+{
+	struct timespec d;
+	int64_t usecs;
+
+	slm_tokbkt_sample(tb, now);
+
+	if (limit != tb->tb_limit || tb->tb_refill.tv_sec == 0) {
+		tb->tb_limit = limit;
+		tb->tb_tokens = limit * SLM_REPL_TB_BURST;
+		tb->tb_refill = *now;
+		return;
+	}
+
+	timespecsub(now, &tb->tb_refill, &d);
+	usecs = d.tv_sec * 1000000 + d.tv_nsec / 1000;
+	usecs = MIN(usecs, SLM_REPL_TB_BURST * 1000000);
+	tb->tb_tokens = MIN(tb->tb_tokens + limit * usecs / 1000000,
+	    limit * SLM_REPL_TB_BURST);
+	tb->tb_refill = *now;
+}
+
+#define SLM_TOKBKT_AVAIL(tb)	((tb)->tb_limit == 0 || (tb)->tb_tokens > 0)
+
+__static int64_t
+slm_replink_limit(struct sl_site *src, struct sl_site *dst)
+{
+	if (src->site_repl_bw == 0)
+		return (dst->site_repl_bw);
+	if (dst->site_repl_bw == 0)
+		return (src->site_repl_bw);
+	return (MIN(src->site_repl_bw, dst->site_repl_bw));
+}
+
+/*
+ * Look up the inter-site link from @src to @dst.  The caller must hold
+ * the lock of @src.
+ */
+struct slm_replink *
+slm_replink_get(struct sl_site *src, struct sl_site *dst)
+{
+	struct site_mds_info *smi;
+	struct slm_replink *rl;
+	int i;
+
+	smi = site2smi(src);
+	LOCK_ENSURE(&smi->smi_lock);
+	DYNARRAY_FOREACH(rl, i, &smi->smi_links)
+		if (rl->srl_dst == dst)
+			return (rl);
+	rl = PSCALLOC(sizeof(*rl));
+	rl->srl_dst = dst;
+	psc_dynarray_add(&smi->smi_links, rl);
+	return (rl);
+}
+
+/*
+ * Charge the replication of @amt bytes from @src to @dst against the
+ * token buckets on its path.  The caller must hold both RPMI locks.
+ * Returns zero if some bucket is empty.
+ */
+__static int
+resmpair_tb_take(struct sl_resm *src, struct sl_resm *dst, int64_t amt)
+{
+	struct sl_site *ss = src->resm_res->res_site;
+	struct sl_site *ds = dst->resm_res->res_site;
+	struct slm_replink *rl = NULL;
+	struct rpmi_ios *is, *id;
+	struct timespec now;
+	int avail;
+
+	PFL_GETTIMESPEC(&now);
+
+	is = res2rpmi_ios(src->resm_res);
+	id = res2rpmi_ios(dst->resm_res);
+	slm_tokbkt_refill(&is->si_tb_egress, src->resm_res->res_repl_bw,
+	    &now);
+	slm_tokbkt_refill(&id->si_tb_ingress, dst->resm_res->res_repl_bw,
+	    &now);
+	avail = SLM_TOKBKT_AVAIL(&is->si_tb_egress) &&
+	    SLM_TOKBKT_AVAIL(&id->si_tb_ingress);
+
+	if (ss != ds) {
+		spinlock(&site2smi(ss)->smi_lock);
+		rl = slm_replink_get(ss, ds);
+		slm_tokbkt_refill(&rl->srl_tb, slm_replink_limit(ss, ds),
+		    &now);
+		if (avail)
+			avail = SLM_TOKBKT_AVAIL(&rl->srl_tb);
+		if (avail && rl->srl_tb.tb_limit)
+			rl->srl_tb.tb_tokens -= amt;
+		freelock(&site2smi(ss)->smi_lock);
+	}
+
+	if (!avail) {
+		slm_repl_tb_throttled = 1;
+		OPSTAT_INCR("repl-throttle");
+		return (0);
+	}
+
+	if (is->si_tb_egress.tb_limit)
+		is->si_tb_egress.tb_tokens -= amt;
+	if (id->si_tb_ingress.tb_limit)
+		id->si_tb_ingress.tb_tokens -= amt;
+	return (1);
+}
+
+/*
+ * Settle a replication admitted by resmpair_tb_take().  If the data
+ * was transferred, account it to the measured rates of the links;
+ * otherwise return the tokens it was charged.
+ */
+void
+resmpair_tb_release(struct sl_resm *src, struct sl_resm *dst,
+    int64_t amt, int xfer)
+{
+	struct resprof_mds_info *r_min, *r_max;
+	struct sl_site *ss = src->resm_res->res_site;
+	struct sl_site *ds = dst->resm_res->res_site;
+	struct slm_replink *rl;
+	struct rpmi_ios *is, *id;
+	struct timespec now;
+
+	PFL_GETTIMESPEC(&now);
+
+	r_min = MIN(res2rpmi(src->resm_res), res2rpmi(dst->resm_res));
+	r_max = MAX(res2rpmi(src->resm_res), res2rpmi(dst->resm_res));
+	RPMI_LOCK(r_min);
+	RPMI_LOCK(r_max);
+
+	is = res2rpmi_ios(src->resm_res);
+	id = res2rpmi_ios(dst->resm_res);
+	if (xfer) {
+		is->si_tb_egress.tb_done += amt;
+		id->si_tb_ingress.tb_done += amt;
+		slm_tokbkt_sample(&is->si_tb_egress, &now);
+		slm_tokbkt_sample(&id->si_tb_ingress, &now);
+	} else {
+		if (is->si_tb_egress.tb_limit)
+			is->si_tb_egress.tb_tokens += amt;
+		if (id->si_tb_ingress.tb_limit)
+			id->si_tb_ingress.tb_tokens += amt;
+	}
+
+	if (ss != ds) {
+		spinlock(&site2smi(ss)->smi_lock);
+		rl = slm_replink_get(ss, ds);
+		if (xfer) {
+			rl->srl_tb.tb_done += amt;
+			slm_tokbkt_sample(&rl->srl_tb, &now);
+		} else if (rl->srl_tb.tb_limit)
+			rl->srl_tb.tb_tokens += amt;
+		freelock(&site2smi(ss)->smi_lock);
+	}
+
+	RPMI_ULOCK(r_max);
+	RPMI_ULOCK(r_min);
+}
+
+/*
+ * Snapshot the state of a token bucket for reporting, rolling the
+ * measured rate forward so idle links decay toward zero.
+ */
+void
+slm_tokbkt_report(struct slm_tokbkt *tb, int64_t *rate, int64_t *limit,
+    int64_t *tokens)
+{
+	struct timespec now;
+
+	PFL_GETTIMESPEC(&now);
+	slm_tokbkt_sample(tb, &now);
+	*rate = tb->tb_rate;
+	*limit = tb->tb_limit;
+	*tokens = tb->tb_tokens;
+}
 
 #define HAS_BW(bwd, amt)						\
 	((bwd)->bwd_queued + (bwd)->bwd_inflight < slm_bwqueuesz)
@@ -1035,7 +1250,8 @@ resmpair_bw_adj(struct sl_resm *src, struct sl_resm *dst,
 	    (HAS_BW(&is->si_bw_egress, amt) &&
 	     HAS_BW(&is->si_bw_aggr, amt) &&
 	     HAS_BW(&id->si_bw_ingress, amt) &&
-	     HAS_BW(&id->si_bw_aggr, amt))) {
+	     HAS_BW(&id->si_bw_aggr, amt) &&
+	     resmpair_tb_take(src, dst, amt_bytes))) {
 		ADJ_BW(&is->si_bw_egress, amt);
 		ADJ_BW(&is->si_bw_aggr, amt);
 		ADJ_BW(&id->si_bw_ingress, amt);
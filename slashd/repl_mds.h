@@ -30,6 +30,10 @@
 #include "fidc_mds.h"
 
 struct resm_mds_info;
+struct sl_resource;
+struct sl_site;
+struct slm_replink;
+struct slm_tokbkt;
 
 struct slm_replst_workreq {
 	struct slrpc_cservice	*rsw_csvc;
@@ -51,6 +55,12 @@ int	_mds_repl_ios_lookup(int, struct slash_inode_handle *, sl_ios_id_t, int);
 int	_mds_repl_iosv_lookup(int, struct slash_inode_handle *, const sl_replica_t [], int [], int, int);
 
 int	 resmpair_bw_adj(struct sl_resm *, struct sl_resm *, int64_t, int *);
+void	 resmpair_tb_release(struct sl_resm *, struct sl_resm *, int64_t, int);
+void	 slm_tokbkt_report(struct slm_tokbkt *, int64_t *, int64_t *, int64_t *);
+struct slm_replink *
+	 slm_replink_get(struct sl_site *, struct sl_site *);
+
+int	 slm_repl_src_select(struct bmap *, int, struct sl_resource *, int, struct sl_resource **, int *);
 
 #define slm_repl_bmap_rel(b)		 slm_repl_bmap_rel_type((b), BMAP_OPCNT_LOOKUP)
 #define slm_repl_bmap_rel_type(b, type) _slm_repl_bmap_rel_type((b), (type))
@@ -60,6 +70,13 @@ void	_slm_repl_bmap_rel_type(struct bmap *, int);
 
 void	 mds_brepls_check(uint8_t *, int);
 
+#define SLM_REPL_TB_BURST		2		/* bucket depth, seconds */
+#define SLM_REPL_TB_SAMPLE_USECS	1000000		/* rate measurement interval */
+#define SLM_REPL_TB_RETRY_USECS		100000		/* upsch retry when throttled */
+
+#define SLM_REPLSRC_MINRATE		(1024 * 1024)	/* assumed for unmeasured sources */
+#define SLM_REPLSRC_REMOTE_PENALTY	2		/* score factor for other sites */
+
 /* replication state walking flags */
 #define REPL_WALKF_SCIRCUIT	(1 << 0)	/* short circuit on return value set */
 #define REPL_WALKF_MODOTH	(1 << 1)	/* modify everyone except specified IOS */
@@ -81,5 +98,6 @@ void	 mds_brepls_check(uint8_t *, int);
 
 extern struct psc_listcache	 slm_replst_workq;
 extern int			 slm_bwqueuesz;
+extern int			 slm_repl_tb_throttled;
 
 #endif /* _SL_MDS_REPL_H_ */
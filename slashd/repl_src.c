@@ -0,0 +1,175 @@
+/* $Id$ */
+/*
+ * %PSCGPL_START_COPYRIGHT%
+ * -----------------------------------------------------------------------------
+ * Copyright (c) 2015, Pittsburgh Supercomputing Center (PSC).
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License contained in the file
+ * `COPYING-GPL' at the top of this distribution or at
+ * https://www.gnu.org/licenses/gpl-2.0.html for more details.
+ *
+ * Pittsburgh Supercomputing Center	phone: 412.268.4960  fax: 412.268.5832
+ * 300 S. Craig Street			e-mail: remarks@psc.edu
+ * Pittsburgh, PA 15213			web: http://www.psc.edu/
+ * -----------------------------------------------------------------------------
+ * %PSC_END_COPYRIGHT%
+ */
+
+/*
+ * Replication source selection.  When several replicas of a bmap are
+ * valid, rank them by how soon each could be expected to deliver the
+ * bmap to the destination: the replication work already assigned to
+ * the source plus this bmap, divided by the rate recently achieved out
+ * of the source (or across the site link, if slower), with a penalty
+ * for crossing sites.  Since every scheduled transfer adds to the
+ * assigned work of its source, successive bmaps of a popular file are
+ * spread over all of its valid replicas.
+ */
+
+#include "subsys_mds.h"
+
+#include <sys/param.h>
+
+#include <stdlib.h>
+
+#include "pfl/lock.h"
+#include "pfl/log.h"
+#include "pfl/opstats.h"
+#include "pfl/random.h"
+
+#include "bmap_mds.h"
+#include "fidc_mds.h"
+#include "repl_mds.h"
+#include "slashd.h"
+#include "slconfig.h"
+
+struct slm_replsrc {
+	struct sl_resource	*rs_res;
+	int64_t			 rs_score;
+};
+
+__static int
+slm_replsrc_cmp(const void *a, const void *b)
+{
+	const struct slm_replsrc *x = a, *y = b;
+
+	return (CMP(x->rs_score, y->rs_score));
+}
+
+/*
+ * Estimate the time, in microseconds, to replicate @amt bytes from
+ * @src to @dst given the current load of @src.
+ */
+__static int64_t
+slm_repl_src_score(struct sl_resource *src, struct sl_resource *dst,
+    int64_t amt)
+{
+	struct resprof_mds_info *rpmi;
+	struct site_mds_info *smi;
+	struct slm_replink *rl;
+	struct sl_mds_iosinfo *si;
+	int64_t backlog, rate, score;
+
+	rpmi = res2rpmi(src);
+	si = res2iosinfo(src);
+	RPMI_LOCK(rpmi);
+	backlog = MAX(si->si_bw_egress.bwd_assigned,
+	    si->si_bw_egress.bwd_queued + si->si_bw_egress.bwd_inflight);
+	backlog *= BW_UNITSZ;
+	rate = si->si_tb_egress.tb_rate;
+	RPMI_ULOCK(rpmi);
+
+	if (src->res_site != dst->res_site) {
+		smi = site2smi(src->res_site);
+		spinlock(&smi->smi_lock);
+		rl = slm_replink_get(src->res_site, dst->res_site);
+		if (rl->srl_tb.tb_rate &&
+		    (rate == 0 || rl->srl_tb.tb_rate < rate))
+			rate = rl->srl_tb.tb_rate;
+		freelock(&smi->smi_lock);
+	}
+
+	rate = MAX(rate, SLM_REPLSRC_MINRATE);
+	score = (backlog + amt) * 1000000 / rate;
+	if (src->res_site != dst->res_site)
+		score *= SLM_REPLSRC_REMOTE_PENALTY;
+	return (score);
+}
+
+/*
+ * Collect the valid replicas of @b that may serve as a source for the
+ * replica at index @dst_idx, best candidate first.
+ * @pass: 0 for regular sources, 1 for archival or lease-disabled ones.
+ * @srcv: array of SL_MAX_REPLICAS entries to fill.
+ * @valid_exists: set if any valid replica other than the destination
+ *	exists.
+ */
+int
+slm_repl_src_select(struct bmap *b, int dst_idx,
+    struct sl_resource *dst_res, int pass, struct sl_resource **srcv,
+    int *valid_exists)
+{
+	struct slm_replsrc cand[SL_MAX_REPLICAS];
+	struct bmap_mds_info *bmi = bmap_2_bmi(b);
+	struct fidc_membh *f = b->bcm_fcmh;
+	struct rnd_iterator src_res_i;
+	struct sl_resource *src_res;
+	struct sl_mds_iosinfo *si;
+	int i, n = 0;
+	int64_t amt;
+
+	amt = slm_bmap_calc_repltraffic(b);
+
+	FOREACH_RND(&src_res_i, fcmh_2_nrepls(f)) {
+		if (src_res_i.ri_rnd_idx == dst_idx)
+			continue;
+
+		src_res = libsl_id2res(fcmh_getrepl(f,
+		    src_res_i.ri_rnd_idx).bs_id);
+
+		/* Skip ourself and old/inactive replicas. */
+		if (src_res == NULL ||
+		    SL_REPL_GET_BMAP_IOS_STAT(bmi->bmi_repls,
+		    SL_BITS_PER_REPLICA * src_res_i.ri_rnd_idx) !=
+		    BREPLST_VALID)
+			continue;
+
+		*valid_exists = 1;
+
+		si = res2iosinfo(src_res);
+		if (pass ^ (src_res->res_type == SLREST_ARCHIVAL_FS ||
+		    !!(si->si_flags & (SIF_DISABLE_LEASE |
+		    SIF_DISABLE_ADVLEASE))))
+			continue;
+
+		cand[n].rs_res = src_res;
+		cand[n].rs_score = slm_repl_src_score(src_res, dst_res,
+		    amt);
+		n++;
+	}
+
+	/*
+	 * The iteration order above is random so candidates with equal
+	 * scores, e.g. idle ones, are tried in random order.
+	 */
+	qsort(cand, n, sizeof(cand[0]), slm_replsrc_cmp);
+
+	for (i = 0; i < n; i++) {
+		srcv[i] = cand[i].rs_res;
+		psclog_debug("repl source candidate %s -> %s score=%"PRId64,
+		    cand[i].rs_res->res_name, dst_res->res_name,
+		    cand[i].rs_score);
+	}
+	if (n && srcv[0]->res_site == dst_res->res_site)
+		OPSTAT_INCR("repl-src-local");
+	else if (n)
+		OPSTAT_INCR("repl-src-remote");
+	return (n);
+}
@@ -38,6 +38,7 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include "pfl/completion.h"
 #include "pfl/ctlsvr.h"
 #include "pfl/export.h"
 #include "pfl/fs.h"
@@ -48,6 +49,7 @@
 #include "pfl/service.h"
 #include "pfl/str.h"
 #include "pfl/time.h"
+#include "pfl/workthr.h"
 
 #include "authbuf.h"
 #include "bmap_mds.h"
@@ -71,6 +73,7 @@
 int			use_global_mount;
 
 uint64_t		slm_next_fid = UINT64_MAX;
+uint64_t		slm_fidlease_base;	/* next FID as of last cursor write */
 psc_spinlock_t		slm_fid_lock = SPINLOCK_INIT;
 
 static void
@@ -159,6 +162,49 @@ slm_get_next_slashfid(slfid_t *fidp)
 	return (0);
 }
 
+/*
+ * Record the next FID as written to the cursor file.  FID leases may
+ * not reach more than SLM_FIDLEASE_SLACK past it.
+ */
+void
+slm_set_fidlease_base(slfid_t fid)
+{
+	spinlock(&slm_fid_lock);
+	slm_fidlease_base = fid;
+	freelock(&slm_fid_lock);
+}
+
+/*
+ * Allocate a range of FIDs for a client to assign to files it creates
+ * asynchronously.  Unlike FIDs handed out one at a time, nothing about
+ * a lease is journaled, so we only lease within SLM_FIDLEASE_SLACK of
+ * the FID recorded in the cursor and mds_open_cursor() skips that many
+ * at startup.
+ */
+int
+slm_get_next_slashfid_range(int n, slfid_t *fidp)
+{
+	spinlock(&slm_fid_lock);
+	if (FID_GET_INUM(slm_next_fid) + n > FID_MAX_INUM) {
+		psclog_warnx("max FID "SLPRI_FID" reached, manual "
+		    "intervention needed (bump the cycle bits)",
+		    slm_next_fid);
+		freelock(&slm_fid_lock);
+		return (ENOSPC);
+	}
+	if (slm_next_fid + n > slm_fidlease_base + SLM_FIDLEASE_SLACK) {
+		freelock(&slm_fid_lock);
+		return (EAGAIN);
+	}
+	*fidp = slm_next_fid;
+	slm_next_fid += n;
+	freelock(&slm_fid_lock);
+
+	psclog_diag("leased FIDs "SLPRI_FID"-"SLPRI_FID, *fidp,
+	    *fidp + n - 1);
+	return (0);
+}
+
 int
 slm_rmc_handle_ping(struct pscrpc_request *rq)
 {
@@ -169,44 +215,139 @@ slm_rmc_handle_ping(struct pscrpc_request *rq)
 	return (0);
 }
 
+/*
+ * Fetch the attributes of one file for GETATTR and GETATTR_BULK.
+ * @fg: file to stat.
+ * @attr: value-result attributes.
+ * @xattrsize: value-result size of extended attributes.
+ */
 int
-slm_rmc_handle_getattr(struct pscrpc_request *rq)
+slm_getattr(const struct sl_fidgen *fg, struct srt_stat *attr,
+    uint32_t *xattrsize)
 {
-	const struct srm_getattr_req *mq;
-	struct srm_getattr_rep *mp;
-	struct fidc_membh *f;
-	int vfsid;
-
-	SL_RSX_ALLOCREP(rq, mq, mp);
-
-	psclog_diag("pfid="SLPRI_FID, mq->fg.fg_fid);
+	struct fidc_membh *f = NULL;
+	int rc, vfsid;
 
-	if (mq->fg.fg_fid == SLFID_ROOT && use_global_mount) {
-		mp->attr.sst_fg.fg_fid = SLFID_ROOT;
-		mp->attr.sst_fg.fg_gen = FGEN_ANY-1;
-		slm_root_attributes(&mp->attr);
+	if (fg->fg_fid == SLFID_ROOT && use_global_mount) {
+		attr->sst_fg.fg_fid = SLFID_ROOT;
+		attr->sst_fg.fg_gen = FGEN_ANY-1;
+		slm_root_attributes(attr);
 		return (0);
 	}
 
-	mp->rc = -slm_fcmh_get(&mq->fg, &f);
-	if (mp->rc)
-		PFL_GOTOERR(out, mp->rc);
-	mp->rc = slfid_to_vfsid(mq->fg.fg_fid, &vfsid);
-	if (mp->rc)
-		PFL_GOTOERR(out, mp->rc);
+	rc = -slm_fcmh_get(fg, &f);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	rc = slfid_to_vfsid(fg->fg_fid, &vfsid);
+	if (rc)
+		PFL_GOTOERR(out, rc);
 
-	mp->xattrsize = mdsio_hasxattrs(vfsid, &rootcreds,
+	*xattrsize = mdsio_hasxattrs(vfsid, &rootcreds,
 	    fcmh_2_mfid(f));
 
 	FCMH_LOCK(f);
-	mp->attr = f->fcmh_sstb;
+	*attr = f->fcmh_sstb;
 
  out:
 	if (f)
 		fcmh_op_done(f);
+	return (rc);
+}
+
+int
+slm_rmc_handle_getattr(struct pscrpc_request *rq)
+{
+	const struct srm_getattr_req *mq;
+	struct srm_getattr_rep *mp;
+
+	SL_RSX_ALLOCREP(rq, mq, mp);
+
+	psclog_diag("pfid="SLPRI_FID, mq->fg.fg_fid);
+
+	mp->rc = slm_getattr(&mq->fg, &mp->attr, &mp->xattrsize);
+	return (0);
+}
+
+void
+slm_getattr_bulk_chunk(struct slm_getattr_bulk *gb, int off, int n)
+{
+	struct srt_getattr_ent *e;
+	int i, last;
+
+	for (i = off; i < off + n; i++) {
+		e = &gb->sgb_ents[i];
+		e->rc = slm_getattr(&gb->sgb_fgs[i], &e->attr,
+		    &e->xattrsize);
+	}
+
+	spinlock(&gb->sgb_lock);
+	last = --gb->sgb_nleft == 0;
+	freelock(&gb->sgb_lock);
+	if (last)
+		psc_compl_ready(&gb->sgb_compl, 1);
+}
+
+int
+slm_wk_getattr_bulk(void *p)
+{
+	struct slm_wkdata_getattr_bulk *wk = p;
+
+	slm_getattr_bulk_chunk(wk->gb, wk->off, wk->n);
 	return (0);
 }
 
+/*
+ * Handle a GETATTR_BULK request.  The FIDs are split into chunks and
+ * all but the first are handed to the worker threads so that lookups
+ * which must go to disk proceed in parallel.
+ */
+int
+slm_rmc_handle_getattr_bulk(struct pscrpc_request *rq)
+{
+	const struct srm_getattr_bulk_req *mq;
+	struct srm_getattr_bulk_rep *mp;
+	struct slm_wkdata_getattr_bulk *wk;
+	struct slm_getattr_bulk gb;
+	struct iovec iov;
+	int off;
+
+	SL_RSX_ALLOCREP(rq, mq, mp);
+	if (mq->nfids <= 0 || mq->nfids > SRM_GETATTR_BULK_MAX)
+		return (mp->rc = -EINVAL);
+
+	OPSTAT_INCR("getattr-bulk");
+	OPSTAT_ADD("getattr-bulk-fids", mq->nfids);
+
+	iov.iov_len = mq->nfids * sizeof(struct srt_getattr_ent);
+	iov.iov_base = PSCALLOC(iov.iov_len);
+
+	INIT_SPINLOCK(&gb.sgb_lock);
+	psc_compl_init(&gb.sgb_compl);
+	gb.sgb_fgs = mq->fgs;
+	gb.sgb_ents = iov.iov_base;
+	gb.sgb_nleft = howmany(mq->nfids, SLM_GETATTR_BULK_CHUNK);
+
+	for (off = SLM_GETATTR_BULK_CHUNK; off < mq->nfids;
+	    off += SLM_GETATTR_BULK_CHUNK) {
+		wk = pfl_workq_getitem(slm_wk_getattr_bulk,
+		    struct slm_wkdata_getattr_bulk);
+		wk->gb = &gb;
+		wk->off = off;
+		wk->n = MIN(SLM_GETATTR_BULK_CHUNK, mq->nfids - off);
+		pfl_workq_putitem(wk);
+	}
+	slm_getattr_bulk_chunk(&gb, 0,
+	    MIN(SLM_GETATTR_BULK_CHUNK, mq->nfids));
+
+	psc_compl_wait(&gb.sgb_compl);
+	psc_compl_destroy(&gb.sgb_compl);
+
+	mp->rc = slrpc_bulkserver(rq, BULK_PUT_SOURCE,
+	    SRMC_BULK_PORTAL, &iov, 1);
+	PSCFREE(iov.iov_base);
+	return (mp->rc);
+}
+
 /*
  * Handle a BMAPCHWRMODE request to upgrade a client bmap lease from
  * READ-only to READ+WRITE.
@@ -238,7 +379,8 @@ slm_rmc_handle_bmap_chwrmode(struct pscrpc_request *rq)
 	if (bml == NULL)
 		PFL_GOTOERR(out, mp->rc = -EINVAL);
 
-	mp->rc = mds_bmap_bml_chwrmode(bml, mq->prefios[0]);
+	mp->rc = mds_bmap_bml_chwrmode(bml, mq->prefios[0], mq->off,
+	    mq->len);
 	if (mp->rc == -PFLERR_ALREADY)
 		mp->rc = 0;
 	else if (mp->rc)
@@ -246,7 +388,11 @@ slm_rmc_handle_bmap_chwrmode(struct pscrpc_request *rq)
 
 	mp->sbd = mq->sbd;
 	mp->sbd.sbd_seq = bml->bml_seq;
+	mp->off = bml->bml_off;
+	mp->len = bml->bml_len;
 	mp->sbd.sbd_key = bmi->bmi_assign->odtr_crc;
+	if ((b->bcm_flags & BMAPF_DIO) || (bml->bml_flags & BML_DIO))
+		mp->sbd.sbd_flags |= SRM_LEASEBMAPF_DIO;
 
 	psc_assert(bmi->bmi_wr_ion);
 	mp->sbd.sbd_ios = rmmi2resm(bmi->bmi_wr_ion)->resm_res_id;
@@ -306,6 +452,7 @@ slm_pack_inode(struct fidc_membh *f, struct srt_inode *in)
 	int rc;
 
 	ih = fcmh_2_inoh(f);
+	in->flags = ih->inoh_ino.ino_flags;
 	in->newreplpol = ih->inoh_ino.ino_replpol;
 	in->nrepls = ih->inoh_ino.ino_nrepls;
 	memcpy(in->reptbl, &ih->inoh_ino.ino_repls,
@@ -361,7 +508,8 @@ slm_rmc_handle_getbmap(struct pscrpc_request *rq)
 	mp->flags = mq->flags;
 
 	mp->rc = mds_bmap_load_cli(f, mq->bmapno, mq->flags, mq->rw,
-	    mq->prefios[0], &mp->sbd, rq->rq_export, mp->repls, 0);
+	    mq->off, mq->len, mq->prefios[0], &mp->sbd, rq->rq_export,
+	    mp->repls, 0);
 	if (mp->rc)
 		PFL_GOTOERR(out, mp->rc);
 
@@ -373,6 +521,133 @@ slm_rmc_handle_getbmap(struct pscrpc_request *rq)
 	return (rc ? rc : mp->rc);
 }
 
+/*
+ * Handle INLINE_IO from CLI: access the data of a small file which is
+ * held in its metafile instead of in bmaps (INOF_INLINE).
+ *
+ * Conversion to a regular file takes two requests.  A READ with PROMOTE
+ * hands the contents to the client and marks the conversion underway,
+ * which makes bmap 0 available to write while the data stays here.  A
+ * WRITE with COMMIT, sent once the client has written the contents to
+ * bmap 0 on an IOS, drops the inline copy.  In between, inline writes
+ * and truncates are refused with SLERR_INLINE_FULL, which sends their
+ * clients down the same conversion path.
+ */
+int
+slm_rmc_handle_inline_io(struct pscrpc_request *rq)
+{
+	struct srm_inline_io_req *mq;
+	struct srm_inline_io_rep *mp;
+	struct fidc_membh *f = NULL;
+	char buf[SRM_INLINE_MAX];
+	uint32_t off, len;
+	struct srt_stat sstb;
+	struct iovec iov;
+	int to_set, vfsid;
+	uint64_t fsz;
+
+	SL_RSX_ALLOCREP(rq, mq, mp);
+	mp->rc = slfid_to_vfsid(mq->fg.fg_fid, &vfsid);
+	if (mp->rc)
+		PFL_GOTOERR(out, mp->rc);
+	if (mq->size > SRM_INLINE_MAX)
+		PFL_GOTOERR(out, mp->rc = -EINVAL);
+
+	mp->rc = -slm_fcmh_get(&mq->fg, &f);
+	if (mp->rc)
+		PFL_GOTOERR(out, mp->rc);
+
+	FCMH_WAIT_BUSY(f);
+	fsz = fcmh_2_fsz(f);
+	FCMH_ULOCK(f);
+
+	if ((fcmh_2_ino(f)->ino_flags & INOF_INLINE) == 0)
+		PFL_GOTOERR(out, mp->rc = -SLERR_NOTINLINE);
+
+	off = mq->offset;
+	switch (mq->op) {
+	case SRMIOP_RD:
+		OPSTAT_INCR("inline-read");
+		if (mq->flags & SRM_INLINEF_PROMOTE) {
+			mp->rc = -mds_inline_promote_start(vfsid, f);
+			if (mp->rc)
+				break;
+			off = 0;
+			len = MIN(fsz, SRM_INLINE_MAX);
+		} else if (off >= fsz)
+			len = 0;
+		else
+			len = MIN(mq->size, fsz - off);
+
+		mp->rc = -mds_inline_read(vfsid, f, buf, off, len);
+		if (mp->rc)
+			break;
+		mp->size = len;
+		if (len) {
+			iov.iov_base = buf;
+			iov.iov_len = len;
+			mp->rc = slrpc_bulkserver(rq, BULK_PUT_SOURCE,
+			    SRMC_BULK_PORTAL, &iov, 1);
+		} else
+			pscrpc_msg_add_flags(rq->rq_repmsg,
+			    MSG_ABORT_BULK);
+		break;
+	case SRMIOP_WR:
+		if (mq->flags & SRM_INLINEF_COMMIT) {
+			/*
+			 * Without the mark, bmap 0 as written by the
+			 * client is not known here (e.g. we restarted),
+			 * so it must start over.
+			 */
+			if ((f->fcmh_flags & FCMH_MDS_INLPROMOTE) == 0)
+				PFL_GOTOERR(out, mp->rc = -EAGAIN);
+			mp->rc = -mds_inline_promote(vfsid, f);
+			break;
+		}
+		OPSTAT_INCR("inline-write");
+		if ((uint64_t)off + mq->size > SLM_INLINE_LIMIT ||
+		    (f->fcmh_flags & FCMH_MDS_INLPROMOTE))
+			PFL_GOTOERR(out, mp->rc = -SLERR_INLINE_FULL);
+
+		iov.iov_base = buf;
+		iov.iov_len = mq->size;
+		mp->rc = slrpc_bulkserver(rq, BULK_GET_SINK,
+		    SRMC_BULK_PORTAL, &iov, 1);
+		if (mp->rc)
+			break;
+		mp->rc = -mds_inline_write(vfsid, f, buf, off, mq->size);
+		if (mp->rc)
+			break;
+		mp->size = mq->size;
+
+		memset(&sstb, 0, sizeof(sstb));
+		to_set = PSCFS_SETATTRF_MTIME;
+		PFL_GETPTIMESPEC(&sstb.sst_mtim);
+		if (off + mq->size > fsz) {
+			to_set |= PSCFS_SETATTRF_DATASIZE;
+			sstb.sst_size = off + mq->size;
+		}
+		FCMH_LOCK(f);
+		mp->rc = -mds_fcmh_setattr(vfsid, f, to_set, &sstb);
+		break;
+	default:
+		mp->rc = -EINVAL;
+		break;
+	}
+
+ out:
+	if (f) {
+		(void)FCMH_RLOCK(f);
+		if (mp->rc == 0)
+			mp->attr = f->fcmh_sstb;
+		FCMH_UNBUSY(f);
+		fcmh_op_done(f);
+	}
+	if (mp->rc)
+		pscrpc_msg_add_flags(rq->rq_repmsg, MSG_ABORT_BULK);
+	return (0);
+}
+
 int
 slm_rmc_handle_link(struct pscrpc_request *rq)
 {
@@ -410,67 +685,71 @@ slm_rmc_handle_link(struct pscrpc_request *rq)
 	return (0);
 }
 
+/*
+ * Resolve a name in a directory for LOOKUP and COMPOUND.
+ * @pfg: parent directory.
+ * @name: NUL-terminated component name.
+ * @attr: value-result attributes of the child.
+ * @xattrsize: value-result size of the child's extended attributes.
+ */
 int
-slm_rmc_handle_lookup(struct pscrpc_request *rq)
+slm_lookup(const struct sl_fidgen *pfg, const char *name,
+    struct srt_stat *attr, uint32_t *xattrsize)
 {
 	struct fidc_membh *p = NULL;
-	struct srm_lookup_req *mq;
-	struct srm_lookup_rep *mp;
-	int vfsid;
+	int rc, vfsid;
 
-	SL_RSX_ALLOCREP(rq, mq, mp);
-	mp->rc = slfid_to_vfsid(mq->pfg.fg_fid, &vfsid);
-	if (mp->rc)
-		PFL_GOTOERR(out, mp->rc);
-	mp->rc = -slm_fcmh_get(&mq->pfg, &p);
-	if (mp->rc)
-		PFL_GOTOERR(out, mp->rc);
+	rc = slfid_to_vfsid(pfg->fg_fid, &vfsid);
+	if (rc)
+		PFL_GOTOERR(out, rc);
+	rc = -slm_fcmh_get(pfg, &p);
+	if (rc)
+		PFL_GOTOERR(out, rc);
 
-	mq->name[sizeof(mq->name) - 1] = '\0';
 	psclog_diag("lookup: pfid="SLPRI_FID" name=%s", fcmh_2_mfid(p),
-	    mq->name);
+	    name);
 
 	if (fcmh_2_mfid(p) == SLFID_ROOT &&
-	    strcmp(mq->name, SL_RPATH_META_DIR) == 0)
-		PFL_GOTOERR(out, mp->rc = -EINVAL);
+	    strcmp(name, SL_RPATH_META_DIR) == 0)
+		PFL_GOTOERR(out, rc = -EINVAL);
 
-	if (mq->pfg.fg_fid == SLFID_ROOT && use_global_mount) {
+	if (pfg->fg_fid == SLFID_ROOT && use_global_mount) {
 		uint64_t fid;
 		struct sl_site *site;
 
-		mp->rc = -ENOENT;
+		rc = -ENOENT;
 		CONF_LOCK();
 		CONF_FOREACH_SITE(site) {
-			if (strcmp(mq->name, site->site_name) != 0)
+			if (strcmp(name, site->site_name) != 0)
 				continue;
 
 			fid = SLFID_ROOT;
 			FID_SET_SITEID(fid, site->site_id);
 
-			mp->xattrsize = 0;
-			mp->attr.sst_fg.fg_fid = fid;
-			mp->attr.sst_fg.fg_gen = 2;
-			slm_root_attributes(&mp->attr);
-			mp->rc = 0;
+			*xattrsize = 0;
+			attr->sst_fg.fg_fid = fid;
+			attr->sst_fg.fg_gen = 2;
+			slm_root_attributes(attr);
+			rc = 0;
 			break;
 		}
 		CONF_ULOCK();
 		goto out;
 	}
 
-	mp->rc = mdsio_lookupx(vfsid, fcmh_2_mfid(p), mq->name, NULL,
-	    &rootcreds, &mp->attr, &mp->xattrsize);
-	if (mp->rc)
-		PFL_GOTOERR(out, mp->rc);
+	rc = mdsio_lookupx(vfsid, fcmh_2_mfid(p), name, NULL,
+	    &rootcreds, attr, xattrsize);
+	if (rc)
+		PFL_GOTOERR(out, rc);
 
-	if (mq->pfg.fg_fid == SLFID_ROOT) {
+	if (pfg->fg_fid == SLFID_ROOT) {
 		mount_info_t *mountinfo;
 		struct srt_stat tmpattr;
 		struct mio_rootnames *rn;
 		uint64_t fid;
 		int error;
 
-		rn = slm_rmc_search_roots(mq->name);
+		rn = slm_rmc_search_roots(name);
 		if (rn) {
 			mountinfo = &zfs_mounts[rn->rn_vfsid];
 			fid = SLFID_ROOT;
@@ -482,16 +761,139 @@ slm_rmc_handle_lookup(struct pscrpc_request *rq)
 			    &tmpattr);
 			if (!error) {
 				tmpattr.sst_fg.fg_fid = fid;
-				mp->attr = tmpattr;
+				*attr = tmpattr;
 			} else
 				/* better than nothing */
-				mp->attr.sst_fg.fg_fid = fid;
+				attr->sst_fg.fg_fid = fid;
 		}
 	}
 
  out:
 	if (p)
 		fcmh_op_done(p);
+	return (rc);
+}
+
+int
+slm_rmc_handle_lookup(struct pscrpc_request *rq)
+{
+	struct srm_lookup_req *mq;
+	struct srm_lookup_rep *mp;
+
+	SL_RSX_ALLOCREP(rq, mq, mp);
+	mq->name[sizeof(mq->name) - 1] = '\0';
+	mp->rc = slm_lookup(&mq->pfg, mq->name, &mp->attr,
+	    &mp->xattrsize);
+	return (0);
+}
+
+/*
+ * Handle a COMPOUND request, which saves a client the separate LOOKUP,
+ * GET_INODE and GETBMAP round trips of a cold open.  The results of
+ * operations reported in mp->ops are valid even if a later one failed.
+ */
+int
+slm_rmc_handle_compound(struct pscrpc_request *rq)
+{
+	struct fidc_membh *f = NULL;
+	struct srm_compound_req *mq;
+	struct srm_compound_rep *mp;
+	char buf[SRM_INLINE_MAX];
+	struct sl_fidgen fg;
+	struct iovec iov;
+	uint64_t fsz;
+	int vfsid;
+
+	SL_RSX_ALLOCREP(rq, mq, mp);
+	OPSTAT_INCR("compound");
+
+	fg = mq->fg;
+	if (mq->ops & SRM_COMPOUNDF_LOOKUP) {
+		mq->name[sizeof(mq->name) - 1] = '\0';
+		mp->rc = slm_lookup(&mq->fg, mq->name, &mp->attr,
+		    &mp->xattrsize);
+		if (mp->rc)
+			goto out;
+		mp->ops |= SRM_COMPOUNDF_LOOKUP;
+
+		/*
+		 * Only regular files served by this MDS have anything
+		 * further to offer.
+		 */
+		if (!S_ISREG(mp->attr.sst_mode) ||
+		    IS_REMOTE_FID(mp->attr.sst_fid))
+			goto out;
+		fg = mp->attr.sst_fg;
+	}
+
+	if (mq->ops & SRM_COMPOUNDF_GETATTR) {
+		mp->rc = slm_getattr(&fg, &mp->attr, &mp->xattrsize);
+		if (mp->rc)
+			goto out;
+		mp->ops |= SRM_COMPOUNDF_GETATTR;
+	}
+
+	if ((mq->ops & (SRM_COMPOUNDF_GETINODE |
+	    SRM_COMPOUNDF_LEASEBMAP | SRM_COMPOUNDF_INLINE)) == 0)
+		goto out;
+
+	mp->rc = -slm_fcmh_get(&fg, &f);
+	if (mp->rc)
+		goto out;
+	if (!fcmh_isreg(f))
+		goto out;
+
+	if (mq->ops & SRM_COMPOUNDF_GETINODE) {
+		slm_pack_inode(f, &mp->ino);
+		mp->ops |= SRM_COMPOUNDF_GETINODE;
+	}
+
+	/*
+	 * Data held by the MDS goes back with the reply; there are no
+	 * bmaps to lease.
+	 */
+	if (fcmh_2_ino(f)->ino_flags & INOF_INLINE) {
+		if ((mq->ops & SRM_COMPOUNDF_INLINE) == 0)
+			goto out;
+		mp->rc = slfid_to_vfsid(fcmh_2_fid(f), &vfsid);
+		if (mp->rc)
+			goto out;
+		FCMH_WAIT_BUSY(f);
+		fsz = MIN(fcmh_2_fsz(f), SRM_INLINE_MAX);
+		FCMH_ULOCK(f);
+		mp->rc = -mds_inline_read(vfsid, f, buf, 0, fsz);
+		if (mp->rc == 0 && fsz) {
+			iov.iov_base = buf;
+			iov.iov_len = fsz;
+			mp->rc = slrpc_bulkserver(rq, BULK_PUT_SOURCE,
+			    SRMC_BULK_PORTAL, &iov, 1);
+		}
+		FCMH_UNBUSY(f);
+		if (mp->rc == 0) {
+			OPSTAT_INCR("inline-read");
+			mp->inlsize = fsz;
+			mp->ops |= SRM_COMPOUNDF_INLINE;
+		}
+		goto out;
+	}
+
+	/* there is nothing to read past EOF */
+	if ((mq->ops & SRM_COMPOUNDF_LEASEBMAP) &&
+	    fcmh_2_fsz(f) > (uint64_t)mq->bmapno * SLASH_BMAP_SIZE) {
+		OPSTAT_INCR("get_bmap_lease_read");
+		mp->rc = mds_bmap_load_cli(f, mq->bmapno, 0, SL_READ,
+		    0, 0, mq->prefios[0], &mp->sbd, rq->rq_export,
+		    mp->repls, 0);
+		if (mp->rc == 0)
+			mp->ops |= SRM_COMPOUNDF_LEASEBMAP;
+	}
+
+ out:
+	if (f)
+		fcmh_op_done(f);
+	if ((mq->ops & SRM_COMPOUNDF_INLINE) &&
+	    ((mp->ops & SRM_COMPOUNDF_INLINE) == 0 || mp->inlsize == 0))
+		pscrpc_msg_add_flags(rq->rq_repmsg, MSG_ABORT_BULK);
 	return (0);
 }
 
@@ -695,10 +1097,20 @@ slm_rmc_handle_create(struct pscrpc_request *rq)
 
 	slm_fcmh_endow_nolog(vfsid, p, c);
 
+	/*
+	 * Small files start out with their data held right here; a
+	 * bmap lease will be needed only once they outgrow that.
+	 */
+	if (slm_inline_max && mds_inline_init(vfsid, c) == 0) {
+		mp->flags = SRM_LEASEBMAPF_INLINE;
+		fcmh_op_done(c);
+		goto out;
+	}
+
 	/* obtain lease for first bmap as optimization */
 	mp->flags = mq->flags;
 
-	mp->rc2 = mds_bmap_load_cli(c, 0, mp->flags, SL_WRITE,
+	mp->rc2 = mds_bmap_load_cli(c, 0, mp->flags, SL_WRITE, 0, 0,
 	    mq->prefios[0], &mp->sbd, rq->rq_export, NULL, 1);
 
 	fcmh_op_done(c);
@@ -712,6 +1124,184 @@ slm_rmc_handle_create(struct pscrpc_request *rq)
 	return (0);
 }
 
+/*
+ * Handle a FIDLEASE from CLI: hand out a range of FIDs for the client
+ * to assign to files it creates asynchronously.
+ */
+int
+slm_rmc_handle_fidlease(struct pscrpc_request *rq)
+{
+	const struct srm_fidlease_req *mq;
+	struct srm_fidlease_rep *mp;
+	struct slm_exp_cli *mexpc;
+	struct slm_fidlease *fl;
+	int i, n;
+
+	SL_RSX_ALLOCREP(rq, mq, mp);
+	if (mq->nfids <= 0)
+		return (mp->rc = -EINVAL);
+
+	mexpc = sl_exp_getpri_cli(rq->rq_export, 1);
+	if (mexpc == NULL)
+		return (mp->rc = -ENOMEM);
+
+	n = MIN(mq->nfids, SRM_FIDLEASE_MAX);
+	mp->rc = -slm_get_next_slashfid_range(n, &mp->fid);
+	if (mp->rc) {
+		OPSTAT_INCR("fid-lease-err");
+		return (0);
+	}
+	mp->nfids = n;
+
+	/*
+	 * Remember the range so CREATE_BULK only accepts FIDs leased to
+	 * this client, each once.  A client only draws from its newest
+	 * range, so if no slot is free the oldest is forgotten.
+	 */
+	spinlock(&mexpc->mexpc_lock);
+	for (i = 0; i < SLM_FIDLEASE_NRANGES; i++)
+		if (mexpc->mexpc_fidleases[i].mfl_nfids == 0)
+			break;
+	if (i == SLM_FIDLEASE_NRANGES) {
+		OPSTAT_INCR("fid-lease-evict");
+		i = mexpc->mexpc_fidlease_next;
+		mexpc->mexpc_fidlease_next = (i + 1) %
+		    SLM_FIDLEASE_NRANGES;
+	}
+	fl = &mexpc->mexpc_fidleases[i];
+	memset(fl, 0, sizeof(*fl));
+	fl->mfl_fid = mp->fid;
+	fl->mfl_nfids = n;
+	freelock(&mexpc->mexpc_lock);
+
+	OPSTAT_INCR("fid-lease");
+	return (0);
+}
+
+/*
+ * Check that @fid lies in a range leased to the client and has not been
+ * used yet, and mark it used.  A fully used range frees its slot.
+ */
+int
+slm_fidlease_consume(struct slm_exp_cli *mexpc, slfid_t fid)
+{
+	struct slm_fidlease *fl;
+	uint64_t bit, n;
+	int i, rc = -ESTALE;
+
+	spinlock(&mexpc->mexpc_lock);
+	for (i = 0; i < SLM_FIDLEASE_NRANGES; i++) {
+		fl = &mexpc->mexpc_fidleases[i];
+		if (fl->mfl_nfids == 0 || fid < fl->mfl_fid ||
+		    fid >= fl->mfl_fid + fl->mfl_nfids)
+			continue;
+		n = fid - fl->mfl_fid;
+		bit = UINT64_C(1) << (n % 64);
+		if (fl->mfl_used[n / 64] & bit)
+			break;
+		fl->mfl_used[n / 64] |= bit;
+		if (++fl->mfl_nused == fl->mfl_nfids)
+			fl->mfl_nfids = 0;
+		rc = 0;
+		break;
+	}
+	freelock(&mexpc->mexpc_lock);
+	return (rc);
+}
+
+/*
+ * Handle a CREATE_BULK from CLI: create a batch of files the client has
+ * already replied to its callers for, each under a FID we leased to it.
+ * Journal space for the whole batch is reserved up front.  An entry
+ * whose FID was not leased to this client, or was already used, fails
+ * with ESTALE.
+ */
+int
+slm_rmc_handle_create_bulk(struct pscrpc_request *rq)
+{
+	const struct srm_create_bulk_req *mq;
+	struct srm_create_bulk_rep *mp;
+	struct fidc_membh *p, *c;
+	struct srt_create_ent *e;
+	struct slm_exp_cli *mexpc;
+	struct slash_creds cr;
+	struct srt_stat sstb;
+	struct iovec iov;
+	int i, rc, vfsid;
+	void *mfh;
+
+	SL_RSX_ALLOCREP(rq, mq, mp);
+	if (mq->nents <= 0 || mq->nents > SRM_CREATE_BULK_MAX)
+		return (mp->rc = -EINVAL);
+
+	mexpc = sl_exp_getpri_cli(rq->rq_export, 1);
+	if (mexpc == NULL)
+		return (mp->rc = -ENOMEM);
+
+	iov.iov_len = mq->nents * sizeof(*e);
+	iov.iov_base = PSCALLOC(iov.iov_len);
+	mp->rc = slrpc_bulkserver(rq, BULK_GET_SINK, SRMC_BULK_PORTAL,
+	    &iov, 1);
+	if (mp->rc)
+		PFL_GOTOERR(out, mp->rc);
+
+	OPSTAT_INCR("create-bulk");
+	OPSTAT_ADD("create-bulk-ents", mq->nents);
+
+	mds_reserve_slot(mq->nents);
+	for (i = 0, e = iov.iov_base; i < mq->nents; i++, e++) {
+		p = NULL;
+		e->name[sizeof(e->name) - 1] = '\0';
+
+		rc = slfid_to_vfsid(e->pfg.fg_fid, &vfsid);
+		if (rc)
+			PFL_GOTOERR(next, rc);
+		if (IS_REMOTE_FID(e->pfg.fg_fid) ||
+		    (e->pfg.fg_fid == SLFID_ROOT && use_global_mount))
+			PFL_GOTOERR(next, rc = -EINVAL);
+
+		rc = slm_fidlease_consume(mexpc, e->fid);
+		if (rc)
+			PFL_GOTOERR(next, rc);
+
+		rc = -slm_fcmh_get(&e->pfg, &p);
+		if (rc)
+			PFL_GOTOERR(next, rc);
+
+		cr.scr_uid = e->owner.scr_uid;
+		cr.scr_gid = e->owner.scr_gid;
+
+		sstb.sst_ctim = e->time;
+		rc = mdsio_opencreate(vfsid, fcmh_2_mfid(p), &cr,
+		    O_CREAT | O_EXCL | O_RDWR, e->mode, e->name, NULL,
+		    &sstb, &mfh, mdslog_namespace, NULL, e->fid);
+		if (rc)
+			PFL_GOTOERR(next, rc);
+
+		mdsio_fcmh_refreshattr(p, NULL);
+		mdsio_release(vfsid, &rootcreds, mfh);
+
+		rc = -slm_fcmh_get(&sstb.sst_fg, &c);
+		if (rc)
+			PFL_GOTOERR(next, rc);
+		slm_fcmh_endow_nolog(vfsid, p, c);
+		fcmh_op_done(c);
+
+ next:
+		if (rc)
+			OPSTAT_INCR("create-bulk-err");
+		mp->rcs[i] = rc;
+		if (p)
+			fcmh_op_done(p);
+	}
+	mds_unreserve_slot(mq->nents);
+	mp->nents = mq->nents;
+
+ out:
+	PSCFREE(iov.iov_base);
+	return (mp->rc);
+}
+
 void
 slm_rmc_handle_readdir_roots(struct iovec *iov, size_t nents)
 {
@@ -1101,7 +1691,24 @@ slm_rmc_handle_setattr(struct pscrpc_request *rq)
 			to_set |= PSCFS_SETATTRF_MTIME;
 			PFL_GETPTIMESPEC(&mq->attr.sst_mtim);
 		}
-		if (mq->attr.sst_size == 0 || !fcmh_2_fsz(f)) {
+		if (fcmh_2_ino(f)->ino_flags & INOF_INLINE) {
+			/*
+			 * No bmaps to deal with; the client promotes
+			 * the file first if it is growing too large or
+			 * another client is already promoting it.
+			 */
+			if (f->fcmh_flags & FCMH_MDS_INLPROMOTE)
+				PFL_GOTOERR(out, mp->rc =
+				    -SLERR_INLINE_FULL);
+			OPSTAT_INCR("truncate-inline");
+			FCMH_ULOCK(f);
+			mp->rc = -mds_inline_truncate(vfsid, f,
+			    mq->attr.sst_size);
+			FCMH_LOCK(f);
+			if (mp->rc)
+				PFL_GOTOERR(out, mp->rc);
+
+		} else if (mq->attr.sst_size == 0 || !fcmh_2_fsz(f)) {
 			/*
 			 * Full truncate.  If file size is already zero,
 			 * we must still bump the generation since size
@@ -1207,6 +1814,12 @@ slm_rmc_handle_set_fattr(struct pscrpc_request *rq)
 		else
 			fcmh_2_ino(f)->ino_flags &= ~INOF_IOS_AFFINITY;
 		break;
+	case SL_FATTR_STRIPED_READ:
+		if (mq->val)
+			fcmh_2_ino(f)->ino_flags |= INOF_STRIPED_READ;
+		else
+			fcmh_2_ino(f)->ino_flags &= ~INOF_STRIPED_READ;
+		break;
 	case SL_FATTR_REPLPOL:
 		if (mq->val < 0 || mq->val >= NBRPOL)
 			mp->rc = -EINVAL;
@@ -1475,6 +2088,90 @@ slm_rmc_handle_unlink(struct pscrpc_request *rq, int isfile)
 	return (0);
 }
 
+/*
+ * Handle an UNLINK_BULK from CLI: remove a batch of names the client
+ * has already replied to its callers for.  Journal space for the whole
+ * batch is reserved up front.
+ */
+int
+slm_rmc_handle_unlink_bulk(struct pscrpc_request *rq)
+{
+	const struct srm_unlink_bulk_req *mq;
+	struct srm_unlink_bulk_rep *mp;
+	struct sl_fidgen fg, oldfg, chfg;
+	struct fidc_membh *p, *c;
+	struct srt_unlink_ent *e;
+	struct iovec iov;
+	int i, rc, vfsid;
+
+	SL_RSX_ALLOCREP(rq, mq, mp);
+	if (mq->nents <= 0 || mq->nents > SRM_UNLINK_BULK_MAX)
+		return (mp->rc = -EINVAL);
+
+	iov.iov_len = mq->nents * sizeof(*e);
+	iov.iov_base = PSCALLOC(iov.iov_len);
+	mp->rc = slrpc_bulkserver(rq, BULK_GET_SINK, SRMC_BULK_PORTAL,
+	    &iov, 1);
+	if (mp->rc)
+		PFL_GOTOERR(out, mp->rc);
+
+	OPSTAT_INCR("unlink-bulk");
+	OPSTAT_ADD("unlink-bulk-ents", mq->nents);
+
+	mds_reserve_slot(mq->nents);
+	for (i = 0, e = iov.iov_base; i < mq->nents; i++, e++) {
+		p = NULL;
+		chfg.fg_fid = FID_ANY;
+		e->name[sizeof(e->name) - 1] = '\0';
+
+		rc = slfid_to_vfsid(e->pfid, &vfsid);
+		if (rc)
+			PFL_GOTOERR(next, rc);
+		if (e->pfid == SLFID_ROOT && use_global_mount)
+			PFL_GOTOERR(next, rc = -EACCES);
+		if (IS_REMOTE_FID(e->pfid))
+			PFL_GOTOERR(next, rc = -EINVAL);
+
+		fg.fg_fid = e->pfid;
+		fg.fg_gen = FGEN_ANY;
+		rc = -slm_fcmh_get(&fg, &p);
+		if (rc)
+			PFL_GOTOERR(next, rc);
+
+		if (e->isfile)
+			rc = mdsio_unlink(vfsid, fcmh_2_mfid(p), &oldfg,
+			    e->name, &rootcreds, mdslog_namespace, &chfg);
+		else
+			rc = mdsio_rmdir(vfsid, fcmh_2_mfid(p), &oldfg,
+			    e->name, &rootcreds, mdslog_namespace);
+		if (rc)
+			PFL_GOTOERR(next, rc);
+
+		mdsio_fcmh_refreshattr(p, NULL);
+		if (chfg.fg_fid != FID_ANY &&
+		    slm_fcmh_get(&chfg, &c) == 0) {
+			mdsio_fcmh_refreshattr(c, NULL);
+			fcmh_op_done(c);
+		}
+
+ next:
+		if (rc)
+			OPSTAT_INCR("unlink-bulk-err");
+		mp->rcs[i] = rc;
+		if (p)
+			fcmh_op_done(p);
+
+		psclog_diag("%s parent="SLPRI_FID" name=%s rc=%d",
+		    e->isfile ? "unlink" : "rmdir", e->pfid, e->name, rc);
+	}
+	mds_unreserve_slot(mq->nents);
+	mp->nents = mq->nents;
+
+ out:
+	PSCFREE(iov.iov_base);
+	return (mp->rc);
+}
+
 int
 slm_rmc_handle_listxattr(struct pscrpc_request *rq)
 {
@@ -1728,6 +2425,9 @@ slm_rmc_handler(struct pscrpc_request *rq)
 	case SRMT_GET_INODE:
 		rc = slm_rmc_handle_getinode(rq);
 		break;
+	case SRMT_INLINE_IO:
+		rc = slm_rmc_handle_inline_io(rq);
+		break;
 
 	/* replication messages */
 	case SRMT_SET_FATTR:
@@ -1747,6 +2447,9 @@ slm_rmc_handler(struct pscrpc_request *rq)
 		break;
 
 	/* control messages */
+	case SRMT_COMPOUND:
+		rc = slm_rmc_handle_compound(rq);
+		break;
 	case SRMT_CONNECT:
 		rc = slrpc_handle_connect(rq, SRMC_MAGIC, SRMC_VERSION,
 		    SLCONNT_CLI);
@@ -1759,9 +2462,18 @@ slm_rmc_handler(struct pscrpc_request *rq)
 	case SRMT_CREATE:
 		rc = slm_rmc_handle_create(rq);
 		break;
+	case SRMT_CREATE_BULK:
+		rc = slm_rmc_handle_create_bulk(rq);
+		break;
+	case SRMT_FIDLEASE:
+		rc = slm_rmc_handle_fidlease(rq);
+		break;
 	case SRMT_GETATTR:
 		rc = slm_rmc_handle_getattr(rq);
 		break;
+	case SRMT_GETATTR_BULK:
+		rc = slm_rmc_handle_getattr_bulk(rq);
+		break;
 	case SRMT_LINK:
 		rc = slm_rmc_handle_link(rq);
 		break;
@@ -1798,6 +2510,9 @@ slm_rmc_handler(struct pscrpc_request *rq)
 	case SRMT_UNLINK:
 		rc = slm_rmc_handle_unlink(rq, 1);
 		break;
+	case SRMT_UNLINK_BULK:
+		rc = slm_rmc_handle_unlink_bulk(rq);
+		break;
 	case SRMT_LISTXATTR:
 		rc = slm_rmc_handle_listxattr(rq);
 		break;
@@ -1819,6 +2534,7 @@ slm_rmc_handler(struct pscrpc_request *rq)
 	}
  out:
 	mds_note_update(-1);
+	mds_nsbatch_wait();
 	slrpc_rep_out(rq);
 	pscrpc_target_send_reply_msg(rq, -abs(rc), 0);
 	return (rc);
@@ -1830,6 +2546,7 @@ mexpc_allocpri(struct pscrpc_export *exp)
 	struct slm_exp_cli *mexpc;
 
 	mexpc = exp->exp_private = PSCALLOC(sizeof(*mexpc));
+	INIT_SPINLOCK(&mexpc->mexpc_lock);
 	slm_getclcsvc(exp);
 }
 
@@ -42,6 +42,7 @@
 #include "bmap_mds.h"
 #include "fid.h"
 #include "fidc_mds.h"
+#include "journal_mds.h"
 #include "mdsio.h"
 #include "repl_mds.h"
 #include "rpc_mds.h"
@@ -633,6 +634,7 @@ slm_rmi_handler(struct pscrpc_request *rq)
 		rq->rq_status = -PFLERR_NOSYS;
 		return (pscrpc_error(rq));
 	}
+	mds_nsbatch_wait();
 	slrpc_rep_out(rq);
 	pscrpc_target_send_reply_msg(rq, rc, 0);
 	return (rc);
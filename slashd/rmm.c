@@ -30,6 +30,7 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <zlib.h>
 
 #include "pfl/str.h"
 #include "pfl/rpc.h"
@@ -55,12 +56,37 @@ slm_rmm_apply_update(__unusedx struct srt_update_entry *entryp)
 	psc_fatal("obsolete code path");
 }
 
+/*
+ * An update from a peer MDS that arrived before its predecessor in the
+ * stream.  It is applied by whichever thread applies the predecessor.
+ */
+struct slm_update_pending {
+	uint64_t		 up_seqno;
+	uint64_t		 up_prevxid;
+	int			 up_count;
+	void			*up_buf;		/* uncompressed entries */
+};
+
+__static void
+slm_rmm_pending_free(struct sl_mds_peerinfo *p)
+{
+	struct slm_update_pending *up;
+	int i;
+
+	DYNARRAY_FOREACH(up, i, &p->sp_recv_pending) {
+		PSCFREE(up->up_buf);
+		PSCFREE(up);
+	}
+	psc_dynarray_reset(&p->sp_recv_pending);
+}
+
 /*
  * Handle a NAMESPACE_UPDATE request from another MDS.
  */
 int
 slm_rmm_handle_namespace_update(struct pscrpc_request *rq)
 {
+	struct slm_update_pending *up;
 	struct srt_update_entry *entryp;
 	struct srm_update_req *mq;
 	struct srm_update_rep *mp;
@@ -68,12 +94,18 @@ slm_rmm_handle_namespace_update(struct pscrpc_request *rq)
 	struct sl_resource *res;
 	struct sl_site *site;
 	struct iovec iov;
+	uint64_t lastxid, seqno;
+	void *buf = NULL;
+	uLongf rawsize;
 	int i, len, count;
 
 	SL_RSX_ALLOCREP(rq, mq, mp);
 
 	count = mq->count;
-	if (count <= 0 || mq->size > LNET_MTU) {
+	if (count <= 0 || count > SLM_UPDATE_BATCH_NENTS ||
+	    mq->size <= 0 || mq->size > LNET_MTU || mq->rawsize < 0 ||
+	    mq->rawsize > SLM_UPDATE_BATCH_NENTS *
+	    (int)sizeof(struct srt_update_entry)) {
 		mp->rc = -EINVAL;
 		return (mp->rc);
 	}
@@ -100,20 +132,104 @@ slm_rmm_handle_namespace_update(struct pscrpc_request *rq)
 		PFL_GOTOERR(out, mp->rc = -EINVAL);
 	}
 
+	if (mq->rawsize) {
+		rawsize = mq->rawsize;
+		buf = PSCALLOC(rawsize);
+		if (uncompress(buf, &rawsize, iov.iov_base,
+		    mq->size) != Z_OK || rawsize != (uLongf)mq->rawsize) {
+			OPSTAT_INCR("nsupd-zcorrupt");
+			PFL_GOTOERR(out, mp->rc = -EINVAL);
+		}
+	} else {
+		buf = iov.iov_base;
+		iov.iov_base = NULL;
+	}
+
 	/*
-	 * Iterate through the namespace update buffer and apply updates.
-	 * If we fail to apply an update, we still report success to our
-	 * peer because reporting an error does not help our cause.
+	 * Our peer streams several requests at once, which may be
+	 * serviced out of order.  A request whose predecessor has not
+	 * been applied yet is parked and answered right away with what
+	 * we have applied so far; the thread applying the predecessor
+	 * picks it up.  A request without a predecessor restarts the
+	 * stream, so anything parked from the old stream is dropped.
 	 */
-	entryp = iov.iov_base;
-	for (i = 0; i < count; i++) {
-		slm_rmm_apply_update(entryp);
-		len = UPDATE_ENTRY_LEN(entryp);
-		entryp = PSC_AGP(entryp, len);
+	spinlock(&p->sp_recv_lock);
+	if (mq->prevxid == 0 && psc_dynarray_len(&p->sp_recv_pending)) {
+		OPSTAT_INCR("nsupd-order-reset");
+		slm_rmm_pending_free(p);
 	}
-	zfsslash2_wait_synced(0);
+	if ((p->sp_flags & SPF_RECV_BUSY) ||
+	    (mq->prevxid && p->sp_recv_seqno < mq->prevxid)) {
+		mp->seqno = p->sp_recv_seqno;
+		if (psc_dynarray_len(&p->sp_recv_pending) >=
+		    SLM_UPDATE_NINFLIGHT) {
+			freelock(&p->sp_recv_lock);
+			OPSTAT_INCR("nsupd-order-full");
+			PFL_GOTOERR(out, mp->rc = -EAGAIN);
+		}
+		up = PSCALLOC(sizeof(*up));
+		up->up_seqno = mq->seqno;
+		up->up_prevxid = mq->prevxid;
+		up->up_count = count;
+		up->up_buf = buf;
+		psc_dynarray_add(&p->sp_recv_pending, up);
+		freelock(&p->sp_recv_lock);
+		OPSTAT_INCR("nsupd-order-queue");
+		buf = NULL;
+		goto out;
+	}
+	p->sp_flags |= SPF_RECV_BUSY;
+	lastxid = mq->prevxid ? p->sp_recv_seqno : 0;
+	freelock(&p->sp_recv_lock);
+
+	seqno = mq->seqno;
+	for (;;) {
+		/*
+		 * Iterate through the namespace update buffer and apply
+		 * updates.  Entries before the requested starting point
+		 * have already been sent.  If we fail to apply an
+		 * update, we still report success to our peer because
+		 * reporting an error does not help our cause.
+		 */
+		entryp = buf;
+		for (i = 0; i < count; i++) {
+			if (entryp->xid >= seqno && entryp->xid > lastxid) {
+				slm_rmm_apply_update(entryp);
+				lastxid = entryp->xid;
+			}
+			len = UPDATE_ENTRY_LEN(entryp);
+			entryp = PSC_AGP(entryp, len);
+		}
+		zfsslash2_wait_synced(0);
+
+		/* pick up a parked successor, if it has arrived */
+		spinlock(&p->sp_recv_lock);
+		p->sp_recv_seqno = lastxid;
+		DYNARRAY_FOREACH(up, i, &p->sp_recv_pending)
+			if (up->up_prevxid <= lastxid)
+				break;
+		if (i == psc_dynarray_len(&p->sp_recv_pending)) {
+			p->sp_flags &= ~SPF_RECV_BUSY;
+			freelock(&p->sp_recv_lock);
+			break;
+		}
+		psc_dynarray_removepos(&p->sp_recv_pending, i);
+		freelock(&p->sp_recv_lock);
+
+		OPSTAT_INCR("nsupd-order-apply");
+		if (up->up_prevxid == 0)
+			lastxid = 0;
+		seqno = up->up_seqno;
+		count = up->up_count;
+		PSCFREE(buf);
+		buf = up->up_buf;
+		PSCFREE(up);
+	}
+
+	mp->seqno = lastxid;
 
  out:
+	PSCFREE(buf);
 	PSCFREE(iov.iov_base);
 	return (mp->rc);
 }
@@ -279,6 +395,7 @@ slm_rmm_handler(struct pscrpc_request *rq)
 		rq->rq_status = -PFLERR_NOSYS;
 		return (pscrpc_error(rq));
 	}
+	mds_nsbatch_wait();
 	slrpc_rep_out(rq);
 	pscrpc_target_send_reply_msg(rq, rc, 0);
 	return (rc);
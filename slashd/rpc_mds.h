@@ -73,11 +73,25 @@ enum slm_fwd_op {
  * 512 bytes.
  */
 #define SLM_UPDATE_BATCH_NENTS		2048			/* namespace updates */
+#define SLM_UPDATE_NINFLIGHT		4			/* update RPCs in flight per peer */
 #define SLM_RECLAIM_BATCH_NENTS		2048			/* garbage reclamation */
 
+/* FID leases remembered per client; the oldest is forgotten first */
+#define SLM_FIDLEASE_NRANGES		4
+
+struct slm_fidlease {
+	slfid_t				  mfl_fid;		/* first FID of the range */
+	int32_t				  mfl_nfids;		/* 0 if slot unused */
+	int32_t				  mfl_nused;
+	uint64_t			  mfl_used[SRM_FIDLEASE_MAX / 64];
+};
+
 struct slm_exp_cli {
 	struct slashrpc_cservice	 *mexpc_csvc;		/* must be first field */
 	uint32_t			  mexpc_stkvers;	/* must be second field */
+	psc_spinlock_t			  mexpc_lock;		/* for FID leases */
+	int				  mexpc_fidlease_next;	/* slot to reuse */
+	struct slm_fidlease		  mexpc_fidleases[SLM_FIDLEASE_NRANGES];
 };
 
 struct batchrq {
@@ -112,6 +126,8 @@ struct batchrq {
 
 void	slm_rpc_initsvc(void);
 
+int	slm_fidlease_consume(struct slm_exp_cli *, slfid_t);
+
 int	slm_rmc_handle_lookup(struct pscrpc_request *);
 
 int	slm_rmc_handler(struct pscrpc_request *);
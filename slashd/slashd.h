@@ -27,6 +27,7 @@
 
 #include <sqlite3.h>
 
+#include "pfl/completion.h"
 #include "pfl/ctlsvr.h"
 #include "pfl/dynarray.h"
 #include "pfl/meter.h"
@@ -60,7 +61,9 @@ enum {
 	SLMTHRT_CTLAC,		/* control acceptor */
 	SLMTHRT_CURSOR,		/* cursor update thread */
 	SLMTHRT_DBWORKER,	/* database worker */
+	SLMTHRT_JDISTILL,	/* journal distill log writer */
 	SLMTHRT_JNAMESPACE,	/* namespace propagating thread */
+	SLMTHRT_JNSBATCH,	/* namespace journal batch writer */
 	SLMTHRT_JRECLAIM,	/* garbage reclamation thread */
 	SLMTHRT_JRNL,		/* journal distill thread */
 	SLMTHRT_LNETAC,		/* lustre net accept thr */
@@ -84,6 +87,7 @@ struct slmthr_dbh {
 struct slmrmc_thread {
 	struct pscrpc_thread	  smrct_prt;
 	struct slmthr_dbh	  smrct_dbh;
+	uint64_t		  smrct_nsbatch_gen;	/* journal batch to wait for */
 };
 
 struct slmrcm_thread {
@@ -95,10 +99,12 @@ struct slmrcm_thread {
 struct slmrmi_thread {
 	struct pscrpc_thread	  smrit_prt;
 	struct slmthr_dbh	  smrit_dbh;
+	uint64_t		  smrit_nsbatch_gen;	/* journal batch to wait for */
 };
 
 struct slmrmm_thread {
 	struct pscrpc_thread	  smrmt_prt;
+	uint64_t		  smrmt_nsbatch_gen;	/* journal batch to wait for */
 };
 
 struct slmdbwk_thread {
@@ -151,7 +157,49 @@ slmthr_getdbh(void)
 	psc_fatalx("unknown thread type");
 }
 
+/*
+ * RPC service threads remember the last namespace journal batch they
+ * added to so they can wait for it before replying.
+ */
+static __inline uint64_t *
+slmthr_getnsbatchgen(void)
+{
+	struct psc_thread *thr;
+
+	thr = pscthr_get();
+	switch (thr->pscthr_type) {
+	case SLMTHRT_RMC:
+		return (&slmrmcthr(thr)->smrct_nsbatch_gen);
+	case SLMTHRT_RMI:
+		return (&slmrmithr(thr)->smrit_nsbatch_gen);
+	case SLMTHRT_RMM:
+		return (&slmrmmthr(thr)->smrmt_nsbatch_gen);
+	}
+	return (NULL);
+}
+
+/*
+ * Time-based token bucket limiting the rate of replication traffic
+ * across a link.  Tokens are bytes; a zero limit means unlimited.
+ */
+struct slm_tokbkt {
+	int64_t			  tb_limit;		/* bytes/sec */
+	int64_t			  tb_tokens;
+	struct timespec		  tb_refill;		/* last refill */
+	int64_t			  tb_rate;		/* measured completion rate */
+	int64_t			  tb_done;		/* completed since tb_mark */
+	struct timespec		  tb_mark;		/* start of rate sample */
+};
+
+/* replication traffic from one site to another */
+struct slm_replink {
+	struct sl_site		 *srl_dst;
+	struct slm_tokbkt	  srl_tb;
+};
+
 struct site_mds_info {
+	psc_spinlock_t		  smi_lock;
+	struct psc_dynarray	  smi_links;		/* slm_replink, by dst site */
 };
 
 static __inline struct site_mds_info *
@@ -185,8 +233,10 @@ struct slm_nsstats {
 
 /*
  * This structure is attached to the sl_resource for MDS peers.  It tracks the
- * progress of namespace log application on an MDS.  We allow one pending
- * request per MDS until it responds or timeouts.
+ * progress of namespace log application on an MDS.  Updates are streamed
+ * with up to SLM_UPDATE_NINFLIGHT requests pending per MDS; the peer
+ * applies them in order using sp_recv_seqno, parking any that arrive
+ * early in sp_recv_pending.
  */
 struct rpmi_mds {
 	struct psc_meter	  sp_batchmeter;
@@ -197,15 +247,23 @@ struct rpmi_mds {
 	int			  sp_fails;		/* the number of successive RPC failures */
 	int			  sp_skips;		/* the number of times to skip */
 
-	int			  sp_send_count;	/* # of updates in the batch */
-	uint64_t		  sp_send_seqno;	/* next log sequence number to send */
-	uint64_t		  sp_recv_seqno;	/* last received log sequence number */
+	int			  sp_inflight;		/* # of update RPCs outstanding */
+	int			  sp_gen;		/* bumped when send stream restarts */
+	uint64_t		  sp_send_batchno;	/* batch of next update to send */
+	uint64_t		  sp_send_seqno;	/* xid of next update to send */
+	uint64_t		  sp_send_prevxid;	/* last xid sent, or 0 on restart */
+	time_t			  sp_synced;		/* last time peer was caught up */
+
+	psc_spinlock_t		  sp_recv_lock;
+	struct psc_dynarray	  sp_recv_pending;	/* updates awaiting predecessor */
+	uint64_t		  sp_recv_seqno;	/* last xid applied from peer */
 
 	struct slm_nsstats	  sp_stats;
 };
 #define sl_mds_peerinfo rpmi_mds
 
 #define	SPF_NEED_JRNL_INIT	(1 << 0)		/* journal fields need initialized */
+#define	SPF_RECV_BUSY		(1 << 1)		/* applying updates from peer */
 
 #define res2rpmi_mds(res)	((struct rpmi_mds *)res2rpmi(res)->rpmi_info)
 #define res2mdsinfo(res)	res2rpmi_mds(res)
@@ -234,6 +292,12 @@ struct rpmi_ios {
 	struct bw_dir		  si_bw_ingress;	/* incoming bandwidth */
 	struct bw_dir		  si_bw_egress;		/* outgoing bandwidth */
 	struct bw_dir		  si_bw_aggr;		/* aggregate (incoming + outgoing) */
+
+	struct slm_tokbkt	  si_tb_ingress;	/* replication rate limits */
+	struct slm_tokbkt	  si_tb_egress;
+
+	int64_t			  si_place_score;	/* score at last write lease placement */
+	uint64_t		  si_nplaced;		/* write leases placed here */
 };
 #define sl_mds_iosinfo rpmi_ios
 
@@ -305,6 +369,14 @@ struct slm_wkdata_ptrunc {
 	struct fidc_membh	*f;
 };
 
+struct slm_wkdata_ptrunc_recover {
+	struct sl_fidgen	 fg;
+};
+
+struct slm_wkdata_bia_recover {
+	slfid_t			 fid;
+};
+
 struct slm_wkdata_upsch_purge {
 	slfid_t			 fid;
 	sl_bmapno_t		 bno;
@@ -328,12 +400,37 @@ struct slm_wkdata_batchrq_cb {
 struct slm_wkdata_upschq {
 	struct sl_fidgen	 fg;
 	sl_bmapno_t		 bno;
+	int			 nbmaps;	/* consecutive bmaps from bno */
 };
 
 struct slm_wkdata_rmdir_ino {
 	slfid_t			 fid;
 };
 
+/* number of FIDs of a GETATTR_BULK handled per worker */
+#define SLM_GETATTR_BULK_CHUNK	8
+
+struct slm_getattr_bulk {
+	psc_spinlock_t			 sgb_lock;
+	int				 sgb_nleft;	/* chunks outstanding */
+	struct psc_compl		 sgb_compl;
+	const struct sl_fidgen		*sgb_fgs;
+	struct srt_getattr_ent		*sgb_ents;
+};
+
+struct slm_wkdata_getattr_bulk {
+	struct slm_getattr_bulk		*gb;
+	int				 off;
+	int				 n;
+};
+
+/*
+ * FIDs leased to clients are not journaled until they are used, so at
+ * most this many FIDs past the one recorded in the cursor may be out on
+ * lease, and this many are skipped at startup.
+ */
+#define SLM_FIDLEASE_SLACK	(1 << 16)
+
 struct slm_batchscratch_repl {
 	int64_t			 bsr_amt;
 	int			 bsr_off;
@@ -347,6 +444,10 @@ struct mio_rootnames {
 
 #define SLM_NWORKER_THREADS	4
 
+/* write lease placement, see slm_resm_score() */
+#define SLM_PLACE_BWUNIT	(64 * 1024 * 1024)	/* bytes (or bytes/sec) worth one lease */
+#define SLM_PLACE_MINFREE	10			/* per mille free before IOS is a last resort */
+
 enum {
 	SLM_OPSTATE_INIT = 0,
 	SLM_OPSTATE_REPLAY,
@@ -363,6 +464,8 @@ int		 mds_lease_reassign(struct fidc_membh *,
 
 int		 mds_sliod_alive(void *);
 
+int64_t		 slm_resm_score(struct sl_resm *);
+
 void		 slmbkdbthr_main(struct psc_thread *);
 void		 slmbmaptimeothr_spawn(void);
 void		 slmctlthr_main(const char *);
@@ -371,12 +474,22 @@ void		 slmrcmthr_main(struct psc_thread *);
 slfid_t		 slm_get_curr_slashfid(void);
 void		 slm_set_curr_slashfid(slfid_t);
 int		 slm_get_next_slashfid(slfid_t *);
+int		 slm_get_next_slashfid_range(int, slfid_t *);
+void		 slm_set_fidlease_base(slfid_t);
 
 int		 slm_ptrunc_prepare(void *);
 void		 slm_ptrunc_apply(struct slm_wkdata_ptrunc *);
 int		 slm_ptrunc_wake_clients(void *);
 void		 slm_ptrunc_odt_startup_cb(void *, struct pfl_odt_receipt *, void *);
+size_t		 slm_odt_allocslot(struct pfl_odt *);
+void		 slm_odt_barrier(int);
+void		 slm_odt_flushall(void);
+void		 slm_odt_freeitem(struct pfl_odt *, struct pfl_odt_receipt *);
+void		 slm_odt_initfree(struct pfl_odt *);
+void		 slm_odt_readahead(int);
 void		 slm_setattr_core(struct fidc_membh *, struct srt_stat *, int);
+int		 slm_getattr(const struct sl_fidgen *, struct srt_stat *, uint32_t *);
+int		 slm_lookup(const struct sl_fidgen *, const char *, struct srt_stat *, uint32_t *);
 
 int		 mdscoh_req(struct bmap_mds_lease *);
 
@@ -398,8 +511,15 @@ extern struct psc_listcache	 slm_db_hipri_workq;
 extern struct psc_thread	*slmconnthr;
 
 extern int			 slm_opstate;
+extern int			 slm_lazy_recovery;
 
 extern struct pfl_odt_ops	 slm_odtops;
+extern psc_atomic32_t		 slm_odt_ndirty;
+extern int			 slm_odt_wcomb;
+
+extern int			 slm_inline_max;
+
+#define SLM_INLINE_LIMIT	((uint64_t)MIN(slm_inline_max, SRM_INLINE_MAX))
 
 extern int			 use_global_mount;
 
@@ -119,7 +119,7 @@ void
 slm_batch_repl_cb(struct batchrq *br, int ecode)
 {
 	sl_bmapgen_t bgen;
-	int rc, idx, tract[NBREPLST], retifset[NBREPLST];
+	int rc, idx, xfer, tract[NBREPLST], retifset[NBREPLST];
 	struct srt_replwk_repent *bp = br->br_reply;
 	struct sl_resm *dst_resm, *src_resm;
 	struct slm_batchscratch_repl *bsr;
@@ -142,6 +142,7 @@ slm_batch_repl_cb(struct batchrq *br, int ecode)
 	    bq++, bp ? bp++ : 0, idx++) {
 		b = NULL;
 		f = NULL;
+		xfer = 0;
 		bsr = psc_dynarray_getpos(&br->br_scratch, idx);
 		src_resm = libsl_ios2resm(bq->src_resid);
 
@@ -170,6 +171,7 @@ slm_batch_repl_cb(struct batchrq *br, int ecode)
 			retifset[BREPLST_REPL_QUEUED] = 1;
 
 			OPSTAT2_ADD("replcompl", bsr->bsr_amt);
+			xfer = 1;
 		} else {
 			if (bp == NULL || bp->rc == SLERR_ION_OFFLINE) {
 				dbdo(NULL, NULL,
@@ -214,6 +216,13 @@ slm_batch_repl_cb(struct batchrq *br, int ecode)
 
 		resmpair_bw_adj(src_resm, dst_resm, -bsr->bsr_amt,
 		    NULL);
+		/*
+		 * Count a completed transfer toward the measured rate;
+		 * otherwise refund the tokens reserved for it so a
+		 * failed batch does not eat into the throttle.
+		 */
+		resmpair_tb_release(src_resm, dst_resm, bsr->bsr_amt,
+		    xfer);
 		upschq_resm(dst_resm, UPDT_PAGEIN);
 //		upschq_resm(src_resm, UPDT_PAGEIN);
 
@@ -381,6 +390,7 @@ slm_upsch_tryrepl(struct bmap *b, int off, struct sl_resm *src_resm,
 	}
 
 	resmpair_bw_adj(src_resm, dst_resm, -bsr->bsr_amt, NULL);
+	resmpair_tb_release(src_resm, dst_resm, bsr->bsr_amt, 0);
 
 	UPSCH_WAKE();
 
@@ -699,11 +709,11 @@ return;
 void
 upd_proc_bmap(struct slm_update_data *upd)
 {
-	int rc, off, val, pass, valid_exists = 0;
-	struct rnd_iterator dst_res_i, src_res_i;
+	int rc, off, val, pass, i, nsrc, valid_exists = 0;
+	struct sl_resource *srcv[SL_MAX_REPLICAS];
 	struct sl_resource *dst_res, *src_res;
 	struct slashrpc_cservice *csvc;
-	struct sl_mds_iosinfo *si;
+	struct rnd_iterator dst_res_i;
 	struct bmap_mds_info *bmi;
 	struct fidc_membh *f;
 	struct sl_resm *m;
@@ -765,47 +775,16 @@ upd_proc_bmap(struct slm_update_data *upd)
 			psclog_debug("trying to arrange repl dst=%s",
 			    dst_res->res_name);
 
-			/* look for a repl source */
+			/*
+			 * Look for a repl source, trying the ones
+			 * expected to finish soonest first.
+			 */
 			for (pass = 0; pass < 2; pass++) {
-				FOREACH_RND(&src_res_i, fcmh_2_nrepls(f)) {
-					if (src_res_i.ri_rnd_idx ==
-					    dst_res_i.ri_rnd_idx)
-						continue;
-
-					src_res = libsl_id2res(
-					    fcmh_getrepl(f,
-					    src_res_i.ri_rnd_idx).bs_id);
-
-					/*
-					 * Skip ourself and old/inactive
-					 * replicas.
-					 */
-					if (src_res == NULL ||
-					    SL_REPL_GET_BMAP_IOS_STAT(bmi->bmi_repls,
-					    SL_BITS_PER_REPLICA *
-					    src_res_i.ri_rnd_idx) != BREPLST_VALID)
-						continue;
-
-					valid_exists = 1;
-
-					si = res2iosinfo(src_res);
-
-					psclog_debug("attempt to "
-					    "arrange repl with %s -> %s? "
-					    "pass=%d siflg=%d",
-					    src_res->res_name,
-					    dst_res->res_name,
-					    pass, !!(si->si_flags &
-					    (SIF_DISABLE_LEASE |
-					     SIF_DISABLE_ADVLEASE)));
-
-					if (pass ^
-					    (src_res->res_type ==
-					     SLREST_ARCHIVAL_FS ||
-					     !!(si->si_flags &
-					     (SIF_DISABLE_LEASE |
-					      SIF_DISABLE_ADVLEASE))))
-						continue;
+				nsrc = slm_repl_src_select(b,
+				    dst_res_i.ri_rnd_idx, dst_res, pass,
+				    srcv, &valid_exists);
+				for (i = 0; i < nsrc; i++) {
+					src_res = srcv[i];
 
 					psclog_debug("trying to arrange "
 					    "repl with %s -> %s",
@@ -885,6 +864,8 @@ upd_proc_pagein_unit(struct slm_update_data *upd)
 	rc = slm_fcmh_get(&upg->upg_fg, &f);
 	if (rc)
 		goto out;
+	if (upg->upg_nbmaps > 1)
+		mds_bmap_prefetch(f, upg->upg_bno, upg->upg_nbmaps);
 	rc = bmap_get(f, upg->upg_bno, SL_WRITE, &b);
 	if (rc)
 		goto out;
@@ -943,30 +924,49 @@ upd_pagein_wk(void *p)
 	upg->upg_fg.fg_fid = wk->fg.fg_fid;
 	upg->upg_fg.fg_gen = FGEN_ANY;
 	upg->upg_bno = wk->bno;
+	upg->upg_nbmaps = wk->nbmaps;
 	upsch_enqueue(&upg->upg_upd);
 	UPD_UNBUSY(&upg->upg_upd);
 	return (0);
 }
 
 int
-upd_proc_pagein_cb(struct slm_sth *sth, __unusedx void *p)
+upd_proc_pagein_cb(struct slm_sth *sth, void *p)
 {
+	struct psc_dynarray *da = p;
 	struct slm_wkdata_upschq *wk;
 
 	wk = pfl_workq_getitem(upd_pagein_wk, struct slm_wkdata_upschq);
 	wk->fg.fg_fid = sqlite3_column_int64(sth->sth_sth, 0);
 	wk->bno = sqlite3_column_int(sth->sth_sth, 1);
-	pfl_workq_putitem(wk);
+	wk->nbmaps = 1;
+	psc_dynarray_add(da, wk);
 	return (0);
 }
 
+int
+upd_pagein_cmp(const void *x, const void *y)
+{
+	const struct slm_wkdata_upschq * const *pa = x, *a = *pa;
+	const struct slm_wkdata_upschq * const *pb = y, *b = *pb;
+	int rc;
+
+	rc = CMP(a->fg.fg_fid, b->fg.fg_fid);
+	if (rc)
+		return (rc);
+	return (CMP(a->bno, b->bno));
+}
+
 void
 upd_proc_pagein(struct slm_update_data *upd)
 {
+	struct slm_wkdata_upschq *wk, *run = NULL;
+	struct psc_dynarray da = DYNARRAY_INIT;
 	struct slm_update_generic *upg;
 	struct resprof_mds_info *rpmi;
 	struct sl_mds_iosinfo *si;
 	struct sl_resource *r;
+	int i;
 
 	upg = upd_getpriv(upd);
 	if (upg->upg_resm) {
@@ -988,7 +988,7 @@ upd_proc_pagein(struct slm_update_data *upd)
 	 * selects a different user at random, so over time, no users
 	 * will starve.
 	 */
-	dbdo(upd_proc_pagein_cb, NULL,
+	dbdo(upd_proc_pagein_cb, &da,
 	    " SELECT	fid,"
 	    "		bno,"
 	    "		nonce"
@@ -1007,6 +1007,23 @@ upd_proc_pagein(struct slm_update_data *upd)
 	    " LIMIT	32",
 	    upg->upg_resm ? SQLITE_INTEGER : SQLITE_NULL,
 	    upg->upg_resm ? r->res_id : 0);
+
+	/*
+	 * Note runs of consecutive bmaps of the same file so the first
+	 * unit of each run loads all of their bmaps with one read.
+	 */
+	psc_dynarray_sort(&da, qsort, upd_pagein_cmp);
+	DYNARRAY_FOREACH(wk, i, &da) {
+		if (run && run->fg.fg_fid == wk->fg.fg_fid &&
+		    run->bno + run->nbmaps == wk->bno &&
+		    run->nbmaps < SLM_BMAP_RA_MAX)
+			run->nbmaps++;
+		else
+			run = wk;
+	}
+	DYNARRAY_FOREACH(wk, i, &da)
+		pfl_workq_putitem(wk);
+	psc_dynarray_free(&da);
 }
 
 #if 0
@@ -1159,7 +1176,19 @@ slmupschthr_main(struct psc_thread *thr)
 		UPSCH_ULOCK();
 		if (upd)
 			psc_multiwait_leavecritsect(&slm_upsch_mw);
-		else {
+		else if (slm_repl_tb_throttled) {
+			/*
+			 * Replication is being rate limited: nobody
+			 * will wake us when tokens accrue so retry on
+			 * our own.
+			 */
+			rc = psc_multiwait_usecs(&slm_upsch_mw, &upd,
+			    SLM_REPL_TB_RETRY_USECS);
+			if (rc == -ETIMEDOUT) {
+				slm_repl_tb_throttled = 0;
+				upschq_resm(NULL, UPDT_PAGEIN);
+			}
+		} else {
 			rc = psc_multiwait_secs(&slm_upsch_mw, &upd, 30);
 			if (rc == -ETIMEDOUT)
 				upschq_resm(NULL, UPDT_PAGEIN);
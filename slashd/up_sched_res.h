@@ -65,6 +65,7 @@ struct slm_update_generic {
 	struct sl_resm			*upg_resm;
 	struct sl_fidgen		 upg_fg;
 	sl_bmapno_t			 upg_bno;
+	int				 upg_nbmaps;	/* run of bmaps to prefetch */
 	struct slm_update_data		 upg_upd;
 	struct psc_listentry		 upg_lentry;
 };
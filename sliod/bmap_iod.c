@@ -318,7 +318,6 @@ iod_bmap_init(struct bmap *b)
 
 	memset(bii, 0, sizeof(*bii));
 	INIT_PSC_LISTENTRY(&bii->bii_lentry);
-	SPLAY_INIT(&bii->bii_slvrs);
 
 	pll_init(&bii->bii_rls, struct bmap_iod_rls, bir_lentry, NULL);
 
@@ -337,7 +336,7 @@ iod_bmap_finalcleanup(struct bmap *b)
 
 	bii = bmap_2_bii(b);
 	psc_assert(pll_empty(&bii->bii_rls));
-	psc_assert(SPLAY_EMPTY(&bii->bii_slvrs));
+	psc_assert(bii->bii_nslvrs == 0);
 	psc_assert(psclist_disjoint(&bii->bii_lentry));
 }
 
@@ -80,8 +80,6 @@ struct bmap_iod_rls {
 	    bcr_2_bmap(bcr), bcr_2_bmap(bcr)->bcm_bmapno,	\
 	    ## __VA_ARGS__)
 
-SPLAY_HEAD(biod_slvrtree, slvr);
-
 /*
  * bmap_get_pri() data specific to the I/O server.
  */
@@ -97,7 +95,9 @@ struct bmap_iod_info {
 	 */
 	struct bcrcupd		*bii_bcr;
 
-	struct biod_slvrtree	 bii_slvrs;
+	/* cached slivers, indexed directly by sliver number */
+	struct slvr		*bii_slvrs[SLASH_SLVRS_PER_BMAP];
+	int			 bii_nslvrs;
 	struct psclist_head	 bii_lentry;
 	struct psc_lockedlist	 bii_rls;
 };
@@ -110,7 +110,7 @@ struct bmap_iod_info {
 #undef bmap_2_crcs
 
 #define bmap_2_bii(b)		((struct bmap_iod_info *)bmap_get_pri(b))
-#define bmap_2_bii_slvrs(b)	(&bmap_2_bii(b)->bii_slvrs)
+#define bmap_2_bii_slvrs(b)	bmap_2_bii(b)->bii_slvrs
 #define bmap_2_crcstates(b)	bmap_2_bii(b)->bii_crcstates
 #define bmap_2_crcs(b)		bmap_2_bii(b)->bii_crcs
 
@@ -25,6 +25,7 @@
 #include "pfl/cdefs.h"
 #include "pfl/alloc.h"
 
+#include "repl_iod.h"
 #include "slconfig.h"
 #include "sliod.h"
 
@@ -34,8 +35,13 @@ slcfg_init_res(__unusedx struct sl_resource *res)
 }
 
 void
-slcfg_init_resm(__unusedx struct sl_resm *resm)
+slcfg_init_resm(struct sl_resm *resm)
 {
+	struct resm_iod_info *rmii;
+
+	rmii = resm2rmii(resm);
+	INIT_SPINLOCK(&rmii->rmii_lock);
+	rmii->rmii_window = SLI_REPL_WINDOW_MIN;
 }
 
 void
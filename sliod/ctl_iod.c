@@ -498,27 +498,31 @@ int
 slictlrep_getslvr(int fd, struct psc_ctlmsghdr *mh, void *m)
 {
 	struct slictlmsg_slvr *ss = m;
+	struct psc_listcache *lc;
 	struct slvr *s;
-	int rc;
+	int i, rc;
 
 	rc = 1;
-	LIST_CACHE_LOCK(&sli_lruslvrs);
-	LIST_CACHE_FOREACH(s, &sli_lruslvrs) {
-		memset(ss, 0, sizeof(*ss));
-		ss->ss_fid = fcmh_2_fid(slvr_2_fcmh(s));
-		ss->ss_bno = slvr_2_bmap(s)->bcm_bmapno;
-		ss->ss_slvrno = s->slvr_num;
-		ss->ss_flags = s->slvr_flags;
-		ss->ss_refcnt = s->slvr_refcnt;
-		ss->ss_err = s->slvr_err;
-		ss->ss_ts.tv_sec = s->slvr_ts.tv_sec;
-		ss->ss_ts.tv_nsec = s->slvr_ts.tv_nsec;
-
-		rc = psc_ctlmsg_sendv(fd, mh, ss);
-		if (!rc)
-			break;
+	for (i = 0; rc && i < sli_nlru_shards; i++) {
+		lc = &sli_lru_shards[i].sls_lru;
+		LIST_CACHE_LOCK(lc);
+		LIST_CACHE_FOREACH(s, lc) {
+			memset(ss, 0, sizeof(*ss));
+			ss->ss_fid = fcmh_2_fid(slvr_2_fcmh(s));
+			ss->ss_bno = slvr_2_bmap(s)->bcm_bmapno;
+			ss->ss_slvrno = s->slvr_num;
+			ss->ss_flags = s->slvr_flags;
+			ss->ss_refcnt = s->slvr_refcnt;
+			ss->ss_err = s->slvr_err;
+			ss->ss_ts.tv_sec = s->slvr_ts.tv_sec;
+			ss->ss_ts.tv_nsec = s->slvr_ts.tv_nsec;
+
+			rc = psc_ctlmsg_sendv(fd, mh, ss);
+			if (!rc)
+				break;
+		}
+		LIST_CACHE_ULOCK(lc);
 	}
-	LIST_CACHE_ULOCK(&sli_lruslvrs);
 	return (rc);
 }
 
@@ -633,7 +637,8 @@ psc_ctl_thrget_t psc_ctl_thrgets[] = {
 /* SLVR_CRC	*/ NULL,
 /* STATFS	*/ NULL,
 /* USKLNDPL	*/ NULL,
-/* WORKER	*/ NULL
+/* WORKER	*/ NULL,
+/* WRITEBACK	*/ NULL
 };
 
 PFLCTL_SVR_DEFS;
@@ -665,12 +670,22 @@ slictlthr_main(const char *fn)
 
 	psc_ctlparam_register_var("sys.bminseqno", PFLCTL_PARAMT_UINT64,
 	    0, &bimSeq.bim_minseq);
+	psc_ctlparam_register_var("sys.lru_shards", PFLCTL_PARAMT_INT,
+	    0, &sli_nlru_shards);
 	psc_ctlparam_register_var("sys.reclaim_batchno",
 	    PFLCTL_PARAMT_UINT64, 0, &current_reclaim_batchno);
 	psc_ctlparam_register_var("sys.reclaim_xid",
 	    PFLCTL_PARAMT_UINT64, 0, &current_reclaim_xid);
+	psc_ctlparam_register_var("sys.repl_window_max",
+	    PFLCTL_PARAMT_INT, PFLCTL_PARAMF_RDWR, &sli_repl_window_max);
 	psc_ctlparam_register_var("sys.selftestrc", PFLCTL_PARAMT_INT,
 	    0, &sli_selftest_rc);
+	psc_ctlparam_register_var("sys.wb_delay_ms", PFLCTL_PARAMT_INT,
+	    PFLCTL_PARAMF_RDWR, &sli_wb_delay_ms);
+	psc_ctlparam_register_var("sys.wb_max_slvrs", PFLCTL_PARAMT_INT,
+	    PFLCTL_PARAMF_RDWR, &sli_wb_max_slvrs);
+	psc_ctlparam_register_var("sys.wb_ndirty",
+	    PFLCTL_PARAMT_ATOMIC32, 0, &sli_wb_ndirty);
 
 	psc_ctlthr_main(fn, slictlops, nitems(slictlops), SLITHRT_CTLAC);
 }
@@ -99,12 +99,31 @@ sli_fg_makepath(const struct sl_fidgen *fg, char *fid_path)
 static int
 sli_open_backing_file(struct fidc_membh *f)
 {
-	int lvl = PLL_DIAG, incr, rc = 0;
+	int lvl = PLL_DIAG, incr, rc = 0, oflags = O_CREAT | O_RDWR;
 	char fidfn[PATH_MAX];
 
+	/*
+	 * In direct I/O mode the sliver cache is the only cache of file
+	 * data; slabs are allocated suitably aligned for this.
+	 */
+	if (slcfg_local->cfg_backfs_direct_io)
+		oflags |= O_DIRECT;
+
 	incr = psc_rlim_adj(RLIMIT_NOFILE, 1);
 	sli_fg_makepath(&f->fcmh_fg, fidfn);
-	fcmh_2_fd(f) = open(fidfn, O_CREAT|O_RDWR, 0600);
+	fcmh_2_fd(f) = open(fidfn, oflags, 0600);
+
+	/* not every backing file system supports O_DIRECT */
+	if (fcmh_2_fd(f) == -1 && errno == EINVAL && (oflags & O_DIRECT)) {
+		OPSTAT_INCR("open-dio-einval");
+		oflags &= ~O_DIRECT;
+		fcmh_2_fd(f) = open(fidfn, oflags, 0600);
+	}
+	if (oflags & O_DIRECT)
+		f->fcmh_flags |= FCMH_IOD_DIRECTIO;
+	else
+		f->fcmh_flags &= ~FCMH_IOD_DIRECTIO;
+
 	if (fcmh_2_fd(f) == -1) {
 		rc = errno;
 		if (incr)
@@ -118,6 +137,62 @@ sli_open_backing_file(struct fidc_membh *f)
 	return (rc);
 }
 
+/*
+ * Obtain a buffered descriptor for a backing file opened with O_DIRECT,
+ * for writes whose length cannot satisfy O_DIRECT alignment.  The
+ * descriptor is opened on first use and lives until the backing file
+ * is closed.  Returns the descriptor or -1 on failure with errno set.
+ */
+int
+sli_fcmh_getbfd(struct fidc_membh *f)
+{
+	char fidfn[PATH_MAX];
+	int fd, incr;
+
+	FCMH_LOCK(f);
+	fd = fcmh_2_bfd(f);
+	FCMH_ULOCK(f);
+	if (fd != -1)
+		return (fd);
+
+	incr = psc_rlim_adj(RLIMIT_NOFILE, 1);
+	sli_fg_makepath(&f->fcmh_fg, fidfn);
+	fd = open(fidfn, O_RDWR);
+	if (fd == -1) {
+		if (incr)
+			psc_rlim_adj(RLIMIT_NOFILE, -1);
+		OPSTAT_INCR("open-bfd-fail");
+		return (-1);
+	}
+
+	FCMH_LOCK(f);
+	if (fcmh_2_bfd(f) == -1) {
+		fcmh_2_bfd(f) = fd;
+		FCMH_ULOCK(f);
+		OPSTAT_INCR("open-bfd");
+		return (fd);
+	}
+	/* lost a race with another writer */
+	FCMH_ULOCK(f);
+	close(fd);
+	if (incr)
+		psc_rlim_adj(RLIMIT_NOFILE, -1);
+	FCMH_LOCK(f);
+	fd = fcmh_2_bfd(f);
+	FCMH_ULOCK(f);
+	return (fd);
+}
+
+void
+sli_fcmh_close_bfd(struct fidc_membh *f)
+{
+	if (fcmh_2_bfd(f) == -1)
+		return;
+	close(fcmh_2_bfd(f));
+	fcmh_2_bfd(f) = -1;
+	psc_rlim_adj(RLIMIT_NOFILE, -1);
+}
+
 int
 sli_fcmh_getattr(struct fidc_membh *f)
 {
@@ -215,6 +290,7 @@ sli_fcmh_reopen(struct fidc_membh *f, const struct sl_fidgen *fg)
 			}
 			fcmh_2_fd(f) = -1;
 			psc_rlim_adj(RLIMIT_NOFILE, -1);
+			sli_fcmh_close_bfd(f);
 			f->fcmh_flags &= ~FCMH_IOD_BACKFILE;
 		}
 
@@ -258,6 +334,7 @@ sli_fcmh_ctor(struct fidc_membh *f, __unusedx int flags)
 
 	fii = fcmh_get_pri(f);
 	INIT_PSC_LISTENTRY(&fii->fii_lentry);
+	fii->fii_bfd = -1;
 	if (f->fcmh_fg.fg_gen == FGEN_ANY) {
 		DEBUG_FCMH(PLL_NOTICE, f, "refusing to open backing file "
 		    "with FGEN_ANY");
@@ -293,6 +370,7 @@ sli_fcmh_dtor(__unusedx struct fidc_membh *f)
 		} else
 			OPSTAT_INCR("close-succeed");
 		psc_rlim_adj(RLIMIT_NOFILE, -1);
+		sli_fcmh_close_bfd(f);
 		f->fcmh_flags &= ~FCMH_IOD_BACKFILE;
 	}
 }
@@ -35,6 +35,7 @@ struct fidc_membh;
 
 struct fcmh_iod_info {
 	int			fii_fd;		/* open file descriptor */
+	int			fii_bfd;	/* buffered fd for O_DIRECT mode */
 	uint32_t		fii_predio_boff;/* offset within bmap */
 	sl_bmapno_t		fii_predio_lastbno;
 	int			fii_predio_nseq;/* num sequential io's */
@@ -59,14 +60,18 @@ fii_2_fcmh(struct fcmh_iod_info *fii)
 
 /* sliod-specific fcmh_flags */
 #define FCMH_IOD_BACKFILE	(_FCMH_FLGSHFT << 0)    /* backing file exists */
+#define FCMH_IOD_DIRECTIO	(_FCMH_FLGSHFT << 1)    /* backing file opened O_DIRECT */
 
 #define fcmh_2_fd(fcmh)		fcmh_2_fii(fcmh)->fii_fd
+#define fcmh_2_bfd(fcmh)	fcmh_2_fii(fcmh)->fii_bfd
 
 #define sli_fcmh_get(fgp, fp)	fidc_lookup((fgp), FIDC_LOOKUP_CREATE, (fp))
 #define sli_fcmh_peek(fgp, fp)  fidc_lookup((fgp), FIDC_LOOKUP_NONE, (fp))
 
 void	sli_fg_makepath(const struct sl_fidgen *, char *);
 int	sli_fcmh_getattr(struct fidc_membh *);
+int	sli_fcmh_getbfd(struct fidc_membh *);
+void	sli_fcmh_close_bfd(struct fidc_membh *);
 int	sli_fcmh_lookup_fid(struct slashrpc_cservice *,
 	    const struct sl_fidgen *, const char *,
 	    struct sl_fidgen *, int *);
@@ -31,15 +31,22 @@
  */
 
 #include <stdio.h>
+#include <unistd.h>
 
+#include "pfl/alloc.h"
 #include "pfl/atomic.h"
+#include "pfl/crc.h"
+#include "pfl/ctlsvr.h"
 #include "pfl/listcache.h"
 #include "pfl/pool.h"
 #include "pfl/rpc.h"
+#include "pfl/time.h"
 #include "pfl/vbitmap.h"
+#include "pfl/workthr.h"
 
 #include "bmap.h"
 #include "bmap_iod.h"
+#include "cache_params.h"
 #include "fidc_iod.h"
 #include "fidcache.h"
 #include "repl_iod.h"
@@ -62,6 +69,9 @@ struct psc_lockedlist	 sli_replwkq_active =
     PLL_INIT(&sli_replwkq_active, struct sli_repl_workrq,
 	    srw_active_lentry);
 
+int			 sli_repl_window_max = SLI_REPL_WINDOW_MAX;
+int			 sli_repl_wakegen;	/* bumped under replwkq_pending lock */
+
 struct sli_repl_workrq *
 sli_repl_findwq(const struct sl_fidgen *fgp, sl_bmapno_t bmapno)
 {
@@ -94,6 +104,177 @@ sli_bwqueued_adj(int32_t *p, int amt_bytes)
 	freelock(&sli_ssfb_lock);
 }
 
+/*
+ * Reserve a slot in the REPL_READ window of a replication source.
+ * Returns zero if the window is full.
+ */
+int
+sli_repl_window_get(struct sl_resm *m)
+{
+	struct resm_iod_info *rmii;
+	int rc = 0;
+
+	rmii = resm2rmii(m);
+	spinlock(&rmii->rmii_lock);
+	if (rmii->rmii_infl < rmii->rmii_window) {
+		rmii->rmii_infl++;
+		rc = 1;
+	}
+	freelock(&rmii->rmii_lock);
+	if (!rc)
+		OPSTAT_INCR("repl-window-full");
+	return (rc);
+}
+
+/*
+ * Release a REPL_READ window slot.  If the read delivered @len bytes
+ * that were requested at @issued, fold the round trip into the
+ * estimates of the path's minimum RTT and delivery rate and, once per
+ * round trip, resize the window to twice the bandwidth-delay product
+ * so that it keeps probing for more bandwidth while the link allows.
+ */
+void
+sli_repl_window_put(struct sl_resm *m, const struct timespec *issued,
+    int len)
+{
+	struct resm_iod_info *rmii;
+	struct timespec now, d;
+	int64_t rtt, elapsed, rate, bdp;
+	int window;
+
+	PFL_GETTIMESPEC(&now);
+
+	rmii = resm2rmii(m);
+	spinlock(&rmii->rmii_lock);
+	psc_assert(rmii->rmii_infl > 0);
+	rmii->rmii_infl--;
+	if (issued == NULL || len <= 0)
+		goto out;
+
+	timespecsub(&now, issued, &d);
+	rtt = d.tv_sec * 1000000 + d.tv_nsec / 1000;
+	if (rmii->rmii_minrtt == 0 || rtt < rmii->rmii_minrtt)
+		rmii->rmii_minrtt = MAX(rtt, 1);
+	rmii->rmii_nbytes += len;
+
+	timespecsub(&now, &rmii->rmii_ts, &d);
+	elapsed = d.tv_sec * 1000000 + d.tv_nsec / 1000;
+	if (elapsed < rmii->rmii_minrtt)
+		goto out;
+
+	if (rmii->rmii_ts.tv_sec) {
+		rate = rmii->rmii_nbytes * 1000000 / elapsed;
+		rmii->rmii_bw = rmii->rmii_bw ?
+		    (rmii->rmii_bw * 7 + rate) / 8 : rate;
+	}
+	rmii->rmii_ts = now;
+	rmii->rmii_nbytes = 0;
+
+	bdp = rmii->rmii_bw * rmii->rmii_minrtt / 1000000;
+	window = howmany(bdp, SLASH_SLVR_SIZE) * 2;
+	window = MAX(window, SLI_REPL_WINDOW_MIN);
+	window = MIN(window, MAX(sli_repl_window_max,
+	    SLI_REPL_WINDOW_MIN));
+	if (window != rmii->rmii_window) {
+		psclog_diag("resm=%s window %d->%d bw=%"PRId64" "
+		    "minrtt=%"PRId64"us", m->resm_name,
+		    rmii->rmii_window, window, rmii->rmii_bw,
+		    rmii->rmii_minrtt);
+		rmii->rmii_window = window;
+	}
+ out:
+	freelock(&rmii->rmii_lock);
+	sli_repl_wakeup();
+}
+
+/*
+ * Kick the pending thread if it is backing off on a full window or
+ * slot array so it rescans the queue.
+ */
+void
+sli_repl_wakeup(void)
+{
+	LIST_CACHE_LOCK(&sli_replwkq_pending);
+	sli_repl_wakegen++;
+	psc_waitq_wakeall(&sli_replwkq_pending.plc_wq_empty);
+	LIST_CACHE_ULOCK(&sli_replwkq_pending);
+}
+
+/*
+ * Delta replication: before pulling anything, compare the CRC of each
+ * wanted sliver present in our backing file with the CRC the MDS has
+ * on record for the valid replica and drop the slivers that already
+ * match from the transfer.  This reads the whole bmap from disk, so it
+ * runs in a worker thread and the work item is only handed to the
+ * pending thread afterward, leaving other replications unhindered.
+ */
+__static int
+sli_repl_delta_wkcb(void *arg)
+{
+	struct sli_wkdata_repldelta *wk = arg;
+	struct sli_repl_workrq *w = wk->w;
+	struct bmap_iod_info *bii;
+	struct fidc_membh *f;
+	uint64_t crc, mdscrc;
+	int i, bits, len;
+	ssize_t rc;
+	void *buf;
+
+	f = w->srw_fcmh;
+	if (!(f->fcmh_flags & FCMH_IOD_BACKFILE))
+		goto out;
+
+	buf = psc_alloc(SLASH_SLVR_SIZE, PAF_PAGEALIGN);
+	bii = bmap_2_bii(w->srw_bcm);
+	for (i = 0; i < w->srw_nslvr_tot; i++) {
+		BMAP_LOCK(w->srw_bcm);
+		bits = bii->bii_crcstates[i];
+		mdscrc = bii->bii_crcs[i];
+		BMAP_ULOCK(w->srw_bcm);
+
+		if (!(bits & BMAP_SLVR_WANTREPL) ||
+		    (bits & BMAP_SLVR_CRCABSENT) ||
+		    (bits & (BMAP_SLVR_DATA | BMAP_SLVR_CRC)) !=
+		    (BMAP_SLVR_DATA | BMAP_SLVR_CRC))
+			continue;
+
+		memset(buf, 0, SLASH_SLVR_SIZE);
+		rc = pread(fcmh_2_fd(f), buf, SLASH_SLVR_SIZE,
+		    (off_t)w->srw_bmapno * SLASH_BMAP_SIZE +
+		    (off_t)i * SLASH_SLVR_SIZE);
+		if (rc <= 0)
+			continue;
+
+		psc_crc64_calc(&crc, buf, SLASH_SLVR_SIZE);
+		if (crc != mdscrc) {
+			OPSTAT_INCR("repl-delta-differ");
+			continue;
+		}
+
+		BMAP_LOCK(w->srw_bcm);
+		bii->bii_crcstates[i] &= ~BMAP_SLVR_WANTREPL;
+		BMAP_ULOCK(w->srw_bcm);
+
+		len = SLASH_SLVR_SIZE;
+		if ((unsigned)i == w->srw_len / SLASH_SLVR_SIZE)
+			len = w->srw_len % SLASH_SLVR_SIZE;
+
+		/* the sliver is as good as transferred */
+		spinlock(&w->srw_lock);
+		w->srw_nslvr_cur++;
+		w->srw_delta_saved += len;
+		freelock(&w->srw_lock);
+		OPSTAT_INCR("repl-delta-skip");
+		OPSTAT_ADD("repl-delta-saved-bytes", len);
+	}
+	psc_free(buf, PAF_PAGEALIGN);
+
+ out:
+	replwk_queue(w);
+	sli_replwkrq_decref(w, 0);
+	return (0);
+}
+
 /*
  * Add a piece of work to the scheduling engine.
  */
@@ -103,6 +284,7 @@ sli_repl_addwk(int op, sl_ios_id_t resid,
     sl_bmapgen_t bgen, int len, struct sli_batch_reply *bchrp,
     struct srt_replwk_repent *pp)
 {
+	struct sli_wkdata_repldelta *wk;
 	struct sli_repl_workrq *w = NULL;
 	struct sl_resource *res = NULL;
 	struct bmap_iod_info *bii;
@@ -194,7 +376,15 @@ sli_repl_addwk(int op, sl_ios_id_t resid,
 	} else {
 		/* add to current processing list */
 		pll_add(&sli_replwkq_active, w);
-		replwk_queue(w);
+		if (op == SLI_REPLWKOP_REPL && slcfg_local->cfg_repl_delta) {
+			psc_atomic32_inc(&w->srw_refcnt);
+			DEBUG_SRW(w, PLL_DEBUG, "incref");
+			wk = pfl_workq_getitem(sli_repl_delta_wkcb,
+			    struct sli_wkdata_repldelta);
+			wk->w = w;
+			pfl_workq_putitem(wk);
+		} else
+			replwk_queue(w);
 	}
 	return (rc);
 }
@@ -229,6 +419,11 @@ sli_replwkrq_decref(struct sli_repl_workrq *w, int rc)
 	}
 	DEBUG_SRW(w, PLL_DEBUG, "destroying");
 
+	if (w->srw_delta_saved)
+		psclog_diag("fid="SLPRI_FG" bmap=%d delta replication "
+		    "saved %"PRId64" bytes", SLPRI_FG_ARGS(&w->srw_fg),
+		    w->srw_bmapno, w->srw_delta_saved);
+
 	pll_remove(&sli_replwkq_active, w);
 
 	if (w->srw_op == SLI_REPLWKOP_REPL)
@@ -268,13 +463,15 @@ slireplpndthr_main(struct psc_thread *thr)
 	struct sli_repl_workrq *w, *wrap;
 	struct slashrpc_cservice *csvc;
 	struct sl_resm *src_resm;
-	int rc, slvridx, slvrno;
+	int rc, gen, slvridx, slvrno;
 	struct bmap_iod_info *bii;
 
 	wrap = NULL;
 	while (pscthr_run(thr)) {
 		slvrno = 0;
 		w = lc_getwait(&sli_replwkq_pending);
+		gen = sli_repl_wakegen;
+
 		spinlock(&w->srw_lock);
 		if (w->srw_status)
 			goto release;
@@ -312,15 +509,28 @@ slireplpndthr_main(struct psc_thread *thr)
 			if (w->srw_slvr[slvridx] == NULL)
 				break;
 
-		if (slvridx == nitems(w->srw_slvr)) {
+		if (w->srw_src_resm == NULL)
+			w->srw_src_resm = psc_dynarray_getpos(
+			    &w->srw_src_res->res_members, 0);
+
+		/*
+		 * Back off if there is no free slot or the source
+		 * already has a full window of reads outstanding.  Once
+		 * we have gone around the whole queue, sleep until a
+		 * completion frees a slot or new work arrives, unless
+		 * that already happened since we dequeued this item.
+		 */
+		if (slvridx == nitems(w->srw_slvr) ||
+		    !sli_repl_window_get(w->srw_src_resm)) {
 			BMAP_ULOCK(w->srw_bcm);
 			freelock(&w->srw_lock);
 			LIST_CACHE_LOCK(&sli_replwkq_pending);
 			replwk_queue(w);
-			if (w == wrap)
+			if (w == wrap && gen == sli_repl_wakegen)
 				psc_waitq_waitrel_us(
 				    &sli_replwkq_pending.plc_wq_empty,
-				    &sli_replwkq_pending.plc_lock, 10);
+				    &sli_replwkq_pending.plc_lock,
+				    SLI_REPL_BACKOFF_USECS);
 			else {
 				if (wrap == NULL)
 					wrap = w;
@@ -338,8 +548,7 @@ slireplpndthr_main(struct psc_thread *thr)
 		freelock(&w->srw_lock);
 
 		/* acquire connection to replication source & issue READ */
-		src_resm = psc_dynarray_getpos(
-		    &w->srw_src_res->res_members, 0);
+		src_resm = w->srw_src_resm;
 		csvc = sli_geticsvc(src_resm);
 
 		replwk_queue(w);
@@ -352,6 +561,7 @@ slireplpndthr_main(struct psc_thread *thr)
 			sl_csvc_decref(csvc);
 		}
 		if (rc) {
+			sli_repl_window_put(src_resm, NULL, 0);
 			spinlock(&w->srw_lock);
 			w->srw_slvr[slvridx] = NULL;
 			BMAP_LOCK(w->srw_bcm);
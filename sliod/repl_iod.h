@@ -41,6 +41,10 @@ struct slvr;
 
 #define SLI_REPL_SLVR_SCHED	((void *)0x1)
 
+#define SLI_REPL_WINDOW_MIN	2	/* REPL_READs in flight per source */
+#define SLI_REPL_WINDOW_MAX	64
+#define SLI_REPL_BACKOFF_USECS	100000	/* idle wait when all sources are busy */
+
 struct sli_batch_reply {
 	uint64_t		 id;
 	void			*buf;
@@ -55,12 +59,14 @@ struct sli_repl_workrq {
 	sl_bmapgen_t		 srw_bgen;		/* bmap generation */
 	uint32_t		 srw_len;		/* bmap size */
 	struct sl_resource	*srw_src_res;		/* repl source */
+	struct sl_resm		*srw_src_resm;
 
 	psc_spinlock_t		 srw_lock;
 	int32_t			 srw_status;		/* return code to pass back to MDS */
 	psc_atomic32_t		 srw_refcnt;		/* number of inflight slivers */
 	int			 srw_nslvr_tot;
 	int			 srw_nslvr_cur;
+	int64_t			 srw_delta_saved;	/* bytes not transferred */
 
 	struct sli_batch_reply	*srw_bchrp;
 	struct srt_replwk_repent*srw_pp;		/* batch reply buffer entry for
@@ -72,6 +78,18 @@ struct sli_repl_workrq {
 	struct psclist_head	 srw_pending_lentry;	/* entry in the pending list */
 
 	struct slvr		*srw_slvr[SLASH_SLVRS_PER_BMAP];
+	struct timespec		 srw_slvr_ts[SLASH_SLVRS_PER_BMAP];	/* REPL_READ issue time */
+};
+
+/* deferred write of a replicated sliver to the backing file */
+struct sli_wkdata_replwr {
+	struct sli_repl_workrq	*w;
+	int			 slvridx;
+};
+
+/* comparison of local sliver CRCs ahead of a delta replication */
+struct sli_wkdata_repldelta {
+	struct sli_repl_workrq	*w;
 };
 
 enum {
@@ -97,7 +115,12 @@ void	sli_bwqueued_adj(int32_t *, int);
 
 void	replwk_queue(struct sli_repl_workrq *);
 
+int	sli_repl_window_get(struct sl_resm *);
+void	sli_repl_window_put(struct sl_resm *, const struct timespec *, int);
+void	sli_repl_wakeup(void);
+
 extern struct psc_lockedlist	 sli_replwkq_active;
 extern struct psc_listcache	 sli_replwkq_pending;
+extern int			 sli_repl_window_max;
 
 #endif /* _REPL_IOD_H_ */
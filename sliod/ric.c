@@ -28,6 +28,7 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "pfl/ctlsvr.h"
 #include "pfl/opstats.h"
@@ -53,6 +54,12 @@
 void				*sli_benchmark_buf;
 uint32_t			 sli_benchmark_bufsiz;
 
+/*
+ * Push the data of a write RPC, already in the slabs of its slivers,
+ * to the backing file.  In write-back mode the range is only marked
+ * dirty unless too much dirty data is outstanding, in which case the
+ * writer pays for a flush itself.
+ */
 int
 sli_ric_write_sliver(uint32_t off, uint32_t size, struct slvr **slvrs,
     int nslvrs)
@@ -72,7 +79,15 @@ sli_ric_write_sliver(uint32_t off, uint32_t size, struct slvr **slvrs,
 		    SLASH_SLVR_BLKSZ, tsize);
 
 		tsize -= tsz;
-		rc = slvr_fsbytes_wio(slvrs[i], sblk, tsz);
+		if (sli_wb_enable) {
+			slvr_wb_mark(slvrs[i], sblk, tsz);
+			if (psc_atomic32_read(&sli_wb_ndirty) >
+			    sli_wb_max_slvrs) {
+				OPSTAT_INCR("wb-throttle");
+				rc = slvr_wb_flush(slvrs[i]);
+			}
+		} else
+			rc = slvr_fsbytes_wio(slvrs[i], sblk, tsz);
 		if (rc) {
 			psc_assert(rc != -SLERR_AIOWAIT);
 			psclog_warnx("write error rc=%d", rc);
@@ -125,6 +140,7 @@ sli_ric_handle_io(struct pscrpc_request *rq, enum rw rw)
 	struct srm_io_req *mq;
 	struct srm_io_rep *mp;
 	struct fidc_membh *f;
+	unsigned char *data = NULL;
 	struct bmap *bmap;
 	uint64_t seqno;
 	ssize_t rv;
@@ -144,10 +160,35 @@ sli_ric_handle_io(struct pscrpc_request *rq, enum rw rw)
 		return (mp->rc);
 	}
 
+	/*
+	 * Small I/O data rides in the message (see SRM_IO_INLINE_MAX):
+	 * WRITE data in the request, READ data in the reply buffer set
+	 * up by sli_rpc_allocrep().
+	 */
+	if ((rw == SL_WRITE && rq->rq_reqmsg->bufcount > 2) ||
+	    (rw == SL_READ && (mq->flags & SRM_IOF_REPDATA))) {
+		if (rw == SL_WRITE && mq->size <= SRM_IO_INLINE_MAX)
+			data = pscrpc_msg_buf(rq->rq_reqmsg, 1,
+			    mq->size);
+		else if (rw == SL_READ && rq->rq_repmsg->bufcount > 2)
+			data = pscrpc_msg_buf(rq->rq_repmsg, 1,
+			    mq->size);
+		if (data == NULL) {
+			psclog_errorx("invalid inline size %u, "
+			    "fid:"SLPRI_FG, mq->size,
+			    SLPRI_FG_ARGS(fgp));
+			mp->rc = -EINVAL;
+			return (mp->rc);
+		}
+	}
+
 	/* network stack test/benchmarking mode */
 	if (mq->flags & SRM_IOF_BENCH) {
 		static struct psc_spinlock lock = SPINLOCK_INIT;
 
+		if (data)
+			return (0);
+
 		spinlock(&lock);
 		if (mq->size > sli_benchmark_bufsiz) {
 			sli_benchmark_buf = psc_realloc(
@@ -349,13 +390,30 @@ sli_ric_handle_io(struct pscrpc_request *rq, enum rw rw)
 		}
 	}
 
-	/*
-	 * We must return an error code to the RPC itself if we don't
-	 * call slrpc_bulkserver() or slrpc_bulkclient() as expected.
-	 */
-	rc = mp->rc = slrpc_bulkserver(rq,
-	    rw == SL_WRITE ? BULK_GET_SINK : BULK_PUT_SOURCE,
-	    SRIC_BULK_PORTAL, iovs, nslvrs);
+	if (data) {
+		for (i = 0; i < nslvrs; i++) {
+			if (rw == SL_WRITE)
+				memcpy(iovs[i].iov_base, data,
+				    iovs[i].iov_len);
+			else
+				memcpy(data, iovs[i].iov_base,
+				    iovs[i].iov_len);
+			data += iovs[i].iov_len;
+		}
+		mp->size = mq->size;
+		if (rw == SL_WRITE)
+			OPSTAT_INCR("write-inline");
+		else
+			OPSTAT_INCR("read-inline");
+	} else
+		/*
+		 * We must return an error code to the RPC itself if we
+		 * don't call slrpc_bulkserver() or slrpc_bulkclient()
+		 * as expected.
+		 */
+		rc = mp->rc = slrpc_bulkserver(rq,
+		    rw == SL_WRITE ? BULK_GET_SINK : BULK_PUT_SOURCE,
+		    SRIC_BULK_PORTAL, iovs, nslvrs);
 	if (rc) {
 		psclog_warnx("bulkserver error on %s, rc=%d",
 		    rw == SL_WRITE ? "write" : "read", rc);
@@ -438,8 +496,11 @@ sli_ric_handle_rlsbmap(struct pscrpc_request *rq)
 		/*
 		 * fsync here to guarantee that buffers are flushed to
 		 * disk before the MDS releases its odtable entry for
-		 * this bmap.
+		 * this bmap.  Any write-back data still in the sliver
+		 * cache must reach the backing file first.
 		 */
+		slvr_wb_flush_fcmh(f);
+
 		FCMH_LOCK(f);
 		if (f->fcmh_flags & FCMH_IOD_BACKFILE) {
 			FCMH_ULOCK(f);
@@ -33,6 +33,8 @@
 #include "pfl/rpclog.h"
 #include "pfl/rsx.h"
 #include "pfl/service.h"
+#include "pfl/time.h"
+#include "pfl/workthr.h"
 
 #include "authbuf.h"
 #include "bmap.h"
@@ -50,6 +52,49 @@
 #define SRII_REPLREAD_CBARG_CSVC	2
 #define SRII_REPLREAD_CBARG_LEN		0
 
+/*
+ * Write a replicated sliver to the backing file and release it along
+ * with the reference it holds on the work item.
+ */
+__static int
+sli_rii_replread_finish(struct sli_repl_workrq *w, int slvridx, int rc)
+{
+	struct slvr *s;
+	int slvrsiz;
+
+	s = w->srw_slvr[slvridx];
+
+	if (rc == 0) {
+		slvrsiz = SLASH_SLVR_SIZE;
+		if (s->slvr_num == w->srw_len / SLASH_SLVR_SIZE)
+			slvrsiz = w->srw_len % SLASH_SLVR_SIZE;
+		rc = slvr_fsbytes_wio(s, 0, slvrsiz);
+	}
+
+	slvr_io_done(s, rc);
+	slvr_wio_done(s, 1);
+
+	spinlock(&w->srw_lock);
+	w->srw_nslvr_cur++;
+	w->srw_slvr[slvridx] = NULL;
+	freelock(&w->srw_lock);
+
+	replwk_queue(w);
+	sli_repl_wakeup();
+	sli_replwkrq_decref(w, rc);
+
+	return (rc);
+}
+
+__static int
+sli_rii_replread_write_wkcb(void *arg)
+{
+	struct sli_wkdata_replwr *wk = arg;
+
+	sli_rii_replread_finish(wk->w, wk->slvridx, 0);
+	return (0);
+}
+
 /*
  * We call this function in the following two cases:
  *
@@ -61,8 +106,8 @@ __static int
 sli_rii_replread_release_sliver(struct sli_repl_workrq *w, int slvridx,
     int rc)
 {
+	struct sli_wkdata_replwr *wk;
 	struct slvr *s;
-	int slvrsiz;
 
 	s = w->srw_slvr[slvridx];
 
@@ -82,25 +127,22 @@ sli_rii_replread_release_sliver(struct sli_repl_workrq *w, int slvridx,
 		return (rc);
 	}
 
+	/*
+	 * Hand the write off to the worker threads so the RPC threads
+	 * can go on receiving the rest of the window while the data
+	 * lands on disk.
+	 */
 	if (rc == 0) {
-		slvrsiz = SLASH_SLVR_SIZE;
-		if (s->slvr_num == w->srw_len / SLASH_SLVR_SIZE)
-			slvrsiz = w->srw_len % SLASH_SLVR_SIZE;
-		rc = slvr_fsbytes_wio(s, 0, slvrsiz);
+		wk = pfl_workq_getitem(sli_rii_replread_write_wkcb,
+		    struct sli_wkdata_replwr);
+		wk->w = w;
+		wk->slvridx = slvridx;
+		pfl_workq_putitem(wk);
+		OPSTAT_INCR("repl-write-async");
+		return (0);
 	}
 
-	slvr_io_done(s, rc);
-	slvr_wio_done(s, 1);
-
-	spinlock(&w->srw_lock);
-	w->srw_nslvr_cur++;
-	w->srw_slvr[slvridx] = NULL;
-	freelock(&w->srw_lock);
-
-	replwk_queue(w);
-	sli_replwkrq_decref(w, rc);
-
-	return (rc);
+	return (sli_rii_replread_finish(w, slvridx, rc));
 }
 
 /*
@@ -289,6 +331,10 @@ sli_rii_handle_repl_read_aio(struct pscrpc_request *rq)
 
 	sli_bwqueued_adj(&sli_bwqueued.sbq_egress, -mq->len);
 
+	/* the REPL_READ held its window slot until the data arrived */
+	sli_repl_window_put(w->srw_src_resm, mp->rc ? NULL :
+	    &w->srw_slvr_ts[slvridx], mq->len);
+
 	sli_rii_replread_release_sliver(w, slvridx, mp->rc);
 
  out:
@@ -309,7 +355,7 @@ sli_rii_replread_cb(struct pscrpc_request *rq,
 	struct slashrpc_cservice *csvc = args->pointer_arg[SRII_REPLREAD_CBARG_CSVC];
 	struct sli_repl_workrq *w = args->pointer_arg[SRII_REPLREAD_CBARG_WKRQ];
 	struct slvr *s = args->pointer_arg[SRII_REPLREAD_CBARG_SLVR];
-	int rc, slvridx;
+	int rc, slvridx, len;
 
 	SL_GET_RQ_STATUS_TYPE(csvc, rq, struct srm_repl_read_rep, rc);
 
@@ -319,6 +365,19 @@ sli_rii_replread_cb(struct pscrpc_request *rq,
 			break;
 	psc_assert(slvridx < (int)nitems(w->srw_slvr));
 
+	/*
+	 * Only a read that brought the data back is a meaningful
+	 * round trip sample.  With AIO the source pushes the data
+	 * later and the transfer keeps its window slot until then; see
+	 * sli_rii_handle_repl_read_aio().
+	 */
+	len = SLASH_SLVR_SIZE;
+	if (s->slvr_num == w->srw_len / SLASH_SLVR_SIZE)
+		len = w->srw_len % SLASH_SLVR_SIZE;
+	if (rc != -SLERR_AIOWAIT)
+		sli_repl_window_put(w->srw_src_resm, rc ? NULL :
+		    &w->srw_slvr_ts[slvridx], len);
+
 	if (rc == -SLERR_AIOWAIT)
 		OPSTAT_INCR("issue-replread-aio");
 	else if (rc)
@@ -391,6 +450,7 @@ sli_rii_issue_repl_read(struct slashrpc_cservice *csvc, int slvrno,
 	rq->rq_async_args.pointer_arg[SRII_REPLREAD_CBARG_SLVR] = s;
 	rq->rq_async_args.pointer_arg[SRII_REPLREAD_CBARG_CSVC] = csvc;
 
+	PFL_GETTIMESPEC(&w->srw_slvr_ts[slvridx]);
 	rc = SL_NBRQSET_ADD(csvc, rq);
 	if (rc == 0)
 		rq = NULL;
@@ -184,6 +184,7 @@ sli_rim_handle_reclaim(struct pscrpc_request *rq)
 			if (f->fcmh_flags & FCMH_IOD_BACKFILE) {
 				close(fcmh_2_fd(f));
 				fcmh_2_fd(f) = -1;
+				sli_fcmh_close_bfd(f);
 				f->fcmh_flags &= ~FCMH_IOD_BACKFILE;
 				OPSTAT_INCR("reclaim-close");
 			}
@@ -324,6 +324,21 @@ int
 sli_rpc_allocrep(struct pscrpc_request *rq, void *mqp, int qlen,
     void *mpp, int plen, int rcoff)
 {
+	if (rq->rq_rqbd->rqbd_service == sli_ric_svc.svh_service &&
+	    rq->rq_reqmsg->opc == SRMT_READ) {
+		const struct srm_io_req *mq;
+
+		/* small READ data goes back in the reply message */
+		mq = pscrpc_msg_buf(rq->rq_reqmsg, 0, qlen);
+		if (mq && (mq->flags & SRM_IOF_REPDATA) &&
+		    mq->size && mq->size <= SRM_IO_INLINE_MAX) {
+			int plens[] = { plen, mq->size,
+			    sizeof(struct srt_authbuf_footer) };
+
+			return (slrpc_allocrepn(rq, mqp, qlen, mpp,
+			    nitems(plens), plens, rcoff));
+		}
+	}
 	if (rq->rq_rqbd->rqbd_service == sli_rim_svc.svh_service) {
 		int rc, np = 1, plens[3] = { plen };
 		struct pscrpc_msg *qm = rq->rq_reqmsg;
@@ -41,8 +41,8 @@ struct sli_repl_workrq;
 
 #define SLI_RIC_NTHREADS	32
 #define SLI_RIC_NBUFS		4096
-#define SLI_RIC_BUFSZ		648
-#define SLI_RIC_REPSZ		256
+#define SLI_RIC_BUFSZ		(648 + SRM_IO_INLINE_MAX)
+#define SLI_RIC_REPSZ		(256 + SRM_IO_INLINE_MAX)
 #define SLI_RIC_SVCNAME		"sliric"
 
 #define SLI_RII_NTHREADS	32
@@ -51,7 +51,8 @@ sl_buffer_init(__unusedx struct psc_poolmgr *m, void *pri)
 {
 	struct sl_buffer *slb = pri;
 
-	slb->slb_base = PSCALLOC(SLASH_SLVR_SIZE);
+	/* page aligned so slivers may be used for O_DIRECT I/O */
+	slb->slb_base = psc_alloc(SLASH_SLVR_SIZE, PAF_PAGEALIGN);
 	INIT_LISTENTRY(&slb->slb_mgmt_lentry);
 
 	return (0);
@@ -62,7 +63,7 @@ sl_buffer_destroy(void *pri)
 {
 	struct sl_buffer *slb = pri;
 
-	PSCFREE(slb->slb_base);
+	psc_free(slb->slb_base, PAF_PAGEALIGN);
 }
 
 void
@@ -26,6 +26,7 @@
 #define _SLIOD_H_
 
 #include "pfl/cdefs.h"
+#include "pfl/lock.h"
 #include "pfl/opstats.h"
 #include "pfl/service.h"
 #include "pfl/thread.h"
@@ -59,7 +60,8 @@ enum {
 	SLITHRT_SLVR_CRC,	/* sliver CRC updaters */
 	SLITHRT_STATFS,		/* statvfs(2) updater */
 	SLITHRT_USKLNDPL,	/* userland socket Lustre net dev poll thr */
-	SLITHRT_WORKER		/* generic worker thread */
+	SLITHRT_WORKER,		/* generic worker thread */
+	SLITHRT_WRITEBACK	/* sliver write-back flusher */
 };
 
 #define NSLVRCRC_THRS		4	/* perhaps default to ncores + configurable? */
@@ -88,7 +90,19 @@ PSCTHR_MKCAST(sliricthr, sliric_thread, SLITHRT_RIC)
 PSCTHR_MKCAST(slirimthr, slirim_thread, SLITHRT_RIM)
 PSCTHR_MKCAST(sliriithr, slirii_thread, SLITHRT_RII)
 
+/*
+ * Per-peer replication transfer state.  We keep up to rmii_window
+ * REPL_READs in flight to a replication source and size the window to
+ * the bandwidth-delay product measured on completions.
+ */
 struct resm_iod_info {
+	psc_spinlock_t		 rmii_lock;
+	int			 rmii_infl;		/* REPL_READs in flight */
+	int			 rmii_window;		/* max REPL_READs in flight */
+	int64_t			 rmii_minrtt;		/* usecs */
+	int64_t			 rmii_bw;		/* bytes/sec */
+	int64_t			 rmii_nbytes;		/* delivered since rmii_ts */
+	struct timespec		 rmii_ts;		/* start of rate sample */
 };
 
 static __inline struct resm_iod_info *
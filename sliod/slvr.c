@@ -30,6 +30,13 @@
 #define PSC_SUBSYS SLISS_SLVR
 #include "subsys_iod.h"
 
+#include <sys/uio.h>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "pfl/alloc.h"
 #include "pfl/atomic.h"
 #include "pfl/ctlsvr.h"
 #include "pfl/fault.h"
@@ -40,6 +47,7 @@
 #include "pfl/rsx.h"
 #include "pfl/treeutil.h"
 #include "pfl/vbitmap.h"
+#include "pfl/workthr.h"
 
 #include "bmap_iod.h"
 #include "fidc_iod.h"
@@ -64,11 +72,17 @@ struct psc_listcache	 sli_iocb_pndg;
 
 psc_atomic64_t		 sli_aio_id = PSC_ATOMIC64_INIT(0);
 
-struct psc_listcache	 sli_lruslvrs;		/* LRU list of clean slivers which may be reaped */
+struct sli_lru_shard	*sli_lru_shards;	/* per-CPU clocks of clean slivers which may be reaped */
+int			 sli_nlru_shards;
 struct psc_listcache	 sli_crcqslvrs;		/* Slivers ready to be CRC'd and have their
 						 * CRCs shipped to the MDS. */
+struct psc_listcache	 sli_wbqslvrs;		/* Slivers holding unwritten data */
 
-SPLAY_GENERATE(biod_slvrtree, slvr, slvr_tentry, slvr_cmp)
+int			 sli_wb_enable;
+int			 sli_wb_delay_ms = SLI_WB_DELAY_MS;
+int			 sli_wb_max_slvrs;
+psc_atomic32_t		 sli_wb_ndirty = PSC_ATOMIC32_INIT(0);
+struct psc_waitq	 sli_wb_waitq = PSC_WAITQ_INIT;	/* write-back thread */
 
 /*
  * Take the CRC of the data contained within a sliver and add the update
@@ -479,12 +493,108 @@ sli_aio_register(struct slvr *s)
 	return (-error);
 }
 
+/*
+ * Write to the backing file of a sliver.  Slabs are page aligned and
+ * writes always start on a sliver block boundary, so in direct I/O
+ * mode only the length can violate O_DIRECT alignment: the aligned
+ * bulk goes through the O_DIRECT descriptor and any short tail past
+ * the last full page is written through a buffered descriptor.  Such
+ * tails come from writes ending at EOF but also from small writes in
+ * the middle of a file, so a worker pushes the tail out to disk and
+ * drops it from the page cache rather than leaving the kernel to
+ * reconcile it with later direct I/O to the same pages.  The writer
+ * does not wait for this; the kernel keeps the two coherent meanwhile.
+ */
+__static int
+slvr_dio_tail_wkcb(void *arg)
+{
+	struct sli_wkdata_dio_tail *wk = arg;
+
+#ifdef SYNC_FILE_RANGE_WRITE
+	if (sync_file_range(wk->fd, wk->off, wk->len,
+	    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+	    SYNC_FILE_RANGE_WAIT_AFTER) == -1)
+#else
+	if (fdatasync(wk->fd) == -1)
+#endif
+		OPSTAT_INCR("dio-tail-flush-fail");
+	else
+		posix_fadvise(wk->fd, wk->off, wk->len, POSIX_FADV_DONTNEED);
+	close(wk->fd);
+	return (0);
+}
+
+__static ssize_t
+slvr_pwritev(struct slvr *s, struct iovec *iovs, int n, off_t foff)
+{
+	struct sli_wkdata_dio_tail *wk;
+	struct fidc_membh *f;
+	struct iovec *last;
+	ssize_t rc, rc2;
+	size_t len = 0, tail;
+	int fd, i;
+
+	f = slvr_2_fcmh(s);
+	if (!(f->fcmh_flags & FCMH_IOD_DIRECTIO))
+		return (pwritev(slvr_2_fd(s), iovs, n, foff));
+
+	psc_assert((foff & (SLI_DIO_ALIGN - 1)) == 0);
+	for (i = 0; i < n; i++)
+		len += iovs[i].iov_len;
+	tail = len & (SLI_DIO_ALIGN - 1);
+	if (tail == 0)
+		return (pwritev(slvr_2_fd(s), iovs, n, foff));
+
+	/* every segment but the last spans whole slivers */
+	last = &iovs[n - 1];
+	psc_assert(last->iov_len >= tail);
+	rc = 0;
+	if (len > tail) {
+		last->iov_len -= tail;
+		rc = pwritev(slvr_2_fd(s), iovs, last->iov_len ? n :
+		    n - 1, foff);
+		last->iov_len += tail;
+		if (rc == -1)
+			return (-1);
+		if ((size_t)rc != len - tail)
+			return (rc);
+	}
+
+	fd = sli_fcmh_getbfd(f);
+	if (fd == -1)
+		return (-1);
+	foff += rc;
+	rc2 = pwrite(fd, (char *)last->iov_base + last->iov_len - tail,
+	    tail, foff);
+	if (rc2 == -1)
+		return (-1);
+	OPSTAT_INCR("dio-tail-write");
+
+	/*
+	 * The worker gets its own descriptor as the buffered one may be
+	 * closed along with the backing file in the meantime.
+	 */
+	fd = dup(fd);
+	if (fd == -1) {
+		OPSTAT_INCR("dio-tail-dup-fail");
+		return (rc + rc2);
+	}
+	wk = pfl_workq_getitem(slvr_dio_tail_wkcb,
+	    struct sli_wkdata_dio_tail);
+	wk->fd = fd;
+	wk->off = foff;
+	wk->len = rc2;
+	pfl_workq_putitem(wk);
+	return (rc + rc2);
+}
+
 __static ssize_t
 slvr_fsio(struct slvr *s, uint32_t off, uint32_t size, enum rw rw)
 {
 	int sblk, nblks, save_errno = 0;
 	struct timespec ts0, ts1, tsd;
 	struct fidc_membh *f;
+	struct iovec iov;
 	uint64_t *v8;
 	ssize_t	rc;
 	size_t foff;
@@ -567,8 +677,9 @@ slvr_fsio(struct slvr *s, uint32_t off, uint32_t size, enum rw rw)
 		 * wait for this counter to reach zero.
 		 */
 
-		rc = pwrite(slvr_2_fd(s), slvr_2_buf(s, sblk), size,
-		    foff);
+		iov.iov_base = slvr_2_buf(s, sblk);
+		iov.iov_len = size;
+		rc = slvr_pwritev(s, &iov, 1, foff);
 		if (rc == -1) {
 			save_errno = errno;
 			OPSTAT_INCR("fsio-write-fail");
@@ -626,6 +737,232 @@ slvr_fsbytes_wio(struct slvr *s, uint32_t sblk, uint32_t size)
 	return (slvr_fsio(s, sblk * SLASH_SLVR_BLKSZ, size, SL_WRITE));
 }
 
+/*
+ * Add a range to the dirty range of a sliver, queueing it for
+ * write-back if it was clean.
+ */
+__static void
+slvr_wb_dirty_locked(struct slvr *s, uint32_t soff, uint32_t eoff)
+{
+	SLVR_LOCK_ENSURE(s);
+	if (s->slvr_flags & SLVRF_WBDIRTY) {
+		s->slvr_wb_soff = MIN(s->slvr_wb_soff, soff);
+		s->slvr_wb_eoff = MAX(s->slvr_wb_eoff, eoff);
+	} else {
+		s->slvr_flags |= SLVRF_WBDIRTY;
+		s->slvr_wb_soff = soff;
+		s->slvr_wb_eoff = eoff;
+		PFL_GETTIMESPEC(&s->slvr_wb_ts);
+		lc_addtail(&sli_wbqslvrs, s);
+		psc_atomic32_inc(&sli_wb_ndirty);
+	}
+	DEBUG_SLVR(PLL_DIAG, s, "wb dirty %u-%u", s->slvr_wb_soff,
+	    s->slvr_wb_eoff);
+}
+
+/*
+ * Record that a client write has landed in a sliver's slab without
+ * being written to the backing file.  The caller must own the
+ * SLVRF_FAULTING bit of the sliver.
+ * @s: the sliver.
+ * @sblk: first block written.
+ * @size: number of bytes written starting at @sblk.
+ */
+void
+slvr_wb_mark(struct slvr *s, uint32_t sblk, uint32_t size)
+{
+	uint32_t soff, eoff;
+
+	soff = sblk * SLASH_SLVR_BLKSZ;
+	eoff = soff + size;
+	psc_assert(eoff <= SLASH_SLVR_SIZE);
+
+	SLVR_LOCK(s);
+	if (s->slvr_flags & SLVRF_WBDIRTY)
+		OPSTAT_INCR("wb-pwrite-saved");
+	slvr_wb_dirty_locked(s, soff, eoff);
+	SLVR_ULOCK(s);
+
+	OPSTAT_ADD("wb-write-bytes", size);
+}
+
+/*
+ * Claim the dirty range of a sliver for writing, taking it off the
+ * write-back queue.  Returns zero if there was nothing to write.
+ */
+__static int
+slvr_wb_claim_locked(struct slvr *s, uint32_t *soff, uint32_t *eoff)
+{
+	SLVR_LOCK_ENSURE(s);
+	if (!(s->slvr_flags & SLVRF_WBDIRTY))
+		return (0);
+	*soff = s->slvr_wb_soff;
+	*eoff = s->slvr_wb_eoff;
+	s->slvr_flags &= ~SLVRF_WBDIRTY;
+	lc_remove(&sli_wbqslvrs, s);
+	psc_atomic32_dec(&sli_wb_ndirty);
+	return (1);
+}
+
+/*
+ * Write back the dirty range of a sliver.  Dirty ranges of following
+ * slivers in the same bmap are appended to the same pwritev(2) as long
+ * as each one picks up exactly where the previous one ends.  The
+ * caller must own the SLVRF_FAULTING bit of @s, which keeps writers
+ * out while the slab is being written.  On failure, the ranges are
+ * marked dirty again so they are retried later.
+ */
+int
+slvr_wb_flush(struct slvr *s)
+{
+	struct slvr *t, *run[SLI_WB_MAXRUN];
+	uint32_t soffs[SLI_WB_MAXRUN], eoffs[SLI_WB_MAXRUN];
+	struct iovec iovs[SLI_WB_MAXRUN];
+	struct bmap_iod_info *bii;
+	uint32_t soff, eoff;
+	int i, n = 0, rc = 0;
+	ssize_t len = 0, rv;
+	off_t foff;
+
+	SLVR_LOCK(s);
+	if (!slvr_wb_claim_locked(s, &soff, &eoff)) {
+		SLVR_ULOCK(s);
+		return (0);
+	}
+	SLVR_ULOCK(s);
+
+	foff = slvr_2_fileoff(s, 0) + soff;
+	run[n] = s;
+	soffs[n] = soff;
+	eoffs[n] = eoff;
+	iovs[n].iov_base = slvr_2_buf(s, 0) + soff;
+	len += iovs[n++].iov_len = eoff - soff;
+
+	bii = slvr_2_bii(s);
+	while (n < SLI_WB_MAXRUN && eoff == SLASH_SLVR_SIZE &&
+	    run[n - 1]->slvr_num + 1 < SLASH_SLVRS_PER_BMAP) {
+		BII_LOCK(bii);
+		t = bii->bii_slvrs[run[n - 1]->slvr_num + 1];
+		if (t == NULL || !SLVR_TRYLOCK(t)) {
+			BII_ULOCK(bii);
+			break;
+		}
+		BII_ULOCK(bii);
+		if ((t->slvr_flags & (SLVRF_FAULTING | SLVRF_FREEING |
+		    SLVRF_DATAERR)) || !(t->slvr_flags & SLVRF_WBDIRTY) ||
+		    t->slvr_wb_soff) {
+			SLVR_ULOCK(t);
+			break;
+		}
+		slvr_wb_claim_locked(t, &soff, &eoff);
+		t->slvr_flags |= SLVRF_FAULTING;
+		SLVR_ULOCK(t);
+
+		run[n] = t;
+		soffs[n] = soff;
+		eoffs[n] = eoff;
+		iovs[n].iov_base = slvr_2_buf(t, 0);
+		len += iovs[n++].iov_len = eoff;
+	}
+
+	if (!(slvr_2_fcmh(s)->fcmh_flags & FCMH_IOD_BACKFILE)) {
+		OPSTAT_INCR("no-backfile");
+		rc = -EBADF;
+	} else {
+		rv = slvr_pwritev(s, iovs, n, foff);
+		if (rv == -1)
+			rc = -errno;
+		else if (rv != len)
+			rc = -EIO;
+		else
+			pfl_opstat_add(sli_backingstore_iostats.wr, rv);
+	}
+
+	OPSTAT_INCR("wb-flush");
+	OPSTAT_ADD("wb-flush-bytes", len);
+	if (n > 1)
+		OPSTAT_ADD("wb-flush-coalesced", n - 1);
+
+	/*
+	 * The client has long been told its write succeeded, so the
+	 * data must stay in the slab until it makes it to disk.
+	 */
+	if (rc) {
+		OPSTAT_INCR("wb-flush-fail");
+		DEBUG_SLVR(PLL_ERROR, s, "write-back failed nslvrs=%d "
+		    "len=%zd off=%"PSCPRIdOFFT" rc=%d", n, len, foff, rc);
+	}
+
+	for (i = 0; i < n; i++) {
+		t = run[i];
+		SLVR_LOCK(t);
+		if (rc)
+			slvr_wb_dirty_locked(t, soffs[i], eoffs[i]);
+		if (i) {
+			t->slvr_flags &= ~SLVRF_FAULTING;
+			SLVR_WAKEUP(t);
+		}
+		SLVR_ULOCK(t);
+	}
+	return (rc);
+}
+
+/*
+ * Write back all dirty slivers of a file, e.g. before its bmap leases
+ * are released.
+ */
+void
+slvr_wb_flush_fcmh(struct fidc_membh *f)
+{
+	struct psc_dynarray a = DYNARRAY_INIT;
+	struct bmap_iod_info *bii;
+	struct bmap *b;
+	struct slvr *s;
+	int i, n;
+
+	if (!sli_wb_enable)
+		return;
+
+	FCMH_LOCK(f);
+	RB_FOREACH(b, bmaptree, &f->fcmh_bmaptree) {
+		bmap_op_start_type(b, BMAP_OPCNT_WRITEBACK);
+		psc_dynarray_add(&a, b);
+	}
+	FCMH_ULOCK(f);
+
+	DYNARRAY_FOREACH(b, i, &a) {
+		bii = bmap_2_bii(b);
+		for (n = 0; n < SLASH_SLVRS_PER_BMAP; n++) {
+			BII_LOCK(bii);
+			s = bii->bii_slvrs[n];
+			if (s == NULL) {
+				BII_ULOCK(bii);
+				continue;
+			}
+			SLVR_LOCK(s);
+			BII_ULOCK(bii);
+			if (!(s->slvr_flags & SLVRF_WBDIRTY)) {
+				SLVR_ULOCK(s);
+				continue;
+			}
+			s->slvr_refcnt++;
+			SLVR_WAIT(s, s->slvr_flags & SLVRF_FAULTING);
+			s->slvr_flags |= SLVRF_FAULTING;
+			SLVR_ULOCK(s);
+
+			slvr_wb_flush(s);
+
+			SLVR_LOCK(s);
+			s->slvr_flags &= ~SLVRF_FAULTING;
+			SLVR_WAKEUP(s);
+			SLVR_ULOCK(s);
+			slvr_rio_done(s);
+		}
+		bmap_op_done_type(b, BMAP_OPCNT_WRITEBACK);
+	}
+	psc_dynarray_free(&a);
+}
+
 /*
  * Prepare a sliver for an incoming I/O.  This may entail faulting 32k
  * aligned regions in from the underlying fs.
@@ -702,6 +1039,60 @@ slvr_io_prep(struct slvr *s, uint32_t off, uint32_t len, enum rw rw,
 	return (rc);
 }
 
+/*
+ * Acquire a sliver list lock, accounting for the times we had to spin
+ * because another thread held it.
+ *
+ * Locking convention: it is legal to request for a list lock while
+ * holding the sliver lock.  On the other hand, when you already hold
+ * the list lock, you should drop the list lock first before asking for
+ * the sliver lock or you should use trylock().
+ */
+#define SLVR_LIST_LOCK(lc, stat)					\
+	do {								\
+		if (!LIST_CACHE_TRYLOCK(lc)) {				\
+			OPSTAT_INCR(stat);				\
+			LIST_CACHE_LOCK(lc);				\
+		}							\
+	} while (0)
+
+/*
+ * Place a clean sliver on the LRU shard of the CPU we are running on.
+ * The sliver stays in that shard until it is dirtied or freed.
+ */
+void
+slvr_lru_add(struct slvr *s)
+{
+	struct sli_lru_shard *sls;
+	int cpu;
+
+	cpu = sched_getcpu();
+	if (cpu < 0)
+		cpu = 0;
+	s->slvr_shard = cpu % sli_nlru_shards;
+	s->slvr_flags &= ~(SLVRF_REFERENCED | SLVRF_HOT);
+
+	sls = slvr_2_shard(s);
+	SLVR_LIST_LOCK(&sls->sls_lru, "slvr-lru-contend");
+	lc_addtail(&sls->sls_lru, s);
+	LIST_CACHE_ULOCK(&sls->sls_lru);
+}
+
+void
+slvr_lru_remove(struct slvr *s)
+{
+	struct sli_lru_shard *sls;
+
+	sls = slvr_2_shard(s);
+	SLVR_LIST_LOCK(&sls->sls_lru, "slvr-lru-contend");
+	lc_remove(&sls->sls_lru, s);
+	LIST_CACHE_ULOCK(&sls->sls_lru);
+	if (s->slvr_flags & SLVRF_HOT) {
+		s->slvr_flags &= ~SLVRF_HOT;
+		psc_atomic32_dec(&sls->sls_nhot);
+	}
+}
+
 __static void
 slvr_schedule_crc_locked(struct slvr *s)
 {
@@ -710,8 +1101,10 @@ slvr_schedule_crc_locked(struct slvr *s)
 	PFL_GETTIMESPEC(&s->slvr_ts);
 	DEBUG_SLVR(PLL_DIAG, s, "sched crc");
 
-	lc_remove(&sli_lruslvrs, s);
+	slvr_lru_remove(s);
+	SLVR_LIST_LOCK(&sli_crcqslvrs, "slvr-crcq-contend");
 	lc_addqueue(&sli_crcqslvrs, s);
+	LIST_CACHE_ULOCK(&sli_crcqslvrs);
 }
 
 void
@@ -725,15 +1118,24 @@ slvr_remove(struct slvr *s)
 
 	SLVR_LOCK(s);
 	if (s->slvr_flags & SLVRF_LRU)
-		lc_remove(&sli_lruslvrs, s);
+		slvr_lru_remove(s);
 	else
 		lc_remove(&sli_crcqslvrs, s);
+	if (s->slvr_flags & SLVRF_WBDIRTY) {
+		/* file is being truncated or reclaimed; drop the data */
+		s->slvr_flags &= ~SLVRF_WBDIRTY;
+		lc_remove(&sli_wbqslvrs, s);
+		psc_atomic32_dec(&sli_wb_ndirty);
+		OPSTAT_INCR("wb-discard");
+	}
 	SLVR_ULOCK(s);
 
 	bii = slvr_2_bii(s);
 
 	BII_LOCK(bii);
-	PSC_SPLAY_XREMOVE(biod_slvrtree, &bii->bii_slvrs, s);
+	psc_assert(bii->bii_slvrs[s->slvr_num] == s);
+	bii->bii_slvrs[s->slvr_num] = NULL;
+	bii->bii_nslvrs--;
 	bmap_op_done_type(bii_2_bmap(bii), BMAP_OPCNT_SLVR);
 
 	if ((s->slvr_flags & (SLVRF_READAHEAD | SLVRF_ACCESSED)) ==
@@ -752,7 +1154,7 @@ slvr_remove(struct slvr *s)
 void
 slvr_remove_all(struct fidc_membh *f)
 {
-	int i;
+	int i, n;
 	struct bmap *b;
 	struct slvr *s;
 	struct bmap_iod_info *bii;
@@ -769,9 +1171,11 @@ slvr_remove_all(struct fidc_membh *f)
 		psc_dynarray_add(&a, b);
 
 		bii = bmap_2_bii(b);
-		while (!SPLAY_EMPTY(&bii->bii_slvrs)) {
-			s = SPLAY_MIN(biod_slvrtree, &bii->bii_slvrs);
-			/* 
+		for (n = 0; n < SLASH_SLVRS_PER_BMAP; n++) {
+			s = bii->bii_slvrs[n];
+			if (s == NULL)
+				continue;
+			/*
 			 * Use SLVRF_FREEING to avoid a race with sliver
 			 * reaper.  Note that we don't check refcnt here
 			 * because we are only called when the file is
@@ -824,13 +1228,11 @@ slvr_lru_tryunpin_locked(struct slvr *s)
 	psc_assert(s->slvr_flags & SLVRF_DATARDY);
 
 	/*
-	 * Locking convention: it is legal to request for a list lock
-	 * while holding the sliver lock.  On the other hand, when you
-	 * already hold the list lock, you should drop the list lock
-	 * first before asking for the sliver lock or you should use
-	 * trylock().
+	 * A hit only sets the CLOCK reference bit; the reaper ages the
+	 * sliver when its hand comes around, so we never touch the
+	 * shard list (or its lock) here.
 	 */
-	lc_move2tail(&sli_lruslvrs, s);
+	s->slvr_flags |= SLVRF_REFERENCED;
 	SLVR_ULOCK(s);
 }
 
@@ -895,15 +1297,15 @@ struct slvr *
 _slvr_lookup(const struct pfl_callerinfo *pci, uint32_t num,
     struct bmap_iod_info *bii)
 {
-	struct slvr *s, *tmp1 = NULL, ts;
+	struct slvr *s, *tmp1 = NULL;
 	struct sl_buffer *tmp2 = NULL;
 	int alloc = 0;
 
-	ts.slvr_num = num;
+	psc_assert(num < SLASH_SLVRS_PER_BMAP);
 
 	BII_LOCK_ENSURE(bii);
  retry:
-	s = SPLAY_FIND(biod_slvrtree, &bii->bii_slvrs, &ts);
+	s = bii->bii_slvrs[num];
 	if (s) {
 		SLVR_LOCK(s);
 		/*
@@ -945,22 +1347,23 @@ _slvr_lookup(const struct pfl_callerinfo *pci, uint32_t num,
 		s->slvr_num = num;
 		s->slvr_bii = bii;
 		INIT_PSC_LISTENTRY(&s->slvr_lentry);
+		INIT_PSC_LISTENTRY(&s->slvr_wb_lentry);
 		INIT_SPINLOCK(&s->slvr_lock);
 
 		memset(tmp2->slb_base, 0, SLASH_SLVR_SIZE);
 		s->slvr_slab = tmp2;
 		s->slvr_refcnt = 1;
 
-		PSC_SPLAY_XINSERT(biod_slvrtree, &bii->bii_slvrs, s);
+		bii->bii_slvrs[num] = s;
+		bii->bii_nslvrs++;
 		bmap_op_start_type(bii_2_bmap(bii), BMAP_OPCNT_SLVR);
 
 		/*
 		 * Until the slab is added to the sliver, the sliver is
-		 * private to the bmap's biod_slvrtree.
+		 * private to the bmap's sliver array.
 		 */
 		s->slvr_flags |= SLVRF_LRU;
-		/* note: lc_addtail() will grab the list lock itself */
-		lc_addtail(&sli_lruslvrs, s);
+		slvr_lru_add(s);
 
 	}
 	if (alloc) {
@@ -971,56 +1374,110 @@ _slvr_lookup(const struct pfl_callerinfo *pci, uint32_t num,
 }
 
 /*
- * The reclaim function for sl_bufs_pool.  Note that our caller
- * psc_pool_get() ensures that we are called exclusively.
+ * Sweep the CLOCK hand of one LRU shard, collecting up to @want
+ * reclaimable slivers into @a.  Every sliver the hand passes is moved
+ * to the tail of the shard so that the head always points at the next
+ * candidate.  Two passes over the shard bound the sweep, enough to
+ * demote a hot sliver and then reclaim it.
  */
-int
-slvr_buffer_reap(struct psc_poolmgr *m)
+__static void
+slvr_lru_sweep(struct sli_lru_shard *sls, struct psc_dynarray *a,
+    int want)
 {
-	static struct psc_dynarray a;
-	struct slvr *s, *dummy;
-	int i, n;
-
-	psc_dynarray_init(&a);
+	struct psc_listcache *lc = &sls->sls_lru;
+	struct slvr *s;
+	int n;
 
-	LIST_CACHE_LOCK(&sli_lruslvrs);
-	LIST_CACHE_FOREACH_SAFE(s, dummy, &sli_lruslvrs) {
-		DEBUG_SLVR(PLL_DIAG, s,
-		    "considering for reap, nwaiters=%d",
-		    psc_atomic32_read(&m->ppm_nwaiters));
+	SLVR_LIST_LOCK(lc, "slvr-lru-contend");
+	for (n = lc_nitems(lc) * 2; n > 0; n--) {
+		if (psc_dynarray_len(a) >= want)
+			break;
+		s = lc_peekhead(lc);
+		if (s == NULL)
+			break;
+		lc_move2tail(lc, s);
 
 		/*
 		 * We are reaping so it is fine to back off on some
-		 * slivers.  We have to use a reqlock here because
-		 * slivers do not have private spinlocks; instead they
-		 * use the lock of the bii.  So if this thread tries to
-		 * free a slvr from the same bii trylock will abort.
+		 * slivers.  Holding the list lock, we may only trylock
+		 * the sliver.
 		 */
 		if (!SLVR_TRYLOCK(s))
 			continue;
 
+		DEBUG_SLVR(PLL_DIAG, s, "considering for reap");
+
 		if (s->slvr_refcnt || (s->slvr_flags & SLVRF_FREEING)) {
 			SLVR_ULOCK(s);
 			continue;
 		}
 
-		psc_dynarray_add(&a, s);
+		if (s->slvr_flags & SLVRF_REFERENCED) {
+			s->slvr_flags &= ~SLVRF_REFERENCED;
+			if (!(s->slvr_flags & SLVRF_HOT)) {
+				s->slvr_flags |= SLVRF_HOT;
+				psc_atomic32_inc(&sls->sls_nhot);
+				OPSTAT_INCR("slvr-lru-promote");
+			}
+			SLVR_ULOCK(s);
+			continue;
+		}
+
+		if (s->slvr_flags & SLVRF_HOT) {
+			s->slvr_flags &= ~SLVRF_HOT;
+			psc_atomic32_dec(&sls->sls_nhot);
+			OPSTAT_INCR("slvr-lru-demote");
+			SLVR_ULOCK(s);
+			continue;
+		}
+
+		psc_dynarray_add(a, s);
 		s->slvr_flags |= SLVRF_FREEING;
 		SLVR_ULOCK(s);
+	}
+	LIST_CACHE_ULOCK(lc);
+}
+
+/*
+ * The reclaim function for sl_bufs_pool.  Note that our caller
+ * psc_pool_get() ensures that we are called exclusively.
+ */
+int
+slvr_buffer_reap(struct psc_poolmgr *m)
+{
+	static struct psc_dynarray a;
+	static int hand;
+	struct slvr *s;
+	int i, n, want;
 
-		if (psc_dynarray_len(&a) >=
-		    psc_atomic32_read(&m->ppm_nwaiters))
+	psc_dynarray_init(&a);
+
+	want = psc_atomic32_read(&m->ppm_nwaiters);
+	if (want < 1)
+		want = 1;
+
+	/*
+	 * Rotate the starting shard so no single CPU's cache absorbs
+	 * all of the memory pressure.
+	 */
+	for (i = 0; i < sli_nlru_shards; i++) {
+		slvr_lru_sweep(&sli_lru_shards[hand], &a, want);
+		hand = (hand + 1) % sli_nlru_shards;
+		if (psc_dynarray_len(&a) >= want)
 			break;
 	}
-	LIST_CACHE_ULOCK(&sli_lruslvrs);
 
 	n = psc_dynarray_len(&a);
 	DYNARRAY_FOREACH(s, i, &a)
 		slvr_remove(s);
 	psc_dynarray_free(&a);
 
-	if (!n || n < psc_atomic32_read(&m->ppm_nwaiters))
+	if (!n || n < psc_atomic32_read(&m->ppm_nwaiters)) {
 		psc_waitq_wakeone(&sli_slvr_waitq);
+		/* dirty slabs can only be reaped once written back */
+		if (psc_atomic32_read(&sli_wb_ndirty))
+			psc_waitq_wakeall(&sli_wb_waitq);
+	}
 
 	return (n);
 }
@@ -1061,6 +1518,72 @@ sliaiothr_main(__unusedx struct psc_thread *thr)
 	}
 }
 
+/*
+ * Write-back thread: flush slivers which have been dirty for longer
+ * than sli_wb_delay_ms, or all of them when the dirty limit has been
+ * reached or threads are waiting for slab buffers.
+ */
+void
+sliwbthr_main(struct psc_thread *thr)
+{
+	struct timespec now, age;
+	struct slvr *s, *dummy;
+	int force, rc;
+
+	while (pscthr_run(thr)) {
+		psc_waitq_waitrel_us(&sli_wb_waitq, NULL,
+		    SLI_WB_SCAN_USECS);
+
+		for (;;) {
+			force = psc_atomic32_read(&sli_wb_ndirty) >
+			    sli_wb_max_slvrs ||
+			    psc_atomic32_read(&sl_bufs_pool->ppm_nwaiters);
+
+			PFL_GETTIMESPEC(&now);
+			age.tv_sec = sli_wb_delay_ms / 1000;
+			age.tv_nsec = (sli_wb_delay_ms % 1000) * 1000000;
+			timespecsub(&now, &age, &now);
+
+			s = NULL;
+			LIST_CACHE_LOCK(&sli_wbqslvrs);
+			LIST_CACHE_FOREACH_SAFE(s, dummy, &sli_wbqslvrs) {
+				/* queue is ordered by time first dirtied */
+				if (!force &&
+				    timespeccmp(&s->slvr_wb_ts, &now, >)) {
+					s = NULL;
+					break;
+				}
+				if (!SLVR_TRYLOCK(s))
+					continue;
+				if (s->slvr_flags & (SLVRF_FAULTING |
+				    SLVRF_FREEING)) {
+					SLVR_ULOCK(s);
+					continue;
+				}
+				s->slvr_flags |= SLVRF_FAULTING;
+				SLVR_ULOCK(s);
+				break;
+			}
+			LIST_CACHE_ULOCK(&sli_wbqslvrs);
+			if (s == NULL)
+				break;
+
+			if (force)
+				OPSTAT_INCR("wb-flush-pressure");
+			rc = slvr_wb_flush(s);
+
+			SLVR_LOCK(s);
+			s->slvr_flags &= ~SLVRF_FAULTING;
+			SLVR_WAKEUP(s);
+			SLVR_ULOCK(s);
+
+			/* failed ranges were requeued; retry next scan */
+			if (rc)
+				break;
+		}
+	}
+}
+
 void
 slirathr_main(struct psc_thread *thr)
 {
@@ -1084,6 +1607,8 @@ slirathr_main(struct psc_thread *thr)
 		if (bmap_get(f, rarq->rarq_bno, SL_READ, &b))
 			goto skip;
 		for (i = 0; i < 4; i++) {
+			if (slvrno + i >= SLASH_SLVRS_PER_BMAP)
+				break;
 			s = slvr_lookup(slvrno + i, bmap_2_bii(b));
 
 			rc = slvr_io_prep(s, 0, SLASH_SLVR_SIZE, SL_READ,
@@ -1127,8 +1652,18 @@ slvr_cache_init(void)
 	lc_reginit(&sli_readaheadq, struct sli_readaheadrq, rarq_lentry,
 	    "readaheadq");
 
-	lc_reginit(&sli_lruslvrs, struct slvr, slvr_lentry, "lruslvrs");
+	sli_nlru_shards = sysconf(_SC_NPROCESSORS_ONLN);
+	if (sli_nlru_shards < 1)
+		sli_nlru_shards = 1;
+	if (sli_nlru_shards > MAX_SLI_LRU_SHARDS)
+		sli_nlru_shards = MAX_SLI_LRU_SHARDS;
+	sli_lru_shards = PSCALLOC(sli_nlru_shards *
+	    sizeof(*sli_lru_shards));
+	for (i = 0; i < sli_nlru_shards; i++)
+		lc_reginit(&sli_lru_shards[i].sls_lru, struct slvr,
+		    slvr_lentry, "lruslvrs%d", i);
 	lc_reginit(&sli_crcqslvrs, struct slvr, slvr_lentry, "crcqslvrs");
+	lc_reginit(&sli_wbqslvrs, struct slvr, slvr_wb_lentry, "wbqslvrs");
 
 	if (slcfg_local->cfg_async_io) {
 		psc_poolmaster_init(&sli_iocb_poolmaster,
@@ -1154,6 +1689,16 @@ slvr_cache_init(void)
 
 	sl_buffer_cache_init();
 	slvr_worker_init();
+
+	if (slcfg_local->cfg_write_back) {
+		sli_wb_enable = 1;
+		sli_wb_max_slvrs = slcfg_local->cfg_write_back_max /
+		    SLASH_SLVR_SIZE;
+		if (sli_wb_max_slvrs <= 0)
+			sli_wb_max_slvrs = SLI_WB_MAX_SLVRS;
+		pscthr_init(SLITHRT_WRITEBACK, sliwbthr_main, NULL, 0,
+		    "sliwbthr");
+	}
 }
 
 #if PFL_DEBUG > 0
@@ -1176,6 +1721,9 @@ dump_sliver_flags(int fl)
 	PFL_PRFLAG(SLVRF_FREEING, &fl, &seq);
 	PFL_PRFLAG(SLVRF_READAHEAD, &fl, &seq);
 	PFL_PRFLAG(SLVRF_ACCESSED, &fl, &seq);
+	PFL_PRFLAG(SLVRF_REFERENCED, &fl, &seq);
+	PFL_PRFLAG(SLVRF_HOT, &fl, &seq);
+	PFL_PRFLAG(SLVRF_WBDIRTY, &fl, &seq);
 	if (fl)
 		printf(" unknown: %x", fl);
 	printf("\n");
@@ -64,8 +64,14 @@ struct slvr {
 	struct sli_iocb		*slvr_iocb;
 	struct sl_buffer	*slvr_slab;
 	struct sli_aiocb_reply  *slvr_aioreply;
-	struct psclist_head	 slvr_lentry;	/* dirty queue */
-	SPLAY_ENTRY(slvr)	 slvr_tentry;	/* bmap tree entry */
+	struct psclist_head	 slvr_lentry;	/* LRU shard or dirty queue */
+	int			 slvr_shard;	/* index into sli_lru_shards */
+
+	/* write-back: dirty byte range not yet written to backing file */
+	uint32_t		 slvr_wb_soff;
+	uint32_t		 slvr_wb_eoff;
+	struct timespec		 slvr_wb_ts;	/* when first dirtied */
+	struct psclist_head	 slvr_wb_lentry;	/* write-back queue */
 };
 
 /* slvr_flags */
@@ -82,6 +88,9 @@ struct slvr {
 #define SLVRF_FREEING		(1 <<  5)	/* sliver is being reaped */
 #define SLVRF_READAHEAD		(1 <<  6)	/* loaded via readahead prediction */
 #define SLVRF_ACCESSED		(1 <<  7)	/* actually used by a client */
+#define SLVRF_REFERENCED	(1 <<  8)	/* CLOCK reference bit */
+#define SLVRF_HOT		(1 <<  9)	/* CLOCK-Pro hot (re-referenced) */
+#define SLVRF_WBDIRTY		(1 << 10)	/* holds data not yet on disk */
 
 #define SLVR_LOCK(s)		spinlock(&(s)->slvr_lock)
 #define SLVR_ULOCK(s)		freelock(&(s)->slvr_lock)
@@ -132,7 +141,7 @@ struct slvr {
 	psclogs((level), SLISS_SLVR, "slvr@%p num=%hu ref=%u "		\
 	    "ts="PSCPRI_TIMESPEC" "					\
 	    "bii=%p slab=%p bmap=%p fid="SLPRI_FID" iocb=%p flgs="	\
-	    "%s%s%s%s%s%s%s%s :: " fmt,					\
+	    "%s%s%s%s%s%s%s%s%s%s%s :: " fmt,				\
 	    (s), (s)->slvr_num, (s)->slvr_refcnt,			\
 	    PSCPRI_TIMESPEC_ARGS(&(s)->slvr_ts),			\
 	    (s)->slvr_bii, (s)->slvr_slab,				\
@@ -148,8 +157,57 @@ struct slvr {
 	    (s)->slvr_flags & SLVRF_FREEING	? "F" : "-",		\
 	    (s)->slvr_flags & SLVRF_READAHEAD	? "R" : "-",		\
 	    (s)->slvr_flags & SLVRF_ACCESSED	? "a" : "-",		\
+	    (s)->slvr_flags & SLVRF_REFERENCED	? "r" : "-",		\
+	    (s)->slvr_flags & SLVRF_HOT		? "h" : "-",		\
+	    (s)->slvr_flags & SLVRF_WBDIRTY	? "w" : "-",		\
 	    ##__VA_ARGS__)
 
+/*
+ * Clean slivers are cached in per-CPU shards instead of one global LRU
+ * list so that hits and insertions from different service threads do
+ * not all serialize on a single list lock.  Each shard is managed with
+ * a simplified CLOCK-Pro policy: a cache hit only sets SLVRF_REFERENCED
+ * on the sliver (no list manipulation), and the reaper sweeps the shard
+ * from its head, promoting re-referenced cold slivers to hot, demoting
+ * unreferenced hot slivers to cold, and reclaiming unreferenced cold
+ * ones.  Non-resident test entries of full CLOCK-Pro are not tracked.
+ */
+struct sli_lru_shard {
+	struct psc_listcache	 sls_lru;	/* clock ring, head is the hand */
+	psc_atomic32_t		 sls_nhot;
+};
+
+#define MAX_SLI_LRU_SHARDS	64
+
+#define slvr_2_shard(s)		(&sli_lru_shards[(s)->slvr_shard])
+
+#define SLI_DIO_ALIGN		4096		/* O_DIRECT length granularity */
+
+/* flush of a buffered tail written to an O_DIRECT backing file */
+struct sli_wkdata_dio_tail {
+	int			 fd;		/* dup of the buffered fd */
+	off_t			 off;
+	size_t			 len;
+};
+
+/*
+ * Write-back mode: instead of issuing a pwrite(2) per write RPC, the
+ * written range is left dirty in the slab and flushed later, with
+ * dirty ranges of adjacent slivers of a bmap combined into a single
+ * pwritev(2).  Flushes happen after sli_wb_delay_ms, when the number
+ * of dirty slivers passes sli_wb_max_slvrs or the slab pool is under
+ * pressure, before the sliver CRC is sent to the MDS, and when a bmap
+ * lease is released.
+ *
+ * Clients are told their writes succeeded once the data is in the
+ * slab, so anything still dirty is lost if sliod crashes.  This is why
+ * write_back is off unless asked for in slcfg.
+ */
+#define SLI_WB_MAXRUN		8		/* max slivers per pwritev(2) */
+#define SLI_WB_DELAY_MS		1000		/* default flush delay */
+#define SLI_WB_MAX_SLVRS	256		/* default dirty sliver limit */
+#define SLI_WB_SCAN_USECS	100000		/* write-back thread interval */
+
 #define RIC_MAX_SLVRS_PER_IO	2
 
 struct sli_aiocb_reply {
@@ -194,12 +252,19 @@ void	slvr_io_done(struct slvr *, int);
 void	slvr_rio_done(struct slvr *);
 void	slvr_wio_done(struct slvr *, int);
 
+void	slvr_lru_add(struct slvr *);
+void	slvr_lru_remove(struct slvr *);
+
 void	slvr_remove(struct slvr *);
 void	slvr_remove_all(struct fidc_membh *);
 
 void	slvr_schedule_crc(struct slvr *);
 void	slvr_worker_init(void);
 
+void	slvr_wb_mark(struct slvr *, uint32_t, uint32_t);
+int	slvr_wb_flush(struct slvr *);
+void	slvr_wb_flush_fcmh(struct fidc_membh *);
+
 struct sli_aiocb_reply *
 	sli_aio_reply_setup(struct pscrpc_request *, uint32_t, uint32_t,
 	    struct slvr **, int, struct iovec *, int, enum rw);
@@ -221,19 +286,16 @@ struct sli_readaheadrq {
 };
 
 extern struct psc_poolmgr	*sli_readaheadrq_pool;
-extern struct psc_listcache	 sli_lruslvrs;
+extern struct sli_lru_shard	*sli_lru_shards;
+extern int			 sli_nlru_shards;
 extern struct psc_listcache	 sli_crcqslvrs;
+extern struct psc_listcache	 sli_wbqslvrs;
+extern int			 sli_wb_enable;
+extern int			 sli_wb_delay_ms;
+extern int			 sli_wb_max_slvrs;
+extern psc_atomic32_t		 sli_wb_ndirty;
+extern struct psc_waitq		 sli_wb_waitq;
 extern struct psc_listcache	 sli_readaheadq;
 extern struct psc_waitq		 sli_slvr_waitq;
 
-static __inline int
-slvr_cmp(const void *x, const void *y)
-{
-	const struct slvr *a = x, *b = y;
-
-	return (CMP(a->slvr_num, b->slvr_num));
-}
-
-SPLAY_PROTOTYPE(biod_slvrtree, slvr, slvr_tentry, slvr_cmp)
-
 #endif /* _SLIOD_SLVR_H_ */
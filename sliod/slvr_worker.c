@@ -293,6 +293,7 @@ slislvrthr_proc(struct slvr *s)
 {
 	struct bmap_iod_info *bii;
 	struct bcrcupd *bcr;
+	uint16_t slvrnum;
 	struct bmap *b;
 	uint64_t crc;
 
@@ -303,8 +304,27 @@ slislvrthr_proc(struct slvr *s)
 	b = bii_2_bmap(bii);
 	bmap_op_start_type(b, BMAP_OPCNT_BCRSCHED);
 
+	/*
+	 * Never let the MDS learn the CRC of data that only exists in
+	 * our cache.  We own SLVRF_FAULTING here, so writers are kept
+	 * out until the CRC has been taken.  If the data cannot be
+	 * written yet, try again once the sliver ages out again.
+	 */
+	if (slvr_wb_flush(s)) {
+		OPSTAT_INCR("slvr-crc-wb-retry");
+		SLVR_LOCK(s);
+		PFL_GETTIMESPEC(&s->slvr_ts);
+		s->slvr_flags &= ~SLVRF_FAULTING;
+		lc_addqueue(&sli_crcqslvrs, s);
+		SLVR_WAKEUP(s);
+		SLVR_ULOCK(s);
+		bmap_op_done_type(b, BMAP_OPCNT_BCRSCHED);
+		return;
+	}
+
 	SLVR_LOCK(s);
 	DEBUG_SLVR(PLL_DEBUG, s, "got sliver");
+	slvrnum = s->slvr_num;
 
 	psc_assert(!(s->slvr_flags & SLVRF_LRU));
 	psc_assert(s->slvr_flags & SLVRF_CRCDIRTY);
@@ -331,7 +351,7 @@ slislvrthr_proc(struct slvr *s)
 		s->slvr_flags |= SLVRF_LRU;
 		s->slvr_flags &= ~(SLVRF_CRCDIRTY | SLVRF_FAULTING);
 		OPSTAT_INCR("slvr-crc-requeue");
-		lc_addtail(&sli_lruslvrs, s);
+		slvr_lru_add(s);
 		SLVR_WAKEUP(s);
 		SLVR_ULOCK(s);
 	}
@@ -353,7 +373,7 @@ slislvrthr_proc(struct slvr *s)
 		 * it.
 		 */
 		for (i = 0, found = 0; i < bcr->bcr_crcup.nups; i++) {
-			if (bcr->bcr_crcup.crcs[i].slot == s->slvr_num) {
+			if (bcr->bcr_crcup.crcs[i].slot == slvrnum) {
 				found = 1;
 				break;
 			}
@@ -362,7 +382,7 @@ slislvrthr_proc(struct slvr *s)
 		bcr->bcr_crcup.crcs[i].crc = crc;
 		if (!found) {
 			bcr->bcr_crcup.nups++;
-			bcr->bcr_crcup.crcs[i].slot = s->slvr_num;
+			bcr->bcr_crcup.crcs[i].slot = slvrnum;
 		}
 
 		DEBUG_BCR(PLL_DIAG, bcr, "add to existing bcr slot=%d "
@@ -382,7 +402,7 @@ slislvrthr_proc(struct slvr *s)
 		bcr->bcr_bii = bii;
 		bcr->bcr_crcup.bno = b->bcm_bmapno;
 		bcr->bcr_crcup.crcs[0].crc = crc;
-		bcr->bcr_crcup.crcs[0].slot = s->slvr_num;
+		bcr->bcr_crcup.crcs[0].slot = slvrnum;
 		bcr->bcr_crcup.nups = 1;
 
 		bcr_ready_add(bcr);
@@ -421,7 +441,8 @@ slislvrthr_main(struct psc_thread *thr)
 		LIST_CACHE_FOREACH_SAFE(s, dummy, &sli_crcqslvrs) {
 			if (!SLVR_TRYLOCK(s))
 				continue;
-			if (s->slvr_refcnt || s->slvr_flags & SLVRF_FREEING) {
+			if (s->slvr_refcnt || s->slvr_flags &
+			    (SLVRF_FREEING | SLVRF_FAULTING)) {
 				SLVR_ULOCK(s);
 				continue;
 			}
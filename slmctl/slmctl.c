@@ -95,6 +95,20 @@ packshow_replqueued(char *res)
 		    sizeof(scrq->scrq_resname));
 }
 
+void
+packshow_place(__unusedx char *s)
+{
+	psc_ctlmsg_push(SLMCMT_GETPLACE,
+	    sizeof(struct slmctlmsg_place));
+}
+
+void
+packshow_replrate(__unusedx char *s)
+{
+	psc_ctlmsg_push(SLMCMT_GETREPLRATE,
+	    sizeof(struct slmctlmsg_replrate));
+}
+
 void
 packshow_statfs(__unusedx char *s)
 {
@@ -117,6 +131,59 @@ slm_replqueued_prhdr(__unusedx struct psc_ctlmsghdr *mh,
 	    "aggr-bw");
 }
 
+void
+slm_place_prhdr(__unusedx struct psc_ctlmsghdr *mh,
+    __unusedx const void *m)
+{
+	printf("%-32s %6s %8s %7s %9s %9s %8s\n",
+	    "resource", "free", "wrleases", "queued", "score",
+	    "lastscore", "placed");
+}
+
+void
+slm_place_prdat(__unusedx const struct psc_ctlmsghdr *mh,
+    const void *m)
+{
+	const struct slmctlmsg_place *scp = m;
+
+	printf("%-32s ", scp->scp_resname);
+	if (scp->scp_freepm >= 0)
+		printf("%5.1f%% ", scp->scp_freepm / 10.0);
+	else
+		printf("%6s ", "-");
+	printf("%8d ", scp->scp_nwrleases);
+	psc_ctl_prnumber(0, scp->scp_queued, 0, " ");
+	if (scp->scp_score == INT64_MAX)
+		printf("%9s ", "full");
+	else
+		printf("%9"PRId64" ", scp->scp_score);
+	printf("%9"PRId64" %8"PRIu64"\n", scp->scp_lastscore,
+	    scp->scp_nplaced);
+}
+
+void
+slm_replrate_prhdr(__unusedx struct psc_ctlmsghdr *mh,
+    __unusedx const void *m)
+{
+	printf("%-32s %-32s %7s %7s %7s\n",
+	    "source", "destination", "rate", "limit", "tokens");
+}
+
+void
+slm_replrate_prdat(__unusedx const struct psc_ctlmsghdr *mh,
+    const void *m)
+{
+	const struct slmctlmsg_replrate *scrr = m;
+
+	printf("%-32s %-32s ", scrr->scrr_src, scrr->scrr_dst);
+	psc_ctl_prnumber(0, scrr->scrr_rate, 0, " ");
+	if (scrr->scrr_limit) {
+		psc_ctl_prnumber(0, scrr->scrr_limit, 0, " ");
+		psc_ctl_prnumber(0, MAX(scrr->scrr_tokens, 0), 0, "\n");
+	} else
+		printf("%7s %7s\n", "-", "-");
+}
+
 void
 slm_replqueued_prdat(__unusedx const struct psc_ctlmsghdr *mh,
     const void *m)
@@ -268,7 +335,9 @@ struct psc_ctlshow_ent psc_ctlshow_tab[] = {
 	{ "bml",		packshow_bml },
 	{ "connections",	packshow_conns },
 	{ "fcmhs",		packshow_fcmhs },
+	{ "placement",		packshow_place },
 	{ "replqueued",		packshow_replqueued },
+	{ "replrate",		packshow_replrate },
 	{ "statfs",		packshow_statfs },
 
 	/* aliases */
@@ -285,7 +354,10 @@ struct psc_ctlmsg_prfmt psc_ctlmsg_prfmts[] = {
 	{ slm_replqueued_prhdr,	slm_replqueued_prdat,	sizeof(struct slmctlmsg_replqueued),	NULL },
 	{ slm_statfs_prhdr,	slm_statfs_prdat,	sizeof(struct slmctlmsg_statfs),	NULL },
 	{ NULL,			NULL,			0,					NULL },
-	{ slm_bml_prhdr,	slm_bml_prdat,		sizeof(struct slmctlmsg_bml),		NULL }
+	{ slm_bml_prhdr,	slm_bml_prdat,		sizeof(struct slmctlmsg_bml),		NULL },
+	{ NULL,			NULL,			0,					NULL },
+	{ slm_replrate_prhdr,	slm_replrate_prdat,	sizeof(struct slmctlmsg_replrate),	NULL },
+	{ slm_place_prhdr,	slm_place_prdat,	sizeof(struct slmctlmsg_place),		NULL }
 };
 
 psc_ctl_prthr_t psc_ctl_prthrs[] = {
@@ -56,7 +56,8 @@ __dead void
 usage(void)
 {
 	fprintf(stderr,
-	    "usage: %s [-fqv] [-b block-device] [-D dir] [-n nentries] [-u uuid]\n",
+	    "usage: %s [-fqv] [-b block-device] [-D dir] [-e entsize] [-n nentries]\n"
+	    "\t[-u uuid]\n",
 	    progname);
 	exit(1);
 }
@@ -162,6 +163,56 @@ pjournal_format(const char *fn, uint32_t nents, uint32_t entsz,
 	    fn, nents, rs, rc);
 }
 
+void
+pjournal_dump_namespace(struct slmds_jent_namespace *sjnm)
+{
+	int nlen, n2len;
+	const char *n, *n2;
+
+	printf("fid=%016"PRIx64" ", sjnm->sjnm_target_fid);
+
+	n = sjnm->sjnm_name;
+	nlen = sjnm->sjnm_namelen;
+	n2len = sjnm->sjnm_namelen2;
+	n2 = n + nlen;
+
+	switch (sjnm->sjnm_op) {
+	case NS_OP_RECLAIM:
+		printf("op=reclaim");
+		break;
+	case NS_OP_CREATE:
+		printf("op=create name=%.*s", nlen, n);
+		break;
+	case NS_OP_MKDIR:
+		printf("op=mkdir name=%.*s", nlen, n);
+		break;
+	case NS_OP_LINK:
+		printf("op=link name=%.*s", nlen, n);
+		break;
+	case NS_OP_SYMLINK:
+		printf("op=symlink name=%.*s", nlen, n);
+		break;
+	case NS_OP_RENAME:
+		printf("op=rename oldname=%.*s newname=%.*s",
+		    nlen, n, n2len, n2);
+		break;
+	case NS_OP_UNLINK:
+		printf("op=unlink name=%.*s", nlen, n);
+		break;
+	case NS_OP_RMDIR:
+		printf("op=rmdir name=%.*s", nlen, n);
+		break;
+	case NS_OP_SETSIZE:
+		printf("op=setsize");
+		break;
+	case NS_OP_SETATTR:
+		printf("op=setattr mask=%#x", sjnm->sjnm_mask);
+		break;
+	default:
+		psclog_errorx("op=INVALID (%d)", sjnm->sjnm_op);
+	}
+}
+
 void
 pjournal_dump_entry(uint32_t slot, struct psc_journal_enthdr *pje)
 {
@@ -171,12 +222,15 @@ pjournal_dump_entry(uint32_t slot, struct psc_journal_enthdr *pje)
 		struct slmds_jent_bmap_repls *sjbr;
 		struct slmds_jent_ino_repls *sjir;
 		struct slmds_jent_namespace *sjnm;
+		struct slmds_jent_nsbatch *sjnb;
 		struct slmds_jent_bmap_crc *sjbc;
 		struct slmds_jent_bmapseq *sjsq;
 		void *p;
 	} u;
-	int type, nlen, n2len;
-	const char *n, *n2;
+	struct slmds_jent_namespace *sjnm;
+	uint32_t i;
+	int type;
+	char *p;
 
 	u.p = PJE_DATA(pje);
 
@@ -208,49 +262,17 @@ pjournal_dump_entry(uint32_t slot, struct psc_journal_enthdr *pje)
 		}
 		break;
 	case MDS_LOG_NAMESPACE:
-		printf("fid=%016"PRIx64" ", u.sjnm->sjnm_target_fid);
-
-		n = u.sjnm->sjnm_name;
-		nlen = u.sjnm->sjnm_namelen;
-		n2len = u.sjnm->sjnm_namelen2;
-		n2 = n + nlen;
-
-		switch (u.sjnm->sjnm_op) {
-		case NS_OP_RECLAIM:
-			printf("op=reclaim");
-			break;
-		case NS_OP_CREATE:
-			printf("op=create name=%.*s", nlen, n);
-			break;
-		case NS_OP_MKDIR:
-			printf("op=mkdir name=%.*s", nlen, n);
-			break;
-		case NS_OP_LINK:
-			printf("op=link name=%.*s", nlen, n);
-			break;
-		case NS_OP_SYMLINK:
-			printf("op=symlink name=%.*s", nlen, n);
-			break;
-		case NS_OP_RENAME:
-			printf("op=rename oldname=%.*s newname=%.*s",
-			    nlen, n, n2len, n2);
-			break;
-		case NS_OP_UNLINK:
-			printf("op=unlink name=%.*s", nlen, n);
-			break;
-		case NS_OP_RMDIR:
-			printf("op=rmdir name=%.*s", nlen, n);
-			break;
-		case NS_OP_SETSIZE:
-			printf("op=setsize");
-			break;
-		case NS_OP_SETATTR:
-			printf("op=setattr mask=%#x",
-			    u.sjnm->sjnm_mask);
-			break;
-		default:
-			psclog_errorx("op=INVALID (%d)",
-			    u.sjnm->sjnm_op);
+		pjournal_dump_namespace(u.sjnm);
+		break;
+	case MDS_LOG_NAMESPACE_BATCH:
+		printf("nsbatch count=%u len=%u", u.sjnb->sjnb_count,
+		    u.sjnb->sjnb_len);
+		p = u.sjnb->sjnb_data;
+		for (i = 0; i < u.sjnb->sjnb_count; i++) {
+			sjnm = (void *)p;
+			printf("\n%6s  ", "");
+			pjournal_dump_namespace(sjnm);
+			p += SJNB_RECLEN(sjnm);
 		}
 		break;
 	default:
@@ -439,6 +461,7 @@ int
 main(int argc, char *argv[])
 {
 	ssize_t nents = SLJ_MDS_JNENTS;
+	uint32_t entsz = SLJ_MDS_ENTSIZE;
 	char *endp, c, fn[PATH_MAX];
 	uint64_t uuid = 0;
 	long l;
@@ -448,7 +471,7 @@ main(int argc, char *argv[])
 
 	fn[0] = '\0';
 	progname = argv[0];
-	while ((c = getopt(argc, argv, "b:D:fn:qu:v")) != -1)
+	while ((c = getopt(argc, argv, "b:D:e:fn:qu:v")) != -1)
 		switch (c) {
 		case 'b':
 			strlcpy(fn, optarg, sizeof(fn));
@@ -456,6 +479,14 @@ main(int argc, char *argv[])
 		case 'D':
 			datadir = optarg;
 			break;
+		case 'e':
+			endp = NULL;
+			l = strtol(optarg, &endp, 10);
+			if (l < SLJ_MDS_ENTSIZE || l > SLJ_MDS_MAXENTSIZE ||
+			    (l & (l - 1)) || endp == optarg || *endp)
+				errx(1, "invalid -e entsize: %s", optarg);
+			entsz = (uint32_t)l;
+			break;
 		case 'f':
 			format = 1;
 			break;
@@ -499,12 +530,11 @@ main(int argc, char *argv[])
 	if (format) {
 		if (!uuid)
 			psc_fatalx("no fsuuid specified");
-		pjournal_format(fn, nents, SLJ_MDS_ENTSIZE,
-		    SLJ_MDS_READSZ, uuid);
+		pjournal_format(fn, nents, entsz, SLJ_MDS_READSZ, uuid);
 		if (verbose)
-			warnx("created log file %s with %zu %d-byte entries "
+			warnx("created log file %s with %zu %u-byte entries "
 			      "(uuid=%"PRIx64")",
-			      fn, nents, SLJ_MDS_ENTSIZE, uuid);
+			      fn, nents, entsz, uuid);
 	} else if (query)
 		pjournal_dump(fn);
 	else
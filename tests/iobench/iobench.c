@@ -0,0 +1,160 @@
+/* $Id$ */
+/*
+ * %PSCGPL_START_COPYRIGHT%
+ * -----------------------------------------------------------------------------
+ * Copyright (c) 2015, Pittsburgh Supercomputing Center (PSC).
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License contained in the file
+ * `COPYING-GPL' at the top of this distribution or at
+ * https://www.gnu.org/licenses/gpl-2.0.html for more details.
+ *
+ * Pittsburgh Supercomputing Center	phone: 412.268.4960  fax: 412.268.5832
+ * 300 S. Craig Street			e-mail: remarks@psc.edu
+ * Pittsburgh, PA 15213			web: http://www.psc.edu/
+ * -----------------------------------------------------------------------------
+ * %PSC_END_COPYRIGHT%
+ */
+
+/*
+ * Compare buffered and O_DIRECT sequential throughput on a file system,
+ * e.g. the backing store of an I/O server, to judge whether sliod
+ * should be run with `backfs_direct_io'.  Each pass writes the file in
+ * sliver-sized chunks, syncs it, drops it from the page cache where
+ * possible, and reads it back.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pfl/cdefs.h"
+
+#define IOBENCH_BUFSZ		(1024 * 1024)	/* SLASH_SLVR_SIZE */
+#define IOBENCH_ALIGN		4096
+#define IOBENCH_DEFSIZE		(1024 * 1024 * 1024)
+
+const char		*progname;
+
+__dead void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: %s [-b bufsize] [-s filesize] file\n", progname);
+	exit(1);
+}
+
+double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec / 1e6);
+}
+
+void
+report(const char *mode, const char *op, off_t len, double t)
+{
+	printf("%-8s %-5s %10.1f MB/s\n", mode, op,
+	    len / t / (1024 * 1024));
+}
+
+void
+bench(const char *fn, int oflags, const char *mode, char *buf,
+    size_t bufsz, off_t filesz)
+{
+	double t0;
+	ssize_t rc;
+	off_t off;
+	int fd;
+
+	fd = open(fn, O_CREAT | O_TRUNC | O_RDWR | oflags, 0600);
+	if (fd == -1)
+		err(1, "open %s", fn);
+
+	t0 = now();
+	for (off = 0; off < filesz; off += rc) {
+		rc = pwrite(fd, buf, bufsz, off);
+		if (rc == -1)
+			err(1, "pwrite");
+		if (rc == 0)
+			errx(1, "pwrite: short write");
+	}
+	if (fsync(fd) == -1)
+		err(1, "fsync");
+	report(mode, "write", filesz, now() - t0);
+
+#ifdef POSIX_FADV_DONTNEED
+	posix_fadvise(fd, 0, filesz, POSIX_FADV_DONTNEED);
+#endif
+
+	t0 = now();
+	for (off = 0; off < filesz; off += rc) {
+		rc = pread(fd, buf, bufsz, off);
+		if (rc == -1)
+			err(1, "pread");
+		if (rc == 0)
+			break;
+	}
+	report(mode, "read", off, now() - t0);
+
+	close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t bufsz = IOBENCH_BUFSZ;
+	off_t filesz = IOBENCH_DEFSIZE;
+	char *buf;
+	int c;
+
+	progname = argv[0];
+	while ((c = getopt(argc, argv, "b:s:")) != -1) {
+		switch (c) {
+		case 'b':
+			bufsz = strtoull(optarg, NULL, 0);
+			break;
+		case 's':
+			filesz = strtoll(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
+		usage();
+
+	if (bufsz == 0 || bufsz % IOBENCH_ALIGN)
+		errx(1, "buffer size must be a multiple of %d",
+		    IOBENCH_ALIGN);
+	if (filesz <= 0 || filesz % bufsz)
+		errx(1, "file size must be a multiple of buffer size");
+
+	if (posix_memalign((void **)&buf, IOBENCH_ALIGN, bufsz))
+		errx(1, "posix_memalign");
+	memset(buf, 'a', bufsz);
+
+	bench(argv[0], 0, "buffered", buf, bufsz, filesz);
+	bench(argv[0], O_DIRECT, "direct", buf, bufsz, filesz);
+
+	unlink(argv[0]);
+	free(buf);
+	exit(0);
+}
@@ -0,0 +1,168 @@
+/* $Id$ */
+
+/*
+ * Measure namespace operation throughput: create a tree of empty files
+ * spread over a number of directories with several threads, then
+ * remove it, and report creates and unlinks per second.  Useful for
+ * comparing mount_slash with and without `async_create' and
+ * `async_delete'.
+ *
+ *	cc -o nsbench nsbench.c -lpthread
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int		 nthreads = 4;
+int		 ndirs = 16;
+long		 nfiles = 100000;
+int		 keep;
+const char	*topdir;
+
+const char	*progname;
+
+void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: %s [-k] [-d ndirs] [-n nfiles] [-t nthreads] empty-directory\n",
+	    progname);
+	exit(1);
+}
+
+double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec / 1e6);
+}
+
+void
+mkpath(char *buf, size_t len, long i)
+{
+	snprintf(buf, len, "%s/d%03ld/f%08ld", topdir, i % ndirs, i);
+}
+
+void *
+create_thr(void *arg)
+{
+	char fn[PATH_MAX];
+	long i, id = (long)arg;
+	int fd;
+
+	for (i = id; i < nfiles; i += nthreads) {
+		mkpath(fn, sizeof(fn), i);
+		fd = open(fn, O_CREAT | O_EXCL | O_WRONLY, 0644);
+		if (fd == -1)
+			err(1, "create %s", fn);
+		close(fd);
+	}
+	return (NULL);
+}
+
+void *
+unlink_thr(void *arg)
+{
+	char fn[PATH_MAX];
+	long i, id = (long)arg;
+
+	for (i = id; i < nfiles; i += nthreads) {
+		mkpath(fn, sizeof(fn), i);
+		if (unlink(fn) == -1)
+			err(1, "unlink %s", fn);
+	}
+	return (NULL);
+}
+
+void
+run(const char *op, void *(*startf)(void *))
+{
+	pthread_t *thrs;
+	double t0, t;
+	long i;
+	int rc;
+
+	thrs = calloc(nthreads, sizeof(*thrs));
+	if (thrs == NULL)
+		err(1, "calloc");
+
+	t0 = now();
+	for (i = 0; i < nthreads; i++) {
+		rc = pthread_create(&thrs[i], NULL, startf, (void *)i);
+		if (rc)
+			errx(1, "pthread_create: %s", strerror(rc));
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(thrs[i], NULL);
+	t = now() - t0;
+
+	printf("%-8s %10ld files %8.2fs %10.1f ops/s\n", op, nfiles, t,
+	    nfiles / t);
+	free(thrs);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char fn[PATH_MAX];
+	double t0;
+	int c, i;
+
+	progname = argv[0];
+	while ((c = getopt(argc, argv, "d:kn:t:")) != -1)
+		switch (c) {
+		case 'd':
+			ndirs = atoi(optarg);
+			break;
+		case 'k':
+			keep = 1;
+			break;
+		case 'n':
+			nfiles = atol(optarg);
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1 || ndirs <= 0 || nfiles <= 0 || nthreads <= 0)
+		usage();
+	topdir = argv[0];
+
+	t0 = now();
+	for (i = 0; i < ndirs; i++) {
+		snprintf(fn, sizeof(fn), "%s/d%03d", topdir, i);
+		if (mkdir(fn, 0755) == -1)
+			err(1, "mkdir %s", fn);
+	}
+	printf("%-8s %10d dirs  %8.2fs\n", "mkdir", ndirs, now() - t0);
+
+	run("create", create_thr);
+	if (keep)
+		exit(0);
+	run("unlink", unlink_thr);
+
+	t0 = now();
+	for (i = 0; i < ndirs; i++) {
+		snprintf(fn, sizeof(fn), "%s/d%03d", topdir, i);
+		if (rmdir(fn) == -1)
+			err(1, "rmdir %s", fn);
+	}
+	printf("%-8s %10d dirs  %8.2fs\n", "rmdir", ndirs, now() - t0);
+	exit(0);
+}
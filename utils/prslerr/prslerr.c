@@ -89,6 +89,9 @@ main(int argc, char *argv[])
 	printf("%4d [SLERR_REIMPORT_OLD]: %s\n", SLERR_REIMPORT_OLD, slstrerror(SLERR_REIMPORT_OLD));
 	printf("%4d [SLERR_IMPORT_XREPL_DIFF]: %s\n", SLERR_IMPORT_XREPL_DIFF, slstrerror(SLERR_IMPORT_XREPL_DIFF));
 	printf("%4d [SLERR_RES_BADTYPE]: %s\n", SLERR_RES_BADTYPE, slstrerror(SLERR_RES_BADTYPE));
+	printf("%4d [SLERR_INLINE]: %s\n", SLERR_INLINE, slstrerror(SLERR_INLINE));
+	printf("%4d [SLERR_NOTINLINE]: %s\n", SLERR_NOTINLINE, slstrerror(SLERR_NOTINLINE));
+	printf("%4d [SLERR_INLINE_FULL]: %s\n", SLERR_INLINE_FULL, slstrerror(SLERR_INLINE_FULL));
 	printf("%4d [SLERR_CRCABSENT]: %s\n", SLERR_CRCABSENT, slstrerror(SLERR_CRCABSENT));
 	/* end custom errnos */
 	exit(0);
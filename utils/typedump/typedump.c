@@ -183,6 +183,8 @@ main(int argc, char *argv[])
 	PRTYPE(struct mdsio_ops);
 	PRTYPE(struct mio_fh);
 	PRTYPE(struct mio_rootnames);
+	PRTYPE(struct msacreate_thread);
+	PRTYPE(struct msadelete_thread);
 	PRTYPE(struct msattrflush_thread);
 	PRTYPE(struct msbrelease_thread);
 	PRTYPE(struct msbwatch_thread);
@@ -196,11 +198,15 @@ main(int argc, char *argv[])
 	PRTYPE(struct msctlmsg_replst_slave);
 	PRTYPE(struct msflush_thread);
 	PRTYPE(struct msfs_thread);
+	PRTYPE(struct msl_acreate);
+	PRTYPE(struct msl_adelete);
 	PRTYPE(struct msl_fhent);
 	PRTYPE(struct msl_fsrqinfo);
+	PRTYPE(struct msl_readrpc);
 	PRTYPE(struct msrci_thread);
 	PRTYPE(struct msrcm_thread);
 	PRTYPE(struct msreadahead_thread);
+	PRTYPE(struct msreadhedge_thread);
 	PRTYPE(struct readaheadrq);
 	PRTYPE(struct resm_cli_info);
 	PRTYPE(struct resm_iod_info);
@@ -247,7 +253,10 @@ main(int argc, char *argv[])
 	PRTYPE(struct slirii_thread);
 	PRTYPE(struct slirim_thread);
 	PRTYPE(struct slm_batchscratch_repl);
+	PRTYPE(struct slm_bia_recover);
+	PRTYPE(struct slm_bmap_ra);
 	PRTYPE(struct slm_exp_cli);
+	PRTYPE(struct slm_fidlease);
 	PRTYPE(struct slm_ino_od);
 	PRTYPE(struct slm_inoh);
 	PRTYPE(struct slm_inox_od);
@@ -258,7 +267,9 @@ main(int argc, char *argv[])
 	PRTYPE(struct slm_update_data);
 	PRTYPE(struct slm_update_generic);
 	PRTYPE(struct slm_wkdata_batchrq_cb);
+	PRTYPE(struct slm_wkdata_bia_recover);
 	PRTYPE(struct slm_wkdata_ptrunc);
+	PRTYPE(struct slm_wkdata_ptrunc_recover);
 	PRTYPE(struct slm_wkdata_rmdir_ino);
 	PRTYPE(struct slm_wkdata_upsch_cb);
 	PRTYPE(struct slm_wkdata_upsch_purge);
@@ -277,6 +288,7 @@ main(int argc, char *argv[])
 	PRTYPE(struct slmds_jent_bmapseq);
 	PRTYPE(struct slmds_jent_ino_repls);
 	PRTYPE(struct slmds_jent_namespace);
+	PRTYPE(struct slmds_jent_nsbatch);
 	PRTYPE(struct slmrcm_thread);
 	PRTYPE(struct slmrmc_thread);
 	PRTYPE(struct slmrmi_thread);
@@ -298,17 +310,24 @@ main(int argc, char *argv[])
 	PRTYPE(struct srm_bmap_release_rep);
 	PRTYPE(struct srm_bmap_release_req);
 	PRTYPE(struct srm_bmap_wake_req);
+	PRTYPE(struct srm_compound_rep);
+	PRTYPE(struct srm_compound_req);
 	PRTYPE(struct srm_connect_rep);
 	PRTYPE(struct srm_connect_req);
+	PRTYPE(struct srm_create_bulk_rep);
+	PRTYPE(struct srm_create_bulk_req);
 	PRTYPE(struct srm_create_rep);
 	PRTYPE(struct srm_create_req);
 	PRTYPE(struct srm_ctl_req);
+	PRTYPE(struct srm_fidlease_rep);
+	PRTYPE(struct srm_fidlease_req);
 	PRTYPE(struct srm_forward_rep);
 	PRTYPE(struct srm_forward_req);
 	PRTYPE(struct srm_generic_rep);
 	PRTYPE(struct srm_get_inode_rep);
 	PRTYPE(struct srm_get_inode_req);
 	PRTYPE(struct srm_getattr2_rep);
+	PRTYPE(struct srm_getattr_bulk_req);
 	PRTYPE(struct srm_getattr_rep);
 	PRTYPE(struct srm_getattr_req);
 	PRTYPE(struct srm_getbmap_full_rep);
@@ -319,6 +338,8 @@ main(int argc, char *argv[])
 	PRTYPE(struct srm_getxattr_req);
 	PRTYPE(struct srm_import_rep);
 	PRTYPE(struct srm_import_req);
+	PRTYPE(struct srm_inline_io_rep);
+	PRTYPE(struct srm_inline_io_req);
 	PRTYPE(struct srm_io_rep);
 	PRTYPE(struct srm_io_req);
 	PRTYPE(struct srm_leasebmap_rep);
@@ -355,6 +376,8 @@ main(int argc, char *argv[])
 	PRTYPE(struct srm_statfs_rep);
 	PRTYPE(struct srm_statfs_req);
 	PRTYPE(struct srm_symlink_req);
+	PRTYPE(struct srm_unlink_bulk_rep);
+	PRTYPE(struct srm_unlink_bulk_req);
 	PRTYPE(struct srm_unlink_rep);
 	PRTYPE(struct srm_unlink_req);
 	PRTYPE(struct srm_update_rep);
@@ -365,8 +388,10 @@ main(int argc, char *argv[])
 	PRTYPE(struct srt_bmapdesc);
 	PRTYPE(struct srt_bmapminseq);
 	PRTYPE(struct srt_bwqueued);
+	PRTYPE(struct srt_create_ent);
 	PRTYPE(struct srt_creds);
 	PRTYPE(struct srt_ctlsetopt);
+	PRTYPE(struct srt_getattr_ent);
 	PRTYPE(struct srt_inode);
 	PRTYPE(struct srt_preclaim_repent);
 	PRTYPE(struct srt_preclaim_reqent);
@@ -377,6 +402,7 @@ main(int argc, char *argv[])
 	PRTYPE(struct srt_replwk_reqent);
 	PRTYPE(struct srt_stat);
 	PRTYPE(struct srt_statfs);
+	PRTYPE(struct srt_unlink_ent);
 	PRTYPE(struct srt_update_entry);
 	PRTYPE(struct uid_mapping);
 	/* end structs */
@@ -525,6 +551,8 @@ main(int argc, char *argv[])
 	PRVAL(FID_PATH_DEPTH);
 	PRVAL(FID_PATH_START);
 	PRVAL(FSID_LEN);
+	PRVAL(INOF_INLINE);
+	PRVAL(INOF_INLINE_TRIM);
 	PRVAL(INOF_IOS_AFFINITY);
 	PRVAL(INOH_INO_NEW);
 	PRVAL(INOH_INO_NOTLOADED);
@@ -550,6 +578,8 @@ main(int argc, char *argv[])
 	PRVAL(MFSRQ_FSREPLIED);
 	PRVAL(MFSRQ_NONE);
 	PRVAL(MFSRQ_READ);
+	PRVAL(MRRF_HEDGED);
+	PRVAL(MRRF_SETTLED);
 	PRVAL(MRSLF_EOF);
 	PRVAL(MSCMT_ADDREPLRQ);
 	PRVAL(MSCMT_DELREPLRQ);
@@ -569,7 +599,10 @@ main(int argc, char *argv[])
 	PRVAL(MSL_CBARG_BMAP);
 	PRVAL(MSL_CBARG_BMPC);
 	PRVAL(MSL_CBARG_BMPCE);
+	PRVAL(MSL_CBARG_BUF);
 	PRVAL(MSL_CBARG_CSVC);
+	PRVAL(MSL_CBARG_ISSUED);
+	PRVAL(MSL_CBARG_READRPC);
 	PRVAL(MSL_CBARG_RESM);
 	PRVAL(MSL_READDIR_CBARG_CSVC);
 	PRVAL(MSL_READDIR_CBARG_DENTBUF);
@@ -591,6 +624,7 @@ main(int argc, char *argv[])
 	PRVAL(RESF_PREFIOS);
 	PRVAL(RIC_MAX_SLVRS_PER_IO);
 	PRVAL(RPCIF_AVOID);
+	PRVAL(SBRF_BUSY);
 	PRVAL(SIF_DISABLE_ADVLEASE);
 	PRVAL(SIF_DISABLE_GC);
 	PRVAL(SIF_DISABLE_LEASE);
@@ -645,7 +679,10 @@ main(int argc, char *argv[])
 	PRVAL(SLI_RIM_NTHREADS);
 	PRVAL(SLI_RIM_REPSZ);
 	PRVAL(SLJ_MDS_ENTSIZE);
+	PRVAL(SLJ_MDS_MAXENTSIZE);
 	PRVAL(SLJ_MDS_READSZ);
+	PRVAL(SLM_BMAP_RA_MAX);
+	PRVAL(SLM_FIDLEASE_NRANGES);
 	PRVAL(SLM_NWORKER_THREADS);
 	PRVAL(SLM_RECLAIM_BATCH_NENTS);
 	PRVAL(SLM_RMC_BUFSZ);
@@ -661,6 +698,7 @@ main(int argc, char *argv[])
 	PRVAL(SLM_RMM_NTHREADS);
 	PRVAL(SLM_RMM_REPSZ);
 	PRVAL(SLM_UPDATE_BATCH_NENTS);
+	PRVAL(SLM_UPDATE_NINFLIGHT);
 	PRVAL(SLRPC_DISCONNF_HIGHLEVEL);
 	PRVAL(SLRPC_MSGADJ);
 	PRVAL(SLVRF_ACCESSED);
@@ -687,6 +725,7 @@ main(int argc, char *argv[])
 	PRVAL(SL_TWO_NAME_MAX);
 	PRVAL(SL_XATTR_SIZE_MAX);
 	PRVAL(SPF_NEED_JRNL_INIT);
+	PRVAL(SPF_RECV_BUSY);
 	PRVAL(SRCI_BUFSZ);
 	PRVAL(SRCI_BULK_PORTAL);
 	PRVAL(SRCI_CTL_PORTAL);
@@ -739,14 +778,25 @@ main(int argc, char *argv[])
 	PRVAL(SRMM_REQ_PORTAL);
 	PRVAL(SRMM_VERSION);
 	PRVAL(SRM_BMAPCRCWRT_PTRUNC);
+	PRVAL(SRM_COMPOUNDF_GETATTR);
+	PRVAL(SRM_COMPOUNDF_GETINODE);
+	PRVAL(SRM_COMPOUNDF_INLINE);
+	PRVAL(SRM_COMPOUNDF_LEASEBMAP);
+	PRVAL(SRM_COMPOUNDF_LOOKUP);
 	PRVAL(SRM_CTLOP_SETOPT);
 	PRVAL(SRM_IMPORTF_XREPL);
+	PRVAL(SRM_INLINEF_COMMIT);
+	PRVAL(SRM_INLINEF_PROMOTE);
+	PRVAL(SRM_INLINE_MAX);
 	PRVAL(SRM_IOF_APPEND);
 	PRVAL(SRM_IOF_BENCH);
 	PRVAL(SRM_IOF_DIO);
+	PRVAL(SRM_IOF_REPDATA);
+	PRVAL(SRM_IO_INLINE_MAX);
 	PRVAL(SRM_LEASEBMAPF_DATA);
 	PRVAL(SRM_LEASEBMAPF_DIO);
 	PRVAL(SRM_LEASEBMAPF_GETINODE);
+	PRVAL(SRM_LEASEBMAPF_INLINE);
 	PRVAL(SRM_RENAME_NAMEMAX);
 	PRVAL(SRPCWAITF_DEFER_BULK_AUTHBUF_CHECK);
 	PRVAL(UPDF_BUSY);
@@ -772,9 +822,12 @@ main(int argc, char *argv[])
 	PRVAL(BMAP_OPCNT_TRUNCWAIT);
 	PRVAL(BMAP_OPCNT_UPSCH);
 	PRVAL(BMAP_OPCNT_WORK);
+	PRVAL(BMAP_OPCNT_WRITEBACK);
 	PRVAL(MSL_BMLGET_CBARG_BMAP);
 	PRVAL(MSL_BMLGET_CBARG_COMPL);
 	PRVAL(MSL_BMLGET_CBARG_CSVC);
+	PRVAL(MSTHRT_ACREATE);
+	PRVAL(MSTHRT_ADELETE);
 	PRVAL(MSTHRT_ATTR_FLUSH);
 	PRVAL(MSTHRT_BENCH);
 	PRVAL(MSTHRT_BRELEASE);
@@ -792,6 +845,7 @@ main(int argc, char *argv[])
 	PRVAL(MSTHRT_RCI);
 	PRVAL(MSTHRT_RCM);
 	PRVAL(MSTHRT_READAHEAD);
+	PRVAL(MSTHRT_READHEDGE);
 	PRVAL(MSTHRT_USKLNDPL);
 	PRVAL(MSTHRT_WORKER);
 	PRVAL(NAMECACHELOOKUPF_CLOBBER);
@@ -859,7 +913,9 @@ main(int argc, char *argv[])
 	PRVAL(SLMTHRT_CURSOR);
 	PRVAL(SLMTHRT_DBWORKER);
 	PRVAL(SLMTHRT_FREAP);
+	PRVAL(SLMTHRT_JDISTILL);
 	PRVAL(SLMTHRT_JNAMESPACE);
+	PRVAL(SLMTHRT_JNSBATCH);
 	PRVAL(SLMTHRT_JRECLAIM);
 	PRVAL(SLMTHRT_JRNL);
 	PRVAL(SLMTHRT_LNETAC);
@@ -899,17 +955,22 @@ main(int argc, char *argv[])
 	PRVAL(SRMT_BMAPDIO);
 	PRVAL(SRMT_BMAP_PTRUNC);
 	PRVAL(SRMT_BMAP_WAKE);
+	PRVAL(SRMT_COMPOUND);
 	PRVAL(SRMT_CONNECT);
 	PRVAL(SRMT_CREATE);
+	PRVAL(SRMT_CREATE_BULK);
 	PRVAL(SRMT_CTL);
 	PRVAL(SRMT_EXTENDBMAPLS);
+	PRVAL(SRMT_FIDLEASE);
 	PRVAL(SRMT_GETATTR);
+	PRVAL(SRMT_GETATTR_BULK);
 	PRVAL(SRMT_GETBMAP);
 	PRVAL(SRMT_GETBMAPCRCS);
 	PRVAL(SRMT_GETBMAPMINSEQ);
 	PRVAL(SRMT_GETXATTR);
 	PRVAL(SRMT_GET_INODE);
 	PRVAL(SRMT_IMPORT);
+	PRVAL(SRMT_INLINE_IO);
 	PRVAL(SRMT_LINK);
 	PRVAL(SRMT_LISTXATTR);
 	PRVAL(SRMT_LOOKUP);
@@ -942,6 +1003,7 @@ main(int argc, char *argv[])
 	PRVAL(SRMT_STATFS);
 	PRVAL(SRMT_SYMLINK);
 	PRVAL(SRMT_UNLINK);
+	PRVAL(SRMT_UNLINK_BULK);
 	PRVAL(SRMT_WRITE);
 	PRVAL(UPDT_BMAP);
 	PRVAL(UPDT_HLDROP);